@@ -15,16 +15,36 @@ void console_ui::update() {
             ImGui::EndMenu();
         }
 
+        if (m_duck && m_duck->loading()) {
+            ImGui::Text("Importing rubber duck...");
+        }
+        else if (m_duck && !m_duck->error().empty()) {
+            ImGui::Text("%s", m_duck->error().c_str());
+        }
+
         ImGui::EndMainMenuBar();
     }
 }
 
+void console_ui::render(gfx::render_manager& render_manager) const {
+    if (!m_duck) return;
+
+    const vk::Viewport viewport { 0.0f, 0.0f, static_cast<float>(render_manager.framebuffer_width()),
+                                  static_cast<float>(render_manager.framebuffer_height()), 0.0f, 1.0f };
+
+    render_manager.render([duck = m_duck.get(), viewport](gfx::render_thread& render_thread) {
+        duck->render(render_thread, viewport);
+    });
+}
+
 void console_ui::show_test_scene_cube() {
 
 }
 
 void console_ui::show_test_scene_duck() {
+    if (m_duck) return;
 
+    m_duck = std::make_unique<test_scenes::duck>(*m_vulkan_manager, *m_render_manager, *m_asset_importer, *m_frame_poller);
 }
 
 }
\ No newline at end of file
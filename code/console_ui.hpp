@@ -3,22 +3,42 @@
 
 #pragma once
 
+#include "test_scenes/duck.hpp"
+
+#include <gsl/gsl>
+
+#include <memory>
+
 namespace squadbox {
 
 class console_ui {
 public:
+    console_ui(const gfx::vulkan_manager& vulkan_manager, const gfx::render_manager& render_manager, gfx::asset_importer& asset_importer,
+               gfx::frame_poller& frame_poller)
+        : m_vulkan_manager(&vulkan_manager), m_render_manager(&render_manager), m_asset_importer(&asset_importer),
+          m_frame_poller(&frame_poller) {}
+
     void show() { m_is_visible = true; }
     void hide() { m_is_visible = false; }
     void toggle_visibility() { m_is_visible = !m_is_visible; }
     bool visible() const { return m_is_visible; }
 
     void update();
+    // Between begin_frame() and end_frame(). Draws the test scenes shown.
+    void render(gfx::render_manager& render_manager) const;
 
 private:
     void show_test_scene_cube();
     void show_test_scene_duck();
 
     bool m_is_visible = false;
+
+    gsl::not_null<const gfx::vulkan_manager*> m_vulkan_manager;
+    gsl::not_null<const gfx::render_manager*> m_render_manager;
+    gsl::not_null<gfx::asset_importer*> m_asset_importer;
+    gsl::not_null<gfx::frame_poller*> m_frame_poller;
+
+    std::unique_ptr<test_scenes::duck> m_duck;
 };
 
 }
@@ -0,0 +1,168 @@
+#include "asset_importer.hpp"
+
+#include <assimp/Importer.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+namespace squadbox::gfx {
+
+class asset_importer::mesh_job : public job {
+public:
+    void set_mesh_count(std::size_t count) override { m_meshes.resize(count); }
+    void add_mesh(std::size_t index, imported_mesh&& mesh) override { m_meshes[index] = std::move(mesh); }
+
+    void complete() override { promise.set_value(std::move(m_meshes)); }
+    void fail(std::exception_ptr exception) override { promise.set_exception(exception); }
+
+    std::promise<std::vector<imported_mesh>> promise;
+
+private:
+    std::vector<imported_mesh> m_meshes;
+};
+
+asset_importer::asset_importer(mesh_uploader& mesh_uploader, unsigned int num_threads)
+    : m_mesh_uploader(&mesh_uploader),
+      m_thread_pool(num_threads != 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency())) {
+}
+
+asset_importer::~asset_importer() {
+    m_thread_pool.close();
+    m_thread_pool.join();
+
+    // Finished imports may have copies pending into buffers about to be freed with them.
+    m_mesh_uploader->submit();
+    m_mesh_uploader->wait_idle();
+}
+
+std::future<std::vector<imported_mesh>> asset_importer::import_meshes(const std::string& path, const asset_import_options& options) {
+    auto job = std::make_shared<mesh_job>();
+    auto future = job->promise.get_future();
+
+    start(path, options, std::move(job));
+
+    return future;
+}
+
+void asset_importer::start(const std::string& path, const asset_import_options& options, std::shared_ptr<job> job) {
+    ++m_imports_in_progress;
+
+    m_thread_pool.submit([this, path, options, job] {
+        auto importer = std::make_shared<Assimp::Importer>();
+        auto meshes = std::make_shared<std::vector<const aiMesh*>>();
+
+        try {
+            *meshes = read_triangle_meshes(*importer, path);
+            job->set_mesh_count(meshes->size());
+        }
+        catch (...) {
+            job->set_exception(std::current_exception());
+            finish(job);
+            return;
+        }
+
+        // Meshes are processed side by side; a single mesh spreads its passes across the threads instead.
+        const auto max_threads = meshes->size() == 1 ? 0u : 1u;
+
+        process_meshes(job, meshes->size(), [importer, meshes, options, job, max_threads](std::size_t index) {
+            job->add_mesh(index, process_imported_mesh(*(*meshes)[index], options, max_threads));
+        });
+    });
+}
+
+void asset_importer::start_cooked(const std::string& path, std::shared_ptr<job> job, std::function<void(const cooked_mesh_file&, std::size_t)> load) {
+    ++m_imports_in_progress;
+
+    m_thread_pool.submit([this, path, job, load] {
+        std::shared_ptr<const cooked_mesh_file> file;
+
+        try {
+            file = std::make_shared<const cooked_mesh_file>(path);
+            job->set_mesh_count(file->mesh_count());
+        }
+        catch (...) {
+            job->set_exception(std::current_exception());
+            finish(job);
+            return;
+        }
+
+        process_meshes(job, file->mesh_count(), [file, load](std::size_t index) { load(*file, index); });
+    });
+}
+
+void asset_importer::process_meshes(std::shared_ptr<job> job, std::size_t count, std::function<void(std::size_t)> process) {
+    // One share per mesh task, and one held here until they're all submitted.
+    job->meshes_left = count + 1;
+
+    std::size_t submitted = 0;
+    try {
+        for (; submitted < count; ++submitted) {
+            m_thread_pool.submit([this, job, process, index = submitted] {
+                try {
+                    process(index);
+                }
+                catch (...) {
+                    job->set_exception(std::current_exception());
+                }
+
+                if (--job->meshes_left == 0) finish(job);
+            });
+        }
+    }
+    catch (...) {
+        job->set_exception(std::current_exception());
+    }
+
+    if ((job->meshes_left -= count - submitted + 1) == 0) finish(job);
+}
+
+void asset_importer::finish(std::shared_ptr<job> job) {
+    std::lock_guard<std::mutex> lock(m_finished_mutex);
+    m_finished_jobs.push_back(std::move(job));
+}
+
+void asset_importer::update() {
+    {
+        std::lock_guard<std::mutex> lock(m_finished_mutex);
+
+        // Finished jobs are done writing, so everything they allocated is in the pending batch or an earlier one.
+        const auto upload_batch = m_mesh_uploader->pending_batch();
+        for (auto& job : m_finished_jobs) {
+            job->upload_batch = upload_batch;
+        }
+
+        std::move(m_finished_jobs.begin(), m_finished_jobs.end(), std::back_inserter(m_jobs_to_complete));
+        m_finished_jobs.clear();
+    }
+
+    if (m_jobs_to_complete.empty()) return;
+
+    // Leaves out staging memory other imports are still writing, along with whatever finished jobs share it.
+    m_mesh_uploader->submit();
+
+    bool any_failed = false;
+
+    const auto submitted = std::stable_partition(m_jobs_to_complete.begin(), m_jobs_to_complete.end(), [this](const auto& job) {
+        return !m_mesh_uploader->is_batch_submitted(job->upload_batch);
+    });
+
+    for (auto job = submitted; job != m_jobs_to_complete.end(); ++job) {
+        if ((*job)->exception) {
+            (*job)->fail((*job)->exception);
+            any_failed = true;
+        }
+        else {
+            (*job)->complete();
+        }
+
+        --m_imports_in_progress;
+    }
+
+    // The meshes a failed import did create are freed with it, and may still be copied to. Rare enough to wait for.
+    if (any_failed) m_mesh_uploader->wait_idle();
+
+    m_jobs_to_complete.erase(submitted, m_jobs_to_complete.end());
+}
+
+}
\ No newline at end of file
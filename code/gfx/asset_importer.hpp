@@ -0,0 +1,153 @@
+#ifndef SQUADBOX_GFX_ASSET_IMPORTER_HPP
+#define SQUADBOX_GFX_ASSET_IMPORTER_HPP
+
+#pragma once
+
+#include "cooked_mesh.hpp"
+#include "index_packing.hpp"
+#include "mesh_import.hpp"
+#include "mesh_uploader.hpp"
+
+#include <gsl/gsl>
+#include <boost/thread/executors/basic_thread_pool.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// Loads model files with assimp without blocking the caller. Parsing happens on a worker thread, then every mesh of
+// the file is converted, welded, given normals and optimized as a task of its own, so the meshes of a file are
+// processed side by side. Finished meshes are packed into gpu meshes on the workers, straight into the uploader's
+// staging memory.
+//
+// update() is what hands imports back: called once a frame from the thread submitting frames, it submits the
+// uploads of every import that's done and makes its future ready. A future that's ready is safe to draw from that
+// frame on, and get() never blocks on it.
+class asset_importer {
+public:
+    // 0 worker threads uses every hardware thread.
+    asset_importer(mesh_uploader& mesh_uploader, unsigned int num_threads = 0);
+    asset_importer(const asset_importer&) = delete;
+    // Frame thread only. Waits for imports in progress, and drops them.
+    ~asset_importer();
+
+    // Meshes in the order of the file, without the ones having no triangles.
+    template<typename gpu_mesh_type>
+    std::future<std::vector<gpu_mesh_type>> import(const std::string& path, const asset_import_options& options = {},
+                                                   index_topology topology = index_topology::triangle_list, bool depth_positions = false) {
+        auto job = std::make_shared<gpu_mesh_job<gpu_mesh_type>>(*m_mesh_uploader, topology, depth_positions);
+        auto future = job->promise.get_future();
+
+        start(path, options, std::move(job));
+
+        return future;
+    }
+
+    // Meshes of a file cooked with asset_cooker for gpu_mesh_type's layout. The file is mapped on a worker, then its
+    // meshes are decoded into staging memory side by side, with nothing to parse or process.
+    template<typename gpu_mesh_type>
+    std::future<std::vector<gpu_mesh_type>> import_cooked(const std::string& path) {
+        auto job = std::make_shared<gpu_mesh_job<gpu_mesh_type>>(*m_mesh_uploader, index_topology::triangle_list, false);
+        auto future = job->promise.get_future();
+
+        start_cooked(path, job, [job](const cooked_mesh_file& file, std::size_t index) { job->load_cooked(file, index); });
+
+        return future;
+    }
+
+    // Processed meshes, without uploading them.
+    std::future<std::vector<imported_mesh>> import_meshes(const std::string& path, const asset_import_options& options = {});
+
+    // Frame thread only. Submits the uploads of finished imports and completes them. Never waits for the workers: an
+    // import whose staging memory is shared with a mesh still being written completes on a later call, once the
+    // uploader has submitted it.
+    void update();
+
+    std::size_t imports_in_progress() const { return m_imports_in_progress; }
+
+private:
+    class job {
+    public:
+        virtual ~job() = default;
+
+        // On the workers. Once, when the file is parsed.
+        virtual void set_mesh_count(std::size_t count) = 0;
+        // On the workers, concurrently, once per mesh.
+        virtual void add_mesh(std::size_t index, imported_mesh&& mesh) = 0;
+        // From update().
+        virtual void complete() = 0;
+        virtual void fail(std::exception_ptr exception) = 0;
+
+        // Keeps the first.
+        void set_exception(std::exception_ptr exception) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if (!this->exception) this->exception = exception;
+        }
+
+        std::atomic<std::size_t> meshes_left { 0 };
+        std::mutex exception_mutex;
+        std::exception_ptr exception;
+        // The uploader's pending batch once the job finished, which its meshes go into.
+        std::uint64_t upload_batch = 0;
+    };
+
+    template<typename gpu_mesh_type>
+    class gpu_mesh_job : public job {
+    public:
+        gpu_mesh_job(mesh_uploader& mesh_uploader, index_topology topology, bool depth_positions)
+            : m_mesh_uploader(&mesh_uploader), m_topology(topology), m_depth_positions(depth_positions) {}
+
+        void set_mesh_count(std::size_t count) override { m_meshes.resize(count); }
+
+        // The uploader doesn't submit a mesh until it's fully written.
+        void add_mesh(std::size_t index, imported_mesh&& mesh) override {
+            m_meshes[index] = gpu_mesh_type::create(mesh.mesh, *m_mesh_uploader, m_topology, m_depth_positions);
+        }
+
+        // Like add_mesh().
+        void load_cooked(const cooked_mesh_file& file, std::size_t index) {
+            m_meshes[index] = gpu_mesh_type::load(file, index, *m_mesh_uploader);
+        }
+
+        void complete() override { promise.set_value(std::move(m_meshes)); }
+        void fail(std::exception_ptr exception) override { promise.set_exception(exception); }
+
+        std::promise<std::vector<gpu_mesh_type>> promise;
+
+    private:
+        gsl::not_null<mesh_uploader*> m_mesh_uploader;
+        index_topology m_topology;
+        bool m_depth_positions;
+        std::vector<gpu_mesh_type> m_meshes;
+    };
+
+    class mesh_job;
+
+    void start(const std::string& path, const asset_import_options& options, std::shared_ptr<job> job);
+    void start_cooked(const std::string& path, std::shared_ptr<job> job, std::function<void(const cooked_mesh_file&, std::size_t)> load);
+    // On a worker: runs process for every mesh of the job as a task of its own, and finishes the job after the last.
+    void process_meshes(std::shared_ptr<job> job, std::size_t count, std::function<void(std::size_t)> process);
+    void finish(std::shared_ptr<job> job);
+
+    gsl::not_null<mesh_uploader*> m_mesh_uploader;
+
+    std::mutex m_finished_mutex;
+    std::vector<std::shared_ptr<job>> m_finished_jobs;
+    std::vector<std::shared_ptr<job>> m_jobs_to_complete;
+    std::atomic<std::size_t> m_imports_in_progress { 0 };
+
+    // Last, so the workers are joined before anything they use goes away.
+    boost::basic_thread_pool m_thread_pool;
+};
+
+}
+
+#endif
\ No newline at end of file
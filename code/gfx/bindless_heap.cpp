@@ -0,0 +1,225 @@
+#include "bindless_heap.hpp"
+
+#include "vulkan_manager.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace squadbox::gfx {
+
+bindless_handle::bindless_handle(bindless_handle&& rhs) noexcept
+    : m_heap(rhs.m_heap), m_binding(rhs.m_binding), m_id(rhs.m_id) {
+    rhs.m_heap = nullptr;
+    rhs.m_id = invalid_id;
+}
+
+bindless_handle::~bindless_handle() {
+    reset();
+}
+
+bindless_handle& bindless_handle::operator=(bindless_handle&& rhs) noexcept {
+    if (this != &rhs) {
+        reset();
+
+        m_heap = rhs.m_heap;
+        m_binding = rhs.m_binding;
+        m_id = rhs.m_id;
+
+        rhs.m_heap = nullptr;
+        rhs.m_id = invalid_id;
+    }
+
+    return *this;
+}
+
+void bindless_handle::reset() {
+    if (m_heap) {
+        m_heap->remove(m_binding, m_id);
+    }
+
+    m_heap = nullptr;
+    m_id = invalid_id;
+}
+
+
+std::uint32_t bindless_heap::id_allocator::allocate() {
+    if (!free_ids.empty()) {
+        const auto id = free_ids.back();
+        free_ids.pop_back();
+        return id;
+    }
+
+    if (next_id == capacity) throw std::runtime_error("Bindless heap is full.");
+
+    return next_id++;
+}
+
+bindless_heap::bindless_heap(const vulkan_manager& vulkan_manager,
+                             std::uint32_t max_storage_buffers, std::uint32_t max_sampled_images)
+    : m_device(vulkan_manager.device()) {
+    if (!vulkan_manager.supports_descriptor_indexing()) {
+        throw std::runtime_error("Vulkan: descriptor indexing is not supported by the device.");
+    }
+
+    {
+        vk::PhysicalDeviceProperties2 props;
+        vk::PhysicalDeviceDescriptorIndexingPropertiesEXT descriptor_indexing_props;
+        props.setPNext(&descriptor_indexing_props);
+        vulkan_manager.physical_device().getProperties2(&props);
+
+        max_storage_buffers = std::min(max_storage_buffers, descriptor_indexing_props.maxDescriptorSetUpdateAfterBindStorageBuffers);
+        max_storage_buffers = std::min(max_storage_buffers, descriptor_indexing_props.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+        max_sampled_images = std::min(max_sampled_images, descriptor_indexing_props.maxDescriptorSetUpdateAfterBindSampledImages);
+        max_sampled_images = std::min(max_sampled_images, descriptor_indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    }
+
+    m_storage_buffer_ids.capacity = max_storage_buffers;
+    m_sampled_image_ids.capacity = max_sampled_images;
+
+    m_sampler = [](const vk::Device& device) {
+        vk::SamplerCreateInfo sampler_ci;
+        sampler_ci
+            .setMagFilter(vk::Filter::eLinear)
+            .setMinFilter(vk::Filter::eLinear)
+            .setMipmapMode(vk::SamplerMipmapMode::eLinear)
+            .setAddressModeU(vk::SamplerAddressMode::eRepeat)
+            .setAddressModeV(vk::SamplerAddressMode::eRepeat)
+            .setAddressModeW(vk::SamplerAddressMode::eRepeat)
+            .setMaxLod(VK_LOD_CLAMP_NONE);
+
+        return device.createSamplerUnique(sampler_ci);
+    }(m_device);
+
+    m_descriptor_set_layout = [](const vk::Device& device, const vk::Sampler& sampler,
+                                 std::uint32_t max_storage_buffers, std::uint32_t max_sampled_images) {
+        std::array<vk::DescriptorSetLayoutBinding, 3> layout_bindings;
+        layout_bindings[0]
+            .setBinding(storage_buffer_binding)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(vk::ShaderStageFlagBits::eAll)
+            .setDescriptorCount(max_storage_buffers);
+
+        layout_bindings[1]
+            .setBinding(sampled_image_binding)
+            .setDescriptorType(vk::DescriptorType::eSampledImage)
+            .setStageFlags(vk::ShaderStageFlagBits::eAll)
+            .setDescriptorCount(max_sampled_images);
+
+        layout_bindings[2]
+            .setBinding(sampler_binding)
+            .setDescriptorType(vk::DescriptorType::eSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eAll)
+            .setDescriptorCount(1)
+            .setPImmutableSamplers(&sampler);
+
+        const vk::DescriptorBindingFlagsEXT array_binding_flags
+            = vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind
+            | vk::DescriptorBindingFlagBitsEXT::eUpdateUnusedWhilePending
+            | vk::DescriptorBindingFlagBitsEXT::ePartiallyBound;
+
+        std::array<vk::DescriptorBindingFlagsEXT, 3> binding_flags = { array_binding_flags, array_binding_flags, {} };
+
+        vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_ci;
+        binding_flags_ci
+            .setPBindingFlags(binding_flags.data())
+            .setBindingCount(binding_flags.size());
+
+        vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_ci;
+        descriptor_set_layout_ci
+            .setPNext(&binding_flags_ci)
+            .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT)
+            .setPBindings(layout_bindings.data())
+            .setBindingCount(layout_bindings.size());
+
+        return device.createDescriptorSetLayoutUnique(descriptor_set_layout_ci);
+    }(m_device, m_sampler.get(), max_storage_buffers, max_sampled_images);
+
+    m_descriptor_pool = [](const vk::Device& device, std::uint32_t max_storage_buffers, std::uint32_t max_sampled_images) {
+        std::array<vk::DescriptorPoolSize, 3> descriptor_pool_sizes = {
+            vk::DescriptorPoolSize { vk::DescriptorType::eStorageBuffer, max_storage_buffers },
+            vk::DescriptorPoolSize { vk::DescriptorType::eSampledImage, max_sampled_images },
+            vk::DescriptorPoolSize { vk::DescriptorType::eSampler, 1 },
+        };
+
+        vk::DescriptorPoolCreateInfo descriptor_pool_ci;
+        descriptor_pool_ci
+            .setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT)
+            .setPPoolSizes(descriptor_pool_sizes.data())
+            .setPoolSizeCount(descriptor_pool_sizes.size())
+            .setMaxSets(1);
+
+        return device.createDescriptorPoolUnique(descriptor_pool_ci);
+    }(m_device, max_storage_buffers, max_sampled_images);
+
+    m_descriptor_set = [](const vk::Device& device, const vk::DescriptorSetLayout& layout, const vk::DescriptorPool& pool) {
+        vk::DescriptorSetAllocateInfo descriptor_set_alloc_info;
+        descriptor_set_alloc_info
+            .setDescriptorPool(pool)
+            .setPSetLayouts(&layout)
+            .setDescriptorSetCount(1);
+
+        return device.allocateDescriptorSets(descriptor_set_alloc_info)[0];
+    }(m_device, m_descriptor_set_layout.get(), m_descriptor_pool.get());
+}
+
+bindless_handle bindless_heap::add_storage_buffer(const vk::Buffer& buffer, vk::DeviceSize offset, vk::DeviceSize range) {
+    std::uint32_t id;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        id = m_storage_buffer_ids.allocate();
+    }
+
+    vk::DescriptorBufferInfo buffer_info { buffer, offset, range };
+
+    vk::WriteDescriptorSet write;
+    write
+        .setDstSet(m_descriptor_set)
+        .setDstBinding(storage_buffer_binding)
+        .setDstArrayElement(id)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setDescriptorCount(1)
+        .setPBufferInfo(&buffer_info);
+
+    m_device.updateDescriptorSets({ write }, nullptr);
+
+    return bindless_handle { this, storage_buffer_binding, id };
+}
+
+bindless_handle bindless_heap::add_sampled_image(const vk::ImageView& image_view, vk::ImageLayout layout) {
+    std::uint32_t id;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        id = m_sampled_image_ids.allocate();
+    }
+
+    vk::DescriptorImageInfo image_info { nullptr, image_view, layout };
+
+    vk::WriteDescriptorSet write;
+    write
+        .setDstSet(m_descriptor_set)
+        .setDstBinding(sampled_image_binding)
+        .setDstArrayElement(id)
+        .setDescriptorType(vk::DescriptorType::eSampledImage)
+        .setDescriptorCount(1)
+        .setPImageInfo(&image_info);
+
+    m_device.updateDescriptorSets({ write }, nullptr);
+
+    return bindless_handle { this, sampled_image_binding, id };
+}
+
+void bindless_heap::remove(std::uint32_t binding, std::uint32_t id) {
+    // The descriptor itself is left as is; partially bound arrays allow stale entries that are never accessed.
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (binding == storage_buffer_binding) {
+        m_storage_buffer_ids.free(id);
+    }
+    else {
+        m_sampled_image_ids.free(id);
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef SQUADBOX_GFX_BINDLESS_HEAP_HPP
+#define SQUADBOX_GFX_BINDLESS_HEAP_HPP
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace squadbox::gfx {
+
+class vulkan_manager;
+class bindless_heap;
+
+// Owns a slot in a bindless_heap and releases it on destruction.
+class bindless_handle {
+public:
+    friend class bindless_heap;
+
+    static constexpr std::uint32_t invalid_id = std::numeric_limits<std::uint32_t>::max();
+
+    bindless_handle() = default;
+    bindless_handle(const bindless_handle&) = delete;
+    bindless_handle(bindless_handle&& rhs) noexcept;
+    ~bindless_handle();
+
+    bindless_handle& operator=(const bindless_handle&) = delete;
+    bindless_handle& operator=(bindless_handle&& rhs) noexcept;
+
+    std::uint32_t id() const { return m_id; }
+    bool is_valid() const { return m_heap != nullptr; }
+
+    void reset();
+
+private:
+    bindless_handle(bindless_heap* heap, std::uint32_t binding, std::uint32_t id)
+        : m_heap(heap), m_binding(binding), m_id(id) {}
+
+    bindless_heap* m_heap = nullptr;
+    std::uint32_t m_binding = 0;
+    std::uint32_t m_id = invalid_id;
+};
+
+
+// One global, update-after-bind descriptor set holding large arrays of storage buffers and
+// sampled images (VK_EXT_descriptor_indexing). Resources are registered once and then referred
+// to by their index, usually passed per draw through push constants, so draws never have to
+// bind descriptor sets of their own.
+//
+// set = 0, binding = 0: readonly buffer ... [] (storage buffers)
+// set = 0, binding = 1: texture2D [] (sampled images)
+// set = 0, binding = 2: sampler (linear, repeat)
+//
+// A resource must stay registered until every frame that used its id has retired. Handles
+// kept alive through draw_packet::resources satisfy this.
+class bindless_heap {
+public:
+    friend class bindless_handle;
+
+    static constexpr std::uint32_t storage_buffer_binding = 0;
+    static constexpr std::uint32_t sampled_image_binding = 1;
+    static constexpr std::uint32_t sampler_binding = 2;
+
+    bindless_heap(const vulkan_manager& vulkan_manager,
+                  std::uint32_t max_storage_buffers = 16 * 1024, std::uint32_t max_sampled_images = 4 * 1024);
+
+    bindless_heap(const bindless_heap&) = delete;
+    bindless_heap& operator=(const bindless_heap&) = delete;
+
+    const vk::DescriptorSetLayout& descriptor_set_layout() const { return m_descriptor_set_layout.get(); }
+    const vk::DescriptorSet& descriptor_set() const { return m_descriptor_set; }
+
+    bindless_handle add_storage_buffer(const vk::Buffer& buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+    bindless_handle add_sampled_image(const vk::ImageView& image_view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    std::uint32_t max_storage_buffers() const { return m_storage_buffer_ids.capacity; }
+    std::uint32_t max_sampled_images() const { return m_sampled_image_ids.capacity; }
+
+private:
+    struct id_allocator {
+        std::uint32_t capacity = 0;
+        std::uint32_t next_id = 0;
+        std::vector<std::uint32_t> free_ids;
+
+        std::uint32_t allocate();
+        void free(std::uint32_t id) { free_ids.push_back(id); }
+    };
+
+    void remove(std::uint32_t binding, std::uint32_t id);
+
+    vk::Device m_device;
+    vk::UniqueSampler m_sampler;
+    vk::UniqueDescriptorSetLayout m_descriptor_set_layout;
+    vk::UniqueDescriptorPool m_descriptor_pool;
+    vk::DescriptorSet m_descriptor_set;
+
+    std::mutex m_mutex;
+    id_allocator m_storage_buffer_ids;
+    id_allocator m_sampled_image_ids;
+};
+
+}
+
+#endif
\ No newline at end of file
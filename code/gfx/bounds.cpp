@@ -0,0 +1,97 @@
+#include "bounds.hpp"
+
+#include <algorithm>
+
+namespace squadbox::gfx {
+
+aabb aabb::from_points(gsl::span<const glm::vec3> points) {
+    if (points.empty()) return {};
+
+    glm::vec3 min_corner = points[0];
+    glm::vec3 max_corner = points[0];
+
+    for (const auto& point : points) {
+        min_corner = glm::min(min_corner, point);
+        max_corner = glm::max(max_corner, point);
+    }
+
+    return { min_corner, max_corner };
+}
+
+aabb aabb::from_center_extents(const glm::vec3& center, const glm::vec3& extents) {
+    return { center - extents, center + extents };
+}
+
+aabb aabb::transformed(const glm::mat4& transform) const {
+    // Arvo: each axis of the new box spans the absolute projection of the old extents.
+    const auto new_center = glm::vec3 { transform * glm::vec4 { center(), 1.0f } };
+    const auto old_extents = extents();
+    const auto new_extents
+        = glm::abs(glm::vec3 { transform[0] }) * old_extents.x
+        + glm::abs(glm::vec3 { transform[1] }) * old_extents.y
+        + glm::abs(glm::vec3 { transform[2] }) * old_extents.z;
+
+    return from_center_extents(new_center, new_extents);
+}
+
+
+bounding_sphere bounding_sphere::from_points(gsl::span<const glm::vec3> points, const aabb& bounds) {
+    bounding_sphere result;
+    result.center = bounds.center();
+
+    float radius_squared = 0.0f;
+    for (const auto& point : points) {
+        const auto offset = point - result.center;
+        radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+    }
+
+    result.radius = glm::sqrt(radius_squared);
+
+    return result;
+}
+
+
+frustum frustum::from_view_projection(const glm::mat4& view_projection) {
+    // Gribb & Hartmann. glm is column major, so rows are gathered across columns.
+    const auto row = [&view_projection](int i) {
+        return glm::vec4 { view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i] };
+    };
+
+    frustum result;
+    result.m_planes = {
+        row(3) + row(0),
+        row(3) - row(0),
+        row(3) + row(1),
+        row(3) - row(1),
+        row(2),
+        row(3) - row(2)
+    };
+
+    for (auto& plane : result.m_planes) {
+        plane /= glm::length(glm::vec3 { plane });
+    }
+
+    return result;
+}
+
+bool frustum::intersects(const aabb& bounds) const {
+    const auto center = bounds.center();
+    const auto extents = bounds.extents();
+
+    for (const auto& plane : m_planes) {
+        const auto normal = glm::vec3 { plane };
+        if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extents) < 0.0f) return false;
+    }
+
+    return true;
+}
+
+bool frustum::intersects(const bounding_sphere& bounds) const {
+    for (const auto& plane : m_planes) {
+        if (glm::dot(glm::vec3 { plane }, bounds.center) + plane.w < -bounds.radius) return false;
+    }
+
+    return true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef SQUADBOX_GFX_BOUNDS_HPP
+#define SQUADBOX_GFX_BOUNDS_HPP
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <gsl/gsl>
+
+#include <array>
+
+namespace squadbox::gfx {
+
+class aabb {
+public:
+    aabb() = default;
+
+    aabb(const glm::vec3& min_corner, const glm::vec3& max_corner)
+        : m_min_corner(min_corner), m_max_corner(max_corner) {}
+
+    static aabb from_points(gsl::span<const glm::vec3> points);
+    static aabb from_center_extents(const glm::vec3& center, const glm::vec3& extents);
+
+    const glm::vec3& min_corner() const { return m_min_corner; }
+    const glm::vec3& max_corner() const { return m_max_corner; }
+
+    glm::vec3 center() const { return (m_min_corner + m_max_corner) * 0.5f; }
+    glm::vec3 extents() const { return (m_max_corner - m_min_corner) * 0.5f; }
+
+    // Box enclosing this one after an affine transform.
+    aabb transformed(const glm::mat4& transform) const;
+
+private:
+    glm::vec3 m_min_corner = {};
+    glm::vec3 m_max_corner = {};
+};
+
+
+struct bounding_sphere {
+    glm::vec3 center = {};
+    float radius = 0.0f;
+
+    // Centered on the points' box, so not minimal, but never looser than the box itself.
+    static bounding_sphere from_points(gsl::span<const glm::vec3> points, const aabb& bounds);
+
+    glm::vec4 packed() const { return { center, radius }; }
+};
+
+
+// Planes point inwards as (normal, distance), in left, right, bottom, top, near, far order.
+class frustum {
+public:
+    // Expects Vulkan's [0, 1] clip space depth range. Planes are in whatever space the matrix maps from.
+    static frustum from_view_projection(const glm::mat4& view_projection);
+
+    const std::array<glm::vec4, 6>& planes() const { return m_planes; }
+
+    bool intersects(const aabb& bounds) const;
+    bool intersects(const bounding_sphere& bounds) const;
+
+private:
+    std::array<glm::vec4, 6> m_planes;
+};
+
+}
+
+#endif
\ No newline at end of file
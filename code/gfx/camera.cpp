@@ -24,7 +24,12 @@ const glm::mat4& camera::projection_matrix() const {
 
 
 glm::vec3 camera::position() const {
-    return m_view_matrix[3];
+    // The view matrix's translation is the world origin in view space, not the camera in world space.
+    return glm::inverse(m_view_matrix)[3];
+}
+
+frustum camera::view_frustum() const {
+    return frustum::from_view_projection(m_projection_matrix * m_view_matrix);
 }
 
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef SQUADBOX_GFX_CAMERA_HPP
 #define SQUADBOX_GFX_CAMERA_HPP
 
+#include "bounds.hpp"
+
 #include <glm/glm.hpp>
 
 namespace squadbox::gfx {
@@ -15,6 +17,9 @@ public:
     const glm::mat4& projection_matrix() const;
     glm::vec3 position() const;
 
+    // World space view frustum, for culling before anything is recorded.
+    frustum view_frustum() const;
+
 private:
     glm::mat4 m_view_matrix;
     glm::mat4 m_projection_matrix;
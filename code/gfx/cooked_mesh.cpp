@@ -0,0 +1,401 @@
+#include "cooked_mesh.hpp"
+
+#include "mesh_codec.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace squadbox::gfx {
+
+namespace {
+    constexpr std::uint64_t cooked_alignment = 16;
+
+    // vk::PrimitiveTopology values gpu_mesh::cook() writes.
+    constexpr std::uint32_t topology_triangle_list = 3;
+    constexpr std::uint32_t topology_triangle_strip = 4;
+
+    std::uint64_t align_up(std::uint64_t offset, std::uint64_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    // Whether count elements of the given size at offset lie within the file, without overflowing.
+    bool in_file(std::uint64_t offset, std::uint64_t count, std::uint64_t element_size, std::uint64_t file_size) {
+        if (offset > file_size) return false;
+        return count <= (file_size - offset) / element_size;
+    }
+
+    bool valid_stream(const cooked_stream& stream, std::uint64_t data_size, std::uint64_t encoded_size) {
+        if (stream.element_size == 0) return false;
+        if (!in_file(stream.buffer_offset, stream.element_count, stream.element_size, data_size)) return false;
+        if (!in_file(stream.encoded_offset, stream.encoded_size, 1, encoded_size)) return false;
+
+        switch (stream.codec) {
+        case cooked_stream_codec::none:
+            return stream.encoded_size == static_cast<std::uint64_t>(stream.element_size) * stream.element_count;
+        case cooked_stream_codec::vertices:
+            return stream.element_size <= max_encoded_vertex_size;
+        case cooked_stream_codec::triangle_indices:
+            return (stream.element_size == 2 || stream.element_size == 4) && stream.element_count % 3 == 0;
+        case cooked_stream_codec::index_sequence:
+            return stream.element_size == 2 || stream.element_size == 4;
+        default:
+            return false;
+        }
+    }
+
+    // Whether every range within the index buffer lies within it.
+    template<typename range_type>
+    bool valid_index_ranges(gsl::span<const range_type> ranges, std::uint32_t index_count) {
+        return std::all_of(ranges.begin(), ranges.end(), [index_count](const range_type& range) {
+            return static_cast<std::uint64_t>(range.first_index) + range.index_count <= index_count;
+        });
+    }
+
+    // Whether the streams are the ones gpu_mesh::cook() lays out: a vertex stream per vertex buffer, then the depth
+    // positions if any, then the indices, each at the offset the desc has for it. Within the buffer since the streams
+    // are checked to be.
+    bool valid_layout(const cooked_mesh_desc& desc) {
+        if (desc.num_vertex_buffers == 0) return false;
+        if (desc.has_depth_positions > 1) return false;
+        if (desc.stream_count != desc.num_vertex_buffers + desc.has_depth_positions + 1) return false;
+
+        // vk::IndexType::eUint16 and eUint32.
+        const std::uint32_t index_size = desc.index_type == 0 ? 2 : desc.index_type == 1 ? 4 : 0;
+
+        const auto& index_stream = desc.streams[desc.stream_count - 1];
+        if (index_stream.buffer_offset != desc.index_buffer_offset || index_stream.element_size != index_size
+            || index_stream.element_count != desc.index_count) {
+            return false;
+        }
+
+        // Lists and strips are encoded with their own codecs, if at all.
+        switch (desc.topology) {
+        case topology_triangle_list:
+            if (index_stream.codec != cooked_stream_codec::none && index_stream.codec != cooked_stream_codec::triangle_indices) return false;
+            break;
+        case topology_triangle_strip:
+            if (index_stream.codec != cooked_stream_codec::none && index_stream.codec != cooked_stream_codec::index_sequence) return false;
+            break;
+        default:
+            return false;
+        }
+
+        const auto vertex_count = desc.streams[0].element_count;
+        for (std::uint32_t buffer = 0; buffer < desc.num_vertex_buffers; ++buffer) {
+            const auto& stream = desc.streams[buffer];
+            if (stream.buffer_offset != desc.vertex_buffer_offsets[buffer] || stream.element_count != vertex_count) return false;
+        }
+
+        if (desc.has_depth_positions) {
+            const auto& stream = desc.streams[desc.num_vertex_buffers];
+            if (stream.buffer_offset != desc.depth_vertex_buffer_offset || stream.element_count != vertex_count) return false;
+        }
+
+        return true;
+    }
+
+    // Whether every index names one of the vertices, or, in strips, is the restart index.
+    template<typename index_type>
+    bool valid_indices(gsl::span<const std::byte> indices, std::uint64_t vertex_count, bool strips) {
+        const auto first = reinterpret_cast<const index_type*>(indices.data());
+        const auto last = first + indices.size() / sizeof(index_type);
+
+        return std::all_of(first, last, [vertex_count, strips](index_type index) {
+            return index < vertex_count || (strips && index == std::numeric_limits<index_type>::max());
+        });
+    }
+
+    std::vector<std::byte> encode_stream(const cooked_stream& stream, gsl::span<const std::byte> elements) {
+        switch (stream.codec) {
+        case cooked_stream_codec::vertices:
+            return encode_vertex_stream(elements, stream.element_size);
+        case cooked_stream_codec::triangle_indices:
+            return encode_triangle_indices(elements, stream.element_size);
+        case cooked_stream_codec::index_sequence:
+            return encode_index_sequence(elements, stream.element_size);
+        default:
+            return { elements.begin(), elements.end() };
+        }
+    }
+}
+
+void write_cooked_meshes(const std::string& path, gsl::span<const cooked_mesh> meshes, bool compress) {
+    cooked_mesh_file_header header;
+    header.mesh_count = static_cast<std::uint32_t>(meshes.size());
+
+    std::vector<cooked_mesh_desc> descs;
+    descs.reserve(meshes.size());
+
+    // Every mesh's streams, back to back.
+    std::vector<std::vector<std::byte>> encoded_data(meshes.size());
+
+    std::uint64_t offset = sizeof(cooked_mesh_file_header) + sizeof(cooked_mesh_desc) * meshes.size();
+
+    for (std::ptrdiff_t i = 0; i < meshes.size(); ++i) {
+        const auto& mesh = meshes[i];
+
+        auto desc = mesh.desc;
+        desc.lod_count = static_cast<std::uint32_t>(mesh.lods.size());
+        desc.meshlet_count = static_cast<std::uint32_t>(mesh.meshlets.size());
+        desc.data_size = mesh.data.size();
+
+        auto& encoded = encoded_data[i];
+        for (std::uint32_t stream_index = 0; stream_index < desc.stream_count; ++stream_index) {
+            auto& stream = desc.streams[stream_index];
+            if (!compress) stream.codec = cooked_stream_codec::none;
+
+            const auto elements = gsl::make_span(mesh.data).subspan(static_cast<std::ptrdiff_t>(stream.buffer_offset),
+                                                                   static_cast<std::ptrdiff_t>(stream.element_size) * stream.element_count);
+            const auto encoded_stream = encode_stream(stream, elements);
+
+            stream.encoded_offset = encoded.size();
+            stream.encoded_size = encoded_stream.size();
+            encoded.insert(encoded.end(), encoded_stream.begin(), encoded_stream.end());
+        }
+
+        desc.encoded_size = encoded.size();
+
+        desc.lods_offset = offset = align_up(offset, cooked_alignment);
+        offset += sizeof(mesh_lod) * mesh.lods.size();
+        desc.meshlets_offset = offset = align_up(offset, cooked_alignment);
+        offset += sizeof(meshlet) * mesh.meshlets.size();
+        desc.data_offset = offset = align_up(offset, cooked_alignment);
+        offset += encoded.size();
+
+        descs.push_back(desc);
+    }
+
+    std::ofstream file(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("cooked_mesh: can't open " + path + " for writing.");
+    }
+
+    std::uint64_t written = 0;
+    auto write = [&file, &written](std::uint64_t at, const void* data, std::size_t size) {
+        static const char padding[cooked_alignment] = {};
+        file.write(padding, static_cast<std::streamsize>(at - written));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        written = at + size;
+    };
+
+    write(0, &header, sizeof(header));
+    write(written, descs.data(), sizeof(cooked_mesh_desc) * descs.size());
+
+    for (std::ptrdiff_t i = 0; i < meshes.size(); ++i) {
+        write(descs[i].lods_offset, meshes[i].lods.data(), sizeof(mesh_lod) * meshes[i].lods.size());
+        write(descs[i].meshlets_offset, meshes[i].meshlets.data(), sizeof(meshlet) * meshes[i].meshlets.size());
+        write(descs[i].data_offset, encoded_data[i].data(), encoded_data[i].size());
+    }
+
+    if (!file.flush()) {
+        throw std::runtime_error("cooked_mesh: can't write " + path + ".");
+    }
+}
+
+cooked_mesh_file::cooked_mesh_file(const std::string& path) {
+#if defined(_WIN32)
+    const auto file = CreateFileW(std::filesystem::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("cooked_mesh: can't open " + path + ".");
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        throw std::runtime_error("cooked_mesh: " + path + " is empty.");
+    }
+
+    // The view keeps the file and the mapping open on its own.
+    const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        throw std::runtime_error("cooked_mesh: can't map " + path + ".");
+    }
+
+    m_mapping = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    if (!m_mapping) {
+        throw std::runtime_error("cooked_mesh: can't map " + path + ".");
+    }
+
+    m_size = static_cast<std::size_t>(size.QuadPart);
+#else
+    const auto file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        throw std::runtime_error("cooked_mesh: can't open " + path + ".");
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(file);
+        throw std::runtime_error("cooked_mesh: " + path + " is empty.");
+    }
+
+    m_size = static_cast<std::size_t>(file_stat.st_size);
+
+    // The mapping keeps the file open on its own.
+    const auto mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("cooked_mesh: can't map " + path + ".");
+    }
+
+    // Everything is read once, front to back: read ahead aggressively and drop pages behind.
+    madvise(mapping, m_size, MADV_SEQUENTIAL);
+    madvise(mapping, m_size, MADV_WILLNEED);
+
+    m_mapping = static_cast<const std::byte*>(mapping);
+#endif
+
+    try {
+        if (m_size < sizeof(cooked_mesh_file_header)) {
+            throw std::runtime_error("cooked_mesh: " + path + " is too small to be a cooked file.");
+        }
+
+        const auto& header = *reinterpret_cast<const cooked_mesh_file_header*>(m_mapping);
+        if (header.magic != cooked_mesh_magic) {
+            throw std::runtime_error("cooked_mesh: " + path + " isn't a cooked file.");
+        }
+
+        if (header.version != cooked_mesh_version) {
+            throw std::runtime_error("cooked_mesh: " + path + " is version " + std::to_string(header.version) + ", expected version "
+                                     + std::to_string(cooked_mesh_version) + ". Cook it again.");
+        }
+
+        if (!in_file(sizeof(cooked_mesh_file_header), header.mesh_count, sizeof(cooked_mesh_desc), m_size)) {
+            throw std::runtime_error("cooked_mesh: " + path + " is truncated.");
+        }
+
+        m_descs = gsl::make_span(reinterpret_cast<const cooked_mesh_desc*>(m_mapping + sizeof(cooked_mesh_file_header)), header.mesh_count);
+
+        for (const auto& desc : m_descs) {
+            bool valid = in_file(desc.data_offset, desc.encoded_size, 1, m_size)
+                      && in_file(desc.lods_offset, desc.lod_count, sizeof(mesh_lod), m_size)
+                      && in_file(desc.meshlets_offset, desc.meshlet_count, sizeof(meshlet), m_size)
+                      && desc.lods_offset % alignof(mesh_lod) == 0
+                      && desc.meshlets_offset % alignof(meshlet) == 0
+                      && desc.lod_count != 0
+                      && desc.num_vertex_buffers <= max_cooked_vertex_buffers
+                      && desc.stream_count <= max_cooked_streams;
+
+            for (std::uint32_t stream = 0; valid && stream < desc.stream_count; ++stream) {
+                valid = valid_stream(desc.streams[stream], desc.data_size, desc.encoded_size);
+            }
+
+            // The offsets gpu_mesh::load() binds and the ranges it draws, which the checks above make safe to read.
+            valid = valid
+                 && valid_layout(desc)
+                 && valid_index_ranges(gsl::make_span(reinterpret_cast<const mesh_lod*>(m_mapping + desc.lods_offset), desc.lod_count), desc.index_count)
+                 && valid_index_ranges(gsl::make_span(reinterpret_cast<const meshlet*>(m_mapping + desc.meshlets_offset), desc.meshlet_count), desc.index_count);
+
+            if (!valid) {
+                throw std::runtime_error("cooked_mesh: " + path + " is truncated or corrupt.");
+            }
+        }
+    }
+    catch (...) {
+        unmap();
+        throw;
+    }
+}
+
+cooked_mesh_file::~cooked_mesh_file() {
+    unmap();
+}
+
+void cooked_mesh_file::unmap() {
+    if (!m_mapping) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(m_mapping);
+#else
+    munmap(const_cast<std::byte*>(m_mapping), m_size);
+#endif
+
+    m_mapping = nullptr;
+}
+
+gsl::span<const std::byte> cooked_mesh_file::encoded_data(std::size_t index) const {
+    const auto& desc = m_descs[index];
+    return gsl::make_span(m_mapping + desc.data_offset, static_cast<std::ptrdiff_t>(desc.encoded_size));
+}
+
+gsl::span<const mesh_lod> cooked_mesh_file::lods(std::size_t index) const {
+    const auto& desc = m_descs[index];
+    return gsl::make_span(reinterpret_cast<const mesh_lod*>(m_mapping + desc.lods_offset), desc.lod_count);
+}
+
+gsl::span<const meshlet> cooked_mesh_file::meshlets(std::size_t index) const {
+    const auto& desc = m_descs[index];
+    return gsl::make_span(reinterpret_cast<const meshlet*>(m_mapping + desc.meshlets_offset), desc.meshlet_count);
+}
+
+void cooked_mesh_file::decode(std::size_t index, gsl::span<std::byte> buffer) const {
+    const auto& desc = m_descs[index];
+    assert(static_cast<std::uint64_t>(buffer.size()) == desc.data_size);
+
+    const auto encoded = encoded_data(index);
+
+    // The indices are decoded aside to be checked, as the buffer is likely staging memory, which is slow to read.
+    thread_local std::vector<std::byte> indices;
+    const auto index_stream = desc.stream_count - 1;
+
+    for (std::uint32_t stream_index = 0; stream_index < desc.stream_count; ++stream_index) {
+        const auto& stream = desc.streams[stream_index];
+        const auto source = encoded.subspan(static_cast<std::ptrdiff_t>(stream.encoded_offset), static_cast<std::ptrdiff_t>(stream.encoded_size));
+        auto destination = buffer.subspan(static_cast<std::ptrdiff_t>(stream.buffer_offset),
+                                          static_cast<std::ptrdiff_t>(stream.element_size) * stream.element_count);
+
+        if (stream_index == index_stream) {
+            indices.resize(static_cast<std::size_t>(destination.size()));
+            destination = gsl::make_span(indices.data(), destination.size());
+        }
+
+        switch (stream.codec) {
+        case cooked_stream_codec::none:
+            std::memcpy(destination.data(), source.data(), source.size());
+            break;
+        case cooked_stream_codec::vertices:
+            decode_vertex_stream(source, stream.element_size, destination);
+            break;
+        case cooked_stream_codec::triangle_indices:
+            decode_triangle_indices(source, stream.element_size, destination);
+            break;
+        case cooked_stream_codec::index_sequence:
+            decode_index_sequence(source, stream.element_size, destination);
+            break;
+        }
+    }
+
+    const auto& stream = desc.streams[index_stream];
+    const auto vertex_count = desc.streams[0].element_count;
+    const bool strips = desc.topology == topology_triangle_strip;
+
+    const bool valid = stream.element_size == 2
+        ? valid_indices<std::uint16_t>(indices, vertex_count, strips)
+        : valid_indices<std::uint32_t>(indices, vertex_count, strips);
+
+    if (!valid) {
+        throw std::runtime_error("cooked_mesh: an index is out of the mesh's vertex range.");
+    }
+
+    std::memcpy(buffer.data() + stream.buffer_offset, indices.data(), indices.size());
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#ifndef SQUADBOX_GFX_COOKED_MESH_HPP
+#define SQUADBOX_GFX_COOKED_MESH_HPP
+
+#pragma once
+
+#include "mesh_lod.hpp"
+#include "meshlet.hpp"
+
+#include <gsl/gsl>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// Meshes as gpu_mesh::cook() lays them out, ready to be decoded into a buffer. A file is:
+//
+//   cooked_mesh_file_header
+//   cooked_mesh_desc, one per mesh
+//   per mesh: its levels of detail, meshlets and encoded buffer contents, each 16 byte aligned, at the offsets in its desc
+//
+// A buffer is stored as the streams it's made of, each compressed with the mesh_codec suited to it, or as is.
+// Everything else is stored the way this build lays it out in memory (little endian, this compiler's struct layout),
+// so files are cooked for the platform loading them. Bump cooked_mesh_version whenever any of it changes.
+constexpr std::uint32_t cooked_mesh_version = 2;
+constexpr std::array<char, 4> cooked_mesh_magic = { 'S', 'Q', 'B', 'M' };
+constexpr std::uint32_t max_cooked_vertex_buffers = 4;
+// The vertex buffers, the depth positions and the indices.
+constexpr std::uint32_t max_cooked_streams = max_cooked_vertex_buffers + 2;
+
+struct cooked_mesh_file_header {
+    std::array<char, 4> magic = cooked_mesh_magic;
+    std::uint32_t version = cooked_mesh_version;
+    std::uint32_t mesh_count = 0;
+    std::uint32_t reserved = 0;
+};
+
+enum class cooked_stream_codec : std::uint32_t {
+    none,
+    vertices,
+    triangle_indices,
+    index_sequence
+};
+
+// A stream of elements within a buffer.
+struct cooked_stream {
+    std::uint64_t buffer_offset = 0;
+    // Within the mesh's encoded data.
+    std::uint64_t encoded_offset = 0;
+    std::uint64_t encoded_size = 0;
+    std::uint32_t element_size = 0;
+    std::uint32_t element_count = 0;
+    cooked_stream_codec codec = cooked_stream_codec::none;
+    std::uint32_t reserved = 0;
+};
+
+struct cooked_mesh_desc {
+    // gpu_mesh::layout_id() of the layout the buffer is in.
+    std::uint64_t layout_id = 0;
+
+    // File offsets.
+    std::uint64_t data_offset = 0;
+    std::uint64_t lods_offset = 0;
+    std::uint64_t meshlets_offset = 0;
+
+    // Of the buffer, and of its encoded streams in the file.
+    std::uint64_t data_size = 0;
+    std::uint64_t encoded_size = 0;
+
+    // Offsets within the buffer.
+    std::array<std::uint64_t, max_cooked_vertex_buffers> vertex_buffer_offsets = {};
+    std::uint64_t depth_vertex_buffer_offset = 0;
+    std::uint64_t index_buffer_offset = 0;
+
+    std::uint32_t num_vertex_buffers = 0;
+    std::uint32_t has_depth_positions = 0;
+    std::uint32_t lod_count = 0;
+    std::uint32_t meshlet_count = 0;
+    std::uint32_t index_count = 0;
+    // vk::IndexType and vk::PrimitiveTopology values.
+    std::uint32_t index_type = 0;
+    std::uint32_t topology = 0;
+    std::uint32_t stream_count = 0;
+
+    std::array<cooked_stream, max_cooked_streams> streams = {};
+
+    std::array<float, 3> bounds_min = {};
+    std::array<float, 3> bounds_max = {};
+    std::array<float, 4> bounding_sphere = {};     // center, radius
+    std::array<float, 16> position_decode_matrix = {};
+};
+
+static_assert(std::is_trivially_copyable_v<cooked_mesh_desc>);
+static_assert(std::is_trivially_copyable_v<cooked_stream>);
+static_assert(std::is_trivially_copyable_v<mesh_lod>);
+static_assert(std::is_trivially_copyable_v<meshlet>);
+
+// One mesh on its way into a file: its buffer as is, with the streams it's made of in the desc. write_cooked_meshes()
+// encodes them and fills in the file offsets and encoded sizes.
+struct cooked_mesh {
+    cooked_mesh_desc desc;
+    std::vector<std::byte> data;
+    std::vector<mesh_lod> lods;
+    std::vector<meshlet> meshlets;
+};
+
+// Without compress, streams are stored as is. Throws if the file can't be written.
+void write_cooked_meshes(const std::string& path, gsl::span<const cooked_mesh> meshes, bool compress = true);
+
+// A cooked file mapped into memory, read only. Nothing is read up front but the descs and the levels of detail and
+// meshlets, which are checked to lie within the file, to describe streams within their buffers laid out the way
+// gpu_mesh::cook() lays them out, and to draw index ranges within the index buffer; the encoded data is paged in as
+// it's decoded, in order. Load meshes from it with gpu_mesh::load(). Meshes can be decoded from several threads at once.
+class cooked_mesh_file {
+public:
+    // Throws if the file can't be mapped, or isn't a valid cooked file of this version.
+    explicit cooked_mesh_file(const std::string& path);
+    cooked_mesh_file(const cooked_mesh_file&) = delete;
+    cooked_mesh_file& operator=(const cooked_mesh_file&) = delete;
+    ~cooked_mesh_file();
+
+    std::size_t mesh_count() const { return static_cast<std::size_t>(m_descs.size()); }
+    const cooked_mesh_desc& desc(std::size_t index) const { return m_descs[index]; }
+
+    // Straight from the mapping.
+    gsl::span<const std::byte> encoded_data(std::size_t index) const;
+    gsl::span<const mesh_lod> lods(std::size_t index) const;
+    gsl::span<const meshlet> meshlets(std::size_t index) const;
+
+    // Decodes a mesh's buffer, desc().data_size bytes of it. Throws if the encoded streams are corrupt, or the
+    // indices name vertices the mesh doesn't have.
+    void decode(std::size_t index, gsl::span<std::byte> buffer) const;
+private:
+    void unmap();
+
+    const std::byte* m_mapping = nullptr;
+    std::size_t m_size = 0;
+    gsl::span<const cooked_mesh_desc> m_descs;
+};
+
+}
+
+#endif
\ No newline at end of file
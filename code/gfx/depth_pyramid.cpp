@@ -0,0 +1,337 @@
+#include "depth_pyramid.hpp"
+
+#include "vulkan_manager.hpp"
+#include "vulkan_utils.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace squadbox::gfx {
+
+depth_pyramid::depth_pyramid(const vulkan_manager& vulkan_manager, const vk::ImageView& depth_view,
+                             std::uint32_t depth_width, std::uint32_t depth_height)
+    : m_width(std::max(1u, (depth_width + 1) / 2)), m_height(std::max(1u, (depth_height + 1) / 2)),
+      m_depth_width(depth_width), m_depth_height(depth_height) {
+    const auto& device = vulkan_manager.device();
+
+    const auto num_levels = [](std::uint32_t width, std::uint32_t height) {
+        std::uint32_t levels = 1;
+        while ((std::max(width, height) >> levels) != 0) ++levels;
+        return levels;
+    }(m_width, m_height);
+
+    static const std::uint32_t reduce_shader_spv[] = {
+        #include "../shaders/compiled/depth_reduce.comp.spv.c"
+    };
+
+    std::tie(m_image, m_memory) = [](const vk::Device& device, const vk::PhysicalDeviceMemoryProperties& device_memory_props,
+                                     std::uint32_t width, std::uint32_t height, std::uint32_t num_levels) {
+        vk::ImageCreateInfo image_ci;
+        image_ci
+            .setImageType(vk::ImageType::e2D)
+            .setFormat(vk::Format::eR32Sfloat)
+            .setExtent({ width, height, 1 })
+            .setMipLevels(num_levels)
+            .setArrayLayers(1)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setUsage(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+
+        auto image = device.createImageUnique(image_ci);
+        auto memory = vk_utils::alloc_memory(device, device_memory_props, device.getImageMemoryRequirements(image.get()),
+                                             vk::MemoryPropertyFlagBits::eDeviceLocal);
+        device.bindImageMemory(image.get(), memory.get(), 0);
+
+        return std::make_tuple(std::move(image), std::move(memory));
+    }(device, vulkan_manager.physical_device().getMemoryProperties(), m_width, m_height, num_levels);
+
+    auto create_view = [&device, this](std::uint32_t base_level, std::uint32_t level_count) {
+        vk::ImageViewCreateInfo image_view_ci;
+        image_view_ci
+            .setImage(m_image.get())
+            .setViewType(vk::ImageViewType::e2D)
+            .setFormat(vk::Format::eR32Sfloat)
+            .subresourceRange
+                .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                .setBaseMipLevel(base_level)
+                .setLevelCount(level_count)
+                .setBaseArrayLayer(0)
+                .setLayerCount(1);
+
+        return device.createImageViewUnique(image_view_ci);
+    };
+
+    m_view = create_view(0, num_levels);
+    for (std::uint32_t level = 0; level < num_levels; ++level) {
+        m_level_views.push_back(create_view(level, 1));
+    }
+
+    m_sampler = [](const vk::Device& device) {
+        // Lookups pick their level explicitly, and must not blend depths.
+        vk::SamplerCreateInfo sampler_ci;
+        sampler_ci
+            .setMagFilter(vk::Filter::eNearest)
+            .setMinFilter(vk::Filter::eNearest)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+            .setMinLod(0.0f)
+            .setMaxLod(VK_LOD_CLAMP_NONE);
+
+        return device.createSamplerUnique(sampler_ci);
+    }(device);
+
+    m_reduce_shader = [](const vk::Device& device) {
+        vk::ShaderModuleCreateInfo comp_shader_ci;
+        comp_shader_ci
+            .setPCode(reduce_shader_spv)
+            .setCodeSize(sizeof(reduce_shader_spv));
+
+        return device.createShaderModuleUnique(comp_shader_ci);
+    }(device);
+
+    m_descriptor_set_layout = [](const vk::Device& device) {
+        std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+        bindings[0]     // source
+            .setBinding(0)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setDescriptorCount(1)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        bindings[1]     // destination
+            .setBinding(1)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setDescriptorCount(1)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+        vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_ci;
+        descriptor_set_layout_ci
+            .setPBindings(bindings.data())
+            .setBindingCount(bindings.size());
+
+        return device.createDescriptorSetLayoutUnique(descriptor_set_layout_ci);
+    }(device);
+
+    m_descriptor_pool = [](const vk::Device& device, std::uint32_t num_sets) {
+        std::array<vk::DescriptorPoolSize, 2> pool_sizes = {
+            vk::DescriptorPoolSize { vk::DescriptorType::eCombinedImageSampler, num_sets },
+            vk::DescriptorPoolSize { vk::DescriptorType::eStorageImage, num_sets }
+        };
+
+        vk::DescriptorPoolCreateInfo descriptor_pool_ci;
+        descriptor_pool_ci
+            .setMaxSets(num_sets)
+            .setPPoolSizes(pool_sizes.data())
+            .setPoolSizeCount(pool_sizes.size());
+
+        return device.createDescriptorPoolUnique(descriptor_pool_ci);
+    }(device, num_levels);
+
+    // Level n reduces level n - 1, level 0 reduces the depth buffer.
+    {
+        std::vector<vk::DescriptorSetLayout> layouts(num_levels, m_descriptor_set_layout.get());
+
+        vk::DescriptorSetAllocateInfo descriptor_set_alloc_info;
+        descriptor_set_alloc_info
+            .setDescriptorPool(m_descriptor_pool.get())
+            .setPSetLayouts(layouts.data())
+            .setDescriptorSetCount(num_levels);
+
+        m_level_descriptor_sets = device.allocateDescriptorSets(descriptor_set_alloc_info);
+
+        std::vector<vk::DescriptorImageInfo> image_infos;
+        image_infos.reserve(num_levels * 2);
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        writes.reserve(num_levels * 2);
+
+        for (std::uint32_t level = 0; level < num_levels; ++level) {
+            if (level == 0) {
+                image_infos.emplace_back(m_sampler.get(), depth_view, vk::ImageLayout::eShaderReadOnlyOptimal);
+            }
+            else {
+                image_infos.emplace_back(m_sampler.get(), m_level_views[level - 1].get(), vk::ImageLayout::eGeneral);
+            }
+
+            writes.emplace_back(m_level_descriptor_sets[level], 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &image_infos.back());
+
+            image_infos.emplace_back(nullptr, m_level_views[level].get(), vk::ImageLayout::eGeneral);
+            writes.emplace_back(m_level_descriptor_sets[level], 1, 0, 1, vk::DescriptorType::eStorageImage, &image_infos.back());
+        }
+
+        device.updateDescriptorSets(writes, nullptr);
+    }
+
+    m_pipeline_layout = [](const vk::Device& device, const vk::DescriptorSetLayout& descriptor_set_layout) {
+        vk::PushConstantRange push_constant_range;
+        push_constant_range
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+            .setOffset(0)
+            .setSize(sizeof(reduce_push_constants_t));
+
+        vk::PipelineLayoutCreateInfo pipeline_layout_ci;
+        pipeline_layout_ci
+            .setPSetLayouts(&descriptor_set_layout)
+            .setSetLayoutCount(1)
+            .setPPushConstantRanges(&push_constant_range)
+            .setPushConstantRangeCount(1);
+
+        return device.createPipelineLayoutUnique(pipeline_layout_ci);
+    }(device, m_descriptor_set_layout.get());
+
+    m_pipeline = [](const vk::Device& device, const vk::PipelineLayout& pipeline_layout, const vk::ShaderModule& compute_shader_module) {
+        vk::ComputePipelineCreateInfo compute_pipeline_ci;
+        compute_pipeline_ci
+            .setLayout(pipeline_layout)
+            .stage
+                .setStage(vk::ShaderStageFlagBits::eCompute)
+                .setModule(compute_shader_module)
+                .setPName("main");
+
+        return device.createComputePipelineUnique(nullptr, compute_pipeline_ci);
+    }(device, m_pipeline_layout.get(), m_reduce_shader.get());
+}
+
+void depth_pyramid::record_prepare(const vk::CommandBuffer& command_buffer) {
+    if (m_prepared) return;
+
+    vk::ImageSubresourceRange all_levels;
+    all_levels
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setLevelCount(num_levels())
+        .setLayerCount(1);
+
+    vk::ImageMemoryBarrier to_general;
+    to_general
+        .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eGeneral)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setImage(m_image.get())
+        .setSubresourceRange(all_levels);
+
+    command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits(),
+                                   nullptr, nullptr, { to_general });
+
+    // The far plane: nothing counts as occluded until a real build.
+    command_buffer.clearColorImage(m_image.get(), vk::ImageLayout::eGeneral, vk::ClearColorValue { std::array<float, 4> { 1.0f, 1.0f, 1.0f, 1.0f } }, { all_levels });
+
+    vk::ImageMemoryBarrier clear_barrier;
+    clear_barrier
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+        .setOldLayout(vk::ImageLayout::eGeneral)
+        .setNewLayout(vk::ImageLayout::eGeneral)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setImage(m_image.get())
+        .setSubresourceRange(all_levels);
+
+    command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits(),
+                                   nullptr, nullptr, { clear_barrier });
+
+    m_prepared = true;
+}
+
+void depth_pyramid::record_build(const vk::CommandBuffer& command_buffer, const vk::Image& depth_image) {
+    record_prepare(command_buffer);
+
+    vk::ImageSubresourceRange depth_range;
+    depth_range
+        .setAspectMask(vk::ImageAspectFlagBits::eDepth)
+        .setLevelCount(1)
+        .setLayerCount(1);
+
+    vk::ImageSubresourceRange all_levels;
+    all_levels
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setLevelCount(num_levels())
+        .setLayerCount(1);
+
+    {
+        std::array<vk::ImageMemoryBarrier, 2> barriers;
+        barriers[0]     // depth writes -> reduction reads
+            .setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+            .setOldLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+            .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setImage(depth_image)
+            .setSubresourceRange(depth_range);
+        barriers[1]     // this frame's culling reads -> reduction writes
+            .setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderWrite)
+            .setOldLayout(vk::ImageLayout::eGeneral)
+            .setNewLayout(vk::ImageLayout::eGeneral)
+            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setImage(m_image.get())
+            .setSubresourceRange(all_levels);
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eComputeShader,
+                                       vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits(),
+                                       nullptr, nullptr, barriers);
+    }
+
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+
+    std::uint32_t source_width = m_depth_width;
+    std::uint32_t source_height = m_depth_height;
+
+    for (std::uint32_t level = 0; level < num_levels(); ++level) {
+        const auto destination_width = std::max(1u, m_width >> level);
+        const auto destination_height = std::max(1u, m_height >> level);
+
+        reduce_push_constants_t push_constants;
+        push_constants.source_width = static_cast<std::int32_t>(source_width);
+        push_constants.source_height = static_cast<std::int32_t>(source_height);
+        push_constants.destination_width = static_cast<std::int32_t>(destination_width);
+        push_constants.destination_height = static_cast<std::int32_t>(destination_height);
+
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipeline_layout.get(), 0, { m_level_descriptor_sets[level] }, nullptr);
+        command_buffer.pushConstants(m_pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(push_constants), &push_constants);
+        command_buffer.dispatch((destination_width + reduce_workgroup_size - 1) / reduce_workgroup_size,
+                                (destination_height + reduce_workgroup_size - 1) / reduce_workgroup_size, 1);
+
+        // Also makes the last level visible to the next frame's culling.
+        vk::ImageMemoryBarrier level_barrier;
+        level_barrier
+            .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+            .setOldLayout(vk::ImageLayout::eGeneral)
+            .setNewLayout(vk::ImageLayout::eGeneral)
+            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setImage(m_image.get())
+            .subresourceRange
+                .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                .setBaseMipLevel(level)
+                .setLevelCount(1)
+                .setLayerCount(1);
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits(),
+                                       nullptr, nullptr, { level_barrier });
+
+        source_width = destination_width;
+        source_height = destination_height;
+    }
+
+    vk::ImageMemoryBarrier depth_barrier;
+    depth_barrier
+        .setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
+        .setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+        .setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setImage(depth_image)
+        .setSubresourceRange(depth_range);
+
+    command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                   vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests, vk::DependencyFlagBits(),
+                                   nullptr, nullptr, { depth_barrier });
+}
+
+}
\ No newline at end of file
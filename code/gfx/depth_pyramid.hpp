@@ -0,0 +1,84 @@
+#ifndef SQUADBOX_GFX_DEPTH_PYRAMID_HPP
+#define SQUADBOX_GFX_DEPTH_PYRAMID_HPP
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace squadbox::gfx {
+
+class vulkan_manager;
+
+// Hierarchical depth (Hi-Z) built from the depth buffer by a compute reduction.
+//
+// Level 0 is half the depth buffer's resolution, rounded up, and every texel of every level
+// holds the farthest depth of the texels it covers. An object whose nearest depth is behind
+// what the pyramid stores over its screen footprint is fully hidden.
+//
+// The pyramid is sampled (view(), sampler()) as a combined image sampler in GENERAL layout.
+// Before its first build it reads as the far plane everywhere, i.e. nothing is occluded.
+class depth_pyramid {
+public:
+    depth_pyramid(const vulkan_manager& vulkan_manager, const vk::ImageView& depth_view,
+                  std::uint32_t depth_width, std::uint32_t depth_height);
+
+    depth_pyramid(const depth_pyramid&) = delete;
+    depth_pyramid& operator=(const depth_pyramid&) = delete;
+
+    // Record before anything samples the pyramid in a command buffer, outside a render pass.
+    void record_prepare(const vk::CommandBuffer& command_buffer);
+
+    // Record after the render pass that wrote the depth buffer. The depth image is expected in
+    // DEPTH_STENCIL_ATTACHMENT_OPTIMAL and is returned to it.
+    void record_build(const vk::CommandBuffer& command_buffer, const vk::Image& depth_image);
+
+    const vk::ImageView& view() const { return m_view.get(); }
+    const vk::Sampler& sampler() const { return m_sampler.get(); }
+
+    std::uint32_t width() const { return m_width; }
+    std::uint32_t height() const { return m_height; }
+    std::uint32_t num_levels() const { return static_cast<std::uint32_t>(m_level_views.size()); }
+
+private:
+    /*
+    shaders/depth_reduce.comp:
+    layout(push_constant) uniform push_constants_t {
+        ivec2 source_size;
+        ivec2 destination_size;
+    } pc;
+    */
+    struct reduce_push_constants_t {
+        std::int32_t source_width;
+        std::int32_t source_height;
+        std::int32_t destination_width;
+        std::int32_t destination_height;
+    };
+
+    static const std::uint32_t reduce_workgroup_size = 8;
+
+    std::uint32_t m_width;
+    std::uint32_t m_height;
+    std::uint32_t m_depth_width;
+    std::uint32_t m_depth_height;
+    bool m_prepared = false;
+
+    vk::UniqueImage m_image;
+    vk::UniqueDeviceMemory m_memory;
+    vk::UniqueImageView m_view;
+    std::vector<vk::UniqueImageView> m_level_views;
+    vk::UniqueSampler m_sampler;
+
+    vk::UniqueShaderModule m_reduce_shader;
+    vk::UniqueDescriptorSetLayout m_descriptor_set_layout;
+    vk::UniqueDescriptorPool m_descriptor_pool;
+    std::vector<vk::DescriptorSet> m_level_descriptor_sets;
+    vk::UniquePipelineLayout m_pipeline_layout;
+    vk::UniquePipeline m_pipeline;
+};
+
+}
+
+#endif
\ No newline at end of file
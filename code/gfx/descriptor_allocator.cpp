@@ -0,0 +1,91 @@
+#include "descriptor_allocator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+namespace squadbox::gfx {
+
+gsl::span<const vk::DescriptorPoolSize> descriptor_allocator::default_descriptors_per_set() {
+    static const std::array<vk::DescriptorPoolSize, 4> descriptors_per_set = {
+        vk::DescriptorPoolSize { vk::DescriptorType::eUniformBuffer, 2 },
+        vk::DescriptorPoolSize { vk::DescriptorType::eUniformBufferDynamic, 1 },
+        vk::DescriptorPoolSize { vk::DescriptorType::eStorageBuffer, 5 },
+        vk::DescriptorPoolSize { vk::DescriptorType::eCombinedImageSampler, 2 },
+    };
+
+    return descriptors_per_set;
+}
+
+descriptor_allocator::descriptor_allocator(const vk::Device& device,
+                                           gsl::span<const vk::DescriptorPoolSize> descriptors_per_set,
+                                           std::uint32_t initial_sets_per_pool)
+    : m_device(device), m_descriptors_per_set(descriptors_per_set.begin(), descriptors_per_set.end()),
+      m_next_sets_per_pool(std::min(initial_sets_per_pool, max_sets_per_pool)) {
+}
+
+vk::DescriptorSet descriptor_allocator::allocate(const vk::DescriptorSetLayout& layout) {
+    if (!m_current_pool) m_current_pool = next_pool();
+
+    vk::DescriptorSetAllocateInfo descriptor_set_alloc_info;
+    descriptor_set_alloc_info
+        .setDescriptorPool(m_current_pool)
+        .setPSetLayouts(&layout)
+        .setDescriptorSetCount(1);
+
+    vk::DescriptorSet descriptor_set;
+    auto result = m_device.allocateDescriptorSets(&descriptor_set_alloc_info, &descriptor_set);
+
+    // Pre-1.1 drivers may report an exhausted pool as out of device memory, so any failure moves on to a fresh pool.
+    if (result != vk::Result::eSuccess) {
+        m_current_pool = next_pool();
+        descriptor_set_alloc_info.setDescriptorPool(m_current_pool);
+
+        result = m_device.allocateDescriptorSets(&descriptor_set_alloc_info, &descriptor_set);
+        if (result != vk::Result::eSuccess) throw std::runtime_error("Vulkan: unable to allocate descriptor set: " + vk::to_string(result));
+    }
+
+    return descriptor_set;
+}
+
+void descriptor_allocator::reset() {
+    for (auto& pool : m_used_pools) {
+        m_device.resetDescriptorPool(pool.get());
+    }
+
+    std::move(m_used_pools.begin(), m_used_pools.end(), std::back_inserter(m_free_pools));
+    m_used_pools.clear();
+    m_current_pool = nullptr;
+}
+
+vk::DescriptorPool descriptor_allocator::next_pool() {
+    if (!m_free_pools.empty()) {
+        m_used_pools.push_back(std::move(m_free_pools.back()));
+        m_free_pools.pop_back();
+
+        return m_used_pools.back().get();
+    }
+
+    const auto sets_per_pool = m_next_sets_per_pool;
+    m_next_sets_per_pool = std::min(m_next_sets_per_pool * 2, max_sets_per_pool);
+
+    auto pool = [](const vk::Device& device, gsl::span<const vk::DescriptorPoolSize> descriptors_per_set, std::uint32_t sets_per_pool) {
+        std::vector<vk::DescriptorPoolSize> pool_sizes(descriptors_per_set.begin(), descriptors_per_set.end());
+        for (auto& pool_size : pool_sizes) {
+            pool_size.descriptorCount *= sets_per_pool;
+        }
+
+        vk::DescriptorPoolCreateInfo descriptor_pool_ci;
+        descriptor_pool_ci
+            .setPPoolSizes(pool_sizes.data())
+            .setPoolSizeCount(static_cast<std::uint32_t>(pool_sizes.size()))
+            .setMaxSets(sets_per_pool);
+
+        return device.createDescriptorPoolUnique(descriptor_pool_ci);
+    }(m_device, m_descriptors_per_set, sets_per_pool);
+
+    m_used_pools.push_back(std::move(pool));
+    return m_used_pools.back().get();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef SQUADBOX_GFX_DESCRIPTOR_ALLOCATOR_HPP
+#define SQUADBOX_GFX_DESCRIPTOR_ALLOCATOR_HPP
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/gsl>
+
+#include <vector>
+
+namespace squadbox::gfx {
+
+// Hands out descriptor sets that only live for one frame.
+//
+// Sets are carved out of a chain of pools; when the current pool runs out another one is created
+// (each twice the size of the last) instead of failing. reset() recycles every pool of the chain at
+// once, which is meant to be done when the frame the sets were used in has retired.
+//
+// Not thread safe. Each render thread owns one allocator per frame in flight, so allocating never locks.
+class descriptor_allocator {
+public:
+    // Descriptors reserved per set in each pool, by type.
+    static gsl::span<const vk::DescriptorPoolSize> default_descriptors_per_set();
+
+    explicit descriptor_allocator(const vk::Device& device,
+                                  gsl::span<const vk::DescriptorPoolSize> descriptors_per_set = default_descriptors_per_set(),
+                                  std::uint32_t initial_sets_per_pool = 64);
+
+    descriptor_allocator(descriptor_allocator&&) = default;
+    descriptor_allocator& operator=(descriptor_allocator&&) = default;
+
+    vk::DescriptorSet allocate(const vk::DescriptorSetLayout& layout);
+    void reset();
+
+    std::size_t num_pools() const { return m_used_pools.size() + m_free_pools.size(); }
+
+private:
+    vk::DescriptorPool next_pool();
+
+    static constexpr std::uint32_t max_sets_per_pool = 4096;
+
+    vk::Device m_device;
+    std::vector<vk::DescriptorPoolSize> m_descriptors_per_set;
+    std::uint32_t m_next_sets_per_pool;
+
+    vk::DescriptorPool m_current_pool;
+    std::vector<vk::UniqueDescriptorPool> m_used_pools;
+    std::vector<vk::UniqueDescriptorPool> m_free_pools;
+};
+
+
+// Writes every descriptor of a set in one call from a struct laid out as the template entries describe.
+template<typename data_type>
+class descriptor_update_template {
+public:
+    descriptor_update_template() = default;
+
+    descriptor_update_template(const vk::Device& device, const vk::DescriptorSetLayout& layout,
+                               gsl::span<const vk::DescriptorUpdateTemplateEntry> entries)
+        : m_device(device) {
+        vk::DescriptorUpdateTemplateCreateInfo update_template_ci;
+        update_template_ci
+            .setTemplateType(vk::DescriptorUpdateTemplateType::eDescriptorSet)
+            .setDescriptorSetLayout(layout)
+            .setPDescriptorUpdateEntries(entries.data())
+            .setDescriptorUpdateEntryCount(static_cast<std::uint32_t>(entries.size()));
+
+        m_update_template = device.createDescriptorUpdateTemplateUnique(update_template_ci);
+    }
+
+    void update(const vk::DescriptorSet& descriptor_set, const data_type& data) const {
+        m_device.updateDescriptorSetWithTemplate(descriptor_set, m_update_template.get(), &data);
+    }
+
+private:
+    vk::Device m_device;
+    vk::UniqueDescriptorUpdateTemplate m_update_template;
+};
+
+}
+
+#endif
\ No newline at end of file
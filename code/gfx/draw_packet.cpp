@@ -0,0 +1,176 @@
+#include "draw_packet.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+namespace squadbox::gfx {
+
+namespace {
+    // Non-negative IEEE floats order the same as their bit patterns.
+    std::uint64_t depth_bits(float view_depth) {
+        const float clamped_depth = std::max(view_depth, 0.0f);
+
+        std::uint32_t bits;
+        std::memcpy(&bits, &clamped_depth, sizeof(bits));
+
+        return bits;
+    }
+}
+
+draw_sort_key draw_sort_key::opaque(draw_layer layer, std::uint16_t pipeline_id, std::uint16_t material_id, float view_depth) {
+    assert(pipeline_id <= max_pipeline_id);
+
+    return draw_sort_key {
+          (static_cast<std::uint64_t>(layer) & 0xF) << 60
+        | (static_cast<std::uint64_t>(pipeline_id) & max_pipeline_id) << 48
+        | static_cast<std::uint64_t>(material_id) << 32
+        | depth_bits(view_depth)
+    };
+}
+
+draw_sort_key draw_sort_key::depth_major(draw_layer layer, std::uint16_t pipeline_id, std::uint16_t material_id, float view_depth) {
+    assert(pipeline_id <= max_pipeline_id);
+
+    return draw_sort_key {
+          (static_cast<std::uint64_t>(layer) & 0xF) << 60
+        | depth_bits(view_depth) << 28
+        | (static_cast<std::uint64_t>(pipeline_id) & max_pipeline_id) << 16
+        | static_cast<std::uint64_t>(material_id)
+    };
+}
+
+draw_sort_key draw_sort_key::translucent(draw_layer layer, std::uint16_t pipeline_id, std::uint16_t material_id, float view_depth) {
+    assert(pipeline_id <= max_pipeline_id);
+
+    return draw_sort_key {
+          (static_cast<std::uint64_t>(layer) & 0xF) << 60
+        | (~depth_bits(view_depth) & 0xFFFFFFFF) << 28
+        | (static_cast<std::uint64_t>(pipeline_id) & max_pipeline_id) << 16
+        | static_cast<std::uint64_t>(material_id)
+    };
+}
+
+std::uint16_t draw_sort_key::material_id_from_handle(std::uint64_t handle) {
+    handle ^= handle >> 33;
+    handle *= 0xFF51AFD7ED558CCDull;
+    handle ^= handle >> 33;
+
+    return static_cast<std::uint16_t>(handle);
+}
+
+std::uint16_t next_draw_pipeline_id() {
+    static std::atomic<std::uint16_t> next_id { 0 };
+
+    const auto id = next_id++;
+    assert(id <= draw_sort_key::max_pipeline_id);
+
+    return static_cast<std::uint16_t>(id & draw_sort_key::max_pipeline_id);
+}
+
+
+void draw_packet_recorder::sort(gsl::span<const draw_packet> packets) {
+    m_keys.resize(packets.size());
+    m_order.resize(packets.size());
+
+    std::transform(packets.begin(), packets.end(), m_keys.begin(), [](const draw_packet& packet) {
+        return packet.sort_key.value();
+    });
+    std::iota(m_order.begin(), m_order.end(), 0);
+
+    m_sorter.sort(m_keys, m_order);
+}
+
+draw_packet_stats draw_packet_recorder::record(const vk::CommandBuffer& command_buffer, gsl::span<const draw_packet> packets) const {
+    assert(m_order.size() == static_cast<std::size_t>(packets.size()));
+
+    draw_packet_stats stats;
+    const draw_packet* previous = nullptr;
+
+    for (const auto index : m_order) {
+        const auto& packet = packets[index];
+        assert(packet.index_buffer);
+
+        if (!previous || packet.viewport != previous->viewport) {
+            vk::Rect2D scissor;
+            scissor.offset
+                .setX(static_cast<std::int32_t>(packet.viewport.x))
+                .setY(static_cast<std::int32_t>(packet.viewport.y));
+            scissor.extent
+                .setWidth(static_cast<std::uint32_t>(packet.viewport.width))
+                .setHeight(static_cast<std::uint32_t>(packet.viewport.height));
+
+            command_buffer.setViewport(0, { packet.viewport });
+            command_buffer.setScissor(0, { scissor });
+        }
+
+        if (!previous || packet.pipeline != previous->pipeline) {
+            command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, packet.pipeline);
+            ++stats.pipeline_binds;
+        }
+
+        if (packet.descriptor_set_count != 0
+            && (!previous
+                || packet.descriptor_set_count != previous->descriptor_set_count
+                || !std::equal(packet.descriptor_sets.begin(), packet.descriptor_sets.begin() + packet.descriptor_set_count, previous->descriptor_sets.begin())
+                || packet.pipeline_layout != previous->pipeline_layout
+                || packet.dynamic_offset_count != previous->dynamic_offset_count
+                || !std::equal(packet.dynamic_offsets.begin(), packet.dynamic_offsets.begin() + packet.dynamic_offset_count, previous->dynamic_offsets.begin()))) {
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, packet.pipeline_layout, 0,
+                                              { packet.descriptor_set_count, packet.descriptor_sets.data() },
+                                              { packet.dynamic_offset_count, packet.dynamic_offsets.data() });
+            ++stats.descriptor_set_binds;
+        }
+
+        if (packet.push_constants_size != 0
+            && (!previous
+                || packet.pipeline_layout != previous->pipeline_layout
+                || packet.push_constants_stages != previous->push_constants_stages
+                || packet.push_constants_size != previous->push_constants_size
+                || std::memcmp(packet.push_constants.data(), previous->push_constants.data(), packet.push_constants_size) != 0)) {
+            command_buffer.pushConstants(packet.pipeline_layout, packet.push_constants_stages, 0, packet.push_constants_size, packet.push_constants.data());
+            ++stats.push_constant_updates;
+        }
+
+        if (!previous
+            || packet.vertex_buffer_count != previous->vertex_buffer_count
+            || !std::equal(packet.vertex_buffers.begin(), packet.vertex_buffers.begin() + packet.vertex_buffer_count, previous->vertex_buffers.begin())
+            || !std::equal(packet.vertex_buffer_offsets.begin(), packet.vertex_buffer_offsets.begin() + packet.vertex_buffer_count, previous->vertex_buffer_offsets.begin())) {
+            command_buffer.bindVertexBuffers(0,
+                                             { packet.vertex_buffer_count, packet.vertex_buffers.data() },
+                                             { packet.vertex_buffer_count, packet.vertex_buffer_offsets.data() });
+            ++stats.vertex_buffer_binds;
+        }
+
+        if (!previous
+            || packet.index_buffer != previous->index_buffer
+            || packet.index_buffer_offset != previous->index_buffer_offset
+            || packet.index_type != previous->index_type) {
+            command_buffer.bindIndexBuffer(packet.index_buffer, packet.index_buffer_offset, packet.index_type);
+            ++stats.index_buffer_binds;
+        }
+
+        if (packet.count_buffer) {
+            assert(packet.indirect_buffer && m_dispatch_loader);
+            command_buffer.drawIndexedIndirectCountKHR(packet.indirect_buffer, packet.indirect_offset,
+                                                       packet.count_buffer, packet.count_offset,
+                                                       packet.max_draw_count, packet.indirect_stride, *m_dispatch_loader);
+            ++stats.indirect_draws;
+        }
+        else if (packet.indirect_buffer) {
+            command_buffer.drawIndexedIndirect(packet.indirect_buffer, packet.indirect_offset, packet.max_draw_count, packet.indirect_stride);
+            ++stats.indirect_draws;
+        }
+        else {
+            command_buffer.drawIndexed(packet.index_count, packet.instance_count, packet.first_index, packet.vertex_offset, packet.first_instance);
+        }
+        ++stats.draws;
+
+        previous = &packet;
+    }
+
+    return stats;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,174 @@
+#ifndef SQUADBOX_GFX_DRAW_PACKET_HPP
+#define SQUADBOX_GFX_DRAW_PACKET_HPP
+
+#pragma once
+
+#include "radix_sort.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/gsl>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace squadbox::gfx {
+
+enum class draw_layer : std::uint8_t {
+    depth_prepass = 0,
+    opaque = 1,
+    translucent = 2,
+    overlay = 3
+};
+
+
+// 64-bit key that orders draw packets for submission.
+//
+// Opaque:      | layer (4) | pipeline (12) | material (16) | depth, front to back (32) |
+// Depth major: | layer (4) | depth, front to back (32) | pipeline (12) | material (16) |
+// Translucent: | layer (4) | depth, back to front (32) | pipeline (12) | material (16) |
+//
+// Depth major suits passes whose state changes are cheap next to the rejection front to back order buys them,
+// e.g. a depth prepass.
+class draw_sort_key {
+public:
+    draw_sort_key() = default;
+    explicit draw_sort_key(std::uint64_t value) : m_value(value) {}
+
+    static draw_sort_key opaque(draw_layer layer, std::uint16_t pipeline_id, std::uint16_t material_id, float view_depth);
+    static draw_sort_key depth_major(draw_layer layer, std::uint16_t pipeline_id, std::uint16_t material_id, float view_depth);
+    static draw_sort_key translucent(draw_layer layer, std::uint16_t pipeline_id, std::uint16_t material_id, float view_depth);
+
+    // Folds a Vulkan handle (or any other 64-bit identity) down to a material id.
+    static std::uint16_t material_id_from_handle(std::uint64_t handle);
+
+    std::uint64_t value() const { return m_value; }
+
+    static constexpr std::uint32_t max_pipeline_id = (1 << 12) - 1;
+
+private:
+    std::uint64_t m_value = 0;
+};
+
+// Hands out pipeline ids for sort keys. Techniques grab one per pipeline at creation.
+std::uint16_t next_draw_pipeline_id();
+
+
+struct draw_packet {
+    static constexpr std::uint32_t max_vertex_buffers = 3;
+
+    // Guaranteed minimum of maxPushConstantsSize.
+    static constexpr std::uint32_t max_push_constants_size = 128;
+
+    static constexpr std::uint32_t max_dynamic_offsets = 2;
+
+    static constexpr std::uint32_t max_descriptor_sets = 2;
+
+    draw_sort_key sort_key;
+
+    vk::Pipeline pipeline;
+    vk::PipelineLayout pipeline_layout;
+    // Bound from set 0 upwards. Dynamic offsets are consumed in set order.
+    std::array<vk::DescriptorSet, max_descriptor_sets> descriptor_sets;
+    std::uint32_t descriptor_set_count = 0;
+    std::array<std::uint32_t, max_dynamic_offsets> dynamic_offsets = {};
+    std::uint32_t dynamic_offset_count = 0;
+
+    vk::ShaderStageFlags push_constants_stages;
+    std::uint32_t push_constants_size = 0;
+    std::array<std::uint32_t, max_push_constants_size / sizeof(std::uint32_t)> push_constants;
+
+    std::array<vk::Buffer, max_vertex_buffers> vertex_buffers;
+    std::array<vk::DeviceSize, max_vertex_buffers> vertex_buffer_offsets = {};
+    std::uint32_t vertex_buffer_count = 0;
+
+    vk::Buffer index_buffer;
+    vk::DeviceSize index_buffer_offset = 0;
+    vk::IndexType index_type = vk::IndexType::eUint32;
+
+    std::uint32_t index_count = 0;
+    std::uint32_t instance_count = 1;
+    std::uint32_t first_index = 0;
+    std::int32_t vertex_offset = 0;
+    std::uint32_t first_instance = 0;
+
+    // When set, the draw parameters above are ignored and up to max_draw_count VkDrawIndexedIndirectCommands
+    // are read from indirect_buffer. With a count_buffer the actual draw count is read from the GPU as well.
+    vk::Buffer indirect_buffer;
+    vk::DeviceSize indirect_offset = 0;
+    std::uint32_t indirect_stride = sizeof(VkDrawIndexedIndirectCommand);
+    vk::Buffer count_buffer;
+    vk::DeviceSize count_offset = 0;
+    std::uint32_t max_draw_count = 0;
+
+    vk::Viewport viewport;
+
+    // Keeps whatever the packet references alive until the frame that drew it has retired.
+    std::shared_ptr<void> resources;
+
+    void set_descriptor_set(const vk::DescriptorSet& descriptor_set) {
+        descriptor_sets[0] = descriptor_set;
+        descriptor_set_count = 1;
+    }
+
+    template<typename buffers_type, typename offsets_type>
+    void set_vertex_buffers(const buffers_type& buffers, const offsets_type& offsets) {
+        static_assert(std::tuple_size_v<buffers_type> <= max_vertex_buffers);
+        static_assert(std::tuple_size_v<buffers_type> == std::tuple_size_v<offsets_type>);
+
+        std::copy(buffers.begin(), buffers.end(), vertex_buffers.begin());
+        std::copy(offsets.begin(), offsets.end(), vertex_buffer_offsets.begin());
+        vertex_buffer_count = static_cast<std::uint32_t>(buffers.size());
+    }
+
+    template<typename push_constants_type>
+    void set_push_constants(vk::ShaderStageFlags stages, const push_constants_type& data) {
+        static_assert(std::is_trivially_copyable_v<push_constants_type>);
+        static_assert(sizeof(push_constants_type) <= max_push_constants_size);
+        static_assert(sizeof(push_constants_type) % sizeof(std::uint32_t) == 0);
+
+        std::memcpy(push_constants.data(), &data, sizeof(push_constants_type));
+        push_constants_size = sizeof(push_constants_type);
+        push_constants_stages = stages;
+    }
+};
+
+
+struct draw_packet_stats {
+    std::uint32_t draws = 0;
+    std::uint32_t indirect_draws = 0;
+    std::uint32_t pipeline_binds = 0;
+    std::uint32_t descriptor_set_binds = 0;
+    std::uint32_t push_constant_updates = 0;
+    std::uint32_t vertex_buffer_binds = 0;
+    std::uint32_t index_buffer_binds = 0;
+};
+
+
+// Sorts packets by key and records them, only emitting the state that changes between consecutive draws.
+class draw_packet_recorder {
+public:
+    // The dispatch loader is only needed for packets with a count buffer.
+    explicit draw_packet_recorder(const vk::DispatchLoaderDynamic* dispatch_loader = nullptr)
+        : m_dispatch_loader(dispatch_loader) {}
+
+    void sort(gsl::span<const draw_packet> packets);
+    draw_packet_stats record(const vk::CommandBuffer& command_buffer, gsl::span<const draw_packet> packets) const;
+
+    gsl::span<const std::uint32_t> order() const { return m_order; }
+
+private:
+    const vk::DispatchLoaderDynamic* m_dispatch_loader;
+
+    radix_sorter m_sorter;
+    std::vector<std::uint64_t> m_keys;
+    std::vector<std::uint32_t> m_order;
+};
+
+}
+
+#endif
\ No newline at end of file
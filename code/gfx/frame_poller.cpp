@@ -0,0 +1,112 @@
+#include "frame_poller.hpp"
+
+#include "mesh_uploader.hpp"
+#include "render_manager.hpp"
+#include "vulkan_manager.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace squadbox::gfx {
+
+bool frame_poller::frames_awaitable::ready() {
+    return poller().m_frame >= m_frame;
+}
+
+bool frame_poller::fence_awaitable::ready() {
+    return poller().m_vulkan_manager->device().getFenceStatus(m_fence) == vk::Result::eSuccess;
+}
+
+bool frame_poller::frame_serial_awaitable::ready() {
+    return m_render_manager->is_frame_complete(m_serial);
+}
+
+bool frame_poller::upload_awaitable::ready() {
+    return m_mesh_uploader->is_batch_complete(m_batch);
+}
+
+frame_poller::frame_poller(const vulkan_manager& vulkan_manager, unsigned int num_io_threads)
+    : m_vulkan_manager(&vulkan_manager),
+      m_io_thread_pool(std::max(num_io_threads, 1u)) {
+}
+
+frame_poller::~frame_poller() {
+    // Nothing is resumed from here on; the suspended coroutines go with their tasks.
+    m_waiters.clear();
+    m_tasks.clear();
+
+    m_io_thread_pool.close();
+    m_io_thread_pool.join();
+}
+
+void frame_poller::spawn(task<> task) {
+    // The coroutine may spawn others before it suspends.
+    const auto handle = task.m_handle;
+    m_tasks.push_back(std::move(task));
+    handle.resume();
+}
+
+void frame_poller::poll() {
+    ++m_frame;
+
+    // Coroutines resumed here suspend again onto m_waiters, to be checked on the next poll.
+    const auto ready = std::stable_partition(m_waiters.begin(), m_waiters.end(), [](const waiter& waiter) {
+        return !waiter.awaitable->ready();
+    });
+
+    m_waiters_to_resume.assign(ready, m_waiters.end());
+    m_waiters.erase(ready, m_waiters.end());
+
+    for (const auto& waiter : m_waiters_to_resume) {
+        waiter.handle.resume();
+    }
+
+    m_waiters_to_resume.clear();
+
+    std::exception_ptr exception;
+
+    m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(), [&exception](const task<>& task) {
+        if (!task.done()) return false;
+
+        if (!exception) exception = task.m_handle.promise().exception;
+        return true;
+    }), m_tasks.end());
+
+    if (exception) std::rethrow_exception(exception);
+}
+
+frame_poller::upload_awaitable frame_poller::uploaded(const mesh_uploader& mesh_uploader) {
+    return { *this, mesh_uploader, mesh_uploader.pending_batch() };
+}
+
+frame_poller::future_awaitable<std::vector<std::byte>> frame_poller::read_file(const std::string& path) {
+    auto promise = std::make_shared<std::promise<std::vector<std::byte>>>();
+    auto future = promise->get_future();
+
+    m_io_thread_pool.submit([path, promise] {
+        try {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) {
+                throw std::runtime_error("frame_poller: can't open " + path + ".");
+            }
+
+            std::vector<std::byte> bytes(static_cast<std::size_t>(file.tellg()));
+            file.seekg(0);
+
+            if (!file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+                throw std::runtime_error("frame_poller: can't read " + path + ".");
+            }
+
+            promise->set_value(std::move(bytes));
+        }
+        catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+
+    return { *this, std::move(future) };
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,196 @@
+#ifndef SQUADBOX_GFX_FRAME_POLLER_HPP
+#define SQUADBOX_GFX_FRAME_POLLER_HPP
+
+#pragma once
+
+#include "task.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/gsl>
+#include <boost/thread/executors/basic_thread_pool.hpp>
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace squadbox::gfx {
+
+class mesh_uploader;
+class render_manager;
+class vulkan_manager;
+
+// Drives coroutines waiting on the GPU or the disk without blocking a thread on either. Awaiting one of the
+// awaitables below suspends the coroutine unless what it waits for is done already; poll(), called once a frame,
+// checks them and resumes the ones that are. Coroutines only ever run on the thread calling spawn() and poll(), so
+// they can touch frame state like any other code on that thread:
+//
+//   gfx::task<> load(gfx::frame_poller& poller, gfx::mesh_uploader& uploader, std::string path) {
+//       const auto bytes = co_await poller.read_file(path);
+//       auto mesh = create_mesh(bytes, uploader);
+//       co_await poller.uploaded(uploader);
+//       ...
+//   }
+//
+//   poller.spawn(load(poller, uploader, "assets/duck.bin"));
+//
+// Whatever a suspended coroutine refers to has to outlive it, the poller included.
+class frame_poller {
+public:
+    // Suspends the awaiting coroutine until ready() is true.
+    class awaitable_base {
+    public:
+        bool await_ready() { return ready(); }
+        void await_suspend(std::coroutine_handle<> handle) { m_poller->m_waiters.push_back({ this, handle }); }
+
+    protected:
+        explicit awaitable_base(frame_poller& poller) : m_poller(&poller) {}
+        ~awaitable_base() = default;
+
+        frame_poller& poller() const { return *m_poller; }
+
+    private:
+        friend class frame_poller;
+
+        virtual bool ready() = 0;
+
+        gsl::not_null<frame_poller*> m_poller;
+    };
+
+    class frames_awaitable : public awaitable_base {
+    public:
+        frames_awaitable(frame_poller& poller, std::uint64_t frame) : awaitable_base(poller), m_frame(frame) {}
+        void await_resume() const {}
+
+    private:
+        bool ready() override;
+
+        std::uint64_t m_frame;
+    };
+
+    class fence_awaitable : public awaitable_base {
+    public:
+        fence_awaitable(frame_poller& poller, vk::Fence fence) : awaitable_base(poller), m_fence(fence) {}
+        void await_resume() const {}
+
+    private:
+        bool ready() override;
+
+        vk::Fence m_fence;
+    };
+
+    class frame_serial_awaitable : public awaitable_base {
+    public:
+        frame_serial_awaitable(frame_poller& poller, const render_manager& render_manager, std::uint64_t serial)
+            : awaitable_base(poller), m_render_manager(&render_manager), m_serial(serial) {}
+        void await_resume() const {}
+
+    private:
+        bool ready() override;
+
+        gsl::not_null<const render_manager*> m_render_manager;
+        std::uint64_t m_serial;
+    };
+
+    class upload_awaitable : public awaitable_base {
+    public:
+        upload_awaitable(frame_poller& poller, const mesh_uploader& mesh_uploader, std::uint64_t batch)
+            : awaitable_base(poller), m_mesh_uploader(&mesh_uploader), m_batch(batch) {}
+        void await_resume() const {}
+
+    private:
+        bool ready() override;
+
+        gsl::not_null<const mesh_uploader*> m_mesh_uploader;
+        std::uint64_t m_batch;
+    };
+
+    template<typename T>
+    class future_awaitable : public awaitable_base {
+    public:
+        future_awaitable(frame_poller& poller, std::future<T>&& future) : awaitable_base(poller), m_future(std::move(future)) {}
+        // Rethrows what the future holds.
+        T await_resume() { return m_future.get(); }
+
+    private:
+        bool ready() override { return m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+
+        std::future<T> m_future;
+    };
+
+    class condition_awaitable : public awaitable_base {
+    public:
+        condition_awaitable(frame_poller& poller, std::function<bool()> condition) : awaitable_base(poller), m_condition(std::move(condition)) {}
+        void await_resume() const {}
+
+    private:
+        bool ready() override { return m_condition(); }
+
+        std::function<bool()> m_condition;
+    };
+
+    // File reads happen on threads of the poller's own, so they never hold up the asset_importer's workers.
+    explicit frame_poller(const vulkan_manager& vulkan_manager, unsigned int num_io_threads = 1);
+    frame_poller(const frame_poller&) = delete;
+    // Destroys the spawned coroutines that haven't finished, as they are. Waits for file reads in progress.
+    ~frame_poller();
+
+    // Starts a coroutine, which runs until its first suspension before this returns. The poller keeps it until it's
+    // done; an exception escaping it is rethrown from poll().
+    void spawn(task<> task);
+
+    // Once a frame, on the thread calling spawn(), after the frame's uploads are submitted. Resumes every coroutine
+    // whose awaitable is ready, in the order they were suspended, then drops the spawned ones that are done.
+    void poll();
+
+    std::size_t tasks_in_progress() const { return m_tasks.size(); }
+    std::uint64_t frame() const { return m_frame; }
+
+    frames_awaitable next_frame() { return { *this, m_frame + 1 }; }
+    frames_awaitable frames(std::uint64_t count) { return { *this, m_frame + count }; }
+
+    fence_awaitable signaled(vk::Fence fence) { return { *this, fence }; }
+
+    // Vulkan 1.1 has no timeline semaphores; frame serials and upload batches count up the same way.
+    frame_serial_awaitable frame_complete(const render_manager& render_manager, std::uint64_t serial) {
+        return { *this, render_manager, serial };
+    }
+
+    // Until everything allocated from the uploader so far has been copied. Submitting is left to the uploader's owner,
+    // as workers may be writing staging memory (asset_importer::update() submits every frame).
+    upload_awaitable uploaded(const mesh_uploader& mesh_uploader);
+
+    // E.g. asset_importer's imports.
+    template<typename T>
+    future_awaitable<T> ready(std::future<T>&& future) { return { *this, std::move(future) }; }
+
+    condition_awaitable until(std::function<bool()> condition) { return { *this, std::move(condition) }; }
+
+    // The whole file. The awaiting coroutine gets the exception if it can't be read.
+    future_awaitable<std::vector<std::byte>> read_file(const std::string& path);
+
+private:
+    struct waiter {
+        awaitable_base* awaitable;
+        std::coroutine_handle<> handle;
+    };
+
+    gsl::not_null<const vulkan_manager*> m_vulkan_manager;
+    std::uint64_t m_frame = 0;
+    std::vector<waiter> m_waiters;
+    std::vector<waiter> m_waiters_to_resume;
+    std::vector<task<>> m_tasks;
+
+    // Last, so reads in progress finish before anything else goes away.
+    boost::basic_thread_pool m_io_thread_pool;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "frustum_culling.hpp"
+
+#if defined(__AVX__)
+#define SQUADBOX_GFX_CULL_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SQUADBOX_GFX_CULL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace squadbox::gfx {
+
+void aabb_soa::clear() {
+    m_size = 0;
+
+    m_center_x.clear();
+    m_center_y.clear();
+    m_center_z.clear();
+    m_extents_x.clear();
+    m_extents_y.clear();
+    m_extents_z.clear();
+}
+
+void aabb_soa::reserve(std::size_t capacity) {
+    const auto padded_capacity = (capacity + batch_size - 1) / batch_size * batch_size;
+
+    m_center_x.reserve(padded_capacity);
+    m_center_y.reserve(padded_capacity);
+    m_center_z.reserve(padded_capacity);
+    m_extents_x.reserve(padded_capacity);
+    m_extents_y.reserve(padded_capacity);
+    m_extents_z.reserve(padded_capacity);
+}
+
+void aabb_soa::push_back(const aabb& bounds) {
+    // Grow a whole batch at a time; the padding is zero sized boxes whose results are dropped.
+    if (m_size % batch_size == 0) {
+        const auto padded_size = m_size + batch_size;
+
+        m_center_x.resize(padded_size);
+        m_center_y.resize(padded_size);
+        m_center_z.resize(padded_size);
+        m_extents_x.resize(padded_size);
+        m_extents_y.resize(padded_size);
+        m_extents_z.resize(padded_size);
+    }
+
+    const auto center = bounds.center();
+    const auto extents = bounds.extents();
+
+    m_center_x[m_size] = center.x;
+    m_center_y[m_size] = center.y;
+    m_center_z[m_size] = center.z;
+    m_extents_x[m_size] = extents.x;
+    m_extents_y[m_size] = extents.y;
+    m_extents_z[m_size] = extents.z;
+
+    ++m_size;
+}
+
+void cull_aabbs(const frustum& frustum, const aabb_soa& aabbs, std::vector<std::uint32_t>& visible_indices) {
+    const auto& planes = frustum.planes();
+
+    // A box is outside a plane if even its corner furthest along the normal is behind it:
+    // dot(n, center) + d + dot(|n|, extents) < 0.
+    auto append_visible = [&visible_indices, &aabbs](std::size_t batch_begin, int mask) {
+        for (std::size_t lane = 0; lane < aabb_soa::batch_size; ++lane) {
+            const auto index = batch_begin + lane;
+            if ((mask & (1 << lane)) && index < aabbs.size()) {
+                visible_indices.push_back(static_cast<std::uint32_t>(index));
+            }
+        }
+    };
+
+#if defined(SQUADBOX_GFX_CULL_AVX)
+    __m256 normal_x[6], normal_y[6], normal_z[6], abs_normal_x[6], abs_normal_y[6], abs_normal_z[6], distance[6];
+    for (std::size_t p = 0; p < planes.size(); ++p) {
+        normal_x[p] = _mm256_set1_ps(planes[p].x);
+        normal_y[p] = _mm256_set1_ps(planes[p].y);
+        normal_z[p] = _mm256_set1_ps(planes[p].z);
+        abs_normal_x[p] = _mm256_set1_ps(glm::abs(planes[p].x));
+        abs_normal_y[p] = _mm256_set1_ps(glm::abs(planes[p].y));
+        abs_normal_z[p] = _mm256_set1_ps(glm::abs(planes[p].z));
+        distance[p] = _mm256_set1_ps(planes[p].w);
+    }
+
+    const auto zero = _mm256_setzero_ps();
+
+    for (std::size_t i = 0; i < aabbs.size(); i += aabb_soa::batch_size) {
+        const auto center_x = _mm256_loadu_ps(&aabbs.m_center_x[i]);
+        const auto center_y = _mm256_loadu_ps(&aabbs.m_center_y[i]);
+        const auto center_z = _mm256_loadu_ps(&aabbs.m_center_z[i]);
+        const auto extents_x = _mm256_loadu_ps(&aabbs.m_extents_x[i]);
+        const auto extents_y = _mm256_loadu_ps(&aabbs.m_extents_y[i]);
+        const auto extents_z = _mm256_loadu_ps(&aabbs.m_extents_z[i]);
+
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (std::size_t p = 0; p < planes.size(); ++p) {
+            auto d = _mm256_add_ps(_mm256_mul_ps(normal_x[p], center_x), distance[p]);
+            d = _mm256_add_ps(d, _mm256_mul_ps(normal_y[p], center_y));
+            d = _mm256_add_ps(d, _mm256_mul_ps(normal_z[p], center_z));
+            d = _mm256_add_ps(d, _mm256_mul_ps(abs_normal_x[p], extents_x));
+            d = _mm256_add_ps(d, _mm256_mul_ps(abs_normal_y[p], extents_y));
+            d = _mm256_add_ps(d, _mm256_mul_ps(abs_normal_z[p], extents_z));
+
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+        }
+
+        append_visible(i, _mm256_movemask_ps(inside));
+    }
+#elif defined(SQUADBOX_GFX_CULL_SSE2)
+    __m128 normal_x[6], normal_y[6], normal_z[6], abs_normal_x[6], abs_normal_y[6], abs_normal_z[6], distance[6];
+    for (std::size_t p = 0; p < planes.size(); ++p) {
+        normal_x[p] = _mm_set1_ps(planes[p].x);
+        normal_y[p] = _mm_set1_ps(planes[p].y);
+        normal_z[p] = _mm_set1_ps(planes[p].z);
+        abs_normal_x[p] = _mm_set1_ps(glm::abs(planes[p].x));
+        abs_normal_y[p] = _mm_set1_ps(glm::abs(planes[p].y));
+        abs_normal_z[p] = _mm_set1_ps(glm::abs(planes[p].z));
+        distance[p] = _mm_set1_ps(planes[p].w);
+    }
+
+    const auto zero = _mm_setzero_ps();
+
+    auto test_half = [&](std::size_t i) {
+        const auto center_x = _mm_loadu_ps(&aabbs.m_center_x[i]);
+        const auto center_y = _mm_loadu_ps(&aabbs.m_center_y[i]);
+        const auto center_z = _mm_loadu_ps(&aabbs.m_center_z[i]);
+        const auto extents_x = _mm_loadu_ps(&aabbs.m_extents_x[i]);
+        const auto extents_y = _mm_loadu_ps(&aabbs.m_extents_y[i]);
+        const auto extents_z = _mm_loadu_ps(&aabbs.m_extents_z[i]);
+
+        auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (std::size_t p = 0; p < planes.size(); ++p) {
+            auto d = _mm_add_ps(_mm_mul_ps(normal_x[p], center_x), distance[p]);
+            d = _mm_add_ps(d, _mm_mul_ps(normal_y[p], center_y));
+            d = _mm_add_ps(d, _mm_mul_ps(normal_z[p], center_z));
+            d = _mm_add_ps(d, _mm_mul_ps(abs_normal_x[p], extents_x));
+            d = _mm_add_ps(d, _mm_mul_ps(abs_normal_y[p], extents_y));
+            d = _mm_add_ps(d, _mm_mul_ps(abs_normal_z[p], extents_z));
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+        }
+
+        return _mm_movemask_ps(inside);
+    };
+
+    for (std::size_t i = 0; i < aabbs.size(); i += aabb_soa::batch_size) {
+        append_visible(i, test_half(i) | (test_half(i + 4) << 4));
+    }
+#else
+    for (std::size_t i = 0; i < aabbs.size(); i += aabb_soa::batch_size) {
+        int mask = 0;
+
+        for (std::size_t lane = 0; lane < aabb_soa::batch_size; ++lane) {
+            const auto index = i + lane;
+            bool inside = true;
+
+            for (const auto& plane : planes) {
+                const auto d = plane.x * aabbs.m_center_x[index] + plane.y * aabbs.m_center_y[index] + plane.z * aabbs.m_center_z[index] + plane.w
+                             + glm::abs(plane.x) * aabbs.m_extents_x[index] + glm::abs(plane.y) * aabbs.m_extents_y[index] + glm::abs(plane.z) * aabbs.m_extents_z[index];
+                inside = inside && d >= 0.0f;
+            }
+
+            mask |= static_cast<int>(inside) << lane;
+        }
+
+        append_visible(i, mask);
+    }
+#endif
+}
+
+}
\ No newline at end of file
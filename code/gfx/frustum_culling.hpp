@@ -0,0 +1,45 @@
+#ifndef SQUADBOX_GFX_FRUSTUM_CULLING_HPP
+#define SQUADBOX_GFX_FRUSTUM_CULLING_HPP
+
+#pragma once
+
+#include "bounds.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// Boxes as center / extents in structure-of-arrays form, padded to whole batches so the
+// culling kernel can always load a full register.
+class aabb_soa {
+public:
+    static constexpr std::size_t batch_size = 8;
+
+    void clear();
+    void reserve(std::size_t capacity);
+    void push_back(const aabb& bounds);
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    friend void cull_aabbs(const frustum& frustum, const aabb_soa& aabbs, std::vector<std::uint32_t>& visible_indices);
+
+    std::size_t m_size = 0;
+
+    std::vector<float> m_center_x;
+    std::vector<float> m_center_y;
+    std::vector<float> m_center_z;
+    std::vector<float> m_extents_x;
+    std::vector<float> m_extents_y;
+    std::vector<float> m_extents_z;
+};
+
+// Appends the indices of the boxes that are at least partially inside the frustum, in order.
+// Tests 8 boxes at a time with AVX, or as two 4-wide halves with SSE2.
+void cull_aabbs(const frustum& frustum, const aabb_soa& aabbs, std::vector<std::uint32_t>& visible_indices);
+
+}
+
+#endif
\ No newline at end of file
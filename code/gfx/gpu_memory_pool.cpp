@@ -1,12 +1,14 @@
 #include "gpu_memory_pool.hpp"
 
+#include <algorithm>
+
 namespace squadbox::gfx {
 
 gpu_memory_pool::gpu_memory_pool(const vk::Device& device, const vk::PhysicalDevice& physical_device)
     : m_device(&device) {
     auto get_memory_type_index = [memory_props = physical_device.getMemoryProperties()](vk::MemoryPropertyFlags flags) {
         for (std::uint32_t i = 0; i < memory_props.memoryTypeCount; ++i) {
-            if (memory_props.memoryTypes[i].propertyFlags & flags) {
+            if ((memory_props.memoryTypes[i].propertyFlags & flags) == flags) {
                 return i;
             }
         }
@@ -100,7 +102,7 @@ gpu_memory gpu_memory_pool::allocate_gpu_local_mappable(const vk::MemoryRequirem
 gpu_memory_pool::memory_block* gpu_memory_pool::try_allocate_memory_block(std::uint32_t memory_type_index, std::deque<memory_block>& storage, vk::DeviceSize max_size, vk::DeviceSize min_size) {
     vk::MemoryAllocateInfo memory_alloc_info;
     memory_alloc_info
-        .setAllocationSize(max_size)
+        .setAllocationSize(std::max(max_size, min_size))
         .setMemoryTypeIndex(memory_type_index);
 
     while (true) {
@@ -108,6 +110,7 @@ gpu_memory_pool::memory_block* gpu_memory_pool::try_allocate_memory_block(std::u
             auto& block = storage.emplace_back();
             block.block = m_device->allocateMemoryUnique(memory_alloc_info);
             block.size = memory_alloc_info.allocationSize;
+            block.suballocation_pool = &m_suballocation_pool;
 
             auto deleter = [this](memory_block::suballocation* x) { m_suballocation_pool->destroy(x); };
             auto free_suballocation = std::unique_ptr<memory_block::suballocation, decltype(deleter)>(m_suballocation_pool->construct(), deleter);
@@ -125,6 +128,7 @@ gpu_memory_pool::memory_block* gpu_memory_pool::try_allocate_memory_block(std::u
             return &block;
         }
         catch (vk::OutOfDeviceMemoryError) {
+            storage.pop_back();
             memory_alloc_info.allocationSize /= 2;
             if (memory_alloc_info.allocationSize < min_size) break;
         }
@@ -136,14 +140,24 @@ gpu_memory_pool::memory_block* gpu_memory_pool::try_allocate_memory_block(std::u
 gpu_memory_pool::memory_block::suballocation* gpu_memory_pool::try_allocate(memory_block& block, const vk::MemoryRequirements& requirements) {
     std::unique_lock lock(block.mutex);
 
-    if (block.max_free_suballocation == nullptr || (block.max_free_suballocation->size - (block.max_free_suballocation->offset % requirements.alignment)) < requirements.size) {
+    // Space left in a free range once its start is aligned.
+    auto aligned_offset = [&requirements](const memory_block::suballocation& free_suballocation) {
+        return (free_suballocation.offset + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+    };
+
+    auto fits = [&](const memory_block::suballocation& free_suballocation) {
+        const auto padding = aligned_offset(free_suballocation) - free_suballocation.offset;
+        return free_suballocation.size >= padding && free_suballocation.size - padding >= requirements.size;
+    };
+
+    if (block.max_free_suballocation == nullptr || !fits(*block.max_free_suballocation)) {
         return nullptr;
     }
 
     memory_block::suballocation* free_suballocation_pick = nullptr;
     memory_block::suballocation* second_max_free_suballocation = nullptr;
     for (auto& free_suballocation : block.free_suballocations) {
-        if ((free_suballocation.size - (free_suballocation.offset % requirements.alignment)) < requirements.size) continue;
+        if (!fits(free_suballocation)) continue;
 
         if (free_suballocation_pick == nullptr) {
             free_suballocation_pick = &free_suballocation;
@@ -163,7 +177,7 @@ gpu_memory_pool::memory_block::suballocation* gpu_memory_pool::try_allocate(memo
 
     memory_block::suballocation* new_suballocation = nullptr;
 
-    auto new_suballocation_offset = free_suballocation_pick->offset + requirements.alignment - (free_suballocation_pick->offset % requirements.alignment);
+    auto new_suballocation_offset = aligned_offset(*free_suballocation_pick);
 
     if (new_suballocation_offset == free_suballocation_pick->offset && requirements.size == free_suballocation_pick->size) {
         free_suballocation_pick->is_free = false;
@@ -177,7 +191,7 @@ gpu_memory_pool::memory_block::suballocation* gpu_memory_pool::try_allocate(memo
         new_suballocation_safe->offset = new_suballocation_offset;
         new_suballocation_safe->size = requirements.size;
 
-        free_suballocation_pick->size = free_suballocation_pick->size - ((new_suballocation_safe->offset - free_suballocation_pick->offset) + new_suballocation->size);
+        free_suballocation_pick->size = free_suballocation_pick->size - ((new_suballocation_safe->offset - free_suballocation_pick->offset) + new_suballocation_safe->size);
         free_suballocation_pick->offset = new_suballocation_safe->offset + new_suballocation_safe->size;
 
         new_suballocation = new_suballocation_safe.release();
@@ -204,6 +218,10 @@ gpu_memory_pool::memory_block::suballocation* gpu_memory_pool::try_allocate(memo
 }
 
 gpu_memory::~gpu_memory() {
+    release();
+}
+
+void gpu_memory::release() {
     if (m_suballocation == nullptr) return;
 
     auto& block = *m_suballocation->block;
@@ -250,18 +268,22 @@ gpu_memory::~gpu_memory() {
         new_free_allocation.is_free = true;
     }
 
-    if (new_free_allocation.size >= block.max_free_suballocation->size) {
+    if (block.max_free_suballocation == nullptr || new_free_allocation.size >= block.max_free_suballocation->size) {
         block.max_free_suballocation = &new_free_allocation;
     }
 
-    for (auto iter = std::next(merge_free_first); iter != std::next(merge_free_last); ++iter) {
+    for (auto iter = std::next(merge_free_first); iter != std::next(merge_free_last);) {
         if (iter->is_free) {
             block.free_suballocations.erase(block.free_suballocations.iterator_to(*iter));
         }
 
-        block.suballocations.erase(iter);
-        block.suballocation_pool->synchronize()->destroy(&*iter);
+        auto& merged = *iter;
+        iter = block.suballocations.erase(iter);
+        block.suballocation_pool->synchronize()->destroy(&merged);
     }
+
+    m_handle = nullptr;
+    m_suballocation = nullptr;
 }
 
 gpu_memory::gpu_memory(gpu_memory&& rhs)
@@ -271,6 +293,10 @@ gpu_memory::gpu_memory(gpu_memory&& rhs)
 }
 
 gpu_memory& gpu_memory::operator=(gpu_memory && rhs) {
+    if (this == &rhs) return *this;
+
+    release();
+
     m_handle = rhs.m_handle;
     m_offset = rhs.m_offset;
     m_size = rhs.m_size;
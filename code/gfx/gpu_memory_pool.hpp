@@ -80,6 +80,7 @@ class gpu_memory {
 public:
     friend class gpu_memory_pool;
 
+    gpu_memory() = default;
     gpu_memory(gpu_memory&& rhs);
     ~gpu_memory();
 
@@ -89,6 +90,8 @@ public:
     const vk::DeviceSize& offset() const { return m_suballocation->offset; }
     const vk::DeviceSize& size() const { return m_suballocation->size; }
 
+    bool is_valid() const { return m_suballocation != nullptr; }
+
 private:
     gpu_memory(gsl::not_null<gpu_memory_pool::memory_block::suballocation*> suballocation)
         : m_handle(suballocation->block->block.get()),
@@ -96,10 +99,12 @@ private:
           m_size(suballocation->size),
           m_suballocation(suballocation) {}
 
+    void release();
+
     vk::DeviceMemory m_handle;
-    vk::DeviceSize m_offset;
-    vk::DeviceSize m_size;
-    gpu_memory_pool::memory_block::suballocation* m_suballocation;
+    vk::DeviceSize m_offset = 0;
+    vk::DeviceSize m_size = 0;
+    gpu_memory_pool::memory_block::suballocation* m_suballocation = nullptr;
 };
 
 }
@@ -1,29 +1,232 @@
 #ifndef SQUADBOX_GFX_GPU_MESH_HPP
 #define SQUADBOX_GFX_GPU_MESH_HPP
 
+#include "cooked_mesh.hpp"
+#include "index_packing.hpp"
 #include "mesh.hpp"
+#include "mesh_uploader.hpp"
 
+#include <glm/gtc/matrix_transform.hpp>
 #include <vulkan/vulkan.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
 namespace squadbox::gfx {
 
 namespace internal_gpu_mesh {
-    using vertex_position_t = glm::vec3;
-    using vertex_normal_t = glm::vec3;
-    using vertex_tex_2d_coord_t = glm::vec2;
-    using vertex_color_t = glm::vec4;
+    inline std::uint16_t float_to_half(float value) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        const auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+        const auto exponent = static_cast<std::int32_t>((bits >> 23) & 0xffu) - 127 + 15;
+        auto mantissa = bits & 0x7fffffu;
+
+        if (((bits >> 23) & 0xffu) == 0xffu) {
+            // Inf stays inf, NaN stays NaN.
+            return static_cast<std::uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+        }
+
+        if (exponent >= 0x1f) return static_cast<std::uint16_t>(sign | 0x7c00u);
+
+        if (exponent <= 0) {
+            if (exponent < -10) return sign;
+
+            // Denormal; the implicit leading one becomes explicit.
+            mantissa |= 0x800000u;
+            const auto shift = static_cast<std::uint32_t>(14 - exponent);
+            const auto rounded = (mantissa + (1u << (shift - 1)) - 1u + ((mantissa >> shift) & 1u)) >> shift;
+            return static_cast<std::uint16_t>(sign | rounded);
+        }
+
+        // Round to nearest even; a carry out of the mantissa correctly bumps the exponent.
+        const auto half = (static_cast<std::uint32_t>(exponent) << 10) | (mantissa >> 13);
+        const auto rounded = half + ((mantissa & 0x1fffu) > 0x1000u || ((mantissa & 0x1fffu) == 0x1000u && (half & 1u)));
+        return static_cast<std::uint16_t>(sign | rounded);
+    }
+
+    inline std::uint16_t float_to_unorm16(float value) {
+        return static_cast<std::uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    inline std::int16_t float_to_snorm16(float value) {
+        return static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    inline std::uint8_t float_to_unorm8(float value) {
+        return static_cast<std::uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+
+    // Maps the unit sphere onto the [-1, 1] square: the upper hemisphere projected onto the octahedron, the lower
+    // one folded over its edges. Decoding is a few instructions in the vertex shader (see shaders/octahedral.glsl).
+    // A zero normal, e.g. of a degenerate triangle, encodes as +Z rather than dividing by zero.
+    inline glm::vec2 octahedral_encode(const glm::vec3& normal) {
+        const auto l1_norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (l1_norm == 0.0f) return { 0.0f, 0.0f };
+
+        const auto projected = normal / l1_norm;
+        if (projected.z >= 0.0f) return { projected.x, projected.y };
+
+        return {
+            (1.0f - std::abs(projected.y)) * (projected.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - std::abs(projected.x)) * (projected.y >= 0.0f ? 1.0f : -1.0f)
+        };
+    }
+
+
+    // How a mesh feature is stored in a vertex buffer for a given Vulkan format. Every storage type is a multiple of
+    // 4 bytes with the alignment of its components, so interleaved vertices need no padding between attributes and
+    // every attribute offset satisfies Vulkan's component alignment.
+    template<typename mesh_feature, vk::Format vulkan_format>
+    struct vertex_attribute_encoding {
+        static_assert(sizeof(mesh_feature) == 0, "Unsupported vulkan format for this mesh feature.");
+    };
+
+    template<>
+    struct vertex_attribute_encoding<mesh_features::position, vk::Format::eR32G32B32Sfloat> {
+        using storage = glm::vec3;
+        static constexpr bool bounds_relative = false;
+
+        static storage encode(const glm::vec3& position, const aabb&) { return position; }
+    };
+
+    // Half floats keep ~3 significant digits, plenty for model space positions of moderately sized meshes.
+    // 3 component 16-bit formats are rarely supported for vertex input, hence the w padding.
+    template<>
+    struct vertex_attribute_encoding<mesh_features::position, vk::Format::eR16G16B16A16Sfloat> {
+        using storage = std::array<std::uint16_t, 4>;
+        static constexpr bool bounds_relative = false;
+
+        static storage encode(const glm::vec3& position, const aabb&) {
+            return { float_to_half(position.x), float_to_half(position.y), float_to_half(position.z), float_to_half(1.0f) };
+        }
+    };
+
+    // Normalized to the mesh bounds, so the precision is evenly spread over the mesh whatever its size and offset.
+    // Shaders see [0, 1] and need gpu_mesh::position_decode_matrix() to get back to model space.
+    template<>
+    struct vertex_attribute_encoding<mesh_features::position, vk::Format::eR16G16B16A16Unorm> {
+        using storage = std::array<std::uint16_t, 4>;
+        static constexpr bool bounds_relative = true;
+
+        static storage encode(const glm::vec3& position, const aabb& bounds) {
+            const auto extent = glm::max(bounds.max_corner() - bounds.min_corner(), glm::vec3(std::numeric_limits<float>::min()));
+            const auto normalized = (position - bounds.min_corner()) / extent;
+
+            return { float_to_unorm16(normalized.x), float_to_unorm16(normalized.y), float_to_unorm16(normalized.z), 65535 };
+        }
+    };
+
+    template<>
+    struct vertex_attribute_encoding<mesh_features::normal, vk::Format::eR32G32B32Sfloat> {
+        using storage = glm::vec3;
+
+        static storage encode(const glm::vec3& normal, const aabb&) { return normal; }
+    };
+
+    // Octahedral; the shader reads a vec2 and decodes it with octahedral_decode().
+    template<>
+    struct vertex_attribute_encoding<mesh_features::normal, vk::Format::eR16G16Snorm> {
+        using storage = std::array<std::int16_t, 2>;
+
+        static storage encode(const glm::vec3& normal, const aabb&) {
+            const auto encoded = octahedral_encode(normal);
+            return { float_to_snorm16(encoded.x), float_to_snorm16(encoded.y) };
+        }
+    };
+
+    template<>
+    struct vertex_attribute_encoding<mesh_features::tex_2d_coord, vk::Format::eR32G32Sfloat> {
+        using storage = glm::vec2;
+
+        static storage encode(const glm::vec2& tex_2d_coord, const aabb&) { return tex_2d_coord; }
+    };
+
+    // Only for coordinates within [0, 1], i.e. no wrapping.
+    template<>
+    struct vertex_attribute_encoding<mesh_features::tex_2d_coord, vk::Format::eR16G16Unorm> {
+        using storage = std::array<std::uint16_t, 2>;
+
+        static storage encode(const glm::vec2& tex_2d_coord, const aabb&) {
+            return { float_to_unorm16(tex_2d_coord.x), float_to_unorm16(tex_2d_coord.y) };
+        }
+    };
+
+    template<>
+    struct vertex_attribute_encoding<mesh_features::color, vk::Format::eR32G32B32A32Sfloat> {
+        using storage = glm::vec4;
+
+        static storage encode(const glm::vec4& color, const aabb&) { return color; }
+    };
+
+    template<>
+    struct vertex_attribute_encoding<mesh_features::color, vk::Format::eR8G8B8A8Unorm> {
+        using storage = std::array<std::uint8_t, 4>;
+
+        static storage encode(const glm::vec4& color, const aabb&) {
+            return { float_to_unorm8(color.x), float_to_unorm8(color.y), float_to_unorm8(color.z), float_to_unorm8(color.w) };
+        }
+    };
+
+
+    // A mesh feature as laid out in one vertex buffer.
+    template<typename arg_mesh_feature, vk::Format arg_vulkan_format>
+    struct vertex_attribute : vertex_attribute_encoding<arg_mesh_feature, arg_vulkan_format> {
+        using mesh_feature = arg_mesh_feature;
+        static constexpr auto vulkan_format = arg_vulkan_format;
+    };
+
+    template<typename attribute, typename mesh_feature>
+    struct is_attribute_of : std::false_type {};
+
+    template<typename mesh_feature, vk::Format vulkan_format>
+    struct is_attribute_of<vertex_attribute<mesh_feature, vulkan_format>, mesh_feature> : std::true_type {};
+
+    // The attribute of a mesh feature among the vertex's attributes, or void. Absent features are void too.
+    template<typename mesh_feature, typename... attributes>
+    struct find_attribute {
+        using type = void;
+    };
+
+    template<typename mesh_feature, typename attribute, typename... attributes>
+    struct find_attribute<mesh_feature, attribute, attributes...> {
+        using type = std::conditional_t<is_attribute_of<attribute, mesh_feature>::value,
+                                        attribute, typename find_attribute<mesh_feature, attributes...>::type>;
+    };
+
+    template<typename attribute>
+    struct attribute_storage {
+        using type = typename attribute::storage;
+    };
+
+    template<>
+    struct attribute_storage<void> {
+        using type = void;
+    };
+
+    template<typename mesh_feature, typename... attributes>
+    using attribute_storage_t = typename attribute_storage<typename find_attribute<mesh_feature, attributes...>::type>::type;
+
 
     // :( can't use mixins / multiple base classes as it makes the type non-standard layout
-    template<bool has_position, bool has_normal, bool has_tex_2d_coord, bool has_color>
+    template<bool has_position, bool has_normal, bool has_tex_2d_coord, bool has_color,
+             typename position_t, typename normal_t, typename tex_2d_coord_t, typename color_t>
     struct interleaved_vertex_base;
 
-    #define SQUADBOX_GFX_INTERNAL_GEN_INTERLEAVED_VERTEX_BASE_4(P1, P2, P3, P4)         \
-        template<>                                                                      \
-        struct interleaved_vertex_base<P1, P2, P3, P4> {                                    \
-            BOOST_PP_IF(BOOST_PP_EQUAL(P1, 1), vertex_position_t position;, )           \
-            BOOST_PP_IF(BOOST_PP_EQUAL(P2, 1), vertex_normal_t normal;, )               \
-            BOOST_PP_IF(BOOST_PP_EQUAL(P3, 1), vertex_tex_2d_coord_t tex_2d_coord;, )   \
-            BOOST_PP_IF(BOOST_PP_EQUAL(P4, 1), vertex_color_t color;, )                 \
+    #define SQUADBOX_GFX_INTERNAL_GEN_INTERLEAVED_VERTEX_BASE_4(P1, P2, P3, P4)                                  \
+        template<typename position_t, typename normal_t, typename tex_2d_coord_t, typename color_t>              \
+        struct interleaved_vertex_base<P1, P2, P3, P4, position_t, normal_t, tex_2d_coord_t, color_t> {          \
+            BOOST_PP_IF(BOOST_PP_EQUAL(P1, 1), position_t position;, )                                            \
+            BOOST_PP_IF(BOOST_PP_EQUAL(P2, 1), normal_t normal;, )                                                \
+            BOOST_PP_IF(BOOST_PP_EQUAL(P3, 1), tex_2d_coord_t tex_2d_coord;, )                                    \
+            BOOST_PP_IF(BOOST_PP_EQUAL(P4, 1), color_t color;, )                                                  \
         };
 
     #define SQUADBOX_GFX_INTERNAL_GEN_INTERLEAVED_VERTEX_BASE_3(P1, P2, P3) \
@@ -44,26 +247,36 @@ namespace internal_gpu_mesh {
 
     SQUADBOX_GFX_INTERNAL_GEN_INTERLEAVED_VERTEX_BASE()
 
-    template<typename... features>
+    // A vertex holding the given vertex_attributes (void entries are skipped), each in its packed storage.
+    template<typename... attributes>
     struct interleaved_vertex
         : interleaved_vertex_base<
-            std::disjunction_v<std::is_same<features, mesh_features::position>...>,
-            std::disjunction_v<std::is_same<features, mesh_features::normal>...>,
-            std::disjunction_v<std::is_same<features, mesh_features::tex_2d_coord>...>,
-            std::disjunction_v<std::is_same<features, mesh_features::color>...>
+            std::disjunction_v<is_attribute_of<attributes, mesh_features::position>...>,
+            std::disjunction_v<is_attribute_of<attributes, mesh_features::normal>...>,
+            std::disjunction_v<is_attribute_of<attributes, mesh_features::tex_2d_coord>...>,
+            std::disjunction_v<is_attribute_of<attributes, mesh_features::color>...>,
+            attribute_storage_t<mesh_features::position, attributes...>,
+            attribute_storage_t<mesh_features::normal, attributes...>,
+            attribute_storage_t<mesh_features::tex_2d_coord, attributes...>,
+            attribute_storage_t<mesh_features::color, attributes...>
         > {
         interleaved_vertex() = default;
         interleaved_vertex(const interleaved_vertex&) = default;
 
-        static const bool has_position = std::disjunction_v<std::is_same<features, mesh_features::position>...>;
-        static const bool has_normal = std::disjunction_v<std::is_same<features, mesh_features::normal>...>;
-        static const bool has_tex_2d_coord = std::disjunction_v<std::is_same<features, mesh_features::tex_2d_coord>...>;
-        static const bool has_color = std::disjunction_v<std::is_same<features, mesh_features::color>...>;
+        static const bool has_position = std::disjunction_v<is_attribute_of<attributes, mesh_features::position>...>;
+        static const bool has_normal = std::disjunction_v<is_attribute_of<attributes, mesh_features::normal>...>;
+        static const bool has_tex_2d_coord = std::disjunction_v<is_attribute_of<attributes, mesh_features::tex_2d_coord>...>;
+        static const bool has_color = std::disjunction_v<is_attribute_of<attributes, mesh_features::color>...>;
 
-        template<typename... other_vertex_features, typename = std::enable_if_t<!std::is_same_v<interleaved_vertex, interleaved_vertex<other_vertex_features...>>>>
-        operator interleaved_vertex<other_vertex_features...>() const {
+        using position_attribute = typename find_attribute<mesh_features::position, attributes...>::type;
+        using normal_attribute = typename find_attribute<mesh_features::normal, attributes...>::type;
+        using tex_2d_coord_attribute = typename find_attribute<mesh_features::tex_2d_coord, attributes...>::type;
+        using color_attribute = typename find_attribute<mesh_features::color, attributes...>::type;
+
+        template<typename... other_vertex_attributes, typename = std::enable_if_t<!std::is_same_v<interleaved_vertex, interleaved_vertex<other_vertex_attributes...>>>>
+        operator interleaved_vertex<other_vertex_attributes...>() const {
             using this_vertex_t = interleaved_vertex;
-            using other_vertex_t = interleaved_vertex<other_vertex_features...>;
+            using other_vertex_t = interleaved_vertex<other_vertex_attributes...>;
 
             other_vertex_t other;
             other.position = this->position;
@@ -84,6 +297,33 @@ namespace internal_gpu_mesh {
             }
         }
 
+        // Packs one vertex of the mesh. The mesh's bounds are what bounds relative positions are normalized to.
+        template<typename mesh_type>
+        static interleaved_vertex encode(const mesh_type& mesh, std::size_t vertex) {
+            static_assert(sizeof(interleaved_vertex) % 4 == 0);
+
+            const auto& bounds = mesh.bounds();
+            interleaved_vertex result;
+
+            if constexpr(has_position) {
+                result.position = position_attribute::encode(mesh.positions()[vertex], bounds);
+            }
+
+            if constexpr(has_normal) {
+                result.normal = normal_attribute::encode(mesh.normals()[vertex], bounds);
+            }
+
+            if constexpr(has_tex_2d_coord) {
+                result.tex_2d_coord = tex_2d_coord_attribute::encode(mesh.tex_2d_coords()[vertex], bounds);
+            }
+
+            if constexpr(has_color) {
+                result.color = color_attribute::encode(mesh.colors()[vertex], bounds);
+            }
+
+            return result;
+        }
+
         template<typename feature_t>
         static std::size_t offset_of() {
             static_assert(std::is_standard_layout_v<interleaved_vertex>);
@@ -188,10 +428,29 @@ namespace internal_gpu_mesh {
 
     template<unsigned long long usage_needed, template <unsigned long long, std::uint32_t, vk::Format> typename feature, std::uint32_t glsl_location, vk::Format format>
     struct get_mesh_feature_for_interleaved_vertex<usage_needed, feature<usage_needed, glsl_location, format>> {
-        using type = typename feature<usage_needed, glsl_location, format>::mesh_feature;
+        using type = vertex_attribute<typename feature<usage_needed, glsl_location, format>::mesh_feature, format>;
     };
 
 
+    template<typename feature>
+    constexpr bool is_bounds_relative_position() {
+        if constexpr(std::is_same_v<typename feature::mesh_feature, mesh_features::position>) {
+            return vertex_attribute_encoding<mesh_features::position, feature::vulkan_format>::bounds_relative;
+        }
+        else {
+            return false;
+        }
+    }
+
+    // Format of the position feature among the features, or eUndefined.
+    template<typename... features>
+    constexpr vk::Format position_format() {
+        vk::Format format = vk::Format::eUndefined;
+        ((format = std::is_same_v<typename features::mesh_feature, mesh_features::position> ? features::vulkan_format : format), ...);
+        return format;
+    }
+
+
     template<typename feature, typename search_features, typename orig_features>
     struct get_glsl_location_impl;
 
@@ -236,8 +495,17 @@ public:
 
     static constexpr int num_vertex_shader_only_features = internal_gpu_mesh::count_usage<gpu_mesh_usage::vertex, features...>;
     static constexpr int num_fragment_shader_only_features = internal_gpu_mesh::count_usage<gpu_mesh_usage::fragment, features...>;
+    static constexpr bool has_bounds_relative_positions = (internal_gpu_mesh::is_bounds_relative_position<features>() || ...);
+
+    // Depth positions are stored in the same format as the position feature, so depth-only passes compute exactly
+    // the same positions as the passes that use the full vertex.
+    static constexpr vk::Format depth_position_format = internal_gpu_mesh::position_format<features...>();
 
 private:
+    using depth_position_element_type = internal_gpu_mesh::interleaved_vertex<
+        internal_gpu_mesh::vertex_attribute<mesh_features::position, depth_position_format>
+    >;
+
     template<bool enable>
     struct common_buffer_base {};
 
@@ -246,8 +514,6 @@ private:
         using common_buffer_element_type = internal_gpu_mesh::interleaved_vertex<
             typename internal_gpu_mesh::get_mesh_feature_for_interleaved_vertex<gpu_mesh_usage::vertex | gpu_mesh_usage::fragment, features>::type...
         >;
-
-        vk::UniqueBuffer common_buffer;
     };
 
     template<bool enable>
@@ -258,8 +524,6 @@ private:
         using vertex_shader_only_buffer_element_type = internal_gpu_mesh::interleaved_vertex<
             typename internal_gpu_mesh::get_mesh_feature_for_interleaved_vertex<gpu_mesh_usage::vertex, features>::type...
         >;
-
-        vk::UniqueBuffer vertex_shader_only_buffer;
     };
 
     template<bool enable>
@@ -270,8 +534,6 @@ private:
         using fragment_shader_only_buffer_element_type = internal_gpu_mesh::interleaved_vertex<
             typename internal_gpu_mesh::get_mesh_feature_for_interleaved_vertex<gpu_mesh_usage::fragment, features>::type...
         >;
-
-        vk::UniqueBuffer fragment_shader_only_buffer;
     };
 
     struct vertex_buffers_storage
@@ -284,85 +546,173 @@ private:
     };
 
 public:
+    // Type of index counts and offsets. The indices themselves are 16 or 32-bit per mesh, see vulkan_index_type().
     using index_type = std::uint32_t;
 
-    /*template<typename... input_mesh_features>
-    static gpu_mesh create(const mesh<input_mesh_features...>& mesh, const vk::Device& device,
-                           const vk::PhysicalDeviceMemoryProperties& device_memory_props) {
+    // Packs the mesh into this layout and stages it in the uploader's current batch: every vertex stream and the
+    // indices go into one buffer. It can be drawn once the uploader has submitted the batch. Safe to call from
+    // several threads with the same uploader.
+    //
+    // With depth_positions, the positions are also written on their own as a tightly packed stream for depth-only
+    // passes (see depth_vertex_buffer()).
+    template<typename... input_mesh_features>
+    static gpu_mesh create(const mesh<input_mesh_features...>& mesh, mesh_uploader& uploader,
+                           index_topology topology = index_topology::triangle_list, bool depth_positions = false) {
         gpu_mesh gpu_mesh;
 
-        gpu_mesh.m_vertex_buffer = [](const vk::Device& device, const vk::DeviceSize required_vertex_buffer_size) {
-            vk::BufferCreateInfo vertex_buffer_ci;
-            vertex_buffer_ci
-                .setSize(required_vertex_buffer_size)
-                .setUsage(vk::BufferUsageFlagBits::eVertexBuffer)
-                .setSharingMode(vk::SharingMode::eExclusive);
+        auto packed_indices = pack_indices(mesh.lod_indices(), mesh.lods(), mesh.meshlets(), static_cast<std::size_t>(mesh.positions().size()), topology);
+        const auto buffer_size = gpu_mesh.lay_out(mesh, packed_indices, depth_positions);
 
-            return device.createBufferUnique(vertex_buffer_ci);
-        }(device, mesh.vertices().size_bytes());
+        auto allocation = uploader.allocate(buffer_size, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer);
+        gpu_mesh.write_buffer(mesh, packed_indices, allocation.staging);
+        allocation.write.finish();
 
-        gpu_mesh.m_index_buffer = [](const vk::Device& device, const vk::DeviceSize required_index_buffer_size) {
-            vk::BufferCreateInfo index_buffer_ci;
-            index_buffer_ci
-                .setSize(required_index_buffer_size)
-                .setUsage(vk::BufferUsageFlagBits::eIndexBuffer)
-                .setSharingMode(vk::SharingMode::eExclusive);
+        gpu_mesh.m_buffer = std::move(allocation.buffer);
+        gpu_mesh.m_memory = std::move(allocation.memory);
 
-            return device.createBufferUnique(index_buffer_ci);
-        }(device, mesh.triangle_list_indices().size_bytes());
+        return gpu_mesh;
+    }
 
-        auto [ vertex_index_buffers_memory, vertex_index_buffers_memory_size,
-               vertex_buffer_offset, index_buffer_offset ]
-            = [](const vk::Device& device, const vk::PhysicalDeviceMemoryProperties& device_memory_props,
-                 const vk::Buffer& vertex_buffer, const vk::Buffer& index_buffer) {
-            const auto vertex_buffer_memory_reqs = device.getBufferMemoryRequirements(vertex_buffer);
-            const auto index_buffer_memory_reqs = device.getBufferMemoryRequirements(index_buffer);
+    // The buffer create() would upload and everything else it works out, for write_cooked_meshes(). load() reads it
+    // back into the same gpu_mesh create() makes.
+    template<typename... input_mesh_features>
+    static cooked_mesh cook(const mesh<input_mesh_features...>& mesh,
+                            index_topology topology = index_topology::triangle_list, bool depth_positions = false) {
+        gpu_mesh gpu_mesh;
 
-            const vk::DeviceSize vertex_buffer_offset = 0;
-            const vk::DeviceSize index_buffer_offset =
-                vertex_buffer_memory_reqs.size
-                + index_buffer_memory_reqs.alignment
-                - (vertex_buffer_memory_reqs.size % index_buffer_memory_reqs.alignment);
+        auto packed_indices = pack_indices(mesh.lod_indices(), mesh.lods(), mesh.meshlets(), static_cast<std::size_t>(mesh.positions().size()), topology);
 
-            const auto required_device_memory_size = vertex_buffer_offset + index_buffer_offset + index_buffer_memory_reqs.size;
+        cooked_mesh cooked;
+        cooked.data.resize(gpu_mesh.lay_out(mesh, packed_indices, depth_positions));
+        gpu_mesh.write_buffer(mesh, packed_indices, cooked.data);
 
-            const auto vertex_buffer_memory_type_index = vk_utils::get_memory_type_index(device_memory_props, vertex_buffer_memory_reqs, vk::MemoryPropertyFlagBits::eHostVisible);
-            const auto index_buffer_memory_type_index = vk_utils::get_memory_type_index(device_memory_props, index_buffer_memory_reqs, vk::MemoryPropertyFlagBits::eHostVisible);
+        auto& desc = cooked.desc;
 
-            assert(vertex_buffer_memory_type_index == index_buffer_memory_type_index);
+        auto add_stream = [&desc](vk::DeviceSize offset, std::size_t element_size, std::size_t element_count, cooked_stream_codec codec) {
+            auto& stream = desc.streams[desc.stream_count++];
+            stream.buffer_offset = offset;
+            stream.element_size = static_cast<std::uint32_t>(element_size);
+            stream.element_count = static_cast<std::uint32_t>(element_count);
+            stream.codec = codec;
+        };
 
-            vk::MemoryAllocateInfo memory_alloc_info;
-            memory_alloc_info
-                .setAllocationSize(required_device_memory_size)
-                .setMemoryTypeIndex(vertex_buffer_memory_type_index);
+        const auto num_vertices = static_cast<std::size_t>(mesh.positions().size());
+        std::uint32_t stream = 0;
 
-            return std::make_tuple(device.allocateMemoryUnique(memory_alloc_info), required_device_memory_size,
-                                    vertex_buffer_offset, index_buffer_offset);
-        }(device, device_memory_props, gpu_mesh.vertex_buffer.get(), gpu_mesh.index_buffer.get());
+        if constexpr(vertex_buffers_storage::has_common_buffer) {
+            add_stream(gpu_mesh.m_vertex_buffer_offsets[stream++], sizeof(typename vertex_buffers_storage::common_buffer_element_type), num_vertices,
+                       cooked_stream_codec::vertices);
+        }
 
-        device.bindBufferMemory(gpu_mesh.m_vertex_buffer.get(), gpu_mesh.m_vertex_index_buffers_memory.get(), vertex_buffer_offset);
-        device.bindBufferMemory(gpu_mesh.m_index_buffer.get(), gpu_mesh.m_vertex_index_buffers_memory.get(), index_buffer_offset);
+        if constexpr(vertex_buffers_storage::has_vertex_shader_only_buffer) {
+            add_stream(gpu_mesh.m_vertex_buffer_offsets[stream++], sizeof(typename vertex_buffers_storage::vertex_shader_only_buffer_element_type), num_vertices,
+                       cooked_stream_codec::vertices);
+        }
 
-        {
-            const void* mapped_memory_ptr = device.mapMemory(gpu_mesh.m_vertex_index_buffers_memory.get(), 0, vertex_index_buffers_memory_size);
-            auto vertex_dst = static_cast<typename gpu_mesh<gpu_mesh_features...>::vertex_t*>(mapped_memory_ptr + vertex_buffer_offset);
-            auto index_dst = static_cast<typename gpu_mesh<gpu_mesh_features...>::index_t*>(mapped_memory_ptr + index_buffer_offset);
+        if constexpr(vertex_buffers_storage::has_fragment_shader_only_buffer) {
+            add_stream(gpu_mesh.m_vertex_buffer_offsets[stream++], sizeof(typename vertex_buffers_storage::fragment_shader_only_buffer_element_type), num_vertices,
+                       cooked_stream_codec::vertices);
+        }
 
-            std::copy_n(mesh.vertices().data(), mesh.vertices().size(), vertex_dst);
-            std::copy_n(mesh.triangle_list_indices().data(), mesh.triangle_list_indices().size(), index_dst);
+        if (gpu_mesh.m_has_depth_positions) {
+            add_stream(gpu_mesh.m_depth_vertex_buffer_offset, sizeof(depth_position_element_type), num_vertices, cooked_stream_codec::vertices);
+        }
 
-            vk::MappedMemoryRange mapped_memory;
-            mapped_memory
-                .setMemory(vertex_index_buffers_memory)
-                .setOffset(0)
-                .setSize(vertex_index_buffers_memory_size);
+        add_stream(gpu_mesh.m_index_buffer_offset, index_size(packed_indices.index_type), packed_indices.size(),
+                   topology == index_topology::triangle_list ? cooked_stream_codec::triangle_indices : cooked_stream_codec::index_sequence);
+
+        desc.layout_id = layout_id();
+        desc.num_vertex_buffers = num_vertex_buffers;
+        std::copy(gpu_mesh.m_vertex_buffer_offsets.begin(), gpu_mesh.m_vertex_buffer_offsets.end(), desc.vertex_buffer_offsets.begin());
+        desc.depth_vertex_buffer_offset = gpu_mesh.m_depth_vertex_buffer_offset;
+        desc.has_depth_positions = gpu_mesh.m_has_depth_positions;
+        desc.index_buffer_offset = gpu_mesh.m_index_buffer_offset;
+        desc.index_count = gpu_mesh.m_index_count;
+        desc.index_type = static_cast<std::uint32_t>(gpu_mesh.m_index_type);
+        desc.topology = static_cast<std::uint32_t>(gpu_mesh.m_topology);
+        desc.bounds_min = { gpu_mesh.m_bounds.min_corner().x, gpu_mesh.m_bounds.min_corner().y, gpu_mesh.m_bounds.min_corner().z };
+        desc.bounds_max = { gpu_mesh.m_bounds.max_corner().x, gpu_mesh.m_bounds.max_corner().y, gpu_mesh.m_bounds.max_corner().z };
+        desc.bounding_sphere = { gpu_mesh.m_bounding_sphere.center.x, gpu_mesh.m_bounding_sphere.center.y, gpu_mesh.m_bounding_sphere.center.z,
+                                 gpu_mesh.m_bounding_sphere.radius };
+        std::memcpy(desc.position_decode_matrix.data(), &gpu_mesh.m_position_decode_matrix[0][0], sizeof(desc.position_decode_matrix));
+
+        cooked.lods = std::move(gpu_mesh.m_lods);
+        cooked.meshlets = std::move(gpu_mesh.m_meshlets);
+
+        return cooked;
+    }
+
+    // Stages one mesh of a cooked file: its buffer is decoded from the mapping straight into staging memory, with
+    // nothing else to convert. Throws if it was cooked for a different layout, or is corrupt. Same threading rules as
+    // create().
+    static gpu_mesh load(const cooked_mesh_file& file, std::size_t index, mesh_uploader& uploader) {
+        const auto& desc = file.desc(index);
+        if (desc.layout_id != layout_id() || desc.num_vertex_buffers != num_vertex_buffers) {
+            throw std::runtime_error("gpu_mesh: the cooked mesh is in a different vertex layout. Cook it again.");
+        }
 
-            device.flushMappedMemoryRanges({ mapped_memory });
-            device.unmapMemory(gpu_mesh.m_vertex_index_buffers_memory);
+        gpu_mesh gpu_mesh;
+        std::copy_n(desc.vertex_buffer_offsets.begin(), num_vertex_buffers, gpu_mesh.m_vertex_buffer_offsets.begin());
+        gpu_mesh.m_depth_vertex_buffer_offset = desc.depth_vertex_buffer_offset;
+        gpu_mesh.m_has_depth_positions = desc.has_depth_positions != 0;
+        gpu_mesh.m_index_buffer_offset = desc.index_buffer_offset;
+        gpu_mesh.m_index_count = desc.index_count;
+        gpu_mesh.m_index_type = static_cast<vk::IndexType>(desc.index_type);
+        gpu_mesh.m_topology = static_cast<vk::PrimitiveTopology>(desc.topology);
+        gpu_mesh.m_bounds = { { desc.bounds_min[0], desc.bounds_min[1], desc.bounds_min[2] }, { desc.bounds_max[0], desc.bounds_max[1], desc.bounds_max[2] } };
+        gpu_mesh.m_bounding_sphere.center = { desc.bounding_sphere[0], desc.bounding_sphere[1], desc.bounding_sphere[2] };
+        gpu_mesh.m_bounding_sphere.radius = desc.bounding_sphere[3];
+        std::memcpy(&gpu_mesh.m_position_decode_matrix[0][0], desc.position_decode_matrix.data(), sizeof(desc.position_decode_matrix));
+
+        const auto lods = file.lods(index);
+        const auto meshlets = file.meshlets(index);
+        gpu_mesh.m_lods.assign(lods.begin(), lods.end());
+        gpu_mesh.m_meshlets.assign(meshlets.begin(), meshlets.end());
+
+        if (desc.data_size == 0) {
+            throw std::runtime_error("gpu_mesh: can't upload an empty mesh.");
         }
 
+        auto allocation = uploader.allocate(desc.data_size, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer);
+        file.decode(index, allocation.staging);
+        allocation.write.finish();
+
+        gpu_mesh.m_buffer = std::move(allocation.buffer);
+        gpu_mesh.m_memory = std::move(allocation.memory);
+
         return gpu_mesh;
-    }*/
+    }
+
+    // Identifies the buffer layout: every feature's kind, usage and format, and the element sizes they add up to.
+    static std::uint64_t layout_id() {
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        auto add = [&hash](std::uint64_t value) {
+            for (int byte = 0; byte < 8; ++byte) {
+                hash = (hash ^ ((value >> (byte * 8)) & 0xffu)) * 0x100000001b3ull;
+            }
+        };
+
+        auto add_feature = [&add](auto feature) {
+            using feature_t = decltype(feature);
+            using mesh_feature = typename feature_t::mesh_feature;
+
+            add(std::is_same_v<mesh_feature, mesh_features::position> ? 1
+                : std::is_same_v<mesh_feature, mesh_features::normal> ? 2
+                : std::is_same_v<mesh_feature, mesh_features::tex_2d_coord> ? 3
+                : 4);
+            add(feature_t::usage);
+            add(static_cast<std::uint64_t>(feature_t::vulkan_format));
+        };
+
+        (add_feature(features {}), ...);
+
+        if constexpr(vertex_buffers_storage::has_common_buffer) add(sizeof(typename vertex_buffers_storage::common_buffer_element_type));
+        if constexpr(vertex_buffers_storage::has_vertex_shader_only_buffer) add(sizeof(typename vertex_buffers_storage::vertex_shader_only_buffer_element_type));
+        if constexpr(vertex_buffers_storage::has_fragment_shader_only_buffer) add(sizeof(typename vertex_buffers_storage::fragment_shader_only_buffer_element_type));
+        add(sizeof(depth_position_element_type));
+
+        return hash;
+    }
 
 
     static constexpr int num_vertex_buffers = vertex_buffers_storage::has_common_buffer + vertex_buffers_storage::has_vertex_shader_only_buffer + vertex_buffers_storage::has_fragment_shader_only_buffer;
@@ -433,18 +783,183 @@ public:
         return vertex_input_attr_desc;
     }
 
-    std::array<vk::Buffer, num_vertex_buffers> vertex_buffers() const;
-    std::array<vk::DeviceSize, num_vertex_buffers> vertex_buffer_offsets() const;
+    // The depth position stream, bound alone at binding 0 with the position at location 0.
+    static vk::VertexInputBindingDescription depth_vertex_input_binding_desc() {
+        vk::VertexInputBindingDescription binding_desc;
+        binding_desc
+            .setBinding(0)
+            .setStride(sizeof(depth_position_element_type))
+            .setInputRate(vk::VertexInputRate::eVertex);
+
+        return binding_desc;
+    }
+
+    static vk::VertexInputAttributeDescription depth_vertex_input_attr_desc() {
+        vk::VertexInputAttributeDescription attr_desc;
+        attr_desc
+            .setLocation(0)
+            .setBinding(0)
+            .setFormat(depth_position_format)
+            .setOffset(0);
+
+        return attr_desc;
+    }
+
+    // Every stream lives in the same buffer.
+    std::array<vk::Buffer, num_vertex_buffers> vertex_buffers() const {
+        std::array<vk::Buffer, num_vertex_buffers> vertex_buffers;
+        vertex_buffers.fill(m_buffer.get());
+        return vertex_buffers;
+    }
 
-    const vk::Buffer& index_buffer() const { return m_index_buffer.get(); }
+    std::array<vk::DeviceSize, num_vertex_buffers> vertex_buffer_offsets() const { return m_vertex_buffer_offsets; }
 
+    // Only there if the mesh was created with depth positions.
+    bool has_depth_positions() const { return m_has_depth_positions; }
+    const vk::Buffer& depth_vertex_buffer() const { return m_buffer.get(); }
+    vk::DeviceSize depth_vertex_buffer_offset() const { return m_depth_vertex_buffer_offset; }
+
+    const vk::Buffer& index_buffer() const { return m_buffer.get(); }
+    vk::DeviceSize index_buffer_offset() const { return m_index_buffer_offset; }
+
+    // Device local memory the buffer takes.
+    vk::DeviceSize memory_size() const { return m_memory.is_valid() ? m_memory.size() : 0; }
+
+    // 16-bit whenever the mesh has few enough vertices. Bind index_buffer() with this.
+    vk::IndexType vulkan_index_type() const { return m_index_type; }
+
+    // Triangle strips need pipelines with this topology and primitive restart enabled.
+    vk::PrimitiveTopology primitive_topology() const { return m_topology; }
+
+    // Full detail index count.
     index_type index_count() const { return m_index_count; }
 
+    // Index ranges of every level of detail, full detail first. All of them live in index_buffer().
+    gsl::span<const mesh_lod> lods() const { return m_lods; }
+    std::uint32_t num_lods() const { return std::max(static_cast<std::uint32_t>(m_lods.size()), 1u); }
+    mesh_lod lod(std::uint32_t level) const { return m_lods.empty() ? mesh_lod { 0, m_index_count, 0.0f } : m_lods[level]; }
+
+    // Clusters of the full detail level, if the source mesh had them generated.
+    gsl::span<const meshlet> meshlets() const { return m_meshlets; }
+
+    // Model space bounds of the source mesh's positions.
+    const aabb& bounds() const { return m_bounds; }
+    const gfx::bounding_sphere& bounding_sphere() const { return m_bounding_sphere; }
+
+    // Takes positions as the vertex shader reads them back to model space. Identity unless the position format is
+    // normalized to the bounds, in which case it has to be folded into the model matrix.
+    const glm::mat4& position_decode_matrix() const { return m_position_decode_matrix; }
+
 private:
-    vertex_buffers_storage m_vertex_buffers;
-    vk::UniqueBuffer m_index_buffer;
-    vk::UniqueDeviceMemory m_vertex_index_buffers_memory;
-    index_type m_index_count;
+    // Fills in everything but the buffer, and returns the buffer's size. The levels of detail and meshlets are moved
+    // out of packed_indices.
+    template<typename mesh_type>
+    vk::DeviceSize lay_out(const mesh_type& mesh, packed_indices& packed_indices, bool depth_positions) {
+        static_assert(mesh_type::has_positions);
+
+        const auto num_vertices = static_cast<std::size_t>(mesh.positions().size());
+
+        m_bounds = mesh.bounds();
+        m_bounding_sphere = mesh.bounding_sphere();
+        m_lods = std::move(packed_indices.lods);
+        m_meshlets = std::move(packed_indices.meshlets);
+        m_index_type = packed_indices.index_type;
+        m_topology = packed_indices.topology;
+        m_index_count = m_lods.front().index_count;
+
+        if constexpr(has_bounds_relative_positions) {
+            const auto& bounds = mesh.bounds();
+            const auto extent = glm::max(bounds.max_corner() - bounds.min_corner(), glm::vec3(std::numeric_limits<float>::min()));
+            m_position_decode_matrix = glm::scale(glm::translate(glm::mat4(1.0f), bounds.min_corner()), extent);
+        }
+
+        // Streams back to back, each aligned for its elements.
+        vk::DeviceSize buffer_size = 0;
+        auto place = [&buffer_size](vk::DeviceSize alignment, vk::DeviceSize size) {
+            const auto offset = (buffer_size + alignment - 1) / alignment * alignment;
+            buffer_size = offset + size;
+            return offset;
+        };
+
+        std::uint32_t stream = 0;
+
+        if constexpr(vertex_buffers_storage::has_common_buffer) {
+            using element_type = typename vertex_buffers_storage::common_buffer_element_type;
+            m_vertex_buffer_offsets[stream++] = place(alignof(element_type), sizeof(element_type) * num_vertices);
+        }
+
+        if constexpr(vertex_buffers_storage::has_vertex_shader_only_buffer) {
+            using element_type = typename vertex_buffers_storage::vertex_shader_only_buffer_element_type;
+            m_vertex_buffer_offsets[stream++] = place(alignof(element_type), sizeof(element_type) * num_vertices);
+        }
+
+        if constexpr(vertex_buffers_storage::has_fragment_shader_only_buffer) {
+            using element_type = typename vertex_buffers_storage::fragment_shader_only_buffer_element_type;
+            m_vertex_buffer_offsets[stream++] = place(alignof(element_type), sizeof(element_type) * num_vertices);
+        }
+
+        if (depth_positions) {
+            static_assert(depth_position_format != vk::Format::eUndefined);
+            m_depth_vertex_buffer_offset = place(alignof(depth_position_element_type), sizeof(depth_position_element_type) * num_vertices);
+            m_has_depth_positions = true;
+        }
+
+        m_index_buffer_offset = place(index_size(packed_indices.index_type), packed_indices.size_bytes());
+
+        if (buffer_size == 0) {
+            throw std::runtime_error("gpu_mesh: can't upload an empty mesh.");
+        }
+
+        return buffer_size;
+    }
+
+    // Writes the buffer lay_out() sized.
+    template<typename mesh_type>
+    void write_buffer(const mesh_type& mesh, const packed_indices& packed_indices, gsl::span<std::byte> destination) const {
+        std::uint32_t stream = 0;
+
+        if constexpr(vertex_buffers_storage::has_common_buffer) {
+            write_stream<typename vertex_buffers_storage::common_buffer_element_type>(mesh, destination, m_vertex_buffer_offsets[stream++]);
+        }
+
+        if constexpr(vertex_buffers_storage::has_vertex_shader_only_buffer) {
+            write_stream<typename vertex_buffers_storage::vertex_shader_only_buffer_element_type>(mesh, destination, m_vertex_buffer_offsets[stream++]);
+        }
+
+        if constexpr(vertex_buffers_storage::has_fragment_shader_only_buffer) {
+            write_stream<typename vertex_buffers_storage::fragment_shader_only_buffer_element_type>(mesh, destination, m_vertex_buffer_offsets[stream++]);
+        }
+
+        if (m_has_depth_positions) {
+            write_stream<depth_position_element_type>(mesh, destination, m_depth_vertex_buffer_offset);
+        }
+
+        std::memcpy(destination.data() + m_index_buffer_offset, packed_indices.data(), packed_indices.size_bytes());
+    }
+
+    template<typename element_type, typename mesh_type>
+    static void write_stream(const mesh_type& mesh, gsl::span<std::byte> staging, vk::DeviceSize offset) {
+        auto elements = reinterpret_cast<element_type*>(staging.data() + offset);
+
+        for (std::size_t vertex = 0; vertex < static_cast<std::size_t>(mesh.positions().size()); ++vertex) {
+            elements[vertex] = element_type::encode(mesh, vertex);
+        }
+    }
+
+    vk::UniqueBuffer m_buffer;
+    gpu_memory m_memory;
+    std::array<vk::DeviceSize, num_vertex_buffers> m_vertex_buffer_offsets = {};
+    vk::DeviceSize m_depth_vertex_buffer_offset = 0;
+    bool m_has_depth_positions = false;
+    vk::DeviceSize m_index_buffer_offset = 0;
+    index_type m_index_count = 0;
+    vk::IndexType m_index_type = vk::IndexType::eUint32;
+    vk::PrimitiveTopology m_topology = vk::PrimitiveTopology::eTriangleList;
+    std::vector<mesh_lod> m_lods;
+    std::vector<meshlet> m_meshlets;
+    aabb m_bounds;
+    gfx::bounding_sphere m_bounding_sphere;
+    glm::mat4 m_position_decode_matrix = glm::mat4(1.0f);
 };
 
 }
@@ -0,0 +1,179 @@
+#include "index_packing.hpp"
+
+#include <cassert>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace squadbox::gfx {
+
+namespace {
+    constexpr auto no_vertex = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint64_t directed_edge_key(std::uint32_t from, std::uint32_t to) {
+        return (static_cast<std::uint64_t>(from) << 32) | to;
+    }
+}
+
+vk::IndexType select_index_type(std::size_t vertex_count) {
+    return vertex_count <= std::numeric_limits<std::uint16_t>::max() ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+}
+
+std::uint32_t index_size(vk::IndexType index_type) {
+    return index_type == vk::IndexType::eUint16 ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+}
+
+std::uint32_t restart_index(vk::IndexType index_type) {
+    return index_type == vk::IndexType::eUint16 ? std::numeric_limits<std::uint16_t>::max() : std::numeric_limits<std::uint32_t>::max();
+}
+
+std::vector<std::uint32_t> build_triangle_strips(gsl::span<const std::uint32_t> triangle_list_indices, std::uint32_t restart_index) {
+    assert(triangle_list_indices.size() % 3 == 0);
+
+    const auto num_triangles = static_cast<std::uint32_t>(triangle_list_indices.size() / 3);
+
+    // Triangle corner starting every directed edge. Consistently wound neighbours share an edge in opposite directions.
+    std::unordered_map<std::uint64_t, std::uint32_t> edge_corners;
+    edge_corners.reserve(triangle_list_indices.size());
+
+    for (std::uint32_t corner = 0; corner < num_triangles * 3; ++corner) {
+        const auto next_corner = corner - corner % 3 + (corner + 1) % 3;
+        edge_corners.emplace(directed_edge_key(triangle_list_indices[corner], triangle_list_indices[next_corner]), corner);
+    }
+
+    std::vector<bool> emitted(num_triangles, false);
+
+    // Third vertex of the triangle not yet emitted that has the edge, or no_vertex.
+    const auto find_triangle = [&](std::uint32_t from, std::uint32_t to) {
+        const auto it = edge_corners.find(directed_edge_key(from, to));
+        if (it == edge_corners.end() || emitted[it->second / 3]) return no_vertex;
+
+        const auto corner = it->second;
+        return triangle_list_indices[corner - corner % 3 + (corner + 2) % 3];
+    };
+
+    std::vector<std::uint32_t> strips;
+    strips.reserve(triangle_list_indices.size());
+
+    for (std::uint32_t seed = 0; seed < num_triangles; ++seed) {
+        if (emitted[seed]) continue;
+
+        emitted[seed] = true;
+
+        // Start on the rotation that lets the strip continue. The strip's second triangle is wound (s2, s1, s3),
+        // so it has to share the seed's edge from its third vertex to its second.
+        std::uint32_t rotation = 0;
+        for (std::uint32_t r = 0; r < 3; ++r) {
+            if (find_triangle(triangle_list_indices[seed * 3 + (r + 2) % 3], triangle_list_indices[seed * 3 + (r + 1) % 3]) != no_vertex) {
+                rotation = r;
+                break;
+            }
+        }
+
+        if (!strips.empty()) strips.push_back(restart_index);
+
+        for (std::uint32_t v = 0; v < 3; ++v) {
+            strips.push_back(triangle_list_indices[seed * 3 + (rotation + v) % 3]);
+        }
+
+        // Odd triangles of a strip are wound (s[k+1], s[k], s[k+2]), even ones (s[k], s[k+1], s[k+2]).
+        for (std::uint32_t k = 1;; ++k) {
+            const auto p = strips[strips.size() - 2];
+            const auto q = strips[strips.size() - 1];
+
+            const auto from = k % 2 == 1 ? q : p;
+            const auto to = k % 2 == 1 ? p : q;
+
+            const auto next_vertex = find_triangle(from, to);
+            if (next_vertex == no_vertex) break;
+
+            emitted[edge_corners[directed_edge_key(from, to)] / 3] = true;
+            strips.push_back(next_vertex);
+        }
+    }
+
+    return strips;
+}
+
+const void* packed_indices::data() const {
+    return index_type == vk::IndexType::eUint16 ? static_cast<const void*>(indices_16.data()) : static_cast<const void*>(indices_32.data());
+}
+
+std::size_t packed_indices::size() const {
+    return index_type == vk::IndexType::eUint16 ? indices_16.size() : indices_32.size();
+}
+
+packed_indices pack_indices(gsl::span<const std::uint32_t> lod_indices, gsl::span<const mesh_lod> lods, gsl::span<const meshlet> meshlets,
+                            std::size_t vertex_count, index_topology topology) {
+    packed_indices result;
+    result.index_type = select_index_type(vertex_count);
+    result.topology = topology == index_topology::triangle_strip ? vk::PrimitiveTopology::eTriangleStrip : vk::PrimitiveTopology::eTriangleList;
+
+    const auto restart = restart_index(result.index_type);
+
+    std::vector<std::uint32_t> indices;
+    indices.reserve(lod_indices.size());
+
+    // Appends a range of the source indices and returns where it ended up. Ranges continuing a strip drawn as one
+    // are separated from what came before by a restart.
+    const auto append_range = [&](std::uint32_t first_index, std::uint32_t index_count, bool continues_draw) {
+        const auto range = lod_indices.subspan(first_index, index_count);
+
+        if (topology == index_topology::triangle_list) {
+            const auto new_first_index = static_cast<std::uint32_t>(indices.size());
+            indices.insert(indices.end(), range.begin(), range.end());
+            return std::make_pair(new_first_index, index_count);
+        }
+
+        const auto strips = build_triangle_strips(range, restart);
+        if (continues_draw && !strips.empty()) indices.push_back(restart);
+
+        const auto new_first_index = static_cast<std::uint32_t>(indices.size());
+        indices.insert(indices.end(), strips.begin(), strips.end());
+        return std::make_pair(new_first_index, static_cast<std::uint32_t>(strips.size()));
+    };
+
+    const mesh_lod whole_mesh { 0, static_cast<std::uint32_t>(lod_indices.size()), 0.0f };
+    const auto source_lods = lods.empty() ? gsl::make_span(&whole_mesh, 1) : lods;
+
+    for (std::ptrdiff_t level = 0; level < source_lods.size(); ++level) {
+        auto lod = source_lods[level];
+
+        if (level == 0 && !meshlets.empty()) {
+            // Clusters tile the full detail level, so it's drawn as all of them back to back.
+            const auto level_first_index = static_cast<std::uint32_t>(indices.size());
+
+            for (const auto& source_meshlet : meshlets) {
+                auto meshlet = source_meshlet;
+                std::tie(meshlet.first_index, meshlet.index_count)
+                    = append_range(source_meshlet.first_index, source_meshlet.index_count, indices.size() != level_first_index);
+
+                result.meshlets.push_back(meshlet);
+            }
+
+            lod.first_index = level_first_index;
+            lod.index_count = static_cast<std::uint32_t>(indices.size()) - level_first_index;
+        }
+        else {
+            std::tie(lod.first_index, lod.index_count) = append_range(lod.first_index, lod.index_count, false);
+        }
+
+        result.lods.push_back(lod);
+    }
+
+    if (result.index_type == vk::IndexType::eUint16) {
+        result.indices_16.reserve(indices.size());
+        for (const auto index : indices) {
+            assert(index <= restart);
+            result.indices_16.push_back(static_cast<std::uint16_t>(index));
+        }
+    }
+    else {
+        result.indices_32 = std::move(indices);
+    }
+
+    return result;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef SQUADBOX_GFX_INDEX_PACKING_HPP
+#define SQUADBOX_GFX_INDEX_PACKING_HPP
+
+#pragma once
+
+#include "mesh_lod.hpp"
+#include "meshlet.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/gsl>
+
+#include <cstdint>
+#include <vector>
+
+namespace squadbox::gfx {
+
+enum class index_topology {
+    triangle_list,
+    // Strips separated by the restart index; needs primitive restart enabled in the pipeline.
+    triangle_strip
+};
+
+// Vulkan reserves the all ones index for primitive restart, so 16-bit indices address up to 65535 vertices.
+vk::IndexType select_index_type(std::size_t vertex_count);
+std::uint32_t index_size(vk::IndexType index_type);
+std::uint32_t restart_index(vk::IndexType index_type);
+
+// Joins adjacent triangles into strips, following the list's order to keep its cache locality. Strips are separated
+// by restart_index and keep the triangles' winding. At worst (no shared edges) it costs 4 indices a triangle.
+std::vector<std::uint32_t> build_triangle_strips(gsl::span<const std::uint32_t> triangle_list_indices, std::uint32_t restart_index);
+
+// A mesh's indices as they go into its index buffer, in the narrowest type that fits, with the level of detail and
+// cluster ranges moved to match.
+struct packed_indices {
+    vk::IndexType index_type = vk::IndexType::eUint32;
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+
+    // Only the one matching index_type is filled.
+    std::vector<std::uint16_t> indices_16;
+    std::vector<std::uint32_t> indices_32;
+
+    std::vector<mesh_lod> lods;
+    std::vector<meshlet> meshlets;
+
+    const void* data() const;
+    std::size_t size() const;
+    vk::DeviceSize size_bytes() const { return size() * index_size(index_type); }
+};
+
+// Strips are built per level and per cluster, so every range stays drawable on its own.
+packed_indices pack_indices(gsl::span<const std::uint32_t> lod_indices, gsl::span<const mesh_lod> lods, gsl::span<const meshlet> meshlets,
+                            std::size_t vertex_count, index_topology topology = index_topology::triangle_list);
+
+}
+
+#endif
\ No newline at end of file
@@ -1,58 +1,181 @@
 #include "mesh.hpp"
 
+#if defined(__AVX__)
+#define SQUADBOX_GFX_NORMALS_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SQUADBOX_GFX_NORMALS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <thread>
+
 namespace squadbox::gfx {
 
-void calculate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices, const gsl::span<glm::vec3>& output_normals) {
-    assert(triangle_list_indices.size() % 3 == 0);
+namespace {
+    // Triangle counts below this are handled on the calling thread only.
+    constexpr std::size_t normals_parallel_threshold = 64 * 1024;
+
+    struct normal_sums {
+        std::vector<float> x, y, z;
+    };
+
+    // Adds every triangle's normal to its corners, weighted by its area and the corner's angle.
+    void accumulate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices,
+                            std::size_t first_triangle, std::size_t end_triangle, normal_sums& sums) {
+        for (auto triangle = first_triangle; triangle < end_triangle; ++triangle) {
+            const std::uint32_t corners[3] = {
+                triangle_list_indices[triangle * 3 + 0], triangle_list_indices[triangle * 3 + 1], triangle_list_indices[triangle * 3 + 2]
+            };
+
+            const auto& a = positions[corners[0]];
+            const auto& b = positions[corners[1]];
+            const auto& c = positions[corners[2]];
+
+            const auto ab = b - a;
+            const auto ac = c - a;
+            const auto bc = c - b;
+
+            // Twice the area, along the face normal. The unit normal times the area is half of it; the factor of a half
+            // is the same for every triangle and goes away when normalizing.
+            const auto normal = glm::cross(ac, ab);
+            const auto double_area = glm::length(normal);
+            if (double_area == 0.0f) continue;
+
+            // |cross| and dot of the edges leaving a corner are |e1||e2| sin and cos of its angle.
+            const float angles[3] = {
+                std::atan2(double_area, glm::dot(ab, ac)),
+                std::atan2(double_area, -glm::dot(ab, bc)),
+                std::atan2(double_area, glm::dot(ac, bc))
+            };
 
-    std::vector<std::tuple<std::uint32_t /* a */, std::uint32_t /* b */, std::uint32_t /* c */, glm::vec3 /* normal */, float /* area */>> triangles;
-    triangles.reserve(triangle_list_indices.size() / 3);
-
-    for (std::ptrdiff_t i = 0; i < triangle_list_indices.size(); i += 3) {
-        const auto& a = positions[triangle_list_indices[i + 0]];
-        const auto& b = positions[triangle_list_indices[i + 1]];
-        const auto& c = positions[triangle_list_indices[i + 2]];
-        const auto cross_product = glm::cross(c - a, b - a);
-
-        triangles.emplace_back(
-            triangle_list_indices[i + 0],
-            triangle_list_indices[i + 1],
-            triangle_list_indices[i + 2],
-            glm::normalize(cross_product),
-            glm::length(cross_product) / 2.0f
-        );
+            for (int corner = 0; corner < 3; ++corner) {
+                sums.x[corners[corner]] += normal.x * angles[corner];
+                sums.y[corners[corner]] += normal.y * angles[corner];
+                sums.z[corners[corner]] += normal.z * angles[corner];
+            }
+        }
     }
 
-    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(positions.size()); ++index) {
-        const auto& position = positions[index];
-        glm::vec3 vert_normal {};
+    // Sums the per thread normals of [begin, end) and normalizes them into output_normals.
+    void reduce_normals(gsl::span<const normal_sums> thread_sums, std::size_t begin, std::size_t end, gsl::span<glm::vec3> output_normals) {
+        auto vertex = begin;
+
+#if defined(SQUADBOX_GFX_NORMALS_AVX)
+        for (; vertex + 8 <= end; vertex += 8) {
+            auto x = _mm256_loadu_ps(thread_sums[0].x.data() + vertex);
+            auto y = _mm256_loadu_ps(thread_sums[0].y.data() + vertex);
+            auto z = _mm256_loadu_ps(thread_sums[0].z.data() + vertex);
 
-        for (std::ptrdiff_t n = 0; n < triangle_list_indices.size(); ++n) {
-            if (index != triangle_list_indices[n]) break;
-            
-            const auto triangle_idx = n / 3;
-            const auto vert_tri_idx = n - triangle_idx;            
-            const auto& triangle = triangles[triangle_idx];
+            for (std::ptrdiff_t thread = 1; thread < thread_sums.size(); ++thread) {
+                x = _mm256_add_ps(x, _mm256_loadu_ps(thread_sums[thread].x.data() + vertex));
+                y = _mm256_add_ps(y, _mm256_loadu_ps(thread_sums[thread].y.data() + vertex));
+                z = _mm256_add_ps(z, _mm256_loadu_ps(thread_sums[thread].z.data() + vertex));
+            }
 
-            const auto& face_normal = std::get<3>(triangle);
-            const auto& area = std::get<4>(triangle);
+            const auto length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+            const auto non_zero = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ);
 
-            const auto a = positions[vert_tri_idx == 0 ? std::get<1>(triangle) : vert_tri_idx == 1 ? std::get<2>(triangle) : std::get<0>(triangle)] - position;
-            const auto b = positions[vert_tri_idx == 0 ? std::get<2>(triangle) : vert_tri_idx == 1 ? std::get<0>(triangle) : std::get<1>(triangle)] - position;
-            const auto angle = glm::acos(glm::dot(a, b));
+            alignas(32) float normalized[3][8];
+            _mm256_store_ps(normalized[0], _mm256_and_ps(non_zero, _mm256_div_ps(x, length)));
+            _mm256_store_ps(normalized[1], _mm256_and_ps(non_zero, _mm256_div_ps(y, length)));
+            _mm256_store_ps(normalized[2], _mm256_and_ps(non_zero, _mm256_div_ps(z, length)));
 
-            vert_normal += face_normal * area * angle;
+            for (int lane = 0; lane < 8; ++lane) {
+                output_normals[vertex + lane] = { normalized[0][lane], normalized[1][lane], normalized[2][lane] };
+            }
         }
+#elif defined(SQUADBOX_GFX_NORMALS_SSE2)
+        for (; vertex + 4 <= end; vertex += 4) {
+            auto x = _mm_loadu_ps(thread_sums[0].x.data() + vertex);
+            auto y = _mm_loadu_ps(thread_sums[0].y.data() + vertex);
+            auto z = _mm_loadu_ps(thread_sums[0].z.data() + vertex);
+
+            for (std::ptrdiff_t thread = 1; thread < thread_sums.size(); ++thread) {
+                x = _mm_add_ps(x, _mm_loadu_ps(thread_sums[thread].x.data() + vertex));
+                y = _mm_add_ps(y, _mm_loadu_ps(thread_sums[thread].y.data() + vertex));
+                z = _mm_add_ps(z, _mm_loadu_ps(thread_sums[thread].z.data() + vertex));
+            }
+
+            const auto length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+            const auto non_zero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+
+            alignas(16) float normalized[3][4];
+            _mm_store_ps(normalized[0], _mm_and_ps(non_zero, _mm_div_ps(x, length)));
+            _mm_store_ps(normalized[1], _mm_and_ps(non_zero, _mm_div_ps(y, length)));
+            _mm_store_ps(normalized[2], _mm_and_ps(non_zero, _mm_div_ps(z, length)));
 
-        output_normals[index] = glm::normalize(vert_normal);
+            for (int lane = 0; lane < 4; ++lane) {
+                output_normals[vertex + lane] = { normalized[0][lane], normalized[1][lane], normalized[2][lane] };
+            }
+        }
+#endif
+
+        for (; vertex < end; ++vertex) {
+            glm::vec3 sum { 0.0f };
+            for (const auto& sums : thread_sums) {
+                sum += glm::vec3 { sums.x[vertex], sums.y[vertex], sums.z[vertex] };
+            }
+
+            const auto length = glm::length(sum);
+            output_normals[vertex] = length > 0.0f ? sum / length : glm::vec3 { 0.0f };
+        }
     }
+
+    template<typename func_type>
+    void run_on_threads(unsigned int num_threads, const func_type& func) {
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+
+        for (unsigned int i = 1; i < num_threads; ++i) {
+            threads.emplace_back(func, i);
+        }
+
+        func(0);
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+void calculate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices, const gsl::span<glm::vec3>& output_normals,
+                       unsigned int max_threads) {
+    assert(triangle_list_indices.size() % 3 == 0);
+    assert(output_normals.size() == positions.size());
+
+    const auto num_vertices = static_cast<std::size_t>(positions.size());
+    const auto num_triangles = static_cast<std::size_t>(triangle_list_indices.size() / 3);
+
+    if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    const auto num_threads = num_triangles < normals_parallel_threshold
+        ? 1u
+        : static_cast<unsigned int>(std::min<std::size_t>(max_threads, num_triangles / (normals_parallel_threshold / 2)));
+
+    // Threads scatter into sums of their own, so nothing is shared until the reduction.
+    std::vector<normal_sums> thread_sums(num_threads);
+
+    run_on_threads(num_threads, [&](unsigned int thread_index) {
+        auto& sums = thread_sums[thread_index];
+        sums.x.assign(num_vertices, 0.0f);
+        sums.y.assign(num_vertices, 0.0f);
+        sums.z.assign(num_vertices, 0.0f);
+
+        accumulate_normals(positions, triangle_list_indices,
+                           num_triangles * thread_index / num_threads, num_triangles * (thread_index + 1) / num_threads, sums);
+    });
+
+    run_on_threads(num_threads, [&](unsigned int thread_index) {
+        reduce_normals(thread_sums, num_vertices * thread_index / num_threads, num_vertices * (thread_index + 1) / num_threads, output_normals);
+    });
 }
 
-std::vector<glm::vec3> calculate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices) {
-    std::vector<glm::vec3> normals;
-    normals.reserve(positions.size());
-    
-    calculate_normals(positions, triangle_list_indices, normals);
+std::vector<glm::vec3> calculate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices,
+                                         unsigned int max_threads) {
+    std::vector<glm::vec3> normals(positions.size());
+    calculate_normals(positions, triangle_list_indices, normals, max_threads);
 
     return normals;
 }
@@ -3,12 +3,19 @@
 
 #pragma once
 
+#include "bounds.hpp"
+#include "mesh_lod.hpp"
+#include "meshlet.hpp"
+#include "vertex_cache.hpp"
+#include "vertex_welding.hpp"
+
 #include <glm/glm.hpp>
 #include <gsl/gsl>
 #include <boost/preprocessor.hpp>
 
 #include <vector>
 #include <algorithm>
+#include <limits>
 #include <type_traits>
 
 namespace squadbox::gfx {
@@ -33,15 +40,28 @@ namespace internal {
         void set_positions(gsl::span<const glm::vec3> positions) {
             assert(m_positions.size() == static_cast<std::size_t>(positions.size()));
             m_positions.assign(positions.begin(), positions.end());
+            update_bounds();
         }
 
         void set_positions(std::vector<glm::vec3>&& positions) {
             assert(m_positions.size() == positions.size());
             m_positions = std::move(positions);
+            update_bounds();
+        }
+
+        const aabb& bounds() const { return m_bounds; }
+        const gfx::bounding_sphere& bounding_sphere() const { return m_bounding_sphere; }
+
+        // Only needed after writing through positions(); set_positions() keeps the bounds up to date.
+        void update_bounds() {
+            m_bounds = aabb::from_points(m_positions);
+            m_bounding_sphere = gfx::bounding_sphere::from_points(m_positions, m_bounds);
         }
 
     protected:
         std::vector<glm::vec3> m_positions;
+        aabb m_bounds;
+        gfx::bounding_sphere m_bounding_sphere;
     };
 
     template<bool enable>
@@ -121,6 +141,7 @@ class mesh :
     public internal::mesh_base_tex_2d_coords<std::disjunction_v<std::is_same<features, mesh_features::tex_2d_coord>...>>,
     public internal::mesh_base_colors<std::disjunction_v<std::is_same<features, mesh_features::color>...>> {
 public:
+    // Always 32-bit while processing; gpu_mesh narrows to 16-bit on upload where the vertex count allows.
     using index_type = std::uint32_t;
 
     static const bool has_positions = std::disjunction_v<std::is_same<features, mesh_features::position>...>;
@@ -134,14 +155,198 @@ public:
         apply_to_features([num_vertices](auto& v) { v.resize(num_vertices); });
     }
 
+    // Replaces every level of detail with the given full detail indices.
     void set_triangle_list_indices(gsl::span<const index_type> indices) {
         assert(indices.size() % 3 == 0);
         m_indices.assign(indices.begin(), indices.end());
+        m_lods = { mesh_lod { 0, static_cast<std::uint32_t>(m_indices.size()), 0.0f } };
+        m_meshlets.clear();
     }
 
     void set_triangle_list_indices(std::vector<index_type>&& indices) {
         assert(indices.size() % 3 == 0);
         m_indices = std::move(indices);
+        m_lods = { mesh_lod { 0, static_cast<std::uint32_t>(m_indices.size()), 0.0f } };
+        m_meshlets.clear();
+    }
+
+    // Full detail indices.
+    gsl::span<const index_type> triangle_list_indices() const {
+        if (m_lods.empty()) return {};
+        return gsl::make_span(m_indices).subspan(0, m_lods.front().index_count);
+    }
+
+    // Every level back to back, ranges as given by lods().
+    gsl::span<const index_type> lod_indices() const { return m_indices; }
+    gsl::span<const mesh_lod> lods() const { return m_lods; }
+
+    // Merges vertices whose attributes are equal to within the options' epsilons and remaps every index to match. First
+    // step after loading, before anything else looks at the vertices. Triangles that collapse are dropped, unless
+    // levels of detail or clusters were generated already (their ranges are kept intact instead).
+    vertex_weld_stats weld_vertices(const vertex_weld_options& options = {}) {
+        vertex_weld_stats stats;
+
+        std::size_t num_vertices = 0;
+        apply_to_features([&num_vertices](const auto& attributes) { num_vertices = attributes.size(); });
+
+        stats.vertices_before = num_vertices;
+        stats.vertices_after = num_vertices;
+        if (num_vertices == 0) return stats;
+
+        std::vector<vertex_weld_stream> streams;
+
+        const auto add_stream = [&streams](const auto& attributes, float epsilon) {
+            using attribute_type = typename std::decay_t<decltype(attributes)>::value_type;
+            constexpr auto components = static_cast<std::uint32_t>(sizeof(attribute_type) / sizeof(float));
+            static_assert(sizeof(attribute_type) == components * sizeof(float));
+
+            streams.push_back({ gsl::make_span(reinterpret_cast<const float*>(attributes.data()), attributes.size() * components),
+                                components, epsilon });
+        };
+
+        if constexpr(has_positions) add_stream(this->m_positions, options.position_epsilon);
+        if constexpr(has_normals) add_stream(this->m_normals, options.normal_epsilon);
+        if constexpr(has_tex_2d_coords) add_stream(this->m_tex_2d_coords, options.tex_2d_coord_epsilon);
+        if constexpr(has_colors) add_stream(this->m_colors, options.color_epsilon);
+
+        const auto weld = gfx::weld_vertices(streams, num_vertices, options.max_threads);
+
+        stats.vertices_after = weld.unique_vertex_count;
+        if (weld.unique_vertex_count == num_vertices) return stats;
+
+        // Walking backwards leaves the first of every merged group in place.
+        apply_to_features([&weld](auto& attributes) {
+            std::remove_reference_t<decltype(attributes)> welded(weld.unique_vertex_count);
+            for (auto vertex = attributes.size(); vertex-- > 0;) {
+                welded[weld.remap[vertex]] = attributes[vertex];
+            }
+
+            attributes = std::move(welded);
+        });
+
+        for (auto& index : m_indices) {
+            index = weld.remap[index];
+        }
+
+        if (m_lods.size() == 1 && m_meshlets.empty()) {
+            const auto num_indices = m_indices.size();
+
+            std::size_t kept = 0;
+            for (std::size_t triangle = 0; triangle < num_indices; triangle += 3) {
+                const auto a = m_indices[triangle], b = m_indices[triangle + 1], c = m_indices[triangle + 2];
+                if (a == b || b == c || c == a) continue;
+
+                m_indices[kept++] = a;
+                m_indices[kept++] = b;
+                m_indices[kept++] = c;
+            }
+
+            m_indices.resize(kept);
+            m_lods.front().index_count = static_cast<std::uint32_t>(kept);
+            stats.triangles_removed = (num_indices - kept) / 3;
+        }
+
+        if constexpr(has_positions) this->update_bounds();
+
+        return stats;
+    }
+
+    // Simplifies the full detail indices into coarser levels, replacing any generated before.
+    void generate_lods(const lod_chain_options& options = {}) {
+        static_assert(has_positions);
+        if (m_lods.empty()) return;
+
+        m_indices.resize(m_lods.front().index_count);
+        m_lods = build_lod_chain(this->m_positions, m_indices, options);
+    }
+
+    // Keeps one level of detail as the full detail, dropping the others, the meshlets, and the vertices only the others
+    // use. Levels past the coarsest keep the coarsest. For cooking a coarse level on its own, to stream in before the
+    // rest. Kept vertices are renumbered in order of first use, which keeps any order optimize_vertex_order() gave.
+    void keep_lod(std::uint32_t level) {
+        if (m_lods.empty()) return;
+
+        const auto lod = m_lods[std::min(level, static_cast<std::uint32_t>(m_lods.size() - 1))];
+        std::vector<index_type> indices(m_indices.begin() + lod.first_index, m_indices.begin() + lod.first_index + lod.index_count);
+
+        std::size_t num_vertices = 0;
+        apply_to_features([&num_vertices](const auto& attributes) { num_vertices = attributes.size(); });
+
+        constexpr auto unused = std::numeric_limits<index_type>::max();
+        std::vector<index_type> remap(num_vertices, unused);
+        index_type num_kept = 0;
+
+        for (auto& index : indices) {
+            if (remap[index] == unused) remap[index] = num_kept++;
+            index = remap[index];
+        }
+
+        apply_to_features([&remap, num_kept](auto& attributes) {
+            std::remove_reference_t<decltype(attributes)> kept(num_kept);
+            for (std::size_t vertex = 0; vertex < attributes.size(); ++vertex) {
+                if (remap[vertex] != unused) kept[remap[vertex]] = attributes[vertex];
+            }
+
+            attributes = std::move(kept);
+        });
+
+        set_triangle_list_indices(std::move(indices));
+
+        if constexpr(has_positions) this->update_bounds();
+    }
+
+    // Clusters of the full detail level, whose triangles are reordered so each cluster is a contiguous range.
+    // Coarser levels are left alone.
+    void generate_meshlets() {
+        static_assert(has_positions);
+        if (m_lods.empty()) return;
+
+        m_meshlets = build_meshlets(this->m_positions, gsl::make_span(m_indices).subspan(0, m_lods.front().index_count));
+    }
+
+    gsl::span<const meshlet> meshlets() const { return m_meshlets; }
+
+    // Last step before upload, after generate_lods() and generate_meshlets(). Reorders triangles for the
+    // post-transform cache within every level and cluster, so their ranges stay valid, then renumbers the vertices
+    // in order of first use. Returns the full detail level's ACMR before and after.
+    vertex_cache_stats optimize_vertex_order() {
+        vertex_cache_stats stats;
+        if (m_lods.empty()) return stats;
+
+        const auto indices = gsl::make_span(m_indices);
+        const auto full_detail = indices.subspan(0, m_lods.front().index_count);
+
+        stats.acmr_before = calculate_acmr(full_detail);
+
+        if (m_meshlets.empty()) {
+            optimize_vertex_cache(full_detail);
+        }
+        else {
+            for (const auto& meshlet : m_meshlets) {
+                optimize_vertex_cache(indices.subspan(meshlet.first_index, meshlet.index_count));
+            }
+        }
+
+        for (std::size_t level = 1; level < m_lods.size(); ++level) {
+            optimize_vertex_cache(indices.subspan(m_lods[level].first_index, m_lods[level].index_count));
+        }
+
+        stats.acmr_after = calculate_acmr(full_detail);
+
+        std::size_t num_vertices = 0;
+        apply_to_features([&num_vertices](const auto& attributes) { num_vertices = attributes.size(); });
+
+        const auto remap = optimize_vertex_fetch(indices, num_vertices);
+        apply_to_features([&remap](auto& attributes) {
+            std::remove_reference_t<decltype(attributes)> reordered(attributes.size());
+            for (std::size_t vertex = 0; vertex < attributes.size(); ++vertex) {
+                reordered[remap[vertex]] = attributes[vertex];
+            }
+
+            attributes = std::move(reordered);
+        });
+
+        return stats;
     }
 
 private:
@@ -165,11 +370,17 @@ private:
     }
 
     std::vector<index_type> m_indices;
+    std::vector<mesh_lod> m_lods;
+    std::vector<meshlet> m_meshlets;
 };
 
 
-void calculate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices, const gsl::span<glm::vec3>& output_normals);
-std::vector<glm::vec3> calculate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices);
+// Smooth normals: every triangle's normal weighted by its area and the angle at the vertex. Linear time; large meshes
+// are split across threads (0 uses every hardware thread). Vertices without a triangle of non-zero area get zero.
+void calculate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices, const gsl::span<glm::vec3>& output_normals,
+                       unsigned int max_threads = 0);
+std::vector<glm::vec3> calculate_normals(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices,
+                                         unsigned int max_threads = 0);
 
 
 }
@@ -0,0 +1,581 @@
+#include "mesh_codec.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SQUADBOX_GFX_CODEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace squadbox::gfx {
+
+namespace {
+    // Vertices are coded a block at a time, each byte of the vertex as its own column of the block.
+    constexpr std::size_t vertex_block_size = 256;
+    constexpr std::size_t vertex_group_size = 16;
+    // Bytes taken by a group of 16 deltas of 0, 2, 4 and 8 bits.
+    constexpr std::ptrdiff_t vertex_group_bytes[4] = { 0, 4, 8, 16 };
+
+    // Recent edges and vertices, shared by the triangle encoder and decoder: both update them the same way, so
+    // the decoder finds what the encoder referred to.
+    constexpr std::uint32_t index_fifo_size = 16;
+    // An edge FIFO position of 15 means the triangle has no recent edge.
+    constexpr std::uint32_t no_edge_code = 15;
+    // A vertex is coded as 0 for the next new vertex, 1 to 14 for a recent vertex, or 15 followed by a varint.
+    constexpr std::uint32_t next_vertex_code = 0;
+    constexpr std::uint32_t free_vertex_code = 15;
+    // Most a triangle reads past its code: an extra code byte and three varints.
+    constexpr std::ptrdiff_t max_triangle_data = 16;
+    constexpr std::ptrdiff_t max_varint_size = 5;
+
+    std::runtime_error corrupt_data() {
+        return std::runtime_error("mesh_codec: the encoded data is truncated or corrupt.");
+    }
+
+    std::uint8_t zigzag(std::uint8_t delta) {
+        return static_cast<std::uint8_t>((delta << 1) ^ (static_cast<std::int8_t>(delta) >> 7));
+    }
+
+    std::uint32_t zigzag(std::uint32_t delta) {
+        return (delta << 1) ^ static_cast<std::uint32_t>(static_cast<std::int32_t>(delta) >> 31);
+    }
+
+    std::uint32_t unzigzag(std::uint32_t value) {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+
+    void write_varint(std::vector<std::byte>& encoded, std::uint64_t value) {
+        while (value >= 0x80) {
+            encoded.push_back(static_cast<std::byte>(value | 0x80));
+            value >>= 7;
+        }
+
+        encoded.push_back(static_cast<std::byte>(value));
+    }
+
+    // Up to 35 bits. The caller makes sure max_varint_size bytes can be read.
+    std::uint64_t read_varint(const std::uint8_t*& data) {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 7 * max_varint_size; shift += 7) {
+            const auto byte = *data++;
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) return value;
+        }
+
+        throw corrupt_data();
+    }
+
+    template<typename index_type>
+    std::uint32_t read_index(gsl::span<const std::byte> indices, std::size_t index) {
+        index_type value;
+        std::memcpy(&value, indices.data() + index * sizeof(index_type), sizeof(index_type));
+        return value;
+    }
+
+    template<typename index_type>
+    void write_index(std::uint8_t* indices, std::size_t index, std::uint32_t value) {
+        const auto narrowed = static_cast<index_type>(value);
+        std::memcpy(indices + index * sizeof(index_type), &narrowed, sizeof(index_type));
+    }
+
+    void encode_vertex_group(std::vector<std::byte>& encoded, const std::uint8_t* deltas, int mode) {
+        switch (mode) {
+        case 1:
+            for (std::size_t byte = 0; byte < 4; ++byte) {
+                encoded.push_back(static_cast<std::byte>(deltas[byte * 4] << 6 | deltas[byte * 4 + 1] << 4 | deltas[byte * 4 + 2] << 2 | deltas[byte * 4 + 3]));
+            }
+            break;
+
+        case 2:
+            for (std::size_t byte = 0; byte < 8; ++byte) {
+                encoded.push_back(static_cast<std::byte>(deltas[byte * 2] << 4 | deltas[byte * 2 + 1]));
+            }
+            break;
+
+        case 3:
+            for (std::size_t byte = 0; byte < 16; ++byte) {
+                encoded.push_back(static_cast<std::byte>(deltas[byte]));
+            }
+            break;
+        }
+    }
+
+#if !defined(SQUADBOX_GFX_CODEC_SSE2)
+    // The SSE2 path unzigzags 16 lanes at once.
+    std::uint8_t unzigzag(std::uint8_t value) {
+        return static_cast<std::uint8_t>((value >> 1) ^ -(value & 1));
+    }
+#endif
+
+    // Decodes one column of a block into column, continuing from previous, the column's last value so far. Returns
+    // the new last value.
+    std::uint8_t decode_vertex_column(const std::uint8_t* header, std::size_t group_count, const std::uint8_t*& data, const std::uint8_t* end,
+                                      std::uint8_t previous, std::uint8_t* column) {
+#if defined(SQUADBOX_GFX_CODEC_SSE2)
+        const auto two_bits = _mm_set1_epi8(0x03);
+        const auto four_bits = _mm_set1_epi8(0x0f);
+        const auto seven_bits = _mm_set1_epi8(0x7f);
+        const auto one = _mm_set1_epi8(0x01);
+
+        auto carry = _mm_set1_epi8(static_cast<char>(previous));
+
+        for (std::size_t group = 0; group < group_count; ++group) {
+            const auto mode = (header[group / 4] >> (group % 4 * 2)) & 3;
+            if (end - data < vertex_group_bytes[mode]) throw corrupt_data();
+
+            __m128i deltas;
+            switch (mode) {
+            case 0:
+                deltas = _mm_setzero_si128();
+                break;
+
+            case 1: {
+                std::int32_t packed;
+                std::memcpy(&packed, data, sizeof(packed));
+                const auto bits = _mm_cvtsi32_si128(packed);
+
+                // Byte i holds deltas 4i to 4i + 3, from the top bits down.
+                const auto a = _mm_and_si128(_mm_srli_epi16(bits, 6), two_bits);
+                const auto b = _mm_and_si128(_mm_srli_epi16(bits, 4), two_bits);
+                const auto c = _mm_and_si128(_mm_srli_epi16(bits, 2), two_bits);
+                const auto d = _mm_and_si128(bits, two_bits);
+                deltas = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+                break;
+            }
+
+            case 2: {
+                const auto bits = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+                deltas = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(bits, 4), four_bits), _mm_and_si128(bits, four_bits));
+                break;
+            }
+
+            default:
+                deltas = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+                break;
+            }
+
+            data += vertex_group_bytes[mode];
+
+            auto values = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(deltas, 1), seven_bits), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(deltas, one)));
+
+            // Prefix sum across the lanes, on top of the value before the group.
+            values = _mm_add_epi8(values, _mm_slli_si128(values, 1));
+            values = _mm_add_epi8(values, _mm_slli_si128(values, 2));
+            values = _mm_add_epi8(values, _mm_slli_si128(values, 4));
+            values = _mm_add_epi8(values, _mm_slli_si128(values, 8));
+            values = _mm_add_epi8(values, carry);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(column + group * vertex_group_size), values);
+
+            // Broadcasts the last lane.
+            carry = _mm_unpackhi_epi8(values, values);
+            carry = _mm_unpackhi_epi16(carry, carry);
+            carry = _mm_shuffle_epi32(carry, 0xff);
+        }
+
+        return static_cast<std::uint8_t>(_mm_cvtsi128_si32(carry));
+#else
+        for (std::size_t group = 0; group < group_count; ++group) {
+            const auto mode = (header[group / 4] >> (group % 4 * 2)) & 3;
+            if (end - data < vertex_group_bytes[mode]) throw corrupt_data();
+
+            for (std::size_t lane = 0; lane < vertex_group_size; ++lane) {
+                std::uint8_t delta = 0;
+                switch (mode) {
+                case 1: delta = (data[lane / 4] >> (6 - lane % 4 * 2)) & 0x03; break;
+                case 2: delta = (data[lane / 2] >> (4 - lane % 2 * 4)) & 0x0f; break;
+                case 3: delta = data[lane]; break;
+                }
+
+                previous = static_cast<std::uint8_t>(previous + unzigzag(delta));
+                column[group * vertex_group_size + lane] = previous;
+            }
+
+            data += vertex_group_bytes[mode];
+        }
+
+        return previous;
+#endif
+    }
+
+    // Interleaves the columns of a block back into vertices.
+    void transpose_vertex_block(const std::uint8_t* columns, std::size_t count, std::size_t vertex_size, std::uint8_t* vertices) {
+        std::size_t byte = 0;
+
+#if defined(SQUADBOX_GFX_CODEC_SSE2)
+        // Four columns at a time, into the four bytes they make up of 16 vertices.
+        for (; byte + 4 <= vertex_size; byte += 4) {
+            const auto column = columns + byte * vertex_block_size;
+
+            for (std::size_t first = 0; first < count; first += vertex_group_size) {
+                const auto c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + first));
+                const auto c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + vertex_block_size + first));
+                const auto c2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + vertex_block_size * 2 + first));
+                const auto c3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + vertex_block_size * 3 + first));
+
+                const auto c01_low = _mm_unpacklo_epi8(c0, c1);
+                const auto c01_high = _mm_unpackhi_epi8(c0, c1);
+                const auto c23_low = _mm_unpacklo_epi8(c2, c3);
+                const auto c23_high = _mm_unpackhi_epi8(c2, c3);
+
+                alignas(16) std::uint8_t interleaved[vertex_group_size * 4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(interleaved), _mm_unpacklo_epi16(c01_low, c23_low));
+                _mm_store_si128(reinterpret_cast<__m128i*>(interleaved + 16), _mm_unpackhi_epi16(c01_low, c23_low));
+                _mm_store_si128(reinterpret_cast<__m128i*>(interleaved + 32), _mm_unpacklo_epi16(c01_high, c23_high));
+                _mm_store_si128(reinterpret_cast<__m128i*>(interleaved + 48), _mm_unpackhi_epi16(c01_high, c23_high));
+
+                const auto lanes = std::min(vertex_group_size, count - first);
+                for (std::size_t lane = 0; lane < lanes; ++lane) {
+                    std::memcpy(vertices + (first + lane) * vertex_size + byte, interleaved + lane * 4, 4);
+                }
+            }
+        }
+#endif
+
+        for (; byte < vertex_size; ++byte) {
+            for (std::size_t vertex = 0; vertex < count; ++vertex) {
+                vertices[vertex * vertex_size + byte] = columns[byte * vertex_block_size + vertex];
+            }
+        }
+    }
+
+    struct index_fifos {
+        struct edge {
+            std::uint32_t a, b;
+        };
+
+        index_fifos() {
+            edges.fill({ ~0u, ~0u });
+            vertices.fill(~0u);
+        }
+
+        const edge& recent_edge(std::uint32_t position) const { return edges[(edge_count - 1 - position) % index_fifo_size]; }
+        std::uint32_t recent_vertex(std::uint32_t position) const { return vertices[(vertex_count - 1 - position) % index_fifo_size]; }
+
+        void push_edge(std::uint32_t a, std::uint32_t b) { edges[edge_count++ % index_fifo_size] = { a, b }; }
+        void push_vertex(std::uint32_t vertex) { vertices[vertex_count++ % index_fifo_size] = vertex; }
+
+        std::array<edge, index_fifo_size> edges;
+        std::array<std::uint32_t, index_fifo_size> vertices;
+        std::uint32_t edge_count = 0;
+        std::uint32_t vertex_count = 0;
+
+        // The vertex after the highest one seen in order, and the last vertex coded as a varint.
+        std::uint32_t next = 0;
+        std::uint32_t last = 0;
+    };
+
+    std::uint32_t encode_triangle_vertex(index_fifos& fifos, std::uint32_t vertex, std::vector<std::byte>& data) {
+        if (vertex == fifos.next) {
+            ++fifos.next;
+            fifos.push_vertex(vertex);
+            return next_vertex_code;
+        }
+
+        for (std::uint32_t position = 0; position < free_vertex_code - 1; ++position) {
+            if (fifos.recent_vertex(position) == vertex) return position + 1;
+        }
+
+        write_varint(data, zigzag(vertex - fifos.last));
+        fifos.last = vertex;
+        fifos.push_vertex(vertex);
+        return free_vertex_code;
+    }
+
+    std::uint32_t decode_triangle_vertex(index_fifos& fifos, std::uint32_t code, const std::uint8_t*& data) {
+        if (code == next_vertex_code) {
+            const auto vertex = fifos.next++;
+            fifos.push_vertex(vertex);
+            return vertex;
+        }
+
+        if (code != free_vertex_code) return fifos.recent_vertex(code - 1);
+
+        const auto vertex = fifos.last + unzigzag(static_cast<std::uint32_t>(read_varint(data)));
+        fifos.last = vertex;
+        fifos.push_vertex(vertex);
+        return vertex;
+    }
+
+    template<typename index_type>
+    std::vector<std::byte> encode_triangles(gsl::span<const std::byte> indices) {
+        const auto triangle_count = static_cast<std::size_t>(indices.size()) / sizeof(index_type) / 3;
+
+        // Codes first, one a triangle, then everything else they need.
+        std::vector<std::byte> codes;
+        std::vector<std::byte> data;
+        codes.reserve(triangle_count);
+
+        index_fifos fifos;
+
+        for (std::size_t triangle = 0; triangle < triangle_count; ++triangle) {
+            const std::uint32_t corners[3] = {
+                read_index<index_type>(indices, triangle * 3), read_index<index_type>(indices, triangle * 3 + 1), read_index<index_type>(indices, triangle * 3 + 2)
+            };
+
+            // An edge of a recent triangle, in any rotation of this one.
+            std::uint32_t edge_position = no_edge_code;
+            int rotation = 0;
+
+            for (; rotation < 3 && edge_position == no_edge_code; ++rotation) {
+                for (std::uint32_t position = 0; position < no_edge_code; ++position) {
+                    const auto& edge = fifos.recent_edge(position);
+                    if (edge.a == corners[rotation] && edge.b == corners[(rotation + 1) % 3]) {
+                        edge_position = position;
+                        break;
+                    }
+                }
+            }
+
+            if (edge_position != no_edge_code) {
+                --rotation;
+                const auto a = corners[rotation];
+                const auto b = corners[(rotation + 1) % 3];
+                const auto c = corners[(rotation + 2) % 3];
+
+                codes.push_back(static_cast<std::byte>(edge_position << 4 | encode_triangle_vertex(fifos, c, data)));
+
+                // The edges a neighbour would share, in its winding.
+                fifos.push_edge(c, b);
+                fifos.push_edge(a, c);
+            }
+            else {
+                const auto extra_code = data.size();
+                data.emplace_back();
+
+                const auto a_code = encode_triangle_vertex(fifos, corners[0], data);
+                const auto b_code = encode_triangle_vertex(fifos, corners[1], data);
+                const auto c_code = encode_triangle_vertex(fifos, corners[2], data);
+
+                codes.push_back(static_cast<std::byte>(no_edge_code << 4 | a_code));
+                data[extra_code] = static_cast<std::byte>(b_code << 4 | c_code);
+
+                fifos.push_edge(corners[1], corners[0]);
+                fifos.push_edge(corners[2], corners[1]);
+                fifos.push_edge(corners[0], corners[2]);
+            }
+        }
+
+        // Padding, so the decoder only has to check the size once a triangle.
+        codes.insert(codes.end(), data.begin(), data.end());
+        codes.resize(codes.size() + max_triangle_data);
+
+        return codes;
+    }
+
+    template<typename index_type>
+    void decode_triangles(gsl::span<const std::byte> encoded, gsl::span<std::byte> indices) {
+        const auto triangle_count = static_cast<std::size_t>(indices.size()) / sizeof(index_type) / 3;
+        if (static_cast<std::size_t>(encoded.size()) < triangle_count + max_triangle_data) throw corrupt_data();
+
+        const auto codes = reinterpret_cast<const std::uint8_t*>(encoded.data());
+        const auto end = codes + encoded.size();
+        auto data = codes + triangle_count;
+        auto output = reinterpret_cast<std::uint8_t*>(indices.data());
+
+        index_fifos fifos;
+
+        for (std::size_t triangle = 0; triangle < triangle_count; ++triangle) {
+            if (end - data < max_triangle_data) throw corrupt_data();
+
+            const auto code = codes[triangle];
+            const auto edge_position = static_cast<std::uint32_t>(code >> 4);
+
+            std::uint32_t a, b, c;
+
+            if (edge_position != no_edge_code) {
+                const auto edge = fifos.recent_edge(edge_position);
+                a = edge.a;
+                b = edge.b;
+                c = decode_triangle_vertex(fifos, code & 0x0f, data);
+
+                fifos.push_edge(c, b);
+                fifos.push_edge(a, c);
+            }
+            else {
+                const auto extra_code = *data++;
+                a = decode_triangle_vertex(fifos, code & 0x0f, data);
+                b = decode_triangle_vertex(fifos, extra_code >> 4, data);
+                c = decode_triangle_vertex(fifos, extra_code & 0x0f, data);
+
+                fifos.push_edge(b, a);
+                fifos.push_edge(c, b);
+                fifos.push_edge(a, c);
+            }
+
+            write_index<index_type>(output, triangle * 3, a);
+            write_index<index_type>(output, triangle * 3 + 1, b);
+            write_index<index_type>(output, triangle * 3 + 2, c);
+        }
+
+        if (end - data != max_triangle_data) throw corrupt_data();
+    }
+
+    // Each index is coded against one of the previous two, whichever is closer, which in a strip is usually the
+    // index two back: the delta, zigzag encoded, goes in the upper bits and which of the two in the lowest.
+    template<typename index_type>
+    std::vector<std::byte> encode_sequence(gsl::span<const std::byte> indices) {
+        const auto index_count = static_cast<std::size_t>(indices.size()) / sizeof(index_type);
+
+        std::vector<std::byte> encoded;
+        encoded.reserve(index_count + max_varint_size);
+
+        std::uint32_t last[2] = {};
+        for (std::size_t index = 0; index < index_count; ++index) {
+            const auto value = read_index<index_type>(indices, index);
+            const auto deltas = std::array<std::uint32_t, 2> { zigzag(value - last[0]), zigzag(value - last[1]) };
+            const auto baseline = deltas[1] < deltas[0] ? 1 : 0;
+
+            write_varint(encoded, static_cast<std::uint64_t>(deltas[baseline]) << 1 | baseline);
+            last[1] = last[0];
+            last[0] = value;
+        }
+
+        encoded.resize(encoded.size() + max_varint_size);
+
+        return encoded;
+    }
+
+    template<typename index_type>
+    void decode_sequence(gsl::span<const std::byte> encoded, gsl::span<std::byte> indices) {
+        const auto index_count = static_cast<std::size_t>(indices.size()) / sizeof(index_type);
+
+        auto data = reinterpret_cast<const std::uint8_t*>(encoded.data());
+        const auto end = data + encoded.size();
+        auto output = reinterpret_cast<std::uint8_t*>(indices.data());
+
+        std::uint32_t last[2] = {};
+        for (std::size_t index = 0; index < index_count; ++index) {
+            if (end - data < max_varint_size) throw corrupt_data();
+
+            const auto code = read_varint(data);
+            const auto value = last[code & 1] + unzigzag(static_cast<std::uint32_t>(code >> 1));
+            write_index<index_type>(output, index, value);
+
+            last[1] = last[0];
+            last[0] = value;
+        }
+
+        if (end - data != max_varint_size) throw corrupt_data();
+    }
+}
+
+std::vector<std::byte> encode_vertex_stream(gsl::span<const std::byte> vertices, std::size_t vertex_size) {
+    assert(vertex_size != 0 && vertex_size <= max_encoded_vertex_size);
+    assert(vertices.size() % vertex_size == 0);
+
+    const auto vertex_count = static_cast<std::size_t>(vertices.size()) / vertex_size;
+    const auto input = reinterpret_cast<const std::uint8_t*>(vertices.data());
+
+    std::vector<std::byte> encoded;
+    encoded.reserve(vertices.size() / 2);
+
+    std::array<std::uint8_t, max_encoded_vertex_size> previous = {};
+
+    for (std::size_t first = 0; first < vertex_count; first += vertex_block_size) {
+        const auto count = std::min(vertex_block_size, vertex_count - first);
+        const auto group_count = (count + vertex_group_size - 1) / vertex_group_size;
+
+        for (std::size_t byte = 0; byte < vertex_size; ++byte) {
+            // Past the last vertex, deltas are 0 and decode to copies of it.
+            std::uint8_t deltas[vertex_block_size] = {};
+            for (std::size_t vertex = 0; vertex < count; ++vertex) {
+                const auto value = input[(first + vertex) * vertex_size + byte];
+                deltas[vertex] = zigzag(static_cast<std::uint8_t>(value - previous[byte]));
+                previous[byte] = value;
+            }
+
+            const auto header = encoded.size();
+            encoded.resize(encoded.size() + (group_count + 3) / 4);
+
+            for (std::size_t group = 0; group < group_count; ++group) {
+                const auto group_deltas = deltas + group * vertex_group_size;
+                const auto largest = *std::max_element(group_deltas, group_deltas + vertex_group_size);
+                const int mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+
+                encoded[header + group / 4] |= static_cast<std::byte>(mode << (group % 4 * 2));
+                encode_vertex_group(encoded, group_deltas, mode);
+            }
+        }
+    }
+
+    return encoded;
+}
+
+void decode_vertex_stream(gsl::span<const std::byte> encoded, std::size_t vertex_size, gsl::span<std::byte> vertices) {
+    assert(vertex_size != 0 && vertex_size <= max_encoded_vertex_size);
+    assert(vertices.size() % vertex_size == 0);
+
+    const auto vertex_count = static_cast<std::size_t>(vertices.size()) / vertex_size;
+
+    auto data = reinterpret_cast<const std::uint8_t*>(encoded.data());
+    const auto end = data + encoded.size();
+    auto output = reinterpret_cast<std::uint8_t*>(vertices.data());
+
+    // A block, a row per byte of the vertex.
+    std::vector<std::uint8_t> columns(vertex_size * vertex_block_size);
+    std::array<std::uint8_t, max_encoded_vertex_size> previous = {};
+
+    for (std::size_t first = 0; first < vertex_count; first += vertex_block_size) {
+        const auto count = std::min(vertex_block_size, vertex_count - first);
+        const auto group_count = (count + vertex_group_size - 1) / vertex_group_size;
+        const auto header_size = static_cast<std::ptrdiff_t>((group_count + 3) / 4);
+
+        for (std::size_t byte = 0; byte < vertex_size; ++byte) {
+            if (end - data < header_size) throw corrupt_data();
+
+            const auto header = data;
+            data += header_size;
+
+            previous[byte] = decode_vertex_column(header, group_count, data, end, previous[byte], columns.data() + byte * vertex_block_size);
+        }
+
+        transpose_vertex_block(columns.data(), count, vertex_size, output + first * vertex_size);
+    }
+
+    if (data != end) throw corrupt_data();
+}
+
+std::vector<std::byte> encode_triangle_indices(gsl::span<const std::byte> indices, std::size_t index_size) {
+    assert(index_size == 2 || index_size == 4);
+    assert(indices.size() % (index_size * 3) == 0);
+
+    return index_size == 2 ? encode_triangles<std::uint16_t>(indices) : encode_triangles<std::uint32_t>(indices);
+}
+
+void decode_triangle_indices(gsl::span<const std::byte> encoded, std::size_t index_size, gsl::span<std::byte> indices) {
+    assert(index_size == 2 || index_size == 4);
+    assert(indices.size() % (index_size * 3) == 0);
+
+    if (index_size == 2) {
+        decode_triangles<std::uint16_t>(encoded, indices);
+    }
+    else {
+        decode_triangles<std::uint32_t>(encoded, indices);
+    }
+}
+
+std::vector<std::byte> encode_index_sequence(gsl::span<const std::byte> indices, std::size_t index_size) {
+    assert(index_size == 2 || index_size == 4);
+    assert(indices.size() % index_size == 0);
+
+    return index_size == 2 ? encode_sequence<std::uint16_t>(indices) : encode_sequence<std::uint32_t>(indices);
+}
+
+void decode_index_sequence(gsl::span<const std::byte> encoded, std::size_t index_size, gsl::span<std::byte> indices) {
+    assert(index_size == 2 || index_size == 4);
+    assert(indices.size() % index_size == 0);
+
+    if (index_size == 2) {
+        decode_sequence<std::uint16_t>(encoded, indices);
+    }
+    else {
+        decode_sequence<std::uint32_t>(encoded, indices);
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef SQUADBOX_GFX_MESH_CODEC_HPP
+#define SQUADBOX_GFX_MESH_CODEC_HPP
+
+#pragma once
+
+#include <gsl/gsl>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// Lossless compression of the streams in a gpu_mesh buffer, for shipping them. Encoding is meant for offline tools;
+// decoding is meant for loader threads, straight into staging memory, and runs at memory speeds. Decoders throw on
+// data that's truncated or malformed, but don't check that the indices they produce are within the vertex streams.
+
+// Interleaved vertices, as laid out by internal_gpu_mesh::interleaved_vertex. Every byte of a vertex is stored as its
+// difference to the same byte of the previous vertex, zigzag encoded, which for neighbouring vertices is mostly a few
+// bits; groups of 16 are then packed with 0, 2, 4 or 8 bits each. vertex_size is up to max_encoded_vertex_size.
+constexpr std::size_t max_encoded_vertex_size = 256;
+
+std::vector<std::byte> encode_vertex_stream(gsl::span<const std::byte> vertices, std::size_t vertex_size);
+void decode_vertex_stream(gsl::span<const std::byte> encoded, std::size_t vertex_size, gsl::span<std::byte> vertices);
+
+// Triangle list indices of 2 or 4 bytes each. Triangles are coded against a FIFO of the edges of recent triangles
+// and one of recently used vertices, so a triangle sharing an edge with a recent one, whose third vertex is new or
+// recent, takes a single byte. The order of the triangles is kept, their first vertex may be rotated (keeping the
+// winding).
+std::vector<std::byte> encode_triangle_indices(gsl::span<const std::byte> indices, std::size_t index_size);
+void decode_triangle_indices(gsl::span<const std::byte> encoded, std::size_t index_size, gsl::span<std::byte> indices);
+
+// Any other indices (strips with restart indices), as varints of their difference to one of the previous two.
+std::vector<std::byte> encode_index_sequence(gsl::span<const std::byte> indices, std::size_t index_size);
+void decode_index_sequence(gsl::span<const std::byte> encoded, std::size_t index_size, gsl::span<std::byte> indices);
+
+}
+
+#endif
\ No newline at end of file
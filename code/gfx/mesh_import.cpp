@@ -0,0 +1,119 @@
+#include "mesh_import.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/config.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <stdexcept>
+
+namespace squadbox::gfx {
+
+namespace {
+    // Node transforms are baked into the vertices, and triangles are flipped to the clockwise winding used here.
+    constexpr unsigned int import_flags = aiProcess_Triangulate
+                                        | aiProcess_SortByPType
+                                        | aiProcess_PreTransformVertices
+                                        | aiProcess_FlipWindingOrder;
+}
+
+std::vector<const aiMesh*> read_triangle_meshes(Assimp::Importer& importer, const std::string& path) {
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+
+    const auto scene = importer.ReadFile(path, import_flags);
+    if (!scene) {
+        throw std::runtime_error("mesh_import: can't import " + path + ": " + importer.GetErrorString());
+    }
+
+    std::vector<const aiMesh*> meshes;
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+        if (scene->mMeshes[i]->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) meshes.push_back(scene->mMeshes[i]);
+    }
+
+    if (meshes.empty()) {
+        throw std::runtime_error("mesh_import: " + path + " has no triangle meshes.");
+    }
+
+    return meshes;
+}
+
+imported_mesh process_imported_mesh(const aiMesh& ai_mesh, const asset_import_options& options, unsigned int max_threads) {
+    imported_mesh result;
+    result.name = ai_mesh.mName.C_Str();
+    result.material_index = ai_mesh.mMaterialIndex;
+
+    std::vector<imported_mesh_type::index_type> indices;
+    indices.reserve(static_cast<std::size_t>(ai_mesh.mNumFaces) * 3);
+
+    for (unsigned int i = 0; i < ai_mesh.mNumFaces; ++i) {
+        const auto& face = ai_mesh.mFaces[i];
+        if (face.mNumIndices != 3) continue;
+
+        indices.insert(indices.end(), face.mIndices, face.mIndices + 3);
+    }
+
+    if (indices.empty()) {
+        throw std::runtime_error("mesh_import: mesh " + result.name + " has no triangles.");
+    }
+
+    auto& mesh = result.mesh;
+    mesh = imported_mesh_type(ai_mesh.mNumVertices);
+
+    const auto positions = mesh.positions();
+    const auto normals = mesh.normals();
+    const auto tex_2d_coords = mesh.tex_2d_coords();
+    const auto colors = mesh.colors();
+
+    const bool file_normals = ai_mesh.HasNormals() && !options.recalculate_normals;
+
+    for (unsigned int vertex = 0; vertex < ai_mesh.mNumVertices; ++vertex) {
+        const auto& position = ai_mesh.mVertices[vertex];
+        positions[vertex] = { position.x, position.y, position.z };
+
+        if (file_normals) {
+            const auto& normal = ai_mesh.mNormals[vertex];
+            normals[vertex] = { normal.x, normal.y, normal.z };
+        }
+        else {
+            normals[vertex] = glm::vec3 { 0.0f };
+        }
+
+        if (ai_mesh.HasTextureCoords(0)) {
+            const auto& tex_2d_coord = ai_mesh.mTextureCoords[0][vertex];
+            tex_2d_coords[vertex] = { tex_2d_coord.x, tex_2d_coord.y };
+        }
+        else {
+            tex_2d_coords[vertex] = glm::vec2 { 0.0f };
+        }
+
+        if (ai_mesh.HasVertexColors(0)) {
+            const auto& color = ai_mesh.mColors[0][vertex];
+            colors[vertex] = { color.r, color.g, color.b, color.a };
+        }
+        else {
+            colors[vertex] = glm::vec4 { 1.0f };
+        }
+    }
+
+    mesh.update_bounds();
+    mesh.set_triangle_list_indices(std::move(indices));
+
+    // Welding first joins vertices the file repeats per face, so calculated normals come out smooth.
+    if (options.weld_vertices) {
+        auto weld_options = options.weld;
+        weld_options.max_threads = max_threads;
+        mesh.weld_vertices(weld_options);
+    }
+
+    if (!file_normals) {
+        calculate_normals(mesh.positions(), mesh.triangle_list_indices(), mesh.normals(), max_threads);
+    }
+
+    if (options.generate_lods) mesh.generate_lods(options.lods);
+    if (options.generate_meshlets) mesh.generate_meshlets();
+    if (options.optimize_vertex_order) result.vertex_cache = mesh.optimize_vertex_order();
+
+    return result;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef SQUADBOX_GFX_MESH_IMPORT_HPP
+#define SQUADBOX_GFX_MESH_IMPORT_HPP
+
+#pragma once
+
+#include "mesh.hpp"
+#include "mesh_lod.hpp"
+#include "vertex_cache.hpp"
+#include "vertex_welding.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct aiMesh;
+
+namespace Assimp {
+class Importer;
+}
+
+namespace squadbox::gfx {
+
+using imported_mesh_type = mesh<mesh_features::position, mesh_features::normal, mesh_features::tex_2d_coord, mesh_features::color>;
+
+struct asset_import_options {
+    // Normals are calculated for meshes the file has none for, or for every mesh if set.
+    bool recalculate_normals = false;
+    bool weld_vertices = true;
+    vertex_weld_options weld;
+    bool generate_lods = true;
+    lod_chain_options lods;
+    bool generate_meshlets = false;
+    bool optimize_vertex_order = true;
+};
+
+struct imported_mesh {
+    std::string name;
+    std::uint32_t material_index = 0;
+    // In the file's world space (node transforms are applied), wound clockwise like the rest of the meshes here.
+    // Texture coordinates and colors are zero and white where the file has none.
+    imported_mesh_type mesh;
+    // Zero unless the vertex order was optimized.
+    vertex_cache_stats vertex_cache;
+};
+
+// Parses the file into the importer and returns its meshes that have triangles, which live as long as the importer.
+// Throws if the file can't be read or has no triangles at all.
+std::vector<const aiMesh*> read_triangle_meshes(Assimp::Importer& importer, const std::string& path);
+
+// Converts the triangles of an assimp mesh and runs the passes the options ask for. Throws if it has no triangles.
+// Parallel passes use up to max_threads threads (0 for every hardware thread).
+imported_mesh process_imported_mesh(const aiMesh& ai_mesh, const asset_import_options& options, unsigned int max_threads = 0);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include "mesh_lod.hpp"
+
+#include "bounds.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace squadbox::gfx {
+
+namespace {
+    // Sum of squared distances to a set of planes, weighted by the area of the triangles they came from.
+    struct quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        static quadric from_plane(const glm::vec3& normal, float distance, float weight) {
+            const double x = normal.x, y = normal.y, z = normal.z, d = distance, w = weight;
+
+            quadric q;
+            q.a00 = w * x * x; q.a01 = w * x * y; q.a02 = w * x * z;
+            q.a11 = w * y * y; q.a12 = w * y * z;
+            q.a22 = w * z * z;
+            q.b0 = w * x * d; q.b1 = w * y * d; q.b2 = w * z * d;
+            q.c = w * d * d;
+            q.weight = w;
+
+            return q;
+        }
+
+        quadric& operator+=(const quadric& other) {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12;
+            a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+
+            return *this;
+        }
+
+        // Mean squared distance of the point to the planes.
+        double error(const glm::vec3& point) const {
+            if (weight == 0) return 0;
+
+            const double x = point.x, y = point.y, z = point.z;
+            const double e = x * (a00 * x + 2 * (a01 * y + a02 * z + b0))
+                           + y * (a11 * y + 2 * (a12 * z + b1))
+                           + z * (a22 * z + 2 * b2)
+                           + c;
+
+            return std::max(e, 0.0) / weight;
+        }
+    };
+
+    struct collapse {
+        std::uint32_t from;
+        std::uint32_t to;
+        double error;
+    };
+
+    std::uint64_t edge_key(std::uint32_t a, std::uint32_t b) {
+        return a < b ? (std::uint64_t(a) << 32) | b : (std::uint64_t(b) << 32) | a;
+    }
+
+    // Vertices that may not move: those sharing a position with another vertex, and those on an edge that
+    // isn't shared by exactly two triangles.
+    std::vector<bool> find_locked_vertices(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> indices) {
+        struct position_hash {
+            std::size_t operator()(const glm::vec3& p) const {
+                std::uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+
+        std::vector<bool> locked(positions.size(), false);
+
+        std::unordered_map<glm::vec3, std::uint32_t, position_hash> position_groups;
+        std::vector<std::uint32_t> group_of(positions.size());
+        position_groups.reserve(positions.size());
+
+        for (std::uint32_t vertex = 0; vertex < static_cast<std::uint32_t>(positions.size()); ++vertex) {
+            const auto [it, inserted] = position_groups.emplace(positions[vertex], vertex);
+            group_of[vertex] = it->second;
+
+            if (!inserted) {
+                locked[vertex] = true;
+                locked[it->second] = true;
+            }
+        }
+
+        std::unordered_map<std::uint64_t, std::uint32_t> edge_use_counts;
+        edge_use_counts.reserve(indices.size());
+
+        for (std::ptrdiff_t i = 0; i < indices.size(); i += 3) {
+            for (std::ptrdiff_t e = 0; e < 3; ++e) {
+                ++edge_use_counts[edge_key(group_of[indices[i + e]], group_of[indices[i + (e + 1) % 3]])];
+            }
+        }
+
+        for (std::ptrdiff_t i = 0; i < indices.size(); i += 3) {
+            for (std::ptrdiff_t e = 0; e < 3; ++e) {
+                const auto a = indices[i + e];
+                const auto b = indices[i + (e + 1) % 3];
+
+                if (edge_use_counts[edge_key(group_of[a], group_of[b])] != 2) {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+            }
+        }
+
+        return locked;
+    }
+}
+
+std::vector<std::uint32_t> simplify(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices,
+                                    std::size_t target_index_count, float target_error, float* result_error) {
+    assert(triangle_list_indices.size() % 3 == 0);
+
+    std::vector<std::uint32_t> indices(triangle_list_indices.begin(), triangle_list_indices.end());
+    const auto num_vertices = static_cast<std::uint32_t>(positions.size());
+
+    const auto locked = find_locked_vertices(positions, indices);
+
+    std::vector<quadric> quadrics(num_vertices);
+    for (std::size_t i = 0; i < indices.size(); i += 3) {
+        const auto& p0 = positions[indices[i + 0]];
+        const auto& p1 = positions[indices[i + 1]];
+        const auto& p2 = positions[indices[i + 2]];
+
+        const auto normal = glm::cross(p1 - p0, p2 - p0);
+        const auto double_area = glm::length(normal);
+        if (double_area == 0.0f) continue;
+
+        const auto unit_normal = normal / double_area;
+        const auto plane = quadric::from_plane(unit_normal, -glm::dot(unit_normal, p0), double_area * 0.5f);
+
+        for (std::size_t v = 0; v < 3; ++v) {
+            quadrics[indices[i + v]] += plane;
+        }
+    }
+
+    const double max_error = double(target_error) * target_error;
+    double error = 0;
+
+    std::vector<std::uint32_t> triangle_offsets(num_vertices + 1);
+    std::vector<std::uint32_t> vertex_triangles;
+    std::vector<collapse> collapses;
+    std::vector<std::uint32_t> remap(num_vertices);
+    std::vector<bool> touched(num_vertices);
+
+    // Each pass collapses a set of edges that don't share any triangles, cheapest first, then rewrites the indices.
+    while (indices.size() > target_index_count) {
+        // Triangles around every vertex.
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+        for (const auto index : indices) ++triangle_offsets[index + 1];
+        for (std::uint32_t v = 0; v < num_vertices; ++v) triangle_offsets[v + 1] += triangle_offsets[v];
+
+        vertex_triangles.resize(indices.size());
+        {
+            auto write_offsets = triangle_offsets;
+            for (std::size_t i = 0; i < indices.size(); ++i) {
+                vertex_triangles[write_offsets[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+            }
+        }
+
+        collapses.clear();
+        for (std::size_t i = 0; i < indices.size(); i += 3) {
+            for (std::size_t e = 0; e < 3; ++e) {
+                const auto a = indices[i + e];
+                const auto b = indices[i + (e + 1) % 3];
+
+                for (const auto [from, to] : { std::make_pair(a, b), std::make_pair(b, a) }) {
+                    if (locked[from]) continue;
+
+                    auto combined = quadrics[from];
+                    combined += quadrics[to];
+                    collapses.push_back({ from, to, combined.error(positions[to]) });
+                }
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const collapse& lhs, const collapse& rhs) { return lhs.error < rhs.error; });
+
+        for (std::uint32_t v = 0; v < num_vertices; ++v) remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        // Every collapse of an interior edge removes two triangles.
+        const auto triangles_to_remove = (indices.size() - target_index_count) / 3;
+        std::size_t triangles_removed = 0;
+        std::size_t num_collapsed = 0;
+
+        for (const auto& candidate : collapses) {
+            if (candidate.error > max_error || triangles_removed >= triangles_to_remove) break;
+            if (touched[candidate.from] || touched[candidate.to]) continue;
+
+            const auto& to_position = positions[candidate.to];
+            bool flips = false;
+
+            // Triangles that stay around after the collapse mustn't turn over.
+            for (auto t = triangle_offsets[candidate.from]; t < triangle_offsets[candidate.from + 1] && !flips; ++t) {
+                const auto* triangle = &indices[vertex_triangles[t] * 3];
+                if (triangle[0] == candidate.to || triangle[1] == candidate.to || triangle[2] == candidate.to) continue;
+
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for (std::size_t v = 0; v < 3; ++v) {
+                    before[v] = positions[triangle[v]];
+                    after[v] = triangle[v] == candidate.from ? to_position : before[v];
+                }
+
+                const auto normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const auto normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+                flips = glm::dot(normal_before, normal_after) < 0.25f * glm::length(normal_before) * glm::length(normal_after);
+            }
+
+            if (flips) continue;
+
+            remap[candidate.from] = candidate.to;
+            quadrics[candidate.to] += quadrics[candidate.from];
+            error = std::max(error, candidate.error);
+            triangles_removed += 2;
+            ++num_collapsed;
+
+            // The flip test relied on the neighbourhood staying put for the rest of the pass.
+            for (auto t = triangle_offsets[candidate.from]; t < triangle_offsets[candidate.from + 1]; ++t) {
+                const auto* triangle = &indices[vertex_triangles[t] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+        }
+
+        if (num_collapsed == 0) break;
+
+        std::size_t write = 0;
+        for (std::size_t i = 0; i < indices.size(); i += 3) {
+            const auto a = remap[indices[i + 0]];
+            const auto b = remap[indices[i + 1]];
+            const auto c = remap[indices[i + 2]];
+
+            if (a == b || b == c || c == a) continue;
+
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+
+        indices.resize(write);
+    }
+
+    if (result_error) *result_error = static_cast<float>(std::sqrt(error));
+
+    return indices;
+}
+
+std::vector<mesh_lod> build_lod_chain(gsl::span<const glm::vec3> positions, std::vector<std::uint32_t>& triangle_list_indices,
+                                      const lod_chain_options& options) {
+    std::vector<mesh_lod> lods;
+    lods.push_back({ 0, static_cast<std::uint32_t>(triangle_list_indices.size()), 0.0f });
+
+    if (positions.empty()) return lods;
+
+    const auto max_error = options.max_error * glm::length(aabb::from_points(positions).extents());
+
+    // Every level is simplified from the full detail one, so its quadrics, and the error they give, are measured
+    // against the original surface rather than the level before.
+    const std::vector<std::uint32_t> full_detail = triangle_list_indices;
+    auto previous_index_count = full_detail.size();
+
+    while (lods.size() < options.max_levels) {
+        const auto target_index_count = static_cast<std::size_t>(previous_index_count / 3 * options.level_ratio) * 3;
+        if (target_index_count / 3 < options.min_triangles) break;
+
+        float level_error = 0.0f;
+        const auto level = simplify(positions, full_detail, target_index_count, max_error, &level_error);
+
+        // Not worth a level if it barely got any simpler.
+        if (level.size() > previous_index_count * 9 / 10) break;
+
+        mesh_lod lod;
+        lod.first_index = static_cast<std::uint32_t>(triangle_list_indices.size());
+        lod.index_count = static_cast<std::uint32_t>(level.size());
+        // Collapses differ from one level's run to the next; keep the errors from going down as the levels coarsen.
+        lod.error = std::max(level_error, lods.back().error);
+
+        triangle_list_indices.insert(triangle_list_indices.end(), level.begin(), level.end());
+        lods.push_back(lod);
+
+        previous_index_count = level.size();
+    }
+
+    return lods;
+}
+
+float lod_error_to_pixels(const glm::mat4& projection, float viewport_height) {
+    return std::abs(projection[1][1]) * viewport_height * 0.5f;
+}
+
+std::uint32_t select_lod(gsl::span<const mesh_lod> lods, float error_to_pixels, float max_pixel_error) {
+    for (auto level = static_cast<std::uint32_t>(lods.size()); level > 1; --level) {
+        if (lods[level - 1].error * error_to_pixels <= max_pixel_error) return level - 1;
+    }
+
+    return 0;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef SQUADBOX_GFX_MESH_LOD_HPP
+#define SQUADBOX_GFX_MESH_LOD_HPP
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <gsl/gsl>
+
+#include <cstdint>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// One level of detail: a range of a mesh's index buffer, which holds every level back to back.
+struct mesh_lod {
+    std::uint32_t first_index = 0;
+    std::uint32_t index_count = 0;
+    // How far, in model space, the level's surface is from the full detail one: the largest RMS distance of a
+    // collapsed vertex to the planes of the original triangles around it (its quadric error). Typical rather than a
+    // bound on the deviation, which can be larger in places; select_lod() scales it to pixels as if it were one.
+    float error = 0.0f;
+};
+
+struct lod_chain_options {
+    // Including the full detail level.
+    std::uint32_t max_levels = 4;
+    // Target index count of each level relative to the one before it.
+    float level_ratio = 0.5f;
+    // Largest error of the coarsest level, relative to the mesh's bounding radius.
+    float max_error = 0.05f;
+    // Levels stop before going below this.
+    std::uint32_t min_triangles = 32;
+};
+
+// Quadric error edge collapse (Garland-Heckbert), collapsing vertices onto their neighbours until the triangle
+// list is down to target_index_count or the next collapse would move the surface further than target_error.
+//
+// Vertices sharing a position with other vertices (attribute seams) and vertices on open borders are never
+// collapsed away, so the result stays watertight wherever the input was. result_error receives the largest
+// quadric error (an RMS distance to the input's planes) of the collapses made.
+std::vector<std::uint32_t> simplify(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices,
+                                    std::size_t target_index_count, float target_error, float* result_error = nullptr);
+
+// Simplifies triangle_list_indices level after level, appending each level's indices to it. The first level
+// is the indices as given; the others are each simplified from it, with the error measured against it.
+std::vector<mesh_lod> build_lod_chain(gsl::span<const glm::vec3> positions, std::vector<std::uint32_t>& triangle_list_indices,
+                                      const lod_chain_options& options = {});
+
+// Pixels covered by one unit of model space error at a view depth of one unit, for a perspective projection.
+float lod_error_to_pixels(const glm::mat4& projection, float viewport_height);
+
+// Coarsest level whose error, scaled to pixels, stays within max_pixel_error.
+std::uint32_t select_lod(gsl::span<const mesh_lod> lods, float error_to_pixels, float max_pixel_error);
+
+}
+
+#endif
\ No newline at end of file
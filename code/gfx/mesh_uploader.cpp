@@ -0,0 +1,288 @@
+#include "mesh_uploader.hpp"
+
+#include "vulkan_manager.hpp"
+#include "vulkan_utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+namespace squadbox::gfx {
+
+namespace {
+    constexpr vk::DeviceSize staging_alignment = 16;
+
+    vk::DeviceSize align_up(vk::DeviceSize offset, vk::DeviceSize alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
+
+mesh_uploader::staging_write::staging_write(staging_write&& rhs) noexcept
+    : m_uploader(std::exchange(rhs.m_uploader, nullptr)), m_chunk(std::exchange(rhs.m_chunk, nullptr)),
+      m_copy_index(rhs.m_copy_index) {
+}
+
+mesh_uploader::staging_write::~staging_write() {
+    close(false);
+}
+
+mesh_uploader::staging_write& mesh_uploader::staging_write::operator=(staging_write&& rhs) noexcept {
+    if (this != &rhs) {
+        close(false);
+        m_uploader = std::exchange(rhs.m_uploader, nullptr);
+        m_chunk = std::exchange(rhs.m_chunk, nullptr);
+        m_copy_index = rhs.m_copy_index;
+    }
+
+    return *this;
+}
+
+void mesh_uploader::staging_write::finish() {
+    close(true);
+}
+
+void mesh_uploader::staging_write::close(bool written) {
+    if (!m_chunk) return;
+
+    {
+        // The chunk can't be submitted while the write is open, so the copy is still there.
+        std::lock_guard<std::mutex> lock(m_uploader->m_mutex);
+        if (!written) {
+            auto& copy = m_chunk->copies[m_copy_index];
+            m_uploader->m_pending_bytes -= copy.region.size;
+            copy.destination = vk::Buffer();
+        }
+
+        --m_chunk->open_writes;
+    }
+
+    m_uploader = nullptr;
+    m_chunk = nullptr;
+}
+
+mesh_uploader::mesh_uploader(const vulkan_manager& vulkan_manager, gpu_memory_pool& gpu_memory_pool)
+    : m_vulkan_manager(&vulkan_manager), m_gpu_memory_pool(&gpu_memory_pool),
+      m_device_memory_props(vulkan_manager.physical_device().getMemoryProperties()) {
+    m_command_pool = [](const vk::Device& device, std::uint32_t queue_family_index) {
+        vk::CommandPoolCreateInfo command_pool_ci;
+        command_pool_ci
+            .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+            .setQueueFamilyIndex(queue_family_index);
+
+        return device.createCommandPoolUnique(command_pool_ci);
+    }(m_vulkan_manager->device(), m_vulkan_manager->graphics_queue_family_index());
+}
+
+mesh_uploader::~mesh_uploader() {
+    wait_idle();
+}
+
+mesh_uploader::allocation mesh_uploader::allocate(vk::DeviceSize size, vk::BufferUsageFlags usage) {
+    const auto& device = m_vulkan_manager->device();
+    allocation allocation;
+
+    allocation.buffer = [](const vk::Device& device, vk::DeviceSize size, vk::BufferUsageFlags usage) {
+        vk::BufferCreateInfo buffer_ci;
+        buffer_ci
+            .setSize(size)
+            .setUsage(usage | vk::BufferUsageFlagBits::eTransferDst)
+            .setSharingMode(vk::SharingMode::eExclusive);
+
+        return device.createBufferUnique(buffer_ci);
+    }(device, size, usage);
+
+    allocation.memory = m_gpu_memory_pool->allocate_gpu_local(device.getBufferMemoryRequirements(allocation.buffer.get()));
+    device.bindBufferMemory(allocation.buffer.get(), allocation.memory.handle(), allocation.memory.offset());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_staging_chunks.empty() || m_staging_chunks.back()->sealed ||
+        align_up(m_staging_chunks.back()->used, staging_alignment) + size > m_staging_chunks.back()->size) {
+        m_staging_chunks.push_back(acquire_staging_chunk(size));
+        m_staging_chunks.back()->first_batch = m_next_batch_serial;
+    }
+
+    auto& chunk = *m_staging_chunks.back();
+    const auto staging_offset = align_up(chunk.used, staging_alignment);
+    chunk.used = staging_offset + size;
+
+    allocation.staging = gsl::make_span(chunk.mapped + staging_offset, static_cast<std::ptrdiff_t>(size));
+
+    chunk.copies.push_back({ allocation.buffer.get(), vk::BufferCopy { staging_offset, 0, size } });
+    ++chunk.open_writes;
+    allocation.write = staging_write(*this, chunk, chunk.copies.size() - 1);
+    m_pending_bytes += size;
+
+    return allocation;
+}
+
+void mesh_uploader::submit() {
+    batch batch;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Chunks still being written into stay for a later batch.
+        const auto written = std::stable_partition(m_staging_chunks.begin(), m_staging_chunks.end(), [](const auto& chunk) {
+            return chunk->open_writes > 0;
+        });
+
+        // Sealed, so that the writes open now are the last ones the chunks wait for.
+        std::for_each(m_staging_chunks.begin(), written, [](const auto& chunk) { chunk->sealed = true; });
+
+        if (written == m_staging_chunks.end()) return;
+
+        batch.staging_chunks.assign(std::make_move_iterator(written), std::make_move_iterator(m_staging_chunks.end()));
+        m_staging_chunks.erase(written, m_staging_chunks.end());
+        batch.serial = m_next_batch_serial++;
+        batch.first_batch = batch.serial;
+
+        for (const auto& chunk : batch.staging_chunks) {
+            batch.first_batch = std::min(batch.first_batch, chunk->first_batch);
+
+            for (const auto& copy : chunk->copies) {
+                if (copy.destination) m_pending_bytes -= copy.region.size;
+            }
+        }
+    }
+
+    const auto& device = m_vulkan_manager->device();
+
+    batch.command_buffer = vk_utils::create_primary_command_buffer(device, m_command_pool.get());
+    batch.command_buffer->begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+    for (const auto& chunk : batch.staging_chunks) {
+        for (const auto& copy : chunk->copies) {
+            if (copy.destination) batch.command_buffer->copyBuffer(chunk->buffer.get(), copy.destination, { copy.region });
+        }
+    }
+
+    // One barrier for the whole batch, covering anything later submissions read the buffers with.
+    vk::MemoryBarrier upload_barrier;
+    upload_barrier
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead);
+
+    batch.command_buffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                          vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eComputeShader,
+                                          vk::DependencyFlagBits(), { upload_barrier }, nullptr, nullptr);
+
+    batch.command_buffer->end();
+
+    batch.fence = device.createFenceUnique({});
+
+    vk::SubmitInfo submit_info;
+    submit_info
+        .setPCommandBuffers(&batch.command_buffer.get())
+        .setCommandBufferCount(1);
+
+    auto queue = device.getQueue(m_vulkan_manager->graphics_queue_family_index(), 0);
+    queue.submit({ submit_info }, batch.fence.get());
+
+    m_batches_in_flight.push_back(std::move(batch));
+}
+
+std::uint64_t mesh_uploader::pending_batch() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_staging_chunks.empty() ? m_next_batch_serial - 1 : m_next_batch_serial;
+}
+
+bool mesh_uploader::is_batch_submitted(std::uint64_t batch) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return std::none_of(m_staging_chunks.begin(), m_staging_chunks.end(), [batch](const auto& chunk) {
+        return chunk->first_batch <= batch;
+    });
+}
+
+bool mesh_uploader::is_batch_complete(std::uint64_t batch) const {
+    if (!is_batch_submitted(batch)) return false;
+
+    const auto& device = m_vulkan_manager->device();
+
+    return std::all_of(m_batches_in_flight.begin(), m_batches_in_flight.end(), [&device, batch](const mesh_uploader::batch& in_flight) {
+        return in_flight.first_batch > batch || device.getFenceStatus(in_flight.fence.get()) == vk::Result::eSuccess;
+    });
+}
+
+void mesh_uploader::release_completed() {
+    const auto& device = m_vulkan_manager->device();
+
+    const auto completed = std::stable_partition(m_batches_in_flight.begin(), m_batches_in_flight.end(), [&device](const batch& batch) {
+        return device.getFenceStatus(batch.fence.get()) != vk::Result::eSuccess;
+    });
+
+    recycle(completed, m_batches_in_flight.end());
+    m_batches_in_flight.erase(completed, m_batches_in_flight.end());
+}
+
+void mesh_uploader::wait_idle() {
+    const auto& device = m_vulkan_manager->device();
+
+    for (const auto& batch : m_batches_in_flight) {
+        while (device.waitForFences({ batch.fence.get() }, true, std::numeric_limits<std::uint64_t>::max()) == vk::Result::eTimeout);
+    }
+
+    recycle(m_batches_in_flight.begin(), m_batches_in_flight.end());
+    m_batches_in_flight.clear();
+}
+
+vk::DeviceSize mesh_uploader::pending_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending_bytes;
+}
+
+void mesh_uploader::recycle(std::vector<batch>::iterator first, std::vector<batch>::iterator last) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto batch = first; batch != last; ++batch) {
+        for (auto& chunk : batch->staging_chunks) {
+            if (m_free_staging_chunks.size() == max_free_staging_chunks) return;
+
+            chunk->used = 0;
+            chunk->copies.clear();
+            chunk->sealed = false;
+            m_free_staging_chunks.push_back(std::move(chunk));
+        }
+    }
+}
+
+std::unique_ptr<mesh_uploader::staging_chunk> mesh_uploader::acquire_staging_chunk(vk::DeviceSize min_size) {
+    const auto free_chunk = std::find_if(m_free_staging_chunks.begin(), m_free_staging_chunks.end(), [min_size](const auto& chunk) {
+        return chunk->size >= min_size;
+    });
+
+    if (free_chunk == m_free_staging_chunks.end()) return create_staging_chunk(min_size);
+
+    auto chunk = std::move(*free_chunk);
+    m_free_staging_chunks.erase(free_chunk);
+
+    return chunk;
+}
+
+std::unique_ptr<mesh_uploader::staging_chunk> mesh_uploader::create_staging_chunk(vk::DeviceSize min_size) const {
+    const auto& device = m_vulkan_manager->device();
+    auto chunk = std::make_unique<staging_chunk>();
+
+    chunk->size = std::max(staging_chunk_size, min_size);
+
+    vk::BufferCreateInfo buffer_ci;
+    buffer_ci
+        .setSize(chunk->size)
+        .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+        .setSharingMode(vk::SharingMode::eExclusive);
+
+    chunk->buffer = device.createBufferUnique(buffer_ci);
+    chunk->memory = vk_utils::alloc_memory(device, m_device_memory_props, device.getBufferMemoryRequirements(chunk->buffer.get()),
+                                           vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    device.bindBufferMemory(chunk->buffer.get(), chunk->memory.get(), 0);
+
+    // Stays mapped until the chunk is freed, which unmaps it.
+    chunk->mapped = static_cast<std::byte*>(device.mapMemory(chunk->memory.get(), 0, chunk->size));
+
+    return chunk;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#ifndef SQUADBOX_GFX_MESH_UPLOADER_HPP
+#define SQUADBOX_GFX_MESH_UPLOADER_HPP
+
+#pragma once
+
+#include "gpu_memory_pool.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/gsl>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace squadbox::gfx {
+
+class vulkan_manager;
+
+// Batches uploads into device local memory. Every allocation's contents are written straight into a shared, persistently
+// mapped staging buffer, and submit() copies everything allocated since the last submit with one command buffer and one
+// queue submission. allocate() may be called from several threads at once, concurrently with submit(), which has to be
+// called from the thread submitting frames, as it uses the graphics queue.
+//
+// An allocation's write stays open until its staging_write is finished. submit() leaves staging buffers with open
+// writes, and everything allocated from them, to a later batch, so it never copies half written contents; they take
+// no new allocations after that. Destroying the staging_write unfinished, e.g. when writing threw, drops the copy.
+// Staging buffers of completed batches are kept for reuse, up to max_free_staging_chunks of them.
+//
+// Buffers are ready for anything submitted to the graphics queue after their batch.
+class mesh_uploader {
+public:
+    // New staging buffers are at least this big; a batch of typical meshes fits one.
+    static constexpr vk::DeviceSize staging_chunk_size = 64 * 1024 * 1024;     // 64 MiB
+    static constexpr std::size_t max_free_staging_chunks = 2;
+
+private:
+    struct staging_chunk;
+
+public:
+    class staging_write {
+    public:
+        staging_write() = default;
+        staging_write(staging_write&& rhs) noexcept;
+        ~staging_write();
+
+        staging_write& operator=(staging_write&& rhs) noexcept;
+
+        // The contents are written; the next submit() may copy them.
+        void finish();
+
+    private:
+        friend class mesh_uploader;
+
+        staging_write(mesh_uploader& uploader, staging_chunk& chunk, std::size_t copy_index)
+            : m_uploader(&uploader), m_chunk(&chunk), m_copy_index(copy_index) {}
+
+        void close(bool written);
+
+        mesh_uploader* m_uploader = nullptr;
+        staging_chunk* m_chunk = nullptr;
+        std::size_t m_copy_index = 0;
+    };
+
+    struct allocation {
+        vk::UniqueBuffer buffer;
+        gpu_memory memory;
+        // Where to write the buffer's contents before the batch is submitted.
+        gsl::span<std::byte> staging;
+        // Finish once staging is written. Last, so an unfinished one drops the copy before the buffer goes.
+        staging_write write;
+    };
+
+    mesh_uploader(const vulkan_manager& vulkan_manager, gpu_memory_pool& gpu_memory_pool);
+    mesh_uploader(const mesh_uploader&) = delete;
+    ~mesh_uploader();
+
+    // Device local buffer of the given size, with transfer destination usage added.
+    allocation allocate(vk::DeviceSize size, vk::BufferUsageFlags usage);
+
+    // Copies everything allocated so far whose staging buffer has no writes open. Does nothing if there's nothing new.
+    void submit();
+
+    // Batches are numbered in order of submission. The one everything allocated so far goes into, 0 if nothing was
+    // ever allocated. Allocations still being written at submit() go into a later one, which the two below account for.
+    std::uint64_t pending_batch() const;
+    // Whether everything allocated by the time pending_batch() returned the batch has been submitted, so later
+    // submissions to the graphics queue see it.
+    bool is_batch_submitted(std::uint64_t batch) const;
+    // Whether the batch, every one before it, and whatever was held back from them have been copied. Call from the
+    // thread submitting.
+    bool is_batch_complete(std::uint64_t batch) const;
+
+    // Recycles the staging memory of batches the GPU is done with.
+    void release_completed();
+
+    // Blocks until every submitted batch is done.
+    void wait_idle();
+
+    vk::DeviceSize pending_bytes() const;
+
+private:
+    struct pending_copy {
+        vk::Buffer destination;
+        vk::BufferCopy region;
+    };
+
+    struct staging_chunk {
+        vk::UniqueBuffer buffer;
+        vk::UniqueDeviceMemory memory;
+        std::byte* mapped = nullptr;
+        vk::DeviceSize size = 0;
+        vk::DeviceSize used = 0;
+        // Copies out of the chunk, which all go in the batch that takes the chunk. Dropped ones have no destination.
+        std::vector<pending_copy> copies;
+        std::uint32_t open_writes = 0;
+        // The batch it was first meant to go into.
+        std::uint64_t first_batch = 0;
+        // Held back by a submit, so allocations go elsewhere.
+        bool sealed = false;
+    };
+
+    struct batch {
+        std::vector<std::unique_ptr<staging_chunk>> staging_chunks;
+        vk::UniqueCommandBuffer command_buffer;
+        vk::UniqueFence fence;
+        std::uint64_t serial = 0;
+        // The earliest first_batch of its chunks.
+        std::uint64_t first_batch = 0;
+    };
+
+    // Keeps the batches' chunks for reuse, as far as there's room.
+    void recycle(std::vector<batch>::iterator first, std::vector<batch>::iterator last);
+    // Under m_mutex. A free chunk that's big enough, or a new one.
+    std::unique_ptr<staging_chunk> acquire_staging_chunk(vk::DeviceSize min_size);
+    std::unique_ptr<staging_chunk> create_staging_chunk(vk::DeviceSize min_size) const;
+
+    gsl::not_null<const vulkan_manager*> m_vulkan_manager;
+    gsl::not_null<gpu_memory_pool*> m_gpu_memory_pool;
+    vk::PhysicalDeviceMemoryProperties m_device_memory_props;
+    vk::UniqueCommandPool m_command_pool;
+
+    mutable std::mutex m_mutex;
+    // Chunks with copies not submitted yet; allocations go into the last one.
+    std::vector<std::unique_ptr<staging_chunk>> m_staging_chunks;
+    std::vector<std::unique_ptr<staging_chunk>> m_free_staging_chunks;
+    vk::DeviceSize m_pending_bytes = 0;
+    std::uint64_t m_next_batch_serial = 1;
+
+    std::vector<batch> m_batches_in_flight;
+};
+
+}
+
+#endif
\ No newline at end of file
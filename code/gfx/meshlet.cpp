@@ -0,0 +1,200 @@
+#include "meshlet.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace squadbox::gfx {
+
+namespace {
+    constexpr auto not_in_meshlet = std::numeric_limits<std::uint32_t>::max();
+
+    void compute_cone(gsl::span<const glm::vec3> positions, gsl::span<const std::uint32_t> triangle_list_indices, meshlet& meshlet) {
+        std::vector<glm::vec3> normals;
+        normals.reserve(triangle_list_indices.size() / 3);
+
+        glm::vec3 normal_sum {};
+        for (std::ptrdiff_t i = 0; i < triangle_list_indices.size(); i += 3) {
+            const auto& a = positions[triangle_list_indices[i + 0]];
+            const auto& b = positions[triangle_list_indices[i + 1]];
+            const auto& c = positions[triangle_list_indices[i + 2]];
+
+            // Same winding as calculate_normals().
+            const auto normal = glm::cross(c - a, b - a);
+            const auto length = glm::length(normal);
+            if (length == 0.0f) continue;
+
+            normals.push_back(normal / length);
+            normal_sum += normals.back();
+        }
+
+        const auto sum_length = glm::length(normal_sum);
+        if (normals.empty() || sum_length == 0.0f) return;
+
+        meshlet.cone_axis = normal_sum / sum_length;
+
+        auto min_dot = 1.0f;
+        for (const auto& normal : normals) {
+            min_dot = std::min(min_dot, glm::dot(meshlet.cone_axis, normal));
+        }
+
+        // Anything close to a hemisphere or wider is visible from nearly everywhere; not worth testing.
+        if (min_dot <= 0.1f) return;
+
+        // sin of the cone's half angle, i.e. cos of the half angle widened by 90 degrees.
+        meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+}
+
+bool meshlet::is_backfacing(const glm::vec3& view_position) const {
+    const auto to_center = bounding_sphere.center - view_position;
+    return glm::dot(to_center, cone_axis) >= cone_cutoff * glm::length(to_center) + bounding_sphere.radius;
+}
+
+std::vector<meshlet> build_meshlets(gsl::span<const glm::vec3> positions, gsl::span<std::uint32_t> triangle_list_indices,
+                                    std::uint32_t max_vertices, std::uint32_t max_triangles) {
+    assert(triangle_list_indices.size() % 3 == 0);
+    assert(max_vertices >= 3 && max_triangles >= 1);
+
+    const auto num_vertices = static_cast<std::uint32_t>(positions.size());
+    const auto num_triangles = static_cast<std::uint32_t>(triangle_list_indices.size() / 3);
+
+    // Triangles around every vertex.
+    std::vector<std::uint32_t> triangle_offsets(num_vertices + 1, 0);
+    for (const auto index : triangle_list_indices) ++triangle_offsets[index + 1];
+    for (std::uint32_t v = 0; v < num_vertices; ++v) triangle_offsets[v + 1] += triangle_offsets[v];
+
+    std::vector<std::uint32_t> vertex_triangles(triangle_list_indices.size());
+    {
+        auto write_offsets = triangle_offsets;
+        for (std::ptrdiff_t i = 0; i < triangle_list_indices.size(); ++i) {
+            vertex_triangles[write_offsets[triangle_list_indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<meshlet> meshlets;
+    std::vector<std::uint32_t> reordered;
+    reordered.reserve(triangle_list_indices.size());
+
+    std::vector<bool> emitted(num_triangles, false);
+    std::vector<std::uint32_t> meshlet_vertex_slots(num_vertices, not_in_meshlet);
+    std::vector<std::uint32_t> meshlet_vertices;
+    std::vector<std::uint32_t> meshlet_triangles;
+    std::vector<std::uint32_t> candidates;
+    std::vector<glm::vec3> meshlet_positions;
+    glm::vec3 meshlet_position_sum {};
+    std::uint32_t next_seed = 0;
+
+    const auto new_vertex_count = [&](std::uint32_t triangle) {
+        std::uint32_t count = 0;
+        for (std::uint32_t v = 0; v < 3; ++v) {
+            count += meshlet_vertex_slots[triangle_list_indices[triangle * 3 + v]] == not_in_meshlet;
+        }
+        return count;
+    };
+
+    // Squared distance from the cluster's centroid, to keep clusters round when vertex counts tie.
+    const auto centroid_distance = [&](std::uint32_t triangle) {
+        const auto centroid = meshlet_position_sum / static_cast<float>(std::max<std::size_t>(meshlet_vertices.size(), 1));
+        const auto center = (positions[triangle_list_indices[triangle * 3 + 0]]
+                           + positions[triangle_list_indices[triangle * 3 + 1]]
+                           + positions[triangle_list_indices[triangle * 3 + 2]]) / 3.0f;
+
+        return glm::dot(center - centroid, center - centroid);
+    };
+
+    const auto finish_meshlet = [&]() {
+        meshlet meshlet;
+        meshlet.first_index = static_cast<std::uint32_t>(reordered.size());
+        meshlet.index_count = static_cast<std::uint32_t>(meshlet_triangles.size() * 3);
+        meshlet.vertex_count = static_cast<std::uint32_t>(meshlet_vertices.size());
+
+        for (const auto triangle : meshlet_triangles) {
+            for (std::uint32_t v = 0; v < 3; ++v) {
+                reordered.push_back(triangle_list_indices[triangle * 3 + v]);
+            }
+        }
+
+        meshlet_positions.clear();
+        for (const auto vertex : meshlet_vertices) {
+            meshlet_positions.push_back(positions[vertex]);
+            meshlet_vertex_slots[vertex] = not_in_meshlet;
+        }
+
+        meshlet.bounding_sphere = gfx::bounding_sphere::from_points(meshlet_positions, aabb::from_points(meshlet_positions));
+        compute_cone(positions, gsl::make_span(reordered).subspan(meshlet.first_index), meshlet);
+
+        meshlets.push_back(meshlet);
+        meshlet_vertices.clear();
+        meshlet_triangles.clear();
+        meshlet_position_sum = {};
+        candidates.clear();
+    };
+
+    while (true) {
+        // The connected triangle adding the fewest vertices, dropping candidates that were emitted since.
+        auto best_triangle = not_in_meshlet;
+        std::uint32_t best_new_vertices = 4;
+        auto best_distance = std::numeric_limits<float>::max();
+
+        for (std::size_t i = 0; i < candidates.size();) {
+            const auto triangle = candidates[i];
+            if (emitted[triangle]) {
+                candidates[i] = candidates.back();
+                candidates.pop_back();
+                continue;
+            }
+
+            const auto new_vertices = new_vertex_count(triangle);
+            if (new_vertices <= best_new_vertices) {
+                const auto distance = centroid_distance(triangle);
+                if (new_vertices < best_new_vertices || distance < best_distance) {
+                    best_triangle = triangle;
+                    best_new_vertices = new_vertices;
+                    best_distance = distance;
+                }
+            }
+
+            ++i;
+        }
+
+        if (best_triangle == not_in_meshlet) {
+            // Nothing connected is left, so the next cluster starts wherever the input order continues.
+            if (!meshlet_triangles.empty()) finish_meshlet();
+
+            while (next_seed < num_triangles && emitted[next_seed]) ++next_seed;
+            if (next_seed == num_triangles) break;
+
+            best_triangle = next_seed;
+            best_new_vertices = new_vertex_count(best_triangle);
+        }
+        else if (meshlet_vertices.size() + best_new_vertices > max_vertices || meshlet_triangles.size() == max_triangles) {
+            // Full; the triangle seeds the next cluster so it stays next to this one.
+            finish_meshlet();
+            best_new_vertices = 3;
+        }
+
+        emitted[best_triangle] = true;
+        meshlet_triangles.push_back(best_triangle);
+
+        for (std::uint32_t v = 0; v < 3; ++v) {
+            const auto vertex = triangle_list_indices[best_triangle * 3 + v];
+            if (meshlet_vertex_slots[vertex] != not_in_meshlet) continue;
+
+            meshlet_vertex_slots[vertex] = static_cast<std::uint32_t>(meshlet_vertices.size());
+            meshlet_vertices.push_back(vertex);
+            meshlet_position_sum += positions[vertex];
+
+            for (auto t = triangle_offsets[vertex]; t < triangle_offsets[vertex + 1]; ++t) {
+                if (!emitted[vertex_triangles[t]]) candidates.push_back(vertex_triangles[t]);
+            }
+        }
+    }
+
+    std::copy(reordered.begin(), reordered.end(), triangle_list_indices.begin());
+
+    return meshlets;
+}
+
+}
\ No newline at end of file
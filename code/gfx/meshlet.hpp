@@ -0,0 +1,44 @@
+#ifndef SQUADBOX_GFX_MESHLET_HPP
+#define SQUADBOX_GFX_MESHLET_HPP
+
+#pragma once
+
+#include "bounds.hpp"
+
+#include <glm/glm.hpp>
+#include <gsl/gsl>
+
+#include <cstdint>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// A small cluster of connected triangles, culled on its own. Its triangles are a contiguous range of the
+// mesh's triangle list, so a cluster draws as a plain indexed draw.
+struct meshlet {
+    static constexpr std::uint32_t max_vertices = 64;
+    static constexpr std::uint32_t max_triangles = 124;
+
+    std::uint32_t first_index = 0;
+    std::uint32_t index_count = 0;
+    std::uint32_t vertex_count = 0;
+
+    // Model space.
+    gfx::bounding_sphere bounding_sphere;
+
+    // Every triangle faces within the cone around cone_axis. Seen from a point p, the whole cluster faces away if
+    // dot(center - p, cone_axis) >= cone_cutoff * length(center - p) + radius. A cutoff of 1 never culls.
+    glm::vec3 cone_axis = {};
+    float cone_cutoff = 1.0f;
+
+    bool is_backfacing(const glm::vec3& view_position) const;
+};
+
+// Greedily grows clusters of adjacent triangles, preferring those that add the fewest new vertices, and reorders
+// triangle_list_indices in place so every cluster's triangles are contiguous.
+std::vector<meshlet> build_meshlets(gsl::span<const glm::vec3> positions, gsl::span<std::uint32_t> triangle_list_indices,
+                                    std::uint32_t max_vertices = meshlet::max_vertices, std::uint32_t max_triangles = meshlet::max_triangles);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "pipeline_manager.hpp"
+
+#include "vulkan_manager.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+
+namespace squadbox::gfx {
+
+using internal_pipeline_manager::compile_state;
+
+pipeline_handle::~pipeline_handle() {
+    release();
+}
+
+pipeline_handle& pipeline_handle::operator=(pipeline_handle&& rhs) {
+    if (this != &rhs) {
+        release();
+        m_entry = std::move(rhs.m_entry);
+    }
+
+    return *this;
+}
+
+void pipeline_handle::wait() const {
+    if (!m_entry) return;
+
+    std::unique_lock<std::mutex> lock(m_entry->mutex);
+    m_entry->done.wait(lock, [this] {
+        const auto state = m_entry->state.load(std::memory_order_relaxed);
+        return state != compile_state::queued && state != compile_state::compiling;
+    });
+}
+
+void pipeline_handle::release() {
+    if (!m_entry) return;
+
+    vk::UniquePipeline pipeline;
+
+    {
+        std::lock_guard<std::mutex> lock(m_entry->mutex);
+        const auto state = m_entry->state.load(std::memory_order_relaxed);
+
+        if (state == compile_state::queued) {
+            m_entry->state.store(compile_state::cancelled, std::memory_order_relaxed);
+        }
+        else if (state == compile_state::compiling) {
+            m_entry->abandoned = true;
+        }
+        else {
+            pipeline = std::move(m_entry->pipeline);
+        }
+    }
+
+    if (pipeline) {
+        auto& retired = *m_entry->retired;
+        std::lock_guard<std::mutex> lock(retired.mutex);
+        retired.pipelines.emplace_back(retired.frame_serial, std::move(pipeline));
+    }
+
+    m_entry.reset();
+}
+
+pipeline_manager::pipeline_manager(const vulkan_manager& vulkan_manager, unsigned int num_threads)
+    : m_vulkan_manager(&vulkan_manager),
+      m_pipeline_cache(vulkan_manager.device().createPipelineCacheUnique(vk::PipelineCacheCreateInfo())),
+      m_retired(std::make_shared<internal_pipeline_manager::retired_pipelines>()),
+      m_thread_pool(std::max(num_threads, 1u)) {
+}
+
+pipeline_manager::~pipeline_manager() {
+    // Compiles still queued run before the workers exit, unless their handles are gone.
+    m_thread_pool.close();
+    m_thread_pool.join();
+}
+
+pipeline_handle pipeline_manager::compile(create_function create, std::shared_ptr<void> resources) {
+    auto entry = std::make_shared<internal_pipeline_manager::compile_entry>();
+    entry->create = std::move(create);
+    entry->resources = std::move(resources);
+    entry->retired = m_retired;
+
+    m_compiles_pending.fetch_add(1, std::memory_order_relaxed);
+    m_thread_pool.submit([this, entry] { run(*entry); });
+
+    return pipeline_handle(std::move(entry));
+}
+
+void pipeline_manager::begin_frame(std::uint64_t frame_serial, std::uint64_t completed_frame_serial) {
+    // Destroyed once out of the lock.
+    std::vector<std::pair<std::uint64_t, vk::UniquePipeline>> completed;
+
+    {
+        std::lock_guard<std::mutex> lock(m_retired->mutex);
+        m_retired->frame_serial = frame_serial;
+
+        auto& pipelines = m_retired->pipelines;
+        const auto in_flight = std::stable_partition(pipelines.begin(), pipelines.end(), [completed_frame_serial](const auto& retired) {
+            return retired.first > completed_frame_serial;
+        });
+
+        completed.assign(std::make_move_iterator(in_flight), std::make_move_iterator(pipelines.end()));
+        pipelines.erase(in_flight, pipelines.end());
+    }
+}
+
+std::string pipeline_manager::last_error() const {
+    std::lock_guard<std::mutex> lock(m_error_mutex);
+    return m_last_error;
+}
+
+void pipeline_manager::run(internal_pipeline_manager::compile_entry& entry) {
+    // Dropped last and outside the entry's lock, as it may hold the handle.
+    std::shared_ptr<void> resources;
+
+    const auto finish = [this, &entry, &resources](compile_state state, vk::UniquePipeline pipeline, std::string error) {
+        {
+            std::lock_guard<std::mutex> lock(entry.mutex);
+
+            // Never drawn with if abandoned, so it goes right away.
+            if (!entry.abandoned) {
+                entry.pipeline = std::move(pipeline);
+                entry.error = std::move(error);
+            }
+
+            entry.state.store(state, std::memory_order_release);
+            resources = std::move(entry.resources);
+        }
+
+        entry.done.notify_all();
+        m_compiles_pending.fetch_sub(1, std::memory_order_relaxed);
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        if (entry.state.load(std::memory_order_relaxed) == compile_state::cancelled) {
+            entry.create = nullptr;
+            resources = std::move(entry.resources);
+            m_compiles_pending.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+
+        entry.state.store(compile_state::compiling, std::memory_order_relaxed);
+    }
+
+    // Nothing else touches create while it's compiling.
+    std::string error;
+
+    try {
+        auto pipeline = entry.create(m_vulkan_manager->device(), m_pipeline_cache.get());
+        entry.create = nullptr;
+        finish(compile_state::ready, std::move(pipeline), {});
+        return;
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+    }
+    catch (...) {
+        error = "pipeline_manager: the create function threw something other than an exception.";
+    }
+
+    entry.create = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_error_mutex);
+        m_last_error = error;
+    }
+
+    finish(compile_state::failed, {}, std::move(error));
+}
+
+}
\ No newline at end of file
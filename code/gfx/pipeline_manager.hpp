@@ -0,0 +1,140 @@
+#ifndef SQUADBOX_GFX_PIPELINE_MANAGER_HPP
+#define SQUADBOX_GFX_PIPELINE_MANAGER_HPP
+
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/gsl>
+#include <boost/thread/executors/basic_thread_pool.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace squadbox::gfx {
+
+class vulkan_manager;
+
+namespace internal_pipeline_manager {
+    enum class compile_state {
+        queued,
+        compiling,
+        ready,
+        failed,
+        cancelled
+    };
+
+    // Pipelines released while frames in flight may still use them.
+    struct retired_pipelines {
+        std::mutex mutex;
+        // Of the frame last begun; a pipeline released now may be used by it, but not by any later one.
+        std::uint64_t frame_serial = 0;
+        std::vector<std::pair<std::uint64_t, vk::UniquePipeline>> pipelines;
+    };
+
+    struct compile_entry {
+        std::function<vk::UniquePipeline(const vk::Device& device, const vk::PipelineCache& pipeline_cache)> create;
+        // Held until the compile is done.
+        std::shared_ptr<void> resources;
+        // Written under the mutex; read without it by the frame thread.
+        std::atomic<compile_state> state = compile_state::queued;
+        vk::UniquePipeline pipeline;
+        std::string error;
+        // The handle went while compiling; the worker destroys the pipeline itself.
+        bool abandoned = false;
+        std::shared_ptr<retired_pipelines> retired;
+
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+}
+
+// A pipeline that pipeline_manager::compile() may still be working on. Null until it's ready, and for good if it
+// failed, so draws check for it and are skipped or use a variant that's ready.
+//
+// It owns the pipeline, and destroying it never blocks: a compile that hasn't started is dropped, one in progress is
+// left to the worker, which destroys the pipeline once it's made, and a ready pipeline is destroyed once every frame
+// begun so far has retired, as frames in flight may still draw with it.
+class pipeline_handle {
+public:
+    pipeline_handle() = default;
+    pipeline_handle(pipeline_handle&&) = default;
+    ~pipeline_handle();
+
+    pipeline_handle& operator=(pipeline_handle&& rhs);
+
+    bool ready() const { return state() == internal_pipeline_manager::compile_state::ready; }
+    bool failed() const { return state() == internal_pipeline_manager::compile_state::failed; }
+    vk::Pipeline get() const { return ready() ? m_entry->pipeline.get() : vk::Pipeline(); }
+    // Once failed().
+    const std::string& error() const { return m_entry->error; }
+
+    // Blocks until the compile has finished, e.g. for pipelines a loading screen can wait for.
+    void wait() const;
+
+private:
+    friend class pipeline_manager;
+
+    explicit pipeline_handle(std::shared_ptr<internal_pipeline_manager::compile_entry> entry) : m_entry(std::move(entry)) {}
+
+    internal_pipeline_manager::compile_state state() const {
+        return m_entry ? m_entry->state.load(std::memory_order_acquire) : internal_pipeline_manager::compile_state::cancelled;
+    }
+
+    void release();
+
+    std::shared_ptr<internal_pipeline_manager::compile_entry> m_entry;
+};
+
+// Compiles pipelines on threads of its own, so that adding a technique or a variant never holds up a frame; a driver
+// can take tens of milliseconds on one. Compiles start in the order they were queued and share a pipeline cache, so
+// variants that only differ in a few states come cheaper after the first.
+class pipeline_manager {
+public:
+    using create_function = std::function<vk::UniquePipeline(const vk::Device& device, const vk::PipelineCache& pipeline_cache)>;
+
+    explicit pipeline_manager(const vulkan_manager& vulkan_manager, unsigned int num_threads = 2);
+    pipeline_manager(const pipeline_manager&) = delete;
+    // Waits for compiles in progress. Handles outlive it fine, as long as the device is idle by then.
+    ~pipeline_manager();
+
+    // Calls create on a worker thread with the device and the shared cache. It's fine for it to throw; the handle
+    // then stays null, and last_error() has the message. Whatever create refers to (shader modules, layouts, the render
+    // pass) has to stay alive until the compile is done, which may be after the handle is gone: resources are held
+    // until then, like a draw_packet's are until its frame retires.
+    pipeline_handle compile(create_function create, std::shared_ptr<void> resources = nullptr);
+
+    // Frame thread, at the start of every frame. Destroys the pipelines released before completed_frame_serial, and
+    // keeps the ones released from now on until frame_serial completes.
+    void begin_frame(std::uint64_t frame_serial, std::uint64_t completed_frame_serial);
+
+    // Queued or in progress.
+    std::size_t compiles_pending() const { return m_compiles_pending.load(std::memory_order_relaxed); }
+
+    // Of the last compile that failed, empty if none did.
+    std::string last_error() const;
+
+private:
+    void run(internal_pipeline_manager::compile_entry& entry);
+
+    gsl::not_null<const vulkan_manager*> m_vulkan_manager;
+    vk::UniquePipelineCache m_pipeline_cache;
+    std::shared_ptr<internal_pipeline_manager::retired_pipelines> m_retired;
+    std::atomic<std::size_t> m_compiles_pending = 0;
+
+    mutable std::mutex m_error_mutex;
+    std::string m_last_error;
+
+    // Last, so compiles in progress finish before anything else goes away.
+    boost::basic_thread_pool m_thread_pool;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -24,6 +24,8 @@ public:
     const glm::vec3& min_corner() const { return m_min_corner; }
     const glm::vec3& max_corner() const { return m_max_corner; }
 
+    aabb bounds() const { return { m_min_corner, m_max_corner }; }
+
     mesh<mesh_features::position, mesh_features::normal> create_mesh() const {
         std::array<glm::vec3, 8> positions;
 
@@ -99,6 +101,8 @@ public:
         mesh.set_positions(positions);
         mesh.set_normals(calculate_normals(positions, indices));
         mesh.set_triangle_list_indices(indices);
+        mesh.generate_lods();
+        mesh.optimize_vertex_order();
 
         return mesh;
     }
@@ -0,0 +1,129 @@
+#include "radix_sort.hpp"
+
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/latch.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace squadbox::gfx {
+
+radix_sorter::radix_sorter(unsigned int max_threads)
+    : m_max_threads(max_threads != 0 ? max_threads : std::max(1u, std::thread::hardware_concurrency())) {
+}
+
+radix_sorter::~radix_sorter() {
+    if (m_thread_pool) {
+        m_thread_pool->close();
+        m_thread_pool->join();
+    }
+}
+
+void radix_sorter::sort(gsl::span<std::uint64_t> keys, gsl::span<std::uint32_t> values) {
+    assert(keys.size() == values.size());
+
+    const auto count = static_cast<std::size_t>(keys.size());
+    if (count < 2) return;
+
+    m_scratch_keys.resize(count);
+    m_scratch_values.resize(count);
+
+    const auto num_threads = count < parallel_threshold
+        ? 1u
+        : static_cast<unsigned int>(std::min<std::size_t>(m_max_threads, count / (parallel_threshold / 2)));
+
+    m_histograms.resize(num_threads);
+
+    std::optional<boost::barrier> barrier;
+    if (num_threads > 1) barrier.emplace(num_threads);
+
+    auto sync = [&barrier] {
+        if (barrier) barrier->wait();
+    };
+
+    bool skip_pass = false;
+
+    auto sort_chunk = [&](unsigned int thread_index) {
+        const auto begin = count * thread_index / num_threads;
+        const auto end = count * (thread_index + 1) / num_threads;
+
+        std::uint64_t* src_keys = keys.data();
+        std::uint32_t* src_values = values.data();
+        std::uint64_t* dst_keys = m_scratch_keys.data();
+        std::uint32_t* dst_values = m_scratch_values.data();
+
+        auto& local_histogram = m_histograms[thread_index];
+
+        for (std::uint32_t pass = 0; pass < num_passes; ++pass) {
+            const auto shift = pass * radix_bits;
+
+            local_histogram.fill(0);
+            for (auto i = begin; i < end; ++i) {
+                ++local_histogram[(src_keys[i] >> shift) & (radix_size - 1)];
+            }
+
+            sync();
+
+            // Turn the per-thread counts into per-thread scatter offsets. Chunks are laid out in thread
+            // order within each digit, which keeps the sort stable.
+            if (thread_index == 0) {
+                skip_pass = false;
+                std::uint32_t offset = 0;
+
+                for (std::uint32_t digit = 0; digit < radix_size; ++digit) {
+                    std::uint32_t digit_count = 0;
+
+                    for (auto& histogram : m_histograms) {
+                        const auto chunk_digit_count = histogram[digit];
+                        histogram[digit] = offset + digit_count;
+                        digit_count += chunk_digit_count;
+                    }
+
+                    if (digit_count == count) skip_pass = true;
+                    offset += digit_count;
+                }
+            }
+
+            sync();
+
+            if (skip_pass) continue;
+
+            for (auto i = begin; i < end; ++i) {
+                const auto dst = local_histogram[(src_keys[i] >> shift) & (radix_size - 1)]++;
+                dst_keys[dst] = src_keys[i];
+                dst_values[dst] = src_values[i];
+            }
+
+            sync();
+
+            std::swap(src_keys, dst_keys);
+            std::swap(src_values, dst_values);
+        }
+
+        if (src_keys != keys.data()) {
+            std::copy(src_keys + begin, src_keys + end, keys.data() + begin);
+            std::copy(src_values + begin, src_values + end, values.data() + begin);
+        }
+    };
+
+    if (num_threads == 1) {
+        sort_chunk(0);
+        return;
+    }
+
+    if (!m_thread_pool) m_thread_pool.emplace(m_max_threads - 1);
+
+    boost::latch workers_done(num_threads - 1);
+    for (unsigned int i = 1; i < num_threads; ++i) {
+        m_thread_pool->submit([&sort_chunk, &workers_done, i] {
+            sort_chunk(i);
+            workers_done.count_down();
+        });
+    }
+
+    sort_chunk(0);
+    workers_done.wait();
+}
+
+}
\ No newline at end of file
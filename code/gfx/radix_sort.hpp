@@ -0,0 +1,52 @@
+#ifndef SQUADBOX_GFX_RADIX_SORT_HPP
+#define SQUADBOX_GFX_RADIX_SORT_HPP
+
+#pragma once
+
+#include <gsl/gsl>
+#include <boost/thread/executors/basic_thread_pool.hpp>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// Stable LSD radix sort of 64-bit keys (8-bit digits) carrying a 32-bit payload each.
+// Digits that are identical across every key are skipped, so keys that only use a few
+// of their bits (e.g. few layers / pipelines in a frame) take only a few passes.
+class radix_sorter {
+public:
+    // Inputs smaller than this are sorted on the calling thread only.
+    static constexpr std::size_t parallel_threshold = 16 * 1024;
+
+    // The worker threads are started by the first sort big enough to use them, and kept for later sorts.
+    explicit radix_sorter(unsigned int max_threads = 0);
+    radix_sorter(const radix_sorter&) = delete;
+    ~radix_sorter();
+
+    // Sorts keys and values in place. Both spans must have the same size. Not to be called from several threads at
+    // once; the workers wait on each other, so they aren't shared with anything else.
+    void sort(gsl::span<std::uint64_t> keys, gsl::span<std::uint32_t> values);
+
+private:
+    static constexpr std::uint32_t radix_bits = 8;
+    static constexpr std::uint32_t radix_size = 1 << radix_bits;
+    static constexpr std::uint32_t num_passes = 64 / radix_bits;
+
+    using histogram = std::array<std::uint32_t, radix_size>;
+
+    unsigned int m_max_threads;
+
+    std::vector<std::uint64_t> m_scratch_keys;
+    std::vector<std::uint32_t> m_scratch_values;
+    std::vector<histogram> m_histograms;
+
+    // m_max_threads - 1 workers, the calling thread being the last one.
+    std::optional<boost::basic_thread_pool> m_thread_pool;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -3,13 +3,16 @@
 
 #pragma once
 
-#include <boost/container/small_vector.hpp>
 #include <vulkan/vulkan.hpp>
 
-#include <condition_variable>
-#include <shared_mutex>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <tuple>
+#include <vector>
 
 namespace squadbox::gfx {
 
@@ -18,7 +21,10 @@ public:
     friend class render_job;
 
     template<typename storage_type>
-    friend class typed_render_job;
+    friend class render_job_arena;
+
+    // While held, the data outlives its owner, as it does for a render job referencing it.
+    std::shared_ptr<void> share() const { return m_persistent_data_after_destruction; }
 
 protected:
     any_persistent_render_data(std::shared_ptr<void>&& persistent_data_after_destruction)
@@ -89,13 +95,7 @@ struct render_job_command_buffer_base {
 };
 
 
-class render_job {
-    struct finish_flag {
-        std::mutex mutex;
-        std::condition_variable condition_variable;
-        bool is_finished;
-    };
-
+namespace internal_render_job {
     template<typename storage_type>
     struct without_render_job_command_buffer_base : render_job_command_buffer_base {
         storage_type data;
@@ -105,166 +105,304 @@ class render_job {
             : render_job_command_buffer_base { std::move(command_buffer) }, data(std::forward<arg_storage_type>(arg_data)) {
         }
     };
+}
+
 
+// Intrusive header shared by every job in a render_job_arena.
+class render_job_node {
+public:
+    render_job_node() = default;
+    render_job_node(const render_job_node&) = delete;
+
+    vk::CommandBuffer command_buffer;
+    std::shared_ptr<void> persistent_data;
+
+    std::atomic<std::uint32_t> ref_count { 0 };
+    void (*release)(render_job_node* node) = nullptr;
+};
+
+
+template<typename storage_type>
+class render_job_arena;
+
+
+// Reference to a recorded command buffer and the data it needs until the GPU is done with it.
+// Copies only touch the intrusive reference count; the last reference hands the job back to its arena.
+// Completion is tracked per frame by the render_manager rather than per job.
+class render_job {
 public:
     render_job() = default;
 
-    render_job(vk::UniqueCommandBuffer&& command_buffer, const any_persistent_render_data& persistent_data = no_persistent_render_data {})
-        : m_command_buffer(command_buffer.get()),
-          m_persistent_data(persistent_data.m_persistent_data_after_destruction),
-          m_data(std::make_shared<render_job_command_buffer_base>(render_job_command_buffer_base { std::move(command_buffer) })) {
+    render_job(vk::UniqueCommandBuffer&& command_buffer, const any_persistent_render_data& persistent_data = no_persistent_render_data {});
+
+    template<typename storage_type, typename = std::enable_if_t<std::is_base_of_v<render_job_command_buffer_base, std::decay_t<storage_type>>>>
+    render_job(storage_type&& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {});
+
+    template<typename storage_type, typename = std::enable_if_t<!std::is_base_of_v<render_job_command_buffer_base, std::decay_t<storage_type>>>>
+    render_job(vk::UniqueCommandBuffer&& command_buffer, storage_type&& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {});
+
+    render_job(const render_job& rhs) : m_node(rhs.m_node) {
+        add_ref();
     }
 
-    template<typename storage_type, typename = std::enable_if_t<std::is_base_of_v<render_job_command_buffer_base, storage_type>>>
-    render_job(storage_type&& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {})
-        : m_command_buffer(static_cast<render_job_command_buffer_base&>(data).command_buffer.get()),
-          m_persistent_data(persistent_data.m_persistent_data_after_destruction),
-          m_data(std::make_shared<std::decay_t<storage_type>>(std::forward<storage_type>(data))) {
+    render_job(render_job&& rhs) noexcept : m_node(rhs.m_node) {
+        rhs.m_node = nullptr;
     }
 
-    template<typename storage_type, typename = std::enable_if_t<!std::is_base_of_v<render_job_command_buffer_base, storage_type>>>
-    render_job(vk::UniqueCommandBuffer&& command_buffer, storage_type&& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {})
-        : m_command_buffer(command_buffer.get()),
-          m_persistent_data(persistent_data.m_persistent_data_after_destruction),
-          m_data(std::make_shared<without_render_job_command_buffer_base<std::decay_t<storage_type>>>(std::move(command_buffer), std::forward<storage_type>(data))) {
+    ~render_job() {
+        free();
     }
 
-    render_job(const std::shared_ptr<render_job_command_buffer_base>& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {})
-        : m_command_buffer(data->command_buffer.get()),
-          m_persistent_data(persistent_data.m_persistent_data_after_destruction),
-          m_data(data) {
+    render_job& operator=(const render_job& rhs) {
+        if (m_node != rhs.m_node) {
+            free();
+            m_node = rhs.m_node;
+            add_ref();
+        }
+
+        return *this;
     }
 
-    const vk::CommandBuffer& command_buffer() const { return m_command_buffer; }
-    
-    bool is_valid() const { return m_data != nullptr; }
-    auto use_count() const { return m_data.use_count(); }
+    render_job& operator=(render_job&& rhs) noexcept {
+        if (this != &rhs) {
+            free();
+            m_node = rhs.m_node;
+            rhs.m_node = nullptr;
+        }
 
-    void finish() {
-        if (!is_valid()) return;
+        return *this;
+    }
 
-        std::unique_lock<std::mutex> lock(m_finish_flag->mutex);
-        m_finish_flag->is_finished = true;
-        lock.unlock();
-        m_finish_flag->condition_variable.notify_all();
+    const vk::CommandBuffer& command_buffer() const {
+        assert(is_valid());
+        return m_node->command_buffer;
     }
 
+    bool is_valid() const { return m_node != nullptr; }
+    std::uint32_t use_count() const { return m_node ? m_node->ref_count.load(std::memory_order_relaxed) : 0; }
+
     void free() {
-        m_command_buffer = nullptr;
-        m_data.reset();
-        m_persistent_data.reset();
-    }
+        if (m_node && m_node->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            m_node->release(m_node);
+        }
 
-    void wait_finish() {
-        if (!is_valid() || use_count() == 1) return;
-        
-        std::unique_lock<std::mutex> lock(m_finish_flag->mutex);
-        m_finish_flag->condition_variable.wait(lock, [this] { return m_finish_flag->is_finished; });
+        m_node = nullptr;
     }
 
 protected:
-    vk::CommandBuffer m_command_buffer;
-    std::shared_ptr<void> m_persistent_data;
-    std::shared_ptr<render_job_command_buffer_base> m_data;
-    std::shared_ptr<finish_flag> m_finish_flag = std::make_shared<finish_flag>();
+    explicit render_job(render_job_node* node) : m_node(node) {
+        add_ref();
+    }
+
+    void add_ref() {
+        if (m_node) m_node->ref_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    render_job_node* m_node = nullptr;
 };
 
 
 template<typename storage_type>
 class typed_render_job : public render_job {
-    using tuple_storage_type = std::tuple<vk::UniqueCommandBuffer, storage_type>;
-
 public:
     static_assert(std::is_base_of_v<render_job_command_buffer_base, storage_type>);
 
+    friend class render_job_arena<storage_type>;
+
     typed_render_job() = default;
 
-    typed_render_job(vk::UniqueCommandBuffer&& command_buffer, const any_persistent_render_data& persistent_data = no_persistent_render_data {})
-        : render_job() {
-        m_data = std::make_shared<storage_type>();
-        static_cast<render_job_command_buffer_base*>(m_data.get())->command_buffer = std::move(command_buffer);
+    storage_type& data() {
+        return const_cast<storage_type&>(const_cast<const typed_render_job*>(this)->data());
+    }
 
-        m_persistent_data = persistent_data.m_persistent_data_after_destruction;
+    const storage_type& data() const {
+        assert(is_valid());
+        return *static_cast<const typename render_job_arena<storage_type>::node*>(m_node)->data;
     }
 
-    typed_render_job(const storage_type& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {})
-        : render_job(data, persistent_data) {
+    storage_type* operator->() { return &data(); }
+    const storage_type* operator->() const { return &data(); }
+
+private:
+    explicit typed_render_job(render_job_node* node) : render_job(node) {}
+};
+
+
+// Fixed-address job storage with a free list. Creating a job pops a node and releasing the last
+// reference pushes it back, both O(1); memory is only allocated when the arena has to grow.
+//
+// With recycle_data, released jobs keep their storage (minus the command buffer) so that the next
+// job can reuse buffers and memory it already owns. Otherwise the storage is destroyed on release.
+//
+// Outstanding jobs keep the arena's nodes alive, so the arena may be destroyed before its jobs are.
+template<typename storage_type>
+class render_job_arena {
+public:
+    static_assert(std::is_base_of_v<render_job_command_buffer_base, storage_type>);
+
+    friend class typed_render_job<storage_type>;
+
+    explicit render_job_arena(std::size_t initial_capacity = 0, bool recycle_data = false)
+        : m_state(new state(recycle_data)) {
+        if (initial_capacity != 0) {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            m_state->grow(initial_capacity);
+        }
     }
 
-    typed_render_job(storage_type&& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {})
-        : render_job(std::move(data), persistent_data) {
+    render_job_arena(const render_job_arena&) = delete;
+    render_job_arena& operator=(const render_job_arena&) = delete;
+
+    ~render_job_arena() {
+        m_state->release_ref();
     }
 
-    typed_render_job(const std::shared_ptr<storage_type>& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {})
-        : render_job(data, persistent_data) {
+    // Arena backing render jobs that are constructed directly instead of through a pool.
+    static render_job_arena& shared() {
+        static render_job_arena arena;
+        return arena;
     }
 
-    void emplace(vk::UniqueCommandBuffer&& command_buffer, const storage_type& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {}) {
-        static_cast<render_job_command_buffer_base*>(m_data.get())->command_buffer = std::move(command_buffer);
-        *static_cast<storage_type*>(m_data.get()) = data;
+    typed_render_job<storage_type> create(vk::UniqueCommandBuffer&& command_buffer,
+                                          const any_persistent_render_data& persistent_data = no_persistent_render_data {}) {
+        auto& node = acquire();
+
+        if (!node.data) node.data.emplace();
+        static_cast<render_job_command_buffer_base&>(*node.data).command_buffer = std::move(command_buffer);
 
-        m_persistent_data = persistent_data.m_persistent_data_after_destruction;
+        return finish_create(node, persistent_data);
     }
 
-    void emplace(vk::UniqueCommandBuffer&& command_buffer, storage_type&& data, const any_persistent_render_data& persistent_data = no_persistent_render_data {}) {
-        static_cast<render_job_command_buffer_base*>(m_data.get())->command_buffer = std::move(command_buffer);
-        *static_cast<storage_type*>(m_data.get()) = std::move(data);
+    template<typename arg_storage_type, typename = std::enable_if_t<std::is_same_v<std::decay_t<arg_storage_type>, storage_type>>>
+    typed_render_job<storage_type> create(arg_storage_type&& data,
+                                          const any_persistent_render_data& persistent_data = no_persistent_render_data {}) {
+        auto& node = acquire();
+        node.data.emplace(std::forward<arg_storage_type>(data));
 
-        m_persistent_data = persistent_data.m_persistent_data_after_destruction;
+        return finish_create(node, persistent_data);
     }
 
-    storage_type& data() {
-        return const_cast<storage_type&>(const_cast<const typed_render_job*>(this)->data());
+    typed_render_job<storage_type> create(const vk::Device& device, const vk::CommandBufferAllocateInfo& command_buffer_alloc_info,
+                                          const any_persistent_render_data& persistent_data = no_persistent_render_data {}) {
+        return create(std::move(device.allocateCommandBuffersUnique(command_buffer_alloc_info)[0]), persistent_data);
     }
 
-    const storage_type& data() const {
-        return *static_cast<storage_type*>(m_data.get());
-    }
+private:
+    struct state;
 
-    storage_type* operator->() { return &data(); }
-    const storage_type* operator->() const { return &data(); }
-};
+    struct node : render_job_node {
+        std::optional<storage_type> data;
+        node* next_free = nullptr;
+        state* owner = nullptr;
+    };
 
+    struct state {
+        explicit state(bool recycle_data) : recycle_data(recycle_data) {}
 
-template<typename storage_type, std::size_t typical_workload>
-class render_job_pool {
-public:
-    typed_render_job<storage_type> create(vk::UniqueCommandBuffer&& command_buffer,
-                                          const any_persistent_render_data& persistent_data = no_persistent_render_data {}) {
-        auto job = [&]() {
-            for (auto& job : m_jobs) {
-                if (job.use_count() == 1) {
-                    job.emplace(std::move(command_buffer), std::move(job.data()), persistent_data);
-                    return job;
-                }
+        std::mutex mutex;
+        node* free_list = nullptr;
+        std::vector<std::unique_ptr<node[]>> chunks;
+        std::size_t capacity = 0;
+
+        // One reference for the arena itself plus one per outstanding job.
+        std::atomic<std::size_t> ref_count { 1 };
+        const bool recycle_data;
+
+        void grow(std::size_t count) {
+            auto& chunk = chunks.emplace_back(std::make_unique<node[]>(count));
+
+            for (std::size_t i = 0; i < count; ++i) {
+                chunk[i].owner = this;
+                chunk[i].release = &release_node;
+                chunk[i].next_free = free_list;
+                free_list = &chunk[i];
             }
 
-            return m_jobs.emplace_back(std::move(command_buffer), persistent_data);
-        }();
+            capacity += count;
+        }
 
-        // Cleanup excess jobs > typical_workload
-        if (m_jobs.size() > typical_workload) {
-            m_jobs.erase(
-                std::remove_if(m_jobs.begin() + typical_workload, m_jobs.end(), [](const auto& job) {
-                return job.use_count() == 1;
-            }),
-                m_jobs.end());
+        void release_ref() {
+            if (ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete this;
+            }
+        }
+    };
 
-            m_jobs.shrink_to_fit();
+    node& acquire() {
+        m_state->ref_count.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+
+        if (!m_state->free_list) {
+            m_state->grow(std::max<std::size_t>(m_state->capacity, 8));
         }
 
-        return job;
+        auto& node = *m_state->free_list;
+        m_state->free_list = node.next_free;
+        node.next_free = nullptr;
+
+        return node;
     }
 
-    typed_render_job<storage_type> create(const vk::Device& device, const vk::CommandBufferAllocateInfo& command_buffer_alloc_info,
-                                          const any_persistent_render_data& persistent_data = no_persistent_render_data {}) {
-        return create(std::move(device.allocateCommandBuffersUnique(command_buffer_alloc_info)[0]), persistent_data);
+    typed_render_job<storage_type> finish_create(node& node, const any_persistent_render_data& persistent_data) {
+        node.command_buffer = static_cast<render_job_command_buffer_base&>(*node.data).command_buffer.get();
+        node.persistent_data = persistent_data.m_persistent_data_after_destruction;
+
+        return typed_render_job<storage_type> { &node };
     }
 
-private:
-    boost::container::small_vector<typed_render_job<storage_type>, typical_workload> m_jobs;
+    static void release_node(render_job_node* released_node) {
+        auto& node = static_cast<struct node&>(*released_node);
+        auto& owner = *node.owner;
+
+        // The command buffer goes first as it may belong to a pool held by the persistent data.
+        if (owner.recycle_data) {
+            static_cast<render_job_command_buffer_base&>(*node.data).command_buffer.reset();
+        }
+        else {
+            node.data.reset();
+        }
+
+        node.command_buffer = nullptr;
+        node.persistent_data.reset();
+
+        {
+            std::lock_guard<std::mutex> lock(owner.mutex);
+            node.next_free = owner.free_list;
+            owner.free_list = &node;
+        }
+
+        owner.release_ref();
+    }
+
+    state* m_state;
 };
 
+
+// Recycling arena for jobs that are recreated every frame, sized for the typical number of jobs in flight.
+template<typename storage_type, std::size_t typical_workload>
+class render_job_pool : public render_job_arena<storage_type> {
+public:
+    render_job_pool() : render_job_arena<storage_type>(typical_workload, true) {}
+};
+
+
+inline render_job::render_job(vk::UniqueCommandBuffer&& command_buffer, const any_persistent_render_data& persistent_data)
+    : render_job(render_job_arena<render_job_command_buffer_base>::shared().create(std::move(command_buffer), persistent_data)) {
+}
+
+template<typename storage_type, typename>
+render_job::render_job(storage_type&& data, const any_persistent_render_data& persistent_data)
+    : render_job(render_job_arena<std::decay_t<storage_type>>::shared().create(std::forward<storage_type>(data), persistent_data)) {
+}
+
+template<typename storage_type, typename>
+render_job::render_job(vk::UniqueCommandBuffer&& command_buffer, storage_type&& data, const any_persistent_render_data& persistent_data)
+    : render_job(render_job_arena<internal_render_job::without_render_job_command_buffer_base<std::decay_t<storage_type>>>::shared().create(
+        internal_render_job::without_render_job_command_buffer_base<std::decay_t<storage_type>>(std::move(command_buffer), std::forward<storage_type>(data)),
+        persistent_data)) {
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -6,12 +6,13 @@
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <chrono>
 
 namespace squadbox::gfx {
 
 render_manager::render_manager(const vulkan_manager& vulkan_manager)
-    : m_vulkan_manager(&vulkan_manager) {
+    : m_vulkan_manager(&vulkan_manager), m_draw_packet_recorder(&vulkan_manager.dispatch_loader()) {
     m_depth_stencil_format = [](const vk::PhysicalDevice& physical_device) {
         std::array<vk::Format, 1> depth_stencil_formats = {
             //vk::Format::eD32SfloatS8Uint,
@@ -47,7 +48,7 @@ render_manager::render_manager(const vulkan_manager& vulkan_manager)
             .setFormat(depth_stencil_format)
             .setSamples(vk::SampleCountFlagBits::e1)
             .setLoadOp(vk::AttachmentLoadOp::eClear)
-            .setStoreOp(vk::AttachmentStoreOp::eDontCare)
+            .setStoreOp(vk::AttachmentStoreOp::eStore)     // read back into the depth pyramid
             .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
             .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
             .setInitialLayout(vk::ImageLayout::eUndefined)
@@ -87,16 +88,29 @@ render_manager::render_manager(const vulkan_manager& vulkan_manager)
         return device.createCommandPoolUnique(command_pool_ci);
     }(m_vulkan_manager->device(), m_vulkan_manager->graphics_queue_family_index());
 
-    m_render_threads = [](const vk::Device& device, const std::uint32_t graphics_queue_family_index) {
-        std::vector<render_thread> render_threads;
+    for (std::uint32_t i = 0; i < max_frames_in_flight; ++i) {
+        m_descriptor_allocators.emplace_back(m_vulkan_manager->device());
+    }
+
+    m_gpu_memory_pool = std::make_unique<gpu_memory_pool>(m_vulkan_manager->device(), m_vulkan_manager->physical_device());
+
+    if (m_vulkan_manager->supports_descriptor_indexing()) {
+        m_bindless_heap = std::make_unique<bindless_heap>(*m_vulkan_manager);
+    }
+
+    m_uniform_ring = std::make_unique<uniform_ring>(*m_vulkan_manager, max_frames_in_flight, m_bindless_heap.get());
+    m_pipeline_manager = std::make_unique<pipeline_manager>(*m_vulkan_manager);
+
+    m_render_threads = [this]() {
+        std::vector<std::unique_ptr<render_thread>> render_threads;
         render_threads.reserve(std::thread::hardware_concurrency());
-        
+
         for (unsigned int i = 0; i < std::thread::hardware_concurrency(); ++i) {
-            render_threads.emplace_back(device, graphics_queue_family_index);
+            render_threads.emplace_back(new render_thread(*this));
         }
-        
+
         return render_threads;
-    }(m_vulkan_manager->device(), m_vulkan_manager->graphics_queue_family_index());
+    }();
 
     int width, height;
     glfwGetFramebufferSize(m_vulkan_manager->window(), &width, &height);
@@ -238,7 +252,7 @@ void render_manager::resize_framebuffer(const std::uint32_t width, const std::ui
             .setArrayLayers(1)
             .setSamples(vk::SampleCountFlagBits::e1)
             .setTiling(vk::ImageTiling::eOptimal)
-            .setUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment);
+            .setUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled);
 
         auto depth_stencil_buffer_image = device.createImageUnique(depth_stencil_buffer_image_ci);
         auto depth_stencil_buffer_memory = vk_utils::alloc_memory(device, physical_device.getMemoryProperties(),
@@ -291,6 +305,10 @@ void render_manager::resize_framebuffer(const std::uint32_t width, const std::ui
     }(m_vulkan_manager->device(), m_render_pass.get(), new_swapchain_images,
       std::get<vk::UniqueImageView>(new_depth_stencil).get(), width, height);
 
+    // References the old depth view, so it goes first.
+    const bool has_depth_pyramid = m_depth_pyramid != nullptr;
+    m_depth_pyramid.reset();
+
     m_depth_stencil = std::move(new_depth_stencil);
     m_framebuffers = std::move(new_framebuffers);
     m_swapchain_images = std::move(new_swapchain_images);
@@ -298,6 +316,15 @@ void render_manager::resize_framebuffer(const std::uint32_t width, const std::ui
 
     m_framebuffer_width = width;
     m_framebuffer_height = height;
+
+    if (has_depth_pyramid) enable_depth_pyramid();
+}
+
+void render_manager::enable_depth_pyramid() {
+    if (m_depth_pyramid) return;
+
+    m_depth_pyramid = std::make_unique<depth_pyramid>(*m_vulkan_manager, std::get<vk::UniqueImageView>(m_depth_stencil).get(),
+                                                      m_framebuffer_width, m_framebuffer_height);
 }
 
 
@@ -311,7 +338,20 @@ void render_manager::begin_frame() {
     }
 
     device.resetFences({ current_frame.fence.get() });
+    m_completed_frame_serial = std::max(m_completed_frame_serial, current_frame.serial);
+    current_frame.serial = m_frame_serial;
+    m_pipeline_manager->begin_frame(m_frame_serial, m_completed_frame_serial);
+
+    m_uniform_ring->reset(m_current_frame_idx);
+    m_descriptor_allocators[m_current_frame_idx].reset();
+    for (auto& render_thread : m_render_threads) {
+        render_thread->m_descriptor_allocators[m_current_frame_idx].reset();
+    }
+
     current_frame.render_jobs.clear();
+    current_frame.draw_packets.clear();
+    current_frame.compute_passes.clear();
+    current_frame.draw_packet_command_buffer.reset();
 
     current_frame.primary_command_buffer = gfx::vk_utils::create_primary_command_buffer(device, m_primary_command_pool.get());
 
@@ -322,6 +362,48 @@ void render_manager::begin_frame() {
     current_frame.framebuffer = get_framebuffer(current_frame.framebuffer_idx);
 
     current_frame.primary_command_buffer->begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+}
+
+void render_manager::end_frame() {
+    auto& current_frame = m_frames[m_current_frame_idx];
+
+    for (auto& render_thread_ptr : m_render_threads) {
+        auto& render_thread = *render_thread_ptr;
+        render_thread.finish_jobs();
+        current_frame.render_jobs.insert(current_frame.render_jobs.end(),
+                                         std::make_move_iterator(render_thread.m_render_jobs.begin()),
+                                         std::make_move_iterator(render_thread.m_render_jobs.end()));
+        render_thread.m_render_jobs.clear();
+
+        current_frame.draw_packets.insert(current_frame.draw_packets.end(),
+                                          std::make_move_iterator(render_thread.m_draw_packets.begin()),
+                                          std::make_move_iterator(render_thread.m_draw_packets.end()));
+        render_thread.m_draw_packets.clear();
+
+        current_frame.compute_passes.insert(current_frame.compute_passes.end(),
+                                            std::make_move_iterator(render_thread.m_compute_passes.begin()),
+                                            std::make_move_iterator(render_thread.m_compute_passes.end()));
+        render_thread.m_compute_passes.clear();
+    }
+
+    current_frame.draw_packets.insert(current_frame.draw_packets.end(),
+                                      std::make_move_iterator(m_draw_packets.begin()),
+                                      std::make_move_iterator(m_draw_packets.end()));
+    m_draw_packets.clear();
+
+    current_frame.compute_passes.insert(current_frame.compute_passes.end(),
+                                        std::make_move_iterator(m_compute_passes.begin()),
+                                        std::make_move_iterator(m_compute_passes.end()));
+    m_compute_passes.clear();
+
+    if (m_depth_pyramid) {
+        m_depth_pyramid->record_prepare(current_frame.primary_command_buffer.get());
+    }
+
+    // Compute work can't be recorded inside a render pass, so the pass only begins once it's all in.
+    for (const auto& compute_pass : current_frame.compute_passes) {
+        compute_pass(current_frame.primary_command_buffer.get());
+    }
 
     std::array<vk::ClearValue, 2> clear_values;
     clear_values[0].color = m_clear_color;
@@ -339,29 +421,53 @@ void render_manager::begin_frame() {
 
     current_frame.primary_command_buffer->beginRenderPass(render_pass_begin_info, vk::SubpassContents::eSecondaryCommandBuffers);
 
-    vk::CommandBufferInheritanceInfo command_buffer_inheritance_info;
-    command_buffer_inheritance_info
-        .setRenderPass(render_pass())
-        .setSubpass(0)
-        .setFramebuffer(current_frame.framebuffer);
-}
+    if (!current_frame.draw_packets.empty()) {
+        m_draw_packet_recorder.sort(current_frame.draw_packets);
 
-void render_manager::end_frame() {
-    auto& current_frame = m_frames[m_current_frame_idx];
+        current_frame.draw_packet_command_buffer = [](const vk::Device& device, const vk::CommandPool& command_pool) {
+            vk::CommandBufferAllocateInfo command_buffer_alloc_info;
+            command_buffer_alloc_info
+                .setCommandPool(command_pool)
+                .setLevel(vk::CommandBufferLevel::eSecondary)
+                .setCommandBufferCount(1);
 
-    for (auto& render_thread : m_render_threads) {
-        render_thread.finish_jobs();
-        current_frame.render_jobs.insert(current_frame.render_jobs.end(),
-                                         std::make_move_iterator(render_thread.m_render_jobs.begin()),
-                                         std::make_move_iterator(render_thread.m_render_jobs.end()));
-        render_thread.m_render_jobs.clear();
+            return std::move(device.allocateCommandBuffersUnique(command_buffer_alloc_info)[0]);
+        }(m_vulkan_manager->device(), m_primary_command_pool.get());
+
+        vk::CommandBufferInheritanceInfo command_buffer_inheritance_info;
+        command_buffer_inheritance_info
+            .setRenderPass(render_pass())
+            .setSubpass(0)
+            .setFramebuffer(current_frame.framebuffer);
+
+        vk::CommandBufferBeginInfo command_buffer_begin_info;
+        command_buffer_begin_info
+            .setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+            .setPInheritanceInfo(&command_buffer_inheritance_info);
+
+        const auto& command_buffer = current_frame.draw_packet_command_buffer.get();
+        command_buffer.begin(command_buffer_begin_info);
+        m_last_draw_packet_stats = m_draw_packet_recorder.record(command_buffer, current_frame.draw_packets);
+        command_buffer.end();
+
+        current_frame.primary_command_buffer->executeCommands({ command_buffer });
+    }
+    else {
+        m_last_draw_packet_stats = {};
     }
 
+    // Render jobs are recorded as-is after all draw packets, which keeps overlays such as imgui on top.
     for (const auto& render_job : current_frame.render_jobs) {
         current_frame.primary_command_buffer->executeCommands({ render_job.command_buffer() });
     }
 
     current_frame.primary_command_buffer->endRenderPass();
+
+    // Next frame's occlusion culling tests against this frame's depth.
+    if (m_depth_pyramid) {
+        m_depth_pyramid->record_build(current_frame.primary_command_buffer.get(), std::get<vk::UniqueImage>(m_depth_stencil).get());
+    }
+
     current_frame.primary_command_buffer->end();
 
     auto graphics_queue = m_vulkan_manager->device().getQueue(m_vulkan_manager->graphics_queue_family_index(), 0);
@@ -386,7 +492,41 @@ void render_manager::end_frame() {
 
     graphics_queue.presentKHR(present_info);
 
-    m_current_frame_idx = (m_current_frame_idx + 1) % num_frames();
+    m_current_frame_idx = (m_current_frame_idx + 1) % max_frames_in_flight;
+    ++m_frame_serial;
+}
+
+bool render_manager::is_frame_complete(std::uint64_t serial) const {
+    if (serial <= m_completed_frame_serial) return true;
+    if (serial >= m_frame_serial) return false;
+
+    const auto& device = m_vulkan_manager->device();
+
+    for (const auto& frame : m_frames) {
+        if (frame.serial == serial) {
+            if (device.getFenceStatus(frame.fence.get()) != vk::Result::eSuccess) return false;
+
+            m_completed_frame_serial = serial;
+            return true;
+        }
+    }
+
+    return true;
+}
+
+void render_manager::wait_frame(std::uint64_t serial) const {
+    if (is_frame_complete(serial)) return;
+
+    for (const auto& frame : m_frames) {
+        if (frame.serial == serial) {
+            while (m_vulkan_manager->device().waitForFences({ frame.fence.get() }, true,
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::milliseconds(1)).count()) != vk::Result::eSuccess) {
+            }
+
+            m_completed_frame_serial = std::max(m_completed_frame_serial, serial);
+            return;
+        }
+    }
 }
 
 void render_manager::render_immediately(const render_job& render_job) {
@@ -402,19 +542,66 @@ void render_manager::render_immediately(const render_job& render_job) {
     m_vulkan_manager->device().waitIdle();
 }
 
+vk::DescriptorSet render_manager::allocate_descriptor_set(const vk::DescriptorSetLayout& layout) {
+    return m_descriptor_allocators[m_current_frame_idx].allocate(layout);
+}
+
+void render_manager::add_draw_packet(const draw_packet& draw_packet) {
+    m_draw_packets.push_back(draw_packet);
+}
+
+void render_manager::add_draw_packet(draw_packet&& draw_packet) {
+    m_draw_packets.push_back(std::move(draw_packet));
+}
+
+void render_manager::add_compute_pass(compute_pass compute_pass) {
+    m_compute_passes.push_back(std::move(compute_pass));
+}
+
+void render_manager::render(std::function<void(render_thread&)> job) {
+    m_render_threads[m_next_render_thread]->add_job(std::move(job));
+    m_next_render_thread = (m_next_render_thread + 1) % m_render_threads.size();
+}
+
 render_thread::render_thread(const render_manager& render_manager)
     : m_render_manager(&render_manager), m_job_queue(1) {
+    const auto& vulkan_manager = *render_manager.m_vulkan_manager;
+
+    m_command_pool = [](const vk::Device& device, std::uint32_t graphics_queue_family_index) {
+        vk::CommandPoolCreateInfo command_pool_ci;
+        command_pool_ci
+            .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+            .setQueueFamilyIndex(graphics_queue_family_index);
+        return device.createCommandPoolUnique(command_pool_ci);
+    }(vulkan_manager.device(), vulkan_manager.graphics_queue_family_index());
+
+    for (std::uint32_t i = 0; i < render_manager::max_frames_in_flight; ++i) {
+        m_descriptor_allocators.emplace_back(vulkan_manager.device());
+    }
+
     m_thread = std::thread([this] {
         std::function<void(render_thread&)> job;
 
-        while (true) {
-            while (m_job_queue.wait_pull_front(job) == boost::concurrent::queue_op_status::success) {
-                job(*this);
-            }
+        while (m_job_queue.wait_pull_front(job) == boost::concurrent::queue_op_status::success) {
+            const auto job_done = gsl::finally([this] {
+                {
+                    std::lock_guard<std::mutex> lock(m_jobs_mutex);
+                    --m_jobs_pending;
+                }
+
+                m_jobs_done.notify_all();
+            });
+
+            job(*this);
         }
     });
 }
 
+render_thread::~render_thread() {
+    m_job_queue.close();
+    if (m_thread.joinable()) m_thread.join();
+}
+
 void render_thread::add_render_job(const render_job& render_job) {
     m_render_jobs.push_back(render_job);
 }
@@ -423,20 +610,34 @@ void render_thread::add_render_job(render_job&& render_job) {
     m_render_jobs.push_back(std::move(render_job));
 }
 
-void render_thread::finish_jobs() {
-    
+void render_thread::add_draw_packet(const draw_packet& draw_packet) {
+    m_draw_packets.push_back(draw_packet);
 }
 
-vk::UniqueDescriptorSet render_thread::allocate_descriptor_set(const vk::DescriptorSetLayout& layout) const {
-    auto descriptor_pool = m_render_manager->m_descriptor_pool.synchronize();
+void render_thread::add_draw_packet(draw_packet&& draw_packet) {
+    m_draw_packets.push_back(std::move(draw_packet));
+}
 
-    vk::DescriptorSetAllocateInfo descriptor_set_alloc_info;
-    descriptor_set_alloc_info
-        .setDescriptorPool(descriptor_pool->get())
-        .setPSetLayouts(&layout)
-        .setDescriptorSetCount(1);
+void render_thread::add_compute_pass(compute_pass compute_pass) {
+    m_compute_passes.push_back(std::move(compute_pass));
+}
 
-    return std::move(m_render_manager->m_vulkan_manager->device().allocateDescriptorSetsUnique(descriptor_set_alloc_info)[0]);
+void render_thread::add_job(std::function<void(render_thread&)> job) {
+    {
+        std::lock_guard<std::mutex> lock(m_jobs_mutex);
+        ++m_jobs_pending;
+    }
+
+    m_job_queue.push_back(std::move(job));
+}
+
+void render_thread::finish_jobs() {
+    std::unique_lock<std::mutex> lock(m_jobs_mutex);
+    m_jobs_done.wait(lock, [this] { return m_jobs_pending == 0; });
+}
+
+vk::DescriptorSet render_thread::allocate_descriptor_set(const vk::DescriptorSetLayout& layout) {
+    return m_descriptor_allocators[frame_index()].allocate(layout);
 }
 
 vk::UniqueCommandBuffer render_thread::allocate_command_buffer() const {
@@ -449,6 +650,10 @@ vk::UniqueCommandBuffer render_thread::allocate_command_buffer() const {
     return std::move(m_render_manager->m_vulkan_manager->device().allocateCommandBuffersUnique(command_buffer_alloc_info)[0]);
 }
 
+std::uint32_t render_thread::frame_index() const {
+    return m_render_manager->current_frame_index();
+}
+
 const vk::CommandBufferInheritanceInfo& render_thread::command_buffer_inheritance_info() const {
     /*auto& current_frame = m_render_manager->m_frames[m_render_manager->m_current_frame_idx];
 
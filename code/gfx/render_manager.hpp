@@ -1,11 +1,21 @@
 #ifndef SQUADBOX_GFX_RENDER_MANAGER_HPP
 #define SQUADBOX_GFX_RENDER_MANAGER_HPP
 
+#include "bindless_heap.hpp"
+#include "depth_pyramid.hpp"
+#include "descriptor_allocator.hpp"
+#include "draw_packet.hpp"
+#include "gpu_memory_pool.hpp"
+#include "pipeline_manager.hpp"
+#include "uniform_ring.hpp"
+
 #include <vulkan/vulkan.hpp>
 #include <gsl/gsl>
-#include <boost/thread/synchronized_value.hpp>
 #include <boost/thread/sync_bounded_queue.hpp>
+#include <condition_variable>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <thread>
 
 struct GLFWwindow;
@@ -16,38 +26,62 @@ class vulkan_manager;
 class render_job;
 class render_manager;
 
+// Records work into the frame's primary command buffer ahead of the render pass, e.g. compute
+// dispatches producing indirect draw arguments. The recorder and whatever it captures are kept
+// until the frame retires.
+using compute_pass = std::function<void(const vk::CommandBuffer& command_buffer)>;
+
 class render_thread {
 public:
     friend class render_manager;
 
-    vk::UniqueDescriptorSet allocate_descriptor_set(const vk::DescriptorSetLayout& layout) const;
+    ~render_thread();
+
+    // The set is only valid for the frame being recorded and is recycled once that frame retires.
+    vk::DescriptorSet allocate_descriptor_set(const vk::DescriptorSetLayout& layout);
     vk::UniqueCommandBuffer allocate_command_buffer() const;
 
     void add_render_job(const render_job& render_job);
     void add_render_job(render_job&& render_job);
 
+    void add_draw_packet(const draw_packet& draw_packet);
+    void add_draw_packet(draw_packet&& draw_packet);
+
+    void add_compute_pass(compute_pass compute_pass);
+
     const vk::CommandBufferInheritanceInfo& command_buffer_inheritance_info() const;
 
+    std::uint32_t frame_index() const;
+
 private:
     render_thread(const render_manager& render_manager);
 
     void add_job(std::function<void(render_thread&)> job);
+    // Waits until every job added has run.
     void finish_jobs();
 
     gsl::not_null<const render_manager*> m_render_manager;
 
     vk::UniqueCommandPool m_command_pool;
+    std::vector<descriptor_allocator> m_descriptor_allocators;
     vk::CommandBufferInheritanceInfo m_command_buffer_inheritance_info;
 
     std::thread m_thread;
     boost::sync_bounded_queue<std::function<void(render_thread&)>> m_job_queue;
+    std::mutex m_jobs_mutex;
+    std::condition_variable m_jobs_done;
+    std::size_t m_jobs_pending = 0;
     std::vector<squadbox::gfx::render_job> m_render_jobs;
+    std::vector<squadbox::gfx::draw_packet> m_draw_packets;
+    std::vector<squadbox::gfx::compute_pass> m_compute_passes;
 };
 
 class render_manager {
 public:
     friend class render_thread;
 
+    static constexpr std::uint32_t max_frames_in_flight = 3;
+
     render_manager(const vulkan_manager& vulkan_manager);
     render_manager(render_manager&&) = default;
     ~render_manager();
@@ -58,26 +92,57 @@ public:
     void begin_frame();
     void end_frame();
 
-    template<typename func_type>
-    void render(func_type&& func) {
-        boost::async(m_thread_pool, [this](auto&& func) {
-
-        }, std::forward<func_type>(func))
-    }
+    // Runs the job on one of the render threads, recording into the frame begun. Call between begin_frame() and
+    // end_frame(), which waits for it.
+    void render(std::function<void(render_thread&)> job);
 
     void render_immediately(const render_job& render_job);
 
+    // Same as render_thread::allocate_descriptor_set, for draws recorded on the thread driving the frame.
+    vk::DescriptorSet allocate_descriptor_set(const vk::DescriptorSetLayout& layout);
+
+    void add_draw_packet(const draw_packet& draw_packet);
+    void add_draw_packet(draw_packet&& draw_packet);
+
+    void add_compute_pass(compute_pass compute_pass);
+
+    const draw_packet_stats& last_draw_packet_stats() const { return m_last_draw_packet_stats; }
+
+    // Null if the device doesn't support descriptor indexing.
+    bindless_heap* get_bindless_heap() const { return m_bindless_heap.get(); }
+
+    // Builds a Hi-Z pyramid from the depth buffer at the end of every frame, for the next frame's occlusion culling.
+    void enable_depth_pyramid();
+
+    // Null unless enabled.
+    const depth_pyramid* get_depth_pyramid() const { return m_depth_pyramid.get(); }
+
+    // Device local memory for long lived resources, e.g. meshes uploaded with a mesh_uploader.
+    gpu_memory_pool& get_gpu_memory_pool() const { return *m_gpu_memory_pool; }
+
+    // Per-frame constants; allocate with current_frame_index() / render_thread::frame_index().
+    uniform_ring& get_uniform_ring() const { return *m_uniform_ring; }
+
+    // Techniques compile their pipelines here rather than in their constructors, and draw once they're ready.
+    pipeline_manager& get_pipeline_manager() const { return *m_pipeline_manager; }
+
     const vk::RenderPass& render_pass() const { return m_render_pass.get(); }
     const vk::SwapchainKHR& swapchain() const { return m_swapchain.get(); }
 
     vk::Framebuffer get_framebuffer(std::uint32_t idx) const { return m_framebuffers[idx].get(); }
     std::uint32_t num_frames() const { return static_cast<std::uint32_t>(m_framebuffers.size()); }
+    std::uint32_t current_frame_index() const { return m_current_frame_idx; }
+
+    // Serial of the frame currently being recorded. Anything a render job or draw packet references
+    // can be released once is_frame_complete() returns true for the serial it was submitted with.
+    std::uint64_t frame_serial() const { return m_frame_serial; }
+    std::uint64_t completed_frame_serial() const { return m_completed_frame_serial; }
+    bool is_frame_complete(std::uint64_t serial) const;
+    void wait_frame(std::uint64_t serial) const;
     std::uint32_t framebuffer_width() const { return m_framebuffer_width; }
     std::uint32_t framebuffer_height() const { return m_framebuffer_height; }
 
 private:
-    vk::UniqueDescriptorSet allocate_descriptor_set(const vk::DescriptorSetLayout& layout) const;
-
     struct frame_data {
         std::uint32_t framebuffer_idx;
         vk::Framebuffer framebuffer;
@@ -85,6 +150,10 @@ private:
         vk::UniqueFence fence;
         vk::UniqueSemaphore framebuffer_image_acquire_semaphore;
         std::vector<squadbox::gfx::render_job> render_jobs;
+        std::vector<squadbox::gfx::draw_packet> draw_packets;
+        std::vector<squadbox::gfx::compute_pass> compute_passes;
+        vk::UniqueCommandBuffer draw_packet_command_buffer;
+        std::uint64_t serial = 0;
     };
 
     gsl::not_null<const vulkan_manager*> m_vulkan_manager;
@@ -98,13 +167,28 @@ private:
     std::uint32_t m_framebuffer_height;
     vk::Format m_depth_stencil_format;
 
-    std::array<frame_data, 3> m_frames;
+    // Outlive the frames, whose draw packets may reference them.
+    std::unique_ptr<gpu_memory_pool> m_gpu_memory_pool;
+    std::unique_ptr<bindless_heap> m_bindless_heap;
+    std::unique_ptr<uniform_ring> m_uniform_ring;
+    std::unique_ptr<gfx::depth_pyramid> m_depth_pyramid;
+    std::unique_ptr<pipeline_manager> m_pipeline_manager;
+
+    std::array<frame_data, max_frames_in_flight> m_frames;
     std::uint32_t m_current_frame_idx = 0;
+    std::uint64_t m_frame_serial = 1;
+    mutable std::uint64_t m_completed_frame_serial = 0;
     vk::ClearColorValue m_clear_color;
 
+    std::vector<squadbox::gfx::draw_packet> m_draw_packets;
+    std::vector<squadbox::gfx::compute_pass> m_compute_passes;
+    draw_packet_recorder m_draw_packet_recorder;
+    draw_packet_stats m_last_draw_packet_stats;
+
     vk::UniqueCommandPool m_primary_command_pool;
-    boost::synchronized_value<vk::UniqueDescriptorPool> m_descriptor_pool;
-    std::vector<render_thread> m_render_threads;
+    std::vector<descriptor_allocator> m_descriptor_allocators;
+    std::vector<std::unique_ptr<render_thread>> m_render_threads;
+    std::size_t m_next_render_thread = 0;
 };
 
 }
@@ -0,0 +1,251 @@
+#include "depth_prepass.hpp"
+
+#include "../vulkan_manager.hpp"
+#include "../render_manager.hpp"
+
+#include <array>
+
+namespace squadbox::gfx::render_techniques {
+
+depth_prepass::depth_prepass(const vulkan_manager& vulkan_manager, const render_manager& render_manager,
+                             const vk::VertexInputBindingDescription& position_binding_desc, const vk::VertexInputAttributeDescription& position_attr_desc,
+                             const options& options)
+    : m_vulkan_manager(&vulkan_manager), m_render_manager(&render_manager), m_options(options) {
+    const auto& device = m_vulkan_manager->device();
+    const auto& render_pass = m_render_manager->render_pass();
+
+    static const std::uint32_t vert_shader_spv[] = {
+        #include "../../shaders/compiled/depth_prepass.vert.spv.c"
+    };
+
+    static const std::uint32_t instanced_vert_shader_spv[] = {
+        #include "../../shaders/compiled/depth_prepass_instanced.vert.spv.c"
+    };
+
+    m_persistent_render_data->vert_shader = [](const vk::Device& device) {
+        vk::ShaderModuleCreateInfo vert_shader_ci;
+        vert_shader_ci
+            .setPCode(vert_shader_spv)
+            .setCodeSize(sizeof(vert_shader_spv));
+
+        return device.createShaderModuleUnique(vert_shader_ci);
+    }(device);
+
+    m_persistent_render_data->instanced_vert_shader = [](const vk::Device& device) {
+        vk::ShaderModuleCreateInfo vert_shader_ci;
+        vert_shader_ci
+            .setPCode(instanced_vert_shader_spv)
+            .setCodeSize(sizeof(instanced_vert_shader_spv));
+
+        return device.createShaderModuleUnique(vert_shader_ci);
+    }(device);
+
+    m_persistent_render_data->pipeline_layout = [](const vk::Device& device) {
+        vk::PushConstantRange push_constant_range;
+        push_constant_range
+            .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+            .setOffset(0)
+            .setSize(sizeof(push_constants_t));
+
+        vk::PipelineLayoutCreateInfo pipeline_layout_ci;
+        pipeline_layout_ci
+            .setPPushConstantRanges(&push_constant_range)
+            .setPushConstantRangeCount(1);
+
+        return device.createPipelineLayoutUnique(pipeline_layout_ci);
+    }(device);
+
+    const auto topology = m_options.triangle_strips ? vk::PrimitiveTopology::eTriangleStrip : vk::PrimitiveTopology::eTriangleList;
+
+    // Vertex stage only: nothing is shaded, and the color attachment is left alone.
+    auto create_graphics_pipeline = [topology](const vk::Device& device, const vk::PipelineCache& pipeline_cache,
+                                               const vk::RenderPass& render_pass, const vk::PipelineLayout& pipeline_layout,
+                                               const vk::ShaderModule& vertex_shader_module,
+                                               const vk::PipelineVertexInputStateCreateInfo& pipeline_vert_input_state_ci) {
+        vk::GraphicsPipelineCreateInfo graphics_pipeline_ci;
+        std::vector<vk::DynamicState> enabled_dynamic_states;
+
+        vk::PipelineShaderStageCreateInfo stage;
+        stage
+            .setStage(vk::ShaderStageFlagBits::eVertex)
+            .setModule(vertex_shader_module)
+            .setPName("main");
+
+        graphics_pipeline_ci
+            .setPStages(&stage)
+            .setStageCount(1);
+
+        graphics_pipeline_ci.setPVertexInputState(&pipeline_vert_input_state_ci);
+
+        vk::PipelineInputAssemblyStateCreateInfo pipeline_input_assembly_state_ci;
+        pipeline_input_assembly_state_ci
+            .setTopology(topology)
+            .setPrimitiveRestartEnable(topology == vk::PrimitiveTopology::eTriangleStrip);
+        graphics_pipeline_ci.setPInputAssemblyState(&pipeline_input_assembly_state_ci);
+
+        vk::PipelineRasterizationStateCreateInfo pipeline_raster_state_ci;
+        pipeline_raster_state_ci
+            .setPolygonMode(vk::PolygonMode::eFill)
+            .setCullMode(vk::CullModeFlagBits::eNone)
+            .setFrontFace(vk::FrontFace::eClockwise)
+            .setLineWidth(1.0f);
+        graphics_pipeline_ci.setPRasterizationState(&pipeline_raster_state_ci);
+
+        vk::PipelineColorBlendAttachmentState color_blend_attachment;
+        color_blend_attachment
+            .setBlendEnable(false)
+            .setColorWriteMask(vk::ColorComponentFlags());
+
+        vk::PipelineColorBlendStateCreateInfo pipeline_color_blend_state_ci;
+        pipeline_color_blend_state_ci
+            .setPAttachments(&color_blend_attachment)
+            .setAttachmentCount(1);
+        graphics_pipeline_ci.setPColorBlendState(&pipeline_color_blend_state_ci);
+
+        vk::PipelineViewportStateCreateInfo pipeline_viewport_state_ci;
+        pipeline_viewport_state_ci
+            .setViewportCount(1)
+            .setScissorCount(1);
+        graphics_pipeline_ci.setPViewportState(&pipeline_viewport_state_ci);
+
+        enabled_dynamic_states.emplace_back(vk::DynamicState::eViewport);
+        enabled_dynamic_states.emplace_back(vk::DynamicState::eScissor);
+
+        vk::PipelineDepthStencilStateCreateInfo pipeline_depth_stencil_state_ci;
+        pipeline_depth_stencil_state_ci
+            .setDepthTestEnable(true)
+            .setDepthWriteEnable(true)
+            .setDepthCompareOp(vk::CompareOp::eLess);
+        graphics_pipeline_ci.setPDepthStencilState(&pipeline_depth_stencil_state_ci);
+
+        vk::PipelineMultisampleStateCreateInfo pipeline_multisample_state_ci;
+        pipeline_multisample_state_ci
+            .setRasterizationSamples(vk::SampleCountFlagBits::e1);
+        graphics_pipeline_ci.setPMultisampleState(&pipeline_multisample_state_ci);
+
+        vk::PipelineDynamicStateCreateInfo pipeline_dynamic_state_ci;
+        pipeline_dynamic_state_ci
+            .setPDynamicStates(enabled_dynamic_states.data())
+            .setDynamicStateCount(enabled_dynamic_states.size());
+        graphics_pipeline_ci.setPDynamicState(&pipeline_dynamic_state_ci);
+
+        graphics_pipeline_ci
+            .setRenderPass(render_pass)
+            .setLayout(pipeline_layout);
+
+        return device.createGraphicsPipelineUnique(pipeline_cache, graphics_pipeline_ci);
+    };
+
+    // Compiled in the background; what the create functions use is copied in, as it runs after this returns, and the
+    // persistent data they refer to is shared with the compiles until they're done.
+    auto& pipeline_manager = m_render_manager->get_pipeline_manager();
+
+    m_persistent_render_data->graphics_pipeline = pipeline_manager.compile(
+            [create_graphics_pipeline, position_binding_desc, position_attr_desc, render_pass = render_pass,
+             pipeline_layout = m_persistent_render_data->pipeline_layout.get(), vertex_shader_module = m_persistent_render_data->vert_shader.get()](
+            const vk::Device& device, const vk::PipelineCache& pipeline_cache) {
+        vk::PipelineVertexInputStateCreateInfo pipeline_vert_input_state_ci;
+        pipeline_vert_input_state_ci
+            .setPVertexBindingDescriptions(&position_binding_desc)
+            .setVertexBindingDescriptionCount(1)
+            .setPVertexAttributeDescriptions(&position_attr_desc)
+            .setVertexAttributeDescriptionCount(1);
+
+        return create_graphics_pipeline(device, pipeline_cache, render_pass, pipeline_layout, vertex_shader_module, pipeline_vert_input_state_ci);
+    }, m_persistent_render_data.share());
+
+    m_persistent_render_data->instanced_graphics_pipeline = pipeline_manager.compile(
+            [create_graphics_pipeline, position_binding_desc, position_attr_desc, options = m_options, render_pass = render_pass,
+             pipeline_layout = m_persistent_render_data->pipeline_layout.get(), vertex_shader_module = m_persistent_render_data->instanced_vert_shader.get()](
+            const vk::Device& device, const vk::PipelineCache& pipeline_cache) {
+        std::array<vk::VertexInputBindingDescription, 2> vert_input_binding_desc = { position_binding_desc };
+        vert_input_binding_desc[1]
+            .setBinding(instance_binding_idx)
+            .setStride(options.instance_stride)
+            .setInputRate(vk::VertexInputRate::eInstance);
+
+        // mat4 model matrix takes up one location per column.
+        std::array<vk::VertexInputAttributeDescription, 1 + 4> vert_input_attr_desc = { position_attr_desc };
+        for (std::uint32_t column = 0; column < 4; ++column) {
+            vert_input_attr_desc[1 + column]
+                .setLocation(instance_model_matrix_location + column)
+                .setBinding(instance_binding_idx)
+                .setFormat(vk::Format::eR32G32B32A32Sfloat)
+                .setOffset(options.instance_model_matrix_offset + static_cast<std::uint32_t>(sizeof(glm::vec4)) * column);
+        }
+
+        vk::PipelineVertexInputStateCreateInfo pipeline_vert_input_state_ci;
+        pipeline_vert_input_state_ci
+            .setPVertexBindingDescriptions(vert_input_binding_desc.data())
+            .setVertexBindingDescriptionCount(vert_input_binding_desc.size())
+            .setPVertexAttributeDescriptions(vert_input_attr_desc.data())
+            .setVertexAttributeDescriptionCount(vert_input_attr_desc.size());
+
+        return create_graphics_pipeline(device, pipeline_cache, render_pass, pipeline_layout, vertex_shader_module, pipeline_vert_input_state_ci);
+    }, m_persistent_render_data.share());
+}
+
+void depth_prepass::render(render_thread& render_thread, const geometry& geometry, const std::shared_ptr<void>& resources,
+                           const vk::Viewport& viewport, const glm::mat4& model_view, const glm::mat4& projection) const {
+    if (!ready()) return;
+
+    push_constants_t push_constants;
+    push_constants.model_view = model_view;
+    push_constants.projection = projection;
+
+    draw_packet packet;
+    packet.sort_key = draw_sort_key::depth_major(draw_layer::depth_prepass, m_pipeline_id,
+                                                 draw_sort_key::material_id_from_handle((std::uint64_t)static_cast<VkBuffer>(geometry.index_buffer)),
+                                                 -model_view[3].z);
+    packet.pipeline = m_persistent_render_data->graphics_pipeline.get();
+    packet.pipeline_layout = m_persistent_render_data->pipeline_layout.get();
+    packet.set_push_constants(vk::ShaderStageFlagBits::eVertex, push_constants);
+    packet.vertex_buffers[0] = geometry.position_buffer;
+    packet.vertex_buffer_offsets[0] = geometry.position_buffer_offset;
+    packet.vertex_buffer_count = 1;
+    packet.index_buffer = geometry.index_buffer;
+    packet.index_buffer_offset = geometry.index_buffer_offset;
+    packet.index_type = geometry.index_type;
+    packet.first_index = geometry.first_index;
+    packet.index_count = geometry.index_count;
+    packet.viewport = viewport;
+    packet.resources = resources;
+
+    render_thread.add_draw_packet(std::move(packet));
+}
+
+void depth_prepass::render_instanced(render_thread& render_thread, const geometry& geometry, const std::shared_ptr<void>& resources,
+                                     const vk::Viewport& viewport, const glm::mat4& view, const glm::mat4& projection,
+                                     const vk::Buffer& instance_buffer, std::uint32_t first_instance, std::uint32_t instance_count) const {
+    if (!instanced_ready()) return;
+
+    push_constants_t push_constants;
+    push_constants.model_view = view;
+    push_constants.projection = projection;
+
+    draw_packet packet;
+    packet.sort_key = draw_sort_key::depth_major(draw_layer::depth_prepass, m_instanced_pipeline_id,
+                                                 draw_sort_key::material_id_from_handle((std::uint64_t)static_cast<VkBuffer>(geometry.index_buffer)),
+                                                 0.0f);
+    packet.pipeline = m_persistent_render_data->instanced_graphics_pipeline.get();
+    packet.pipeline_layout = m_persistent_render_data->pipeline_layout.get();
+    packet.set_push_constants(vk::ShaderStageFlagBits::eVertex, push_constants);
+    packet.vertex_buffers[0] = geometry.position_buffer;
+    packet.vertex_buffer_offsets[0] = geometry.position_buffer_offset;
+    packet.vertex_buffers[instance_binding_idx] = instance_buffer;
+    packet.vertex_buffer_offsets[instance_binding_idx] = 0;
+    packet.vertex_buffer_count = instance_binding_idx + 1;
+    packet.index_buffer = geometry.index_buffer;
+    packet.index_buffer_offset = geometry.index_buffer_offset;
+    packet.index_type = geometry.index_type;
+    packet.first_index = geometry.first_index;
+    packet.index_count = geometry.index_count;
+    packet.first_instance = first_instance;
+    packet.instance_count = instance_count;
+    packet.viewport = viewport;
+    packet.resources = resources;
+
+    render_thread.add_draw_packet(std::move(packet));
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#ifndef SQUADBOX_GFX_RENDER_TECHNIQUES_DEPTH_PREPASS_HPP
+#define SQUADBOX_GFX_RENDER_TECHNIQUES_DEPTH_PREPASS_HPP
+
+#pragma once
+
+#include "../draw_packet.hpp"
+#include "../mesh_lod.hpp"
+#include "../pipeline_manager.hpp"
+#include "../render_job.hpp"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+
+namespace squadbox::gfx {
+
+class vulkan_manager;
+class render_manager;
+class render_thread;
+
+}
+
+namespace squadbox::gfx::render_techniques {
+
+// Lays down the depth of opaque geometry before it's shaded, reading nothing but a mesh's depth position stream
+// (gpu_mesh::create with depth positions). Shading passes drawn after it with an equal depth test and no depth
+// writes then run their fragment shaders once per visible pixel, however much the scene overdraws.
+//
+// Its draws go in draw_layer::depth_prepass, front to back across pipelines (draw_sort_key::depth_major), instanced
+// batches first as they have no single depth. The shading pass has to draw the same index ranges with the same
+// matrices, and compute gl_Position the same way with it declared invariant, for the depths to match.
+//
+// Its pipelines compile in the background. Until ready() (instanced_ready() for render_instanced()), its draws are
+// dropped, and shading passes testing for equal depth have to hold theirs back as well.
+class depth_prepass {
+public:
+    struct options {
+        // Match the topology the meshes were uploaded with.
+        bool triangle_strips = false;
+        // Layout of the per instance vertex buffers render_instanced() reads model matrices from.
+        std::uint32_t instance_stride = sizeof(glm::mat4);
+        std::uint32_t instance_model_matrix_offset = 0;
+    };
+
+    // What a draw reads from its mesh.
+    struct geometry {
+        vk::Buffer position_buffer;
+        vk::DeviceSize position_buffer_offset = 0;
+        vk::Buffer index_buffer;
+        vk::DeviceSize index_buffer_offset = 0;
+        vk::IndexType index_type = vk::IndexType::eUint32;
+        std::uint32_t first_index = 0;
+        std::uint32_t index_count = 0;
+    };
+
+    template<typename mesh_type>
+    static geometry mesh_geometry(const mesh_type& mesh, const mesh_lod& lod) {
+        geometry result;
+        result.position_buffer = mesh.depth_vertex_buffer();
+        result.position_buffer_offset = mesh.depth_vertex_buffer_offset();
+        result.index_buffer = mesh.index_buffer();
+        result.index_buffer_offset = mesh.index_buffer_offset();
+        result.index_type = mesh.vulkan_index_type();
+        result.first_index = lod.first_index;
+        result.index_count = lod.index_count;
+
+        return result;
+    }
+
+    // The position stream's layout, from mesh_type::depth_vertex_input_binding_desc() and depth_vertex_input_attr_desc().
+    depth_prepass(const vulkan_manager& vulkan_manager, const render_manager& render_manager,
+                  const vk::VertexInputBindingDescription& position_binding_desc, const vk::VertexInputAttributeDescription& position_attr_desc,
+                  const options& options);
+
+    bool ready() const { return m_persistent_render_data->graphics_pipeline.ready(); }
+    bool instanced_ready() const { return m_persistent_render_data->instanced_graphics_pipeline.ready(); }
+
+    // resources is kept alive until the frame has retired, as with draw_packet::resources.
+    void render(render_thread& render_thread, const geometry& geometry, const std::shared_ptr<void>& resources,
+                const vk::Viewport& viewport, const glm::mat4& model_view, const glm::mat4& projection) const;
+
+    // Draws instance_count instances starting at first_instance of instance_buffer.
+    void render_instanced(render_thread& render_thread, const geometry& geometry, const std::shared_ptr<void>& resources,
+                          const vk::Viewport& viewport, const glm::mat4& view, const glm::mat4& projection,
+                          const vk::Buffer& instance_buffer, std::uint32_t first_instance, std::uint32_t instance_count) const;
+
+private:
+    struct persistent_data {
+        vk::UniqueShaderModule vert_shader;
+        vk::UniqueShaderModule instanced_vert_shader;
+        vk::UniquePipelineLayout pipeline_layout;
+        pipeline_handle graphics_pipeline;
+        pipeline_handle instanced_graphics_pipeline;
+    };
+
+    persistent_render_data<persistent_data> m_persistent_render_data;
+
+    /*
+    shaders/depth_prepass.vert, shaders/depth_prepass_instanced.vert (view in place of model_view):
+    layout(push_constant) uniform push_constants_t {
+        mat4 model_view;
+        mat4 projection;
+    } pc;
+    */
+    struct push_constants_t {
+        glm::mat4 model_view;
+        glm::mat4 projection;
+    };
+
+    static_assert(sizeof(push_constants_t) <= draw_packet::max_push_constants_size);
+
+    /*
+    shaders/depth_prepass_instanced.vert:
+    layout(location = 1) in mat4 in_model;
+    */
+    static const std::uint32_t instance_binding_idx = 1;
+    static const std::uint32_t instance_model_matrix_location = 1;
+
+    std::uint16_t m_pipeline_id = next_draw_pipeline_id();
+    std::uint16_t m_instanced_pipeline_id = next_draw_pipeline_id();
+
+    gsl::not_null<const vulkan_manager*> m_vulkan_manager;
+    gsl::not_null<const render_manager*> m_render_manager;
+    options m_options;
+};
+
+}
+
+#endif
\ No newline at end of file
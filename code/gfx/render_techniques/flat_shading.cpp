@@ -7,10 +7,70 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+
 namespace squadbox::gfx::render_techniques {
 
-flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const vk::RenderPass& render_pass)
-    : m_vulkan_manager(&vulkan_manager) {
+namespace {
+    std::tuple<vk::UniqueBuffer, vk::UniqueDeviceMemory> create_buffer(const vk::Device& device, const vk::PhysicalDeviceMemoryProperties& device_memory_props,
+                                                                       vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memory_props) {
+        vk::BufferCreateInfo buffer_ci;
+        buffer_ci
+            .setSize(size)
+            .setUsage(usage)
+            .setSharingMode(vk::SharingMode::eExclusive);
+
+        auto buffer = device.createBufferUnique(buffer_ci);
+        auto buffer_memory = vk_utils::alloc_memory(device, device_memory_props, device.getBufferMemoryRequirements(buffer.get()), memory_props);
+        device.bindBufferMemory(buffer.get(), buffer_memory.get(), 0);
+
+        return std::make_tuple(std::move(buffer), std::move(buffer_memory));
+    }
+}
+
+flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const render_manager& render_manager)
+    : flat_shading(vulkan_manager, render_manager, options {}) {
+}
+
+flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const render_manager& render_manager, const options& options)
+    : m_vulkan_manager(&vulkan_manager), m_render_manager(&render_manager), m_options(options) {
+    if (m_options.mode == binding_mode::bindless && !m_render_manager->get_bindless_heap()) {
+        throw std::runtime_error("flat_shading: bindless mode needs descriptor indexing support.");
+    }
+
+    // Without an indirect count the cull pass can't compact, and has to issue one (possibly empty) draw per object.
+    if (m_options.mode == binding_mode::gpu_driven
+        && !m_vulkan_manager->supports_draw_indirect_count() && !m_vulkan_manager->supports_multi_draw_indirect()) {
+        throw std::runtime_error("flat_shading: GPU-driven mode needs draw indirect count or multi draw indirect support.");
+    }
+
+    // The cull pass points each draw's first instance at its objects.
+    if (m_options.mode == binding_mode::gpu_driven && !m_vulkan_manager->supports_draw_indirect_first_instance()) {
+        throw std::runtime_error("flat_shading: GPU-driven mode needs draw indirect first instance support.");
+    }
+
+    if (m_options.occlusion_culling
+        && (m_options.mode != binding_mode::gpu_driven || !m_render_manager->get_depth_pyramid())) {
+        throw std::runtime_error("flat_shading: occlusion culling needs GPU-driven mode and a depth pyramid.");
+    }
+
+    // The prepass would need the cull pass's draws as well.
+    if (m_options.depth_prepass && m_options.mode == binding_mode::gpu_driven) {
+        throw std::runtime_error("flat_shading: the depth prepass isn't supported in GPU-driven mode.");
+    }
+
+    if (m_options.depth_prepass) {
+        depth_prepass::options depth_prepass_options;
+        depth_prepass_options.triangle_strips = m_options.triangle_strips;
+        depth_prepass_options.instance_stride = sizeof(instance_t);
+        depth_prepass_options.instance_model_matrix_offset = static_cast<std::uint32_t>(offsetof(instance_t, model_matrix));
+
+        m_depth_prepass.emplace(vulkan_manager, render_manager,
+                                mesh_type::depth_vertex_input_binding_desc(), mesh_type::depth_vertex_input_attr_desc(), depth_prepass_options);
+    }
+
+    const auto& render_pass = m_render_manager->render_pass();
+
     static const std::uint32_t vert_shader_spv[] = {
         #include "../../shaders/compiled/flat.vert.spv.c"
     };
@@ -19,6 +79,30 @@ flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const vk::Rende
         #include "../../shaders/compiled/flat.frag.spv.c"
     };
 
+    static const std::uint32_t instanced_vert_shader_spv[] = {
+        #include "../../shaders/compiled/flat_instanced.vert.spv.c"
+    };
+
+    static const std::uint32_t bindless_vert_shader_spv[] = {
+        #include "../../shaders/compiled/flat_bindless.vert.spv.c"
+    };
+
+    static const std::uint32_t push_constants_vert_shader_spv[] = {
+        #include "../../shaders/compiled/flat_push_constants.vert.spv.c"
+    };
+
+    static const std::uint32_t gpu_driven_vert_shader_spv[] = {
+        #include "../../shaders/compiled/flat_gpu_driven.vert.spv.c"
+    };
+
+    static const std::uint32_t cull_comp_shader_spv[] = {
+        #include "../../shaders/compiled/flat_cull.comp.spv.c"
+    };
+
+    static const std::uint32_t cull_occlusion_comp_shader_spv[] = {
+        #include "../../shaders/compiled/flat_cull_occlusion.comp.spv.c"
+    };
+
     m_persistent_render_data->vert_shader = [](const vk::Device& device) {
         vk::ShaderModuleCreateInfo vert_shader_ci;
         vert_shader_ci
@@ -37,67 +121,36 @@ flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const vk::Rende
         return device.createShaderModuleUnique(frag_shader_ci);
     }(m_vulkan_manager->device());
 
-    m_persistent_render_data->descriptor_set_layout = [](const vk::Device& device) {       
-        std::array<vk::DescriptorSetLayoutBinding, 1> layout_bindings;
-        layout_bindings[0]
-            .setBinding(vertex_ubo_binding_idx)
-            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-            .setStageFlags(vk::ShaderStageFlagBits::eVertex)
-            .setDescriptorCount(1);
-
-        vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_ci;
-        descriptor_set_layout_ci
-            .setPBindings(layout_bindings.data())
-            .setBindingCount(layout_bindings.size());
-
-        return device.createDescriptorSetLayoutUnique(descriptor_set_layout_ci);
-    }(m_vulkan_manager->device());
-
-    m_persistent_render_data->descriptor_pool = [](const vk::Device& device) {
-        vk::DescriptorPoolSize descriptor_pool_size;
-        descriptor_pool_size
-            .setType(vk::DescriptorType::eUniformBuffer)
-            .setDescriptorCount(1000);  //  TODO: Make descriptor pool allocator abstraction
-
-        vk::DescriptorPoolCreateInfo descriptor_pool_ci;
-        descriptor_pool_ci
-            .setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
-            .setPPoolSizes(&descriptor_pool_size)
-            .setPoolSizeCount(1)
-            .setMaxSets(1);
+    m_persistent_render_data->instanced_vert_shader = [](const vk::Device& device) {
+        vk::ShaderModuleCreateInfo vert_shader_ci;
+        vert_shader_ci
+            .setPCode(instanced_vert_shader_spv)
+            .setCodeSize(sizeof(instanced_vert_shader_spv));
 
-        return device.createDescriptorPoolUnique(descriptor_pool_ci);
+        return device.createShaderModuleUnique(vert_shader_ci);
     }(m_vulkan_manager->device());
 
-    m_persistent_render_data->pipeline_layout = [](const vk::Device& device, const vk::DescriptorSetLayout& descriptor_set_layout) {
-        /*
-        shaders/imgui.vert:
-        layout(push_constant) uniform uPushConstant {
-            vec2 uScale;
-            vec2 uTranslate;
-        } pc;
-        */
-
-        vk::PushConstantRange push_constant_range;
-        push_constant_range
-            .setStageFlags(vk::ShaderStageFlagBits::eVertex)
-            .setOffset(0)
-            .setSize(sizeof(float) * 2 * 2);
-
-        std::array<vk::DescriptorSetLayout, 1> layouts = { descriptor_set_layout };
+    m_persistent_render_data->pipeline_layout = [](const vk::Device& device, const vk::DescriptorSetLayout& uniform_ring_layout) {
+        std::array<vk::DescriptorSetLayout, 1> layouts = { uniform_ring_layout };
 
         vk::PipelineLayoutCreateInfo pipeline_layout_ci;
         pipeline_layout_ci
             .setPSetLayouts(layouts.data())
-            .setSetLayoutCount(layouts.size())
-            .setPPushConstantRanges(&push_constant_range)
-            .setPushConstantRangeCount(1);
+            .setSetLayoutCount(layouts.size());
 
         return device.createPipelineLayoutUnique(pipeline_layout_ci);
-    }(m_vulkan_manager->device(), m_persistent_render_data->descriptor_set_layout.get());
+    }(m_vulkan_manager->device(), m_render_manager->get_uniform_ring().descriptor_set_layout());
 
-    m_persistent_render_data->graphics_pipeline = [](const vk::Device& device, const vk::RenderPass& render_pass, const vk::PipelineLayout& pipeline_layout,
-                                                     const vk::ShaderModule& vertex_shader_module, const vk::ShaderModule& fragment_shader_module) {
+    const auto topology = m_options.triangle_strips ? vk::PrimitiveTopology::eTriangleStrip : vk::PrimitiveTopology::eTriangleList;
+
+    // After a prepass, depth is final: only the fragments that ended up on top pass.
+    const auto depth_write = !m_options.depth_prepass;
+    const auto depth_compare_op = m_options.depth_prepass ? vk::CompareOp::eEqual : vk::CompareOp::eLess;
+
+    auto create_graphics_pipeline = [topology, depth_write, depth_compare_op](const vk::Device& device, const vk::PipelineCache& pipeline_cache,
+                                               const vk::RenderPass& render_pass, const vk::PipelineLayout& pipeline_layout,
+                                               const vk::ShaderModule& vertex_shader_module, const vk::ShaderModule& fragment_shader_module,
+                                               const vk::PipelineVertexInputStateCreateInfo& pipeline_vert_input_state_ci) {
         vk::GraphicsPipelineCreateInfo graphics_pipeline_ci;
         std::vector<vk::DynamicState> enabled_dynamic_states;
 
@@ -116,32 +169,12 @@ flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const vk::Rende
             .setPStages(stages.data())
             .setStageCount(stages.size());
 
-        auto vert_input_binding_desc = mesh_type::vertex_input_binding_desc();
-        auto vert_input_attr_desc = mesh_type::vertex_input_attr_desc();
-        
-        /*std::array<vk::VertexInputAttributeDescription, 3> vert_input_attr_desc;
-        vert_input_attr_desc[0]
-            .setLocation(0)
-            .setBinding(vert_input_binding_desc.binding)
-            .setFormat(vk::Format::eR32G32B32Sfloat)
-            .setOffset(mesh_type::vertex_t::offset_of<mesh_features::position>());
-        vert_input_attr_desc[1]
-            .setLocation(1)
-            .setBinding(vert_input_binding_desc.binding)
-            .setFormat(vk::Format::eR32G32B32Sfloat)
-            .setOffset(mesh_type::vertex_t::offset_of<mesh_features::normal>());*/
-
-        vk::PipelineVertexInputStateCreateInfo pipeline_vert_input_state_ci;
-        pipeline_vert_input_state_ci
-            .setPVertexBindingDescriptions(vert_input_binding_desc.data())
-            .setVertexBindingDescriptionCount(vert_input_binding_desc.size())
-            .setPVertexAttributeDescriptions(vert_input_attr_desc.data())
-            .setVertexAttributeDescriptionCount(vert_input_attr_desc.size());
         graphics_pipeline_ci.setPVertexInputState(&pipeline_vert_input_state_ci);
 
         vk::PipelineInputAssemblyStateCreateInfo pipeline_input_assembly_state_ci;
         pipeline_input_assembly_state_ci
-            .setTopology(vk::PrimitiveTopology::eTriangleList);
+            .setTopology(topology)
+            .setPrimitiveRestartEnable(topology == vk::PrimitiveTopology::eTriangleStrip);
         graphics_pipeline_ci.setPInputAssemblyState(&pipeline_input_assembly_state_ci);
 
         vk::PipelineRasterizationStateCreateInfo pipeline_raster_state_ci;
@@ -171,7 +204,8 @@ flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const vk::Rende
 
         vk::PipelineViewportStateCreateInfo pipeline_viewport_state_ci;
         pipeline_viewport_state_ci
-            .setViewportCount(1);
+            .setViewportCount(1)
+            .setScissorCount(1);
         graphics_pipeline_ci.setPViewportState(&pipeline_viewport_state_ci);
 
         enabled_dynamic_states.emplace_back(vk::DynamicState::eViewport);
@@ -179,8 +213,9 @@ flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const vk::Rende
 
         vk::PipelineDepthStencilStateCreateInfo pipeline_depth_stencil_state_ci;
         pipeline_depth_stencil_state_ci
-            .setDepthTestEnable(false)
-            .setDepthWriteEnable(false);
+            .setDepthTestEnable(true)
+            .setDepthWriteEnable(depth_write)
+            .setDepthCompareOp(depth_compare_op);
         graphics_pipeline_ci.setPDepthStencilState(&pipeline_depth_stencil_state_ci);
 
         vk::PipelineMultisampleStateCreateInfo pipeline_multisample_state_ci;
@@ -198,83 +233,980 @@ flat_shading::flat_shading(const vulkan_manager& vulkan_manager, const vk::Rende
             .setRenderPass(render_pass)
             .setLayout(pipeline_layout);
 
-        return device.createGraphicsPipelineUnique(nullptr, graphics_pipeline_ci);
-    }(m_vulkan_manager->device(), render_pass, m_persistent_render_data->pipeline_layout.get(),
-      m_persistent_render_data->vert_shader.get(), m_persistent_render_data->frag_shader.get());
+        return device.createGraphicsPipelineUnique(pipeline_cache, graphics_pipeline_ci);
+    };
+
+    // Compiled in the background, the descriptor set variant first as the others fall back to it. What the create
+    // functions use is copied in, as they run after this returns, and the persistent data they refer to is shared with
+    // the compiles until they're done.
+    auto& pipeline_manager = m_render_manager->get_pipeline_manager();
+
+    m_persistent_render_data->graphics_pipeline = pipeline_manager.compile(
+            [create_graphics_pipeline, render_pass = render_pass, pipeline_layout = m_persistent_render_data->pipeline_layout.get(),
+             vertex_shader_module = m_persistent_render_data->vert_shader.get(), fragment_shader_module = m_persistent_render_data->frag_shader.get()](
+            const vk::Device& device, const vk::PipelineCache& pipeline_cache) {
+        auto vert_input_binding_desc = mesh_type::vertex_input_binding_desc();
+        auto vert_input_attr_desc = mesh_type::vertex_input_attr_desc();
+        
+        /*std::array<vk::VertexInputAttributeDescription, 3> vert_input_attr_desc;
+        vert_input_attr_desc[0]
+            .setLocation(0)
+            .setBinding(vert_input_binding_desc.binding)
+            .setFormat(vk::Format::eR32G32B32Sfloat)
+            .setOffset(mesh_type::vertex_t::offset_of<mesh_features::position>());
+        vert_input_attr_desc[1]
+            .setLocation(1)
+            .setBinding(vert_input_binding_desc.binding)
+            .setFormat(vk::Format::eR32G32B32Sfloat)
+            .setOffset(mesh_type::vertex_t::offset_of<mesh_features::normal>());*/
+
+        vk::PipelineVertexInputStateCreateInfo pipeline_vert_input_state_ci;
+        pipeline_vert_input_state_ci
+            .setPVertexBindingDescriptions(vert_input_binding_desc.data())
+            .setVertexBindingDescriptionCount(vert_input_binding_desc.size())
+            .setPVertexAttributeDescriptions(vert_input_attr_desc.data())
+            .setVertexAttributeDescriptionCount(vert_input_attr_desc.size());
+
+        return create_graphics_pipeline(device, pipeline_cache, render_pass, pipeline_layout, vertex_shader_module, fragment_shader_module, pipeline_vert_input_state_ci);
+    }, m_persistent_render_data.share());
+
+    m_persistent_render_data->instanced_graphics_pipeline = pipeline_manager.compile(
+            [create_graphics_pipeline, render_pass = render_pass, pipeline_layout = m_persistent_render_data->pipeline_layout.get(),
+             vertex_shader_module = m_persistent_render_data->instanced_vert_shader.get(), fragment_shader_module = m_persistent_render_data->frag_shader.get()](
+            const vk::Device& device, const vk::PipelineCache& pipeline_cache) {
+        const auto mesh_vert_input_binding_desc = mesh_type::vertex_input_binding_desc();
+        const auto mesh_vert_input_attr_desc = mesh_type::vertex_input_attr_desc();
+
+        std::array<vk::VertexInputBindingDescription, mesh_type::num_vertex_buffers + 1> vert_input_binding_desc;
+        std::copy(mesh_vert_input_binding_desc.begin(), mesh_vert_input_binding_desc.end(), vert_input_binding_desc.begin());
+        vert_input_binding_desc.back()
+            .setBinding(instance_binding_idx)
+            .setStride(sizeof(instance_t))
+            .setInputRate(vk::VertexInputRate::eInstance);
+
+        constexpr auto num_mesh_attrs = std::tuple_size_v<std::decay_t<decltype(mesh_vert_input_attr_desc)>>;
+
+        // mat4 model matrix takes up one location per column, followed by the color.
+        std::array<vk::VertexInputAttributeDescription, num_mesh_attrs + 4 + 1> vert_input_attr_desc;
+        std::copy(mesh_vert_input_attr_desc.begin(), mesh_vert_input_attr_desc.end(), vert_input_attr_desc.begin());
+
+        for (std::uint32_t column = 0; column < 4; ++column) {
+            vert_input_attr_desc[num_mesh_attrs + column]
+                .setLocation(instance_model_matrix_location + column)
+                .setBinding(instance_binding_idx)
+                .setFormat(vk::Format::eR32G32B32A32Sfloat)
+                .setOffset(static_cast<std::uint32_t>(offsetof(instance_t, model_matrix) + sizeof(glm::vec4) * column));
+        }
+
+        vert_input_attr_desc.back()
+            .setLocation(instance_color_location)
+            .setBinding(instance_binding_idx)
+            .setFormat(vk::Format::eR32G32B32A32Sfloat)
+            .setOffset(static_cast<std::uint32_t>(offsetof(instance_t, color)));
+
+        vk::PipelineVertexInputStateCreateInfo pipeline_vert_input_state_ci;
+        pipeline_vert_input_state_ci
+            .setPVertexBindingDescriptions(vert_input_binding_desc.data())
+            .setVertexBindingDescriptionCount(vert_input_binding_desc.size())
+            .setPVertexAttributeDescriptions(vert_input_attr_desc.data())
+            .setVertexAttributeDescriptionCount(vert_input_attr_desc.size());
+
+        return create_graphics_pipeline(device, pipeline_cache, render_pass, pipeline_layout, vertex_shader_module, fragment_shader_module, pipeline_vert_input_state_ci);
+    }, m_persistent_render_data.share());
+
+    if (m_options.mode == binding_mode::push_constants) {
+        m_persistent_render_data->push_constants_vert_shader = [](const vk::Device& device) {
+            vk::ShaderModuleCreateInfo vert_shader_ci;
+            vert_shader_ci
+                .setPCode(push_constants_vert_shader_spv)
+                .setCodeSize(sizeof(push_constants_vert_shader_spv));
+
+            return device.createShaderModuleUnique(vert_shader_ci);
+        }(m_vulkan_manager->device());
+
+        m_persistent_render_data->push_constants_pipeline_layout = [](const vk::Device& device, const vk::DescriptorSetLayout& uniform_ring_layout) {
+            vk::PushConstantRange push_constant_range;
+            push_constant_range
+                .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+                .setOffset(0)
+                .setSize(sizeof(push_constants_t));
+
+            vk::PipelineLayoutCreateInfo pipeline_layout_ci;
+            pipeline_layout_ci
+                .setPSetLayouts(&uniform_ring_layout)
+                .setSetLayoutCount(1)
+                .setPPushConstantRanges(&push_constant_range)
+                .setPushConstantRangeCount(1);
+
+            return device.createPipelineLayoutUnique(pipeline_layout_ci);
+        }(m_vulkan_manager->device(), m_render_manager->get_uniform_ring().descriptor_set_layout());
+
+        m_persistent_render_data->push_constants_graphics_pipeline = pipeline_manager.compile(
+                [create_graphics_pipeline, render_pass = render_pass, pipeline_layout = m_persistent_render_data->push_constants_pipeline_layout.get(),
+                 vertex_shader_module = m_persistent_render_data->push_constants_vert_shader.get(), fragment_shader_module = m_persistent_render_data->frag_shader.get()](
+                const vk::Device& device, const vk::PipelineCache& pipeline_cache) {
+            auto vert_input_binding_desc = mesh_type::vertex_input_binding_desc();
+            auto vert_input_attr_desc = mesh_type::vertex_input_attr_desc();
+
+            vk::PipelineVertexInputStateCreateInfo pipeline_vert_input_state_ci;
+            pipeline_vert_input_state_ci
+                .setPVertexBindingDescriptions(vert_input_binding_desc.data())
+                .setVertexBindingDescriptionCount(vert_input_binding_desc.size())
+                .setPVertexAttributeDescriptions(vert_input_attr_desc.data())
+                .setVertexAttributeDescriptionCount(vert_input_attr_desc.size());
+
+            return create_graphics_pipeline(device, pipeline_cache, render_pass, pipeline_layout, vertex_shader_module, fragment_shader_module, pipeline_vert_input_state_ci);
+        }, m_persistent_render_data.share());
+    }
+
+    if (m_options.mode == binding_mode::gpu_driven) {
+        const auto& device = m_vulkan_manager->device();
+
+        m_persistent_render_data->gpu_driven_vert_shader = [](const vk::Device& device) {
+            vk::ShaderModuleCreateInfo vert_shader_ci;
+            vert_shader_ci
+                .setPCode(gpu_driven_vert_shader_spv)
+                .setCodeSize(sizeof(gpu_driven_vert_shader_spv));
+
+            return device.createShaderModuleUnique(vert_shader_ci);
+        }(device);
+
+        m_persistent_render_data->cull_comp_shader = [](const vk::Device& device, bool occlusion_culling) {
+            vk::ShaderModuleCreateInfo comp_shader_ci;
+            if (occlusion_culling) {
+                comp_shader_ci
+                    .setPCode(cull_occlusion_comp_shader_spv)
+                    .setCodeSize(sizeof(cull_occlusion_comp_shader_spv));
+            }
+            else {
+                comp_shader_ci
+                    .setPCode(cull_comp_shader_spv)
+                    .setCodeSize(sizeof(cull_comp_shader_spv));
+            }
+
+            return device.createShaderModuleUnique(comp_shader_ci);
+        }(device, m_options.occlusion_culling);
+
+        m_persistent_render_data->objects_descriptor_set_layout = [](const vk::Device& device) {
+            vk::DescriptorSetLayoutBinding binding;
+            binding
+                .setBinding(0)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(1)
+                .setStageFlags(vk::ShaderStageFlagBits::eVertex);
+
+            vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_ci;
+            descriptor_set_layout_ci
+                .setPBindings(&binding)
+                .setBindingCount(1);
+
+            return device.createDescriptorSetLayoutUnique(descriptor_set_layout_ci);
+        }(device);
+
+        m_persistent_render_data->cull_descriptor_set_layout = [](const vk::Device& device, bool occlusion_culling) {
+            // objects, draw commands, draw count, meshlets, then the depth pyramid
+            std::array<vk::DescriptorSetLayoutBinding, 5> bindings;
+            for (std::uint32_t i = 0; i < 4; ++i) {
+                bindings[i]
+                    .setBinding(i)
+                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                    .setDescriptorCount(1)
+                    .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+            }
+
+            bindings[4]
+                .setBinding(4)
+                .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                .setDescriptorCount(1)
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+            vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_ci;
+            descriptor_set_layout_ci
+                .setPBindings(bindings.data())
+                .setBindingCount(occlusion_culling ? 5 : 4);
+
+            return device.createDescriptorSetLayoutUnique(descriptor_set_layout_ci);
+        }(device, m_options.occlusion_culling);
+
+        m_persistent_render_data->objects_update_template = [](const vk::Device& device, const vk::DescriptorSetLayout& descriptor_set_layout) {
+            std::array<vk::DescriptorUpdateTemplateEntry, 1> entries;
+            entries[0]
+                .setDstBinding(0)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(1)
+                .setOffset(0)
+                .setStride(sizeof(vk::DescriptorBufferInfo));
+
+            return descriptor_update_template<vk::DescriptorBufferInfo> { device, descriptor_set_layout, entries };
+        }(device, m_persistent_render_data->objects_descriptor_set_layout.get());
+
+        m_persistent_render_data->cull_update_template = [](const vk::Device& device, const vk::DescriptorSetLayout& descriptor_set_layout, bool occlusion_culling) {
+            std::array<vk::DescriptorUpdateTemplateEntry, 3> entries;
+            entries[0]
+                .setDstBinding(0)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(3)
+                .setOffset(offsetof(cull_descriptors_t, buffers))
+                .setStride(sizeof(vk::DescriptorBufferInfo));
+            entries[1]
+                .setDstBinding(3)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(1)
+                .setOffset(offsetof(cull_descriptors_t, meshlets))
+                .setStride(sizeof(vk::DescriptorBufferInfo));
+            entries[2]
+                .setDstBinding(4)
+                .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                .setDescriptorCount(1)
+                .setOffset(offsetof(cull_descriptors_t, depth_pyramid))
+                .setStride(sizeof(vk::DescriptorImageInfo));
+
+            return descriptor_update_template<cull_descriptors_t> { device, descriptor_set_layout,
+                                                                    gsl::make_span(entries.data(), occlusion_culling ? 3 : 2) };
+        }(device, m_persistent_render_data->cull_descriptor_set_layout.get(), m_options.occlusion_culling);
+
+        m_persistent_render_data->gpu_driven_pipeline_layout = [](const vk::Device& device, const vk::DescriptorSetLayout& uniform_ring_layout,
+                                                                  const vk::DescriptorSetLayout& objects_layout) {
+            std::array<vk::DescriptorSetLayout, 2> layouts = { uniform_ring_layout, objects_layout };
+
+            vk::PipelineLayoutCreateInfo pipeline_layout_ci;
+            pipeline_layout_ci
+                .setPSetLayouts(layouts.data())
+                .setSetLayoutCount(layouts.size());
+
+            return device.createPipelineLayoutUnique(pipeline_layout_ci);
+        }(device, m_render_manager->get_uniform_ring().descriptor_set_layout(), m_persistent_render_data->objects_descriptor_set_layout.get());
+
+        m_persistent_render_data->gpu_driven_graphics_pipeline = pipeline_manager.compile(
+                [create_graphics_pipeline, render_pass = render_pass, pipeline_layout = m_persistent_render_data->gpu_driven_pipeline_layout.get(),
+                 vertex_shader_module = m_persistent_render_data->gpu_driven_vert_shader.get(), fragment_shader_module = m_persistent_render_data->frag_shader.get()](
+                const vk::Device& device, const vk::PipelineCache& pipeline_cache) {
+            auto vert_input_binding_desc = mesh_type::vertex_input_binding_desc();
+            auto vert_input_attr_desc = mesh_type::vertex_input_attr_desc();
+
+            vk::PipelineVertexInputStateCreateInfo pipeline_vert_input_state_ci;
+            pipeline_vert_input_state_ci
+                .setPVertexBindingDescriptions(vert_input_binding_desc.data())
+                .setVertexBindingDescriptionCount(vert_input_binding_desc.size())
+                .setPVertexAttributeDescriptions(vert_input_attr_desc.data())
+                .setVertexAttributeDescriptionCount(vert_input_attr_desc.size());
+
+            return create_graphics_pipeline(device, pipeline_cache, render_pass, pipeline_layout, vertex_shader_module, fragment_shader_module, pipeline_vert_input_state_ci);
+        }, m_persistent_render_data.share());
+
+        // The cull parameters outgrew push constants and come from the uniform ring in set 1.
+        m_persistent_render_data->cull_pipeline_layout = [](const vk::Device& device, const vk::DescriptorSetLayout& cull_layout,
+                                                            const vk::DescriptorSetLayout& uniform_ring_layout) {
+            std::array<vk::DescriptorSetLayout, 2> layouts = { cull_layout, uniform_ring_layout };
+
+            vk::PipelineLayoutCreateInfo pipeline_layout_ci;
+            pipeline_layout_ci
+                .setPSetLayouts(layouts.data())
+                .setSetLayoutCount(layouts.size());
+
+            return device.createPipelineLayoutUnique(pipeline_layout_ci);
+        }(device, m_persistent_render_data->cull_descriptor_set_layout.get(), m_render_manager->get_uniform_ring().descriptor_set_layout());
+
+        m_persistent_render_data->cull_pipeline = pipeline_manager.compile(
+                [pipeline_layout = m_persistent_render_data->cull_pipeline_layout.get(), compute_shader_module = m_persistent_render_data->cull_comp_shader.get()](
+                const vk::Device& device, const vk::PipelineCache& pipeline_cache) {
+            vk::ComputePipelineCreateInfo compute_pipeline_ci;
+            compute_pipeline_ci
+                .setLayout(pipeline_layout)
+                .stage
+                    .setStage(vk::ShaderStageFlagBits::eCompute)
+                    .setModule(compute_shader_module)
+                    .setPName("main");
+
+            return device.createComputePipelineUnique(pipeline_cache, compute_pipeline_ci);
+        }, m_persistent_render_data.share());
+    }
+
+    if (m_options.mode != binding_mode::bindless) return;
+
+    m_persistent_render_data->bindless_vert_shader = [](const vk::Device& device) {
+        vk::ShaderModuleCreateInfo vert_shader_ci;
+        vert_shader_ci
+            .setPCode(bindless_vert_shader_spv)
+            .setCodeSize(sizeof(bindless_vert_shader_spv));
+
+        return device.createShaderModuleUnique(vert_shader_ci);
+    }(m_vulkan_manager->device());
+
+    m_persistent_render_data->bindless_pipeline_layout = [](const vk::Device& device, const vk::DescriptorSetLayout& bindless_descriptor_set_layout) {
+        vk::PushConstantRange push_constant_range;
+        push_constant_range
+            .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+            .setOffset(0)
+            .setSize(sizeof(bindless_push_constants_t));
+
+        vk::PipelineLayoutCreateInfo pipeline_layout_ci;
+        pipeline_layout_ci
+            .setPSetLayouts(&bindless_descriptor_set_layout)
+            .setSetLayoutCount(1)
+            .setPPushConstantRanges(&push_constant_range)
+            .setPushConstantRangeCount(1);
+
+        return device.createPipelineLayoutUnique(pipeline_layout_ci);
+    }(m_vulkan_manager->device(), m_render_manager->get_bindless_heap()->descriptor_set_layout());
+
+    m_persistent_render_data->bindless_graphics_pipeline = pipeline_manager.compile(
+            [create_graphics_pipeline, render_pass = render_pass, pipeline_layout = m_persistent_render_data->bindless_pipeline_layout.get(),
+             vertex_shader_module = m_persistent_render_data->bindless_vert_shader.get(), fragment_shader_module = m_persistent_render_data->frag_shader.get()](
+            const vk::Device& device, const vk::PipelineCache& pipeline_cache) {
+        auto vert_input_binding_desc = mesh_type::vertex_input_binding_desc();
+        auto vert_input_attr_desc = mesh_type::vertex_input_attr_desc();
+
+        vk::PipelineVertexInputStateCreateInfo pipeline_vert_input_state_ci;
+        pipeline_vert_input_state_ci
+            .setPVertexBindingDescriptions(vert_input_binding_desc.data())
+            .setVertexBindingDescriptionCount(vert_input_binding_desc.size())
+            .setPVertexAttributeDescriptions(vert_input_attr_desc.data())
+            .setVertexAttributeDescriptionCount(vert_input_attr_desc.size());
+
+        return create_graphics_pipeline(device, pipeline_cache, render_pass, pipeline_layout, vertex_shader_module, fragment_shader_module, pipeline_vert_input_state_ci);
+    }, m_persistent_render_data.share());
+}
+
+bool flat_shading::ready() const {
+    const auto& persistent_data = *m_persistent_render_data;
+
+    if (m_options.mode == binding_mode::gpu_driven) {
+        return persistent_data.gpu_driven_graphics_pipeline.ready() && persistent_data.cull_pipeline.ready();
+    }
+
+    if (m_options.mode == binding_mode::bindless && !persistent_data.bindless_graphics_pipeline.ready()) return false;
+    if (m_options.mode == binding_mode::push_constants && !persistent_data.push_constants_graphics_pipeline.ready()) return false;
+    if (m_depth_prepass && (!m_depth_prepass->ready() || !m_depth_prepass->instanced_ready())) return false;
+
+    return persistent_data.graphics_pipeline.ready() && persistent_data.instanced_graphics_pipeline.ready();
 }
 
 flat_shading::render_data flat_shading::prepare_render_data(mesh_type&& mesh) const {
     render_data_t render_data;
 
+    const auto topology = m_options.triangle_strips ? vk::PrimitiveTopology::eTriangleStrip : vk::PrimitiveTopology::eTriangleList;
+    if (mesh.primitive_topology() != topology) {
+        throw std::runtime_error("flat_shading: the mesh's index topology doesn't match options::triangle_strips.");
+    }
+
+    if (m_options.depth_prepass && !mesh.has_depth_positions()) {
+        throw std::runtime_error("flat_shading: the depth prepass needs meshes created with depth positions.");
+    }
+
     render_data.mesh = std::move(mesh);
 
-    {
-        std::lock_guard<std::mutex> lock(*m_persistent_render_data->descriptor_pool_mutex);
+    if (m_options.mode == binding_mode::gpu_driven) {
+        const auto& device = m_vulkan_manager->device();
+        const auto meshlets = render_data.mesh.meshlets();
+
+        // A storage buffer can't be empty, so meshes without clusters get one the cull shader never reads.
+        render_data.meshlet_count = static_cast<std::uint32_t>(meshlets.size());
+        const auto buffer_size = std::max<std::size_t>(meshlets.size(), 1) * sizeof(gpu_meshlet_t);
+
+        std::tie(render_data.meshlets_buffer, render_data.meshlets_memory)
+            = create_buffer(device, m_vulkan_manager->physical_device().getMemoryProperties(), buffer_size,
+                            vk::BufferUsageFlagBits::eStorageBuffer,
+                            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
 
-        render_data.descriptor_set = [](const vk::Device& device, const vk::DescriptorSetLayout& layout,
-            const vk::DescriptorPool& pool) {
-            vk::DescriptorSetAllocateInfo descriptor_set_alloc_info;
-            descriptor_set_alloc_info
-                .setDescriptorPool(pool)
-                .setPSetLayouts(&layout)
-                .setDescriptorSetCount(1);
+        auto mapped_meshlets = static_cast<gpu_meshlet_t*>(device.mapMemory(render_data.meshlets_memory.get(), 0, VK_WHOLE_SIZE));
+        for (const auto& meshlet : meshlets) {
+            // Clusters too curved to cull by cone have no meaningful axis.
+            const auto cone_axis = meshlet.cone_cutoff < 1.0f ? meshlet.cone_axis : glm::vec3 { 0.0f, 0.0f, 1.0f };
 
-            return std::move(device.allocateDescriptorSetsUnique(descriptor_set_alloc_info)[0]);
-        }(m_vulkan_manager->device(), m_persistent_render_data->descriptor_set_layout.get(), m_persistent_render_data->descriptor_pool.get());
+            *mapped_meshlets++ = { meshlet.bounding_sphere.packed(), glm::vec4 { cone_axis, meshlet.cone_cutoff },
+                                   meshlet.first_index, meshlet.index_count, { 0, 0 } };
+        }
+        device.unmapMemory(render_data.meshlets_memory.get());
     }
 
-    std::tie(render_data.uniform_buffer, render_data.uniform_buffer_memory) = [](const vk::Device& device, const vk::PhysicalDeviceMemoryProperties& device_memory_props) {
-        vk::BufferCreateInfo buffer_ci;
-        buffer_ci
-            .setSize(sizeof(ubo_t))
-            .setUsage(vk::BufferUsageFlagBits::eUniformBuffer)
-            .setSharingMode(vk::SharingMode::eExclusive);
+    return std::make_shared<render_data_t>(std::move(render_data));
+}
 
-        auto uniform_buffer = device.createBufferUnique(buffer_ci);
-        auto uniform_buffer_memory_reqs = device.getBufferMemoryRequirements(uniform_buffer.get());
-        auto uniform_buffer_memory = vk_utils::alloc_memory(device, device_memory_props, uniform_buffer_memory_reqs, vk::MemoryPropertyFlagBits::eHostVisible);
+flat_shading::frame_constants flat_shading::prepare_frame_constants(std::uint32_t frame_index, const camera& camera) const {
+    frame_ubo_t frame_ubo;
+    frame_ubo.projection = camera.projection_matrix();
 
-        return std::make_tuple(std::move(uniform_buffer), std::move(uniform_buffer_memory));
-    }(m_vulkan_manager->device(), m_vulkan_manager->physical_device().getMemoryProperties());
+    const auto uniforms = m_render_manager->get_uniform_ring().push(frame_index, frame_ubo);
 
-    return std::make_shared<render_data_t>(std::move(render_data));
+    frame_constants result;
+    result.descriptor_set = uniforms.descriptor_set;
+    result.dynamic_offset = uniforms.dynamic_offset;
+
+    return result;
+}
+
+void flat_shading::render(render_thread& render_thread,
+                          gsl::not_null<render_data> render_data,
+                          const vk::Viewport& viewport, const camera& camera, const frame_constants& frame_constants,
+                          const glm::mat4& model_matrix, const glm::vec4& model_color, const glm::vec4& ambient_color) const {
+    assert(m_options.mode == binding_mode::push_constants);
+
+    if (!m_persistent_render_data->push_constants_graphics_pipeline.ready()) {
+        render(render_thread, render_data, viewport, camera, model_matrix, model_color, ambient_color);
+        return;
+    }
+
+    if (m_depth_prepass && !m_depth_prepass->ready()) return;
+
+    const auto& mesh = render_data->mesh;
+    if (!camera.view_frustum().intersects(mesh.bounds().transformed(model_matrix))) return;
+
+    push_constants_t push_constants;
+    push_constants.model_view = camera.view_matrix() * model_matrix;
+    push_constants.model_color = model_color;
+    push_constants.ambient_color = ambient_color;
+
+    const auto lod = mesh.lod(select_lod(mesh, push_constants.model_view, camera, viewport));
+
+    if (m_depth_prepass) {
+        m_depth_prepass->render(render_thread, depth_prepass::mesh_geometry(mesh, lod), render_data.get(), viewport,
+                                push_constants.model_view, camera.projection_matrix());
+    }
+
+    // Draws sharing the frame constants differ only in push constants: no descriptor binds, no memory writes.
+    draw_packet packet;
+    packet.sort_key = draw_sort_key::opaque(draw_layer::opaque, m_push_constants_pipeline_id,
+                                            draw_sort_key::material_id_from_handle((std::uint64_t)static_cast<VkBuffer>(mesh.index_buffer())),
+                                            -push_constants.model_view[3].z);
+    packet.pipeline = m_persistent_render_data->push_constants_graphics_pipeline.get();
+    packet.pipeline_layout = m_persistent_render_data->push_constants_pipeline_layout.get();
+    packet.set_descriptor_set(frame_constants.descriptor_set);
+    packet.dynamic_offsets[0] = frame_constants.dynamic_offset;
+    packet.dynamic_offset_count = 1;
+    packet.set_push_constants(vk::ShaderStageFlagBits::eVertex, push_constants);
+    packet.set_vertex_buffers(mesh.vertex_buffers(), mesh.vertex_buffer_offsets());
+    packet.index_buffer = mesh.index_buffer();
+    packet.index_buffer_offset = mesh.index_buffer_offset();
+    packet.index_type = mesh.vulkan_index_type();
+    packet.first_index = lod.first_index;
+    packet.index_count = lod.index_count;
+    packet.viewport = viewport;
+    packet.resources = render_data.get();
+
+    render_thread.add_draw_packet(std::move(packet));
 }
 
 void flat_shading::render(render_thread& render_thread,
                           gsl::not_null<render_data> render_data,
                           const vk::Viewport& viewport, const camera& camera, const glm::mat4& model_matrix,
                           const glm::vec4& model_color, const glm::vec4& ambient_color) const {
+    const auto& persistent_data = *m_persistent_render_data;
+
+    if (m_options.mode == binding_mode::push_constants && persistent_data.push_constants_graphics_pipeline.ready()) {
+        render(render_thread, render_data, viewport, camera, prepare_frame_constants(render_thread.frame_index(), camera),
+               model_matrix, model_color, ambient_color);
+        return;
+    }
+
+    // Variants still compiling fall back to the descriptor set one.
+    const bool bindless = m_options.mode == binding_mode::bindless && persistent_data.bindless_graphics_pipeline.ready();
+    if (!bindless && !persistent_data.graphics_pipeline.ready()) return;
+    if (m_depth_prepass && !m_depth_prepass->ready()) return;
+
+    const auto& mesh = render_data->mesh;
+    if (!camera.view_frustum().intersects(mesh.bounds().transformed(model_matrix))) return;
+
+    const auto model_view = camera.view_matrix() * model_matrix;
+    const auto lod = mesh.lod(select_lod(mesh, model_view, camera, viewport));
+
+    if (m_depth_prepass) {
+        m_depth_prepass->render(render_thread, depth_prepass::mesh_geometry(mesh, lod), render_data.get(), viewport,
+                                model_view, camera.projection_matrix());
+    }
+
+    ubo_t ubo;
+    ubo.model_view = model_view;
+    ubo.projection = camera.projection_matrix();
+    ubo.model_color = model_color;
+    ubo.ambient_color = ambient_color;
+
+    draw_packet packet;
+    packet.sort_key = draw_sort_key::opaque(draw_layer::opaque, bindless ? m_bindless_pipeline_id : m_pipeline_id,
+                                            draw_sort_key::material_id_from_handle((std::uint64_t)static_cast<VkBuffer>(mesh.index_buffer())),
+                                            -model_view[3].z);
+
+    // Per-object constants go into this frame's part of the ring, so frames in flight never share them.
+    const auto uniforms = m_render_manager->get_uniform_ring().push(render_thread.frame_index(), ubo);
+
+    if (bindless) {
+        bindless_push_constants_t push_constants;
+        push_constants.object_buffer_id = uniforms.bindless_id;
+        push_constants.object_offset = uniforms.bindless_offset;
+
+        // Every draw binds the same set, so consecutive draws of a mesh only differ in push constants.
+        packet.pipeline = persistent_data.bindless_graphics_pipeline.get();
+        packet.pipeline_layout = persistent_data.bindless_pipeline_layout.get();
+        packet.set_descriptor_set(m_render_manager->get_bindless_heap()->descriptor_set());
+        packet.set_push_constants(vk::ShaderStageFlagBits::eVertex, push_constants);
+    }
+    else {
+        packet.pipeline = persistent_data.graphics_pipeline.get();
+        packet.pipeline_layout = persistent_data.pipeline_layout.get();
+        packet.set_descriptor_set(uniforms.descriptor_set);
+        packet.dynamic_offsets[0] = uniforms.dynamic_offset;
+        packet.dynamic_offset_count = 1;
+    }
+
+    packet.set_vertex_buffers(mesh.vertex_buffers(), mesh.vertex_buffer_offsets());
+    packet.index_buffer = mesh.index_buffer();
+    packet.index_buffer_offset = mesh.index_buffer_offset();
+    packet.index_type = mesh.vulkan_index_type();
+    packet.first_index = lod.first_index;
+    packet.index_count = lod.index_count;
+    packet.viewport = viewport;
+    packet.resources = render_data.get();
+
+    render_thread.add_draw_packet(std::move(packet));
+}
+
+void flat_shading::render_instanced(render_thread& render_thread,
+                                    gsl::not_null<render_data> render_data,
+                                    const vk::Viewport& viewport, const camera& camera,
+                                    gsl::span<const glm::mat4> model_matrices, gsl::span<const glm::vec4> model_colors,
+                                    const glm::vec4& ambient_color) const {
+    assert(model_matrices.size() == model_colors.size());
+    if (model_matrices.empty()) return;
+
+    if (!m_persistent_render_data->instanced_graphics_pipeline.ready() || (m_depth_prepass && !m_depth_prepass->instanced_ready())) {
+        for (std::size_t i = 0; i < model_matrices.size(); ++i) {
+            render(render_thread, render_data, viewport, camera, model_matrices[i], model_colors[i], ambient_color);
+        }
+
+        return;
+    }
+
+    const auto& mesh = render_data->mesh;
+
+    // Scratch space is per recording thread, so steady state culling doesn't allocate.
+    thread_local aabb_soa instance_bounds;
+    thread_local std::vector<std::uint32_t> visible_instances;
+
+    instance_bounds.clear();
+    instance_bounds.reserve(model_matrices.size());
+    for (const auto& model_matrix : model_matrices) {
+        instance_bounds.push_back(mesh.bounds().transformed(model_matrix));
+    }
+
+    visible_instances.clear();
+    cull_aabbs(camera.view_frustum(), instance_bounds, visible_instances);
+    if (visible_instances.empty()) return;
+
     const auto& device = m_vulkan_manager->device();
+    const auto instance_count = visible_instances.size();
+
+    // One buffer per frame in flight so that we never write instances a previous frame is still reading.
+    auto& instance_buffer = render_data->instance_buffers[render_thread.frame_index()];
+
+    // The last frame to use the slot has retired, and with it every draw reading its buffers.
+    const auto frame_serial = m_render_manager->frame_serial();
+    if (instance_buffer.frame_serial != frame_serial) {
+        instance_buffer.frame_serial = frame_serial;
+        instance_buffer.used = 0;
+        instance_buffer.retired.clear();
+    }
 
-    render_data->command_buffer = render_thread.allocate_command_buffer();
-    const auto& command_buffer = render_data->command_buffer.get();
+    if (instance_buffer.capacity - instance_buffer.used < instance_count) {
+        const auto new_capacity = std::max(instance_count, instance_buffer.capacity * 2);
 
-    vk::CommandBufferBeginInfo command_buffer_begin_info;
-    command_buffer_begin_info
-        .setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue)
-        .setPInheritanceInfo(&render_thread.command_buffer_inheritance_info());
+        // Earlier calls this frame have draws queued from the buffer; it goes once the frame has retired.
+        if (instance_buffer.buffer) {
+            instance_buffer.retired.emplace_back(std::move(instance_buffer.buffer), std::move(instance_buffer.memory));
+        }
 
-    command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_persistent_render_data->graphics_pipeline.get());
-    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_persistent_render_data->pipeline_layout.get(), 0, { render_data->descriptor_set.get() }, nullptr);
-    command_buffer.bindVertexBuffers(0, render_data->mesh.vertex_buffers(), render_data->mesh.vertex_buffer_offsets());
-    command_buffer.bindIndexBuffer(render_data->mesh.index_buffer(), 0, vk::IndexType::eUint32);
-    command_buffer.setViewport(0, { viewport });
+        std::tie(instance_buffer.buffer, instance_buffer.memory) = [](const vk::Device& device, const vk::PhysicalDeviceMemoryProperties& device_memory_props,
+                                                                      const vk::DeviceSize buffer_size) {
+            vk::BufferCreateInfo buffer_ci;
+            buffer_ci
+                .setSize(buffer_size)
+                .setUsage(vk::BufferUsageFlagBits::eVertexBuffer)
+                .setSharingMode(vk::SharingMode::eExclusive);
+
+            auto buffer = device.createBufferUnique(buffer_ci);
+            auto buffer_memory_reqs = device.getBufferMemoryRequirements(buffer.get());
+            auto buffer_memory = vk_utils::alloc_memory(device, device_memory_props, buffer_memory_reqs,
+                                                        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+            device.bindBufferMemory(buffer.get(), buffer_memory.get(), 0);
+
+            return std::make_tuple(std::move(buffer), std::move(buffer_memory));
+        }(device, m_vulkan_manager->physical_device().getMemoryProperties(), new_capacity * sizeof(instance_t));
+
+        instance_buffer.mapped_instances = static_cast<instance_t*>(device.mapMemory(instance_buffer.memory.get(), 0, VK_WHOLE_SIZE));
+        instance_buffer.capacity = new_capacity;
+        instance_buffer.used = 0;
+    }
+
+    const auto base_instance = static_cast<std::uint32_t>(instance_buffer.used);
+    instance_buffer.used += instance_count;
+
+    // Instances are written grouped by level of detail, one draw per level.
+    thread_local std::vector<std::uint32_t> instance_lods;
+    thread_local std::vector<std::uint32_t> lod_instance_offsets;
+
+    const auto num_lods = mesh.num_lods();
+
+    instance_lods.resize(instance_count);
+    lod_instance_offsets.assign(num_lods + 1, 0);
+
+    for (std::size_t i = 0; i < instance_count; ++i) {
+        instance_lods[i] = select_lod(mesh, camera.view_matrix() * model_matrices[visible_instances[i]], camera, viewport);
+        ++lod_instance_offsets[instance_lods[i] + 1];
+    }
+
+    for (std::uint32_t level = 0; level < num_lods; ++level) {
+        lod_instance_offsets[level + 1] += lod_instance_offsets[level];
+    }
 
     {
-        ubo_t ubo;
-        ubo.model_view = camera.view_matrix() * model_matrix;
-        ubo.projection = camera.projection_matrix();
-        ubo.model_color = model_color;
-        ubo.ambient_color = ambient_color;
+        auto write_offsets = lod_instance_offsets;
+        const auto instances = instance_buffer.mapped_instances + base_instance;
+        for (std::size_t i = 0; i < instance_count; ++i) {
+            const auto instance = visible_instances[i];
+            instances[write_offsets[instance_lods[i]]++] = { model_matrices[instance], model_colors[instance] };
+        }
+    }
+
+    ubo_t ubo;
+    ubo.model_view = camera.view_matrix();
+    ubo.projection = camera.projection_matrix();
+    ubo.model_color = glm::vec4 { 1.0f };
+    ubo.ambient_color = ambient_color;
+
+    const auto uniforms = m_render_manager->get_uniform_ring().push(render_thread.frame_index(), ubo);
+
+    draw_packet packet;
+    packet.sort_key = draw_sort_key::opaque(draw_layer::opaque, m_instanced_pipeline_id,
+                                            draw_sort_key::material_id_from_handle((std::uint64_t)static_cast<VkBuffer>(mesh.index_buffer())),
+                                            0.0f);
+    packet.pipeline = m_persistent_render_data->instanced_graphics_pipeline.get();
+    packet.pipeline_layout = m_persistent_render_data->pipeline_layout.get();
+    packet.set_descriptor_set(uniforms.descriptor_set);
+    packet.dynamic_offsets[0] = uniforms.dynamic_offset;
+    packet.dynamic_offset_count = 1;
+    packet.set_vertex_buffers(mesh.vertex_buffers(), mesh.vertex_buffer_offsets());
+    packet.vertex_buffers[instance_binding_idx] = instance_buffer.buffer.get();
+    packet.vertex_buffer_offsets[instance_binding_idx] = 0;
+    packet.vertex_buffer_count = instance_binding_idx + 1;
+    packet.index_buffer = mesh.index_buffer();
+    packet.index_buffer_offset = mesh.index_buffer_offset();
+    packet.index_type = mesh.vulkan_index_type();
+    packet.viewport = viewport;
+    packet.resources = render_data.get();
+
+    for (std::uint32_t level = 0; level < num_lods; ++level) {
+        const auto first_instance = base_instance + lod_instance_offsets[level];
+        const auto level_instance_count = lod_instance_offsets[level + 1] - lod_instance_offsets[level];
+        if (level_instance_count == 0) continue;
+
+        const auto lod = mesh.lod(level);
+
+        draw_packet level_packet = packet;
+        level_packet.first_index = lod.first_index;
+        level_packet.index_count = lod.index_count;
+        level_packet.first_instance = first_instance;
+        level_packet.instance_count = level_instance_count;
+
+        if (m_depth_prepass) {
+            m_depth_prepass->render_instanced(render_thread, depth_prepass::mesh_geometry(mesh, lod), render_data.get(), viewport,
+                                              ubo.model_view, ubo.projection, instance_buffer.buffer.get(), first_instance, level_instance_count);
+        }
+
+        render_thread.add_draw_packet(std::move(level_packet));
+    }
+}
+
+std::uint32_t flat_shading::select_lod(const mesh_type& mesh, const glm::mat4& model_view, const camera& camera, const vk::Viewport& viewport) const {
+    if (mesh.num_lods() == 1) return 0;
 
-        vk_utils::copy_to_memory(device, render_data->uniform_buffer_memory.get(), ubo);
+    const auto& bounding_sphere = mesh.bounding_sphere();
+    const auto scale = std::max({ glm::length(glm::vec3 { model_view[0] }), glm::length(glm::vec3 { model_view[1] }), glm::length(glm::vec3 { model_view[2] }) });
+
+    // Judged at the nearest point of the bounds; from inside them everything is full detail.
+    const auto distance = -(model_view * glm::vec4 { bounding_sphere.center, 1.0f }).z - bounding_sphere.radius * scale;
+    if (distance <= 0.0f) return 0;
+
+    return gfx::select_lod(mesh.lods(), lod_error_to_pixels(camera.projection_matrix(), std::abs(viewport.height)) * scale / distance,
+                           m_options.lod_pixel_error);
+}
+
+void flat_shading::render_data_t::objects::mark_dirty(std::uint32_t slot) {
+    for (auto& buffers : frame_buffers) {
+        if (buffers.all_dirty) continue;
+
+        // Past this point re-uploading everything is cheaper than tracking.
+        if (buffers.dirty_slots.size() >= slots.size() / 2) {
+            buffers.all_dirty = true;
+            buffers.dirty_slots.clear();
+        }
+        else {
+            buffers.dirty_slots.push_back(slot);
+        }
     }
+}
+
+flat_shading::object_id flat_shading::add_object(const render_data& render_data, const glm::mat4& model_matrix, const glm::vec4& model_color) const {
+    assert(m_options.mode == binding_mode::gpu_driven);
+
+    auto& objects = render_data->gpu_objects;
+
+    object_id id;
+    if (objects.free_ids.empty()) {
+        id = static_cast<object_id>(objects.id_slots.size());
+        objects.id_slots.push_back(0);
+    }
+    else {
+        id = objects.free_ids.back();
+        objects.free_ids.pop_back();
+    }
+
+    const auto slot = static_cast<std::uint32_t>(objects.slots.size());
+    objects.slots.push_back({ model_matrix, model_color, render_data->mesh.bounding_sphere().packed() });
+    objects.slot_ids.push_back(id);
+    objects.id_slots[id] = slot;
+    objects.mark_dirty(slot);
+
+    return id;
+}
+
+void flat_shading::update_object(const render_data& render_data, object_id id, const glm::mat4& model_matrix, const glm::vec4& model_color) const {
+    assert(m_options.mode == binding_mode::gpu_driven);
+
+    auto& objects = render_data->gpu_objects;
+    const auto slot = objects.id_slots[id];
+
+    objects.slots[slot].model_matrix = model_matrix;
+    objects.slots[slot].color = model_color;
+    objects.mark_dirty(slot);
+}
+
+void flat_shading::remove_object(const render_data& render_data, object_id id) const {
+    assert(m_options.mode == binding_mode::gpu_driven);
+
+    auto& objects = render_data->gpu_objects;
+    const auto slot = objects.id_slots[id];
+    const auto last_slot = static_cast<std::uint32_t>(objects.slots.size() - 1);
+
+    // Keep slots packed by moving the last object into the hole.
+    if (slot != last_slot) {
+        objects.slots[slot] = objects.slots[last_slot];
+        objects.slot_ids[slot] = objects.slot_ids[last_slot];
+        objects.id_slots[objects.slot_ids[slot]] = slot;
+        objects.mark_dirty(slot);
+    }
+
+    objects.slots.pop_back();
+    objects.slot_ids.pop_back();
+    objects.free_ids.push_back(id);
+}
+
+void flat_shading::render_objects(render_thread& render_thread,
+                                  gsl::not_null<render_data> render_data,
+                                  const vk::Viewport& viewport, const camera& camera, const glm::vec4& ambient_color) const {
+    assert(m_options.mode == binding_mode::gpu_driven);
+
+    auto& objects = render_data->gpu_objects;
+    if (objects.slots.empty()) return;
+
+    // Nothing to fall back to: the objects only exist in the buffers the cull pass reads. Dirty slots stay dirty.
+    if (!m_persistent_render_data->cull_pipeline.ready() || !m_persistent_render_data->gpu_driven_graphics_pipeline.ready()) return;
+
+    const auto& device = m_vulkan_manager->device();
+    const auto object_count = objects.slots.size();
+    const auto draw_count = object_count * std::max<std::size_t>(render_data->meshlet_count, 1);
+    const bool compact = m_vulkan_manager->supports_draw_indirect_count();
 
-    command_buffer.drawIndexed(render_data->mesh.index_count(), 1, 0, 0, 0);
+    // This frame's previous submission has retired, so its buffers are free to write.
+    auto& buffers = objects.frame_buffers[render_thread.frame_index()];
 
-    command_buffer.end();
+    // The last frame to use the slot has retired, and with it every pass reading its buffers.
+    const auto frame_serial = m_render_manager->frame_serial();
+    if (buffers.frame_serial != frame_serial) {
+        buffers.frame_serial = frame_serial;
+        buffers.draws_used = 0;
+        buffers.counts_used = 0;
+        buffers.retired.clear();
+    }
+
+    // Earlier calls this frame have passes queued reading the buffers outgrown; they go once the frame has retired.
+    const auto retire = [&buffers](vk::UniqueBuffer& buffer, vk::UniqueDeviceMemory& memory) {
+        if (buffer) buffers.retired.emplace_back(std::move(buffer), std::move(memory));
+    };
+
+    if (buffers.capacity < object_count) {
+        const auto new_capacity = std::max(object_count, buffers.capacity * 2);
+
+        retire(buffers.objects_buffer, buffers.objects_memory);
+        std::tie(buffers.objects_buffer, buffers.objects_memory)
+            = create_buffer(device, m_vulkan_manager->physical_device().getMemoryProperties(), new_capacity * sizeof(gpu_object_t),
+                            vk::BufferUsageFlagBits::eStorageBuffer,
+                            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        buffers.mapped_objects = static_cast<gpu_object_t*>(device.mapMemory(buffers.objects_memory.get(), 0, VK_WHOLE_SIZE));
+
+        buffers.capacity = new_capacity;
+        buffers.all_dirty = true;
+    }
+
+    if (buffers.draw_capacity - buffers.draws_used < draw_count) {
+        const auto new_capacity = std::max(draw_count, buffers.draw_capacity * 2);
+
+        retire(buffers.draw_commands_buffer, buffers.draw_commands_memory);
+        std::tie(buffers.draw_commands_buffer, buffers.draw_commands_memory)
+            = create_buffer(device, m_vulkan_manager->physical_device().getMemoryProperties(), new_capacity * sizeof(VkDrawIndexedIndirectCommand),
+                            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+                            vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        buffers.draw_capacity = new_capacity;
+        buffers.draws_used = 0;
+    }
+
+    if (buffers.count_capacity == buffers.counts_used) {
+        const auto new_capacity = std::max<std::size_t>(buffers.count_capacity * 2, 1);
+
+        retire(buffers.draw_count_buffer, buffers.draw_count_memory);
+        std::tie(buffers.draw_count_buffer, buffers.draw_count_memory)
+            = create_buffer(device, m_vulkan_manager->physical_device().getMemoryProperties(), new_capacity * sizeof(std::uint32_t),
+                            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                            vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        buffers.count_capacity = new_capacity;
+        buffers.counts_used = 0;
+    }
+
+    const auto draw_offset = static_cast<std::uint32_t>(buffers.draws_used);
+    const auto count_index = static_cast<std::uint32_t>(buffers.counts_used);
+    buffers.draws_used += draw_count;
+    ++buffers.counts_used;
+
+    if (buffers.all_dirty) {
+        std::copy(objects.slots.begin(), objects.slots.end(), buffers.mapped_objects);
+    }
+    else {
+        for (const auto slot : buffers.dirty_slots) {
+            // Slots past the end were removed after being written.
+            if (slot < object_count) buffers.mapped_objects[slot] = objects.slots[slot];
+        }
+    }
+
+    buffers.dirty_slots.clear();
+    buffers.all_dirty = false;
+
+    const auto& persistent_data = *m_persistent_render_data;
+
+    cull_descriptors_t cull_descriptors;
+    cull_descriptors.buffers = {
+        vk::DescriptorBufferInfo { buffers.objects_buffer.get(), 0, VK_WHOLE_SIZE },
+        vk::DescriptorBufferInfo { buffers.draw_commands_buffer.get(), 0, VK_WHOLE_SIZE },
+        vk::DescriptorBufferInfo { buffers.draw_count_buffer.get(), 0, VK_WHOLE_SIZE }
+    };
+    cull_descriptors.meshlets = vk::DescriptorBufferInfo { render_data->meshlets_buffer.get(), 0, VK_WHOLE_SIZE };
+
+    glm::vec2 depth_pyramid_size { 0.0f, 0.0f };
+    if (m_options.occlusion_culling) {
+        const auto& depth_pyramid = *m_render_manager->get_depth_pyramid();
+        cull_descriptors.depth_pyramid = vk::DescriptorImageInfo { depth_pyramid.sampler(), depth_pyramid.view(), vk::ImageLayout::eGeneral };
+        depth_pyramid_size = { depth_pyramid.width(), depth_pyramid.height() };
+    }
+
+    const auto cull_descriptor_set = render_thread.allocate_descriptor_set(persistent_data.cull_descriptor_set_layout.get());
+    persistent_data.cull_update_template.update(cull_descriptor_set, cull_descriptors);
+
+    const auto objects_descriptor_set = render_thread.allocate_descriptor_set(persistent_data.objects_descriptor_set_layout.get());
+    persistent_data.objects_update_template.update(objects_descriptor_set,
+                                                   vk::DescriptorBufferInfo { buffers.objects_buffer.get(), 0, VK_WHOLE_SIZE });
+
+    const auto& mesh = render_data->mesh;
+
+    cull_ubo_t cull_ubo;
+    cull_ubo.view_projection = camera.projection_matrix() * camera.view_matrix();
+    cull_ubo.view_position = glm::vec4 { camera.position(), 1.0f };
+    cull_ubo.frustum_planes = camera.view_frustum().planes();
+    cull_ubo.depth_pyramid_size = depth_pyramid_size;
+    cull_ubo.lod_error_scale = lod_error_to_pixels(camera.projection_matrix(), std::abs(viewport.height)) / m_options.lod_pixel_error;
+    cull_ubo.lod_count = std::min(mesh.num_lods(), max_cull_lods);
+    cull_ubo.object_count = static_cast<std::uint32_t>(object_count);
+    cull_ubo.compact = compact;
+    cull_ubo.meshlet_count = render_data->meshlet_count;
+    cull_ubo.draw_offset = draw_offset;
+    cull_ubo.count_index = count_index;
+
+    for (std::uint32_t level = 0; level < cull_ubo.lod_count; ++level) {
+        const auto lod = mesh.lod(level);
+        cull_ubo.lods[level] = { lod.first_index, lod.index_count, lod.error, 0 };
+    }
+
+    const auto cull_uniforms = m_render_manager->get_uniform_ring().push(render_thread.frame_index(), cull_ubo);
+
+    render_thread.add_compute_pass([cull_pipeline = persistent_data.cull_pipeline.get(),
+                                    cull_pipeline_layout = persistent_data.cull_pipeline_layout.get(),
+                                    cull_descriptor_set, cull_uniforms, compact,
+                                    draw_count = static_cast<std::uint32_t>(draw_count),
+                                    draw_count_buffer = buffers.draw_count_buffer.get(),
+                                    count_offset = vk::DeviceSize { count_index * sizeof(std::uint32_t) },
+                                    resources = std::shared_ptr<void> { render_data.get() }](const vk::CommandBuffer& command_buffer) {
+        if (compact) {
+            command_buffer.fillBuffer(draw_count_buffer, count_offset, sizeof(std::uint32_t), 0);
+
+            vk::BufferMemoryBarrier clear_barrier;
+            clear_barrier
+                .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setBuffer(draw_count_buffer)
+                .setOffset(count_offset)
+                .setSize(sizeof(std::uint32_t));
+
+            command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits(),
+                                           nullptr, { clear_barrier }, nullptr);
+        }
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, cull_pipeline);
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cull_pipeline_layout, 0,
+                                          { cull_descriptor_set, cull_uniforms.descriptor_set }, { cull_uniforms.dynamic_offset });
+        command_buffer.dispatch((draw_count + cull_workgroup_size - 1) / cull_workgroup_size, 1, 1);
+
+        vk::MemoryBarrier draw_barrier;
+        draw_barrier
+            .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead);
+
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect, vk::DependencyFlagBits(),
+                                       { draw_barrier }, nullptr, nullptr);
+    });
+
+    gpu_driven_frame_ubo_t frame_ubo;
+    frame_ubo.view = camera.view_matrix();
+    frame_ubo.projection = camera.projection_matrix();
+    frame_ubo.ambient_color = ambient_color;
+
+    const auto uniforms = m_render_manager->get_uniform_ring().push(render_thread.frame_index(), frame_ubo);
+
+    draw_packet packet;
+    packet.sort_key = draw_sort_key::opaque(draw_layer::opaque, m_gpu_driven_pipeline_id,
+                                            draw_sort_key::material_id_from_handle((std::uint64_t)static_cast<VkBuffer>(mesh.index_buffer())),
+                                            0.0f);
+    packet.pipeline = persistent_data.gpu_driven_graphics_pipeline.get();
+    packet.pipeline_layout = persistent_data.gpu_driven_pipeline_layout.get();
+    packet.descriptor_sets[0] = uniforms.descriptor_set;
+    packet.descriptor_sets[1] = objects_descriptor_set;
+    packet.descriptor_set_count = 2;
+    packet.dynamic_offsets[0] = uniforms.dynamic_offset;
+    packet.dynamic_offset_count = 1;
+    packet.set_vertex_buffers(mesh.vertex_buffers(), mesh.vertex_buffer_offsets());
+    packet.index_buffer = mesh.index_buffer();
+    packet.index_buffer_offset = mesh.index_buffer_offset();
+    packet.index_type = mesh.vulkan_index_type();
+    packet.indirect_buffer = buffers.draw_commands_buffer.get();
+    packet.indirect_offset = draw_offset * sizeof(VkDrawIndexedIndirectCommand);
+    packet.max_draw_count = static_cast<std::uint32_t>(draw_count);
+    if (compact) {
+        packet.count_buffer = buffers.draw_count_buffer.get();
+        packet.count_offset = count_index * sizeof(std::uint32_t);
+    }
+    packet.viewport = viewport;
+    packet.resources = render_data.get();
 
-    render_thread.add_render_job({ std::move(render_data.get()) });
+    render_thread.add_draw_packet(std::move(packet));
 }
 
 }
\ No newline at end of file
@@ -3,8 +3,20 @@
 
 #pragma once
 
+#include "../bindless_heap.hpp"
+#include "../descriptor_allocator.hpp"
+#include "../draw_packet.hpp"
+#include "../frustum_culling.hpp"
 #include "../gpu_mesh.hpp"
+#include "../pipeline_manager.hpp"
 #include "../render_job.hpp"
+#include "../render_manager.hpp"
+#include "../uniform_ring.hpp"
+#include "depth_prepass.hpp"
+
+#include <optional>
+#include <tuple>
+#include <vector>
 
 namespace squadbox::gfx {
 
@@ -19,20 +31,169 @@ namespace squadbox::gfx::render_techniques {
 
 class flat_shading {
 public:
-    using mesh_type = gpu_mesh<gpu_mesh_position<gpu_mesh_usage::vertex>, gpu_mesh_normal<gpu_mesh_usage::vertex>>;
+    // Half float positions and octahedral normals: 12 bytes a vertex instead of 24. Positions stay in model space, so
+    // position_decode_matrix() is identity and needn't be applied.
+    using mesh_type = gpu_mesh<gpu_mesh_position<gpu_mesh_usage::vertex, 0, vk::Format::eR16G16B16A16Sfloat>,
+                               gpu_mesh_normal<gpu_mesh_usage::vertex, 1, vk::Format::eR16G16Snorm>>;
+
+    static_assert(!mesh_type::has_bounds_relative_positions);
+
+    enum class binding_mode {
+        // Object constants are bound as a dynamic uniform buffer from the uniform ring.
+        descriptor_sets,
+        // Object constants are read from the uniform ring through the bindless heap, located per draw by push constants.
+        bindless,
+        // Object constants are push constants; only per-frame data (the projection) goes through the uniform ring.
+        push_constants,
+        // Objects live in GPU buffers (add_object() etc.) and are culled by a compute pass that writes the
+        // indirect draws. Per frame, the CPU only uploads the objects that changed and records one draw per mesh.
+        // Needs drawIndirectFirstInstance, and either draw indirect count or multi draw indirect.
+        gpu_driven
+    };
+
+    using object_id = std::uint32_t;
+
+    // Push-constant mode: per-frame data shared by every draw using the same camera in a frame.
+    struct frame_constants {
+        vk::DescriptorSet descriptor_set;
+        std::uint32_t dynamic_offset = 0;
+    };
+
+    struct options {
+        binding_mode mode = binding_mode::descriptor_sets;
+        // GPU-driven mode only. Also culls objects hidden behind the previous frame's depth, which needs
+        // render_manager::enable_depth_pyramid(). Objects that were hidden can pop in a frame late when the view moves quickly.
+        bool occlusion_culling = false;
+        // Meshes with levels of detail are drawn at the coarsest level whose error covers at most this many pixels.
+        float lod_pixel_error = 1.0f;
+        // Draw meshes uploaded as triangle strips (index_topology::triangle_strip) instead of lists. Every mesh
+        // given to prepare_render_data() has to match.
+        bool triangle_strips = false;
+        // Lays down depth with a depth_prepass first, then shades with an equal depth test and depth writes off, so
+        // each visible pixel is shaded once. Meshes need depth positions. Not available in GPU-driven mode.
+        bool depth_prepass = false;
+    };
 
 private:
-    struct render_data_t : render_job_command_buffer_base {
-        vk::UniqueDescriptorSet descriptor_set;
-        vk::UniqueBuffer uniform_buffer;
-        vk::UniqueDeviceMemory uniform_buffer_memory;
+    struct ubo_t {
+        glm::mat4 model_view;
+        glm::mat4 projection;
+        glm::vec4 model_color;
+        glm::vec4 ambient_color;
+    };
+
+    struct instance_t {
+        glm::mat4 model_matrix;
+        glm::vec4 color;
+    };
+
+    /*
+    shaders/flat_gpu_driven.vert, shaders/flat_cull.comp:
+    struct object_t {
+        mat4 model_matrix;
+        vec4 color;
+        vec4 bounding_sphere;
+    };
+    */
+    struct gpu_object_t {
+        glm::mat4 model_matrix;
+        glm::vec4 color;
+        glm::vec4 bounding_sphere;  // model space center, radius
+    };
+
+    /*
+    shaders/flat_cull.glsl:
+    struct meshlet_t {
+        vec4 bounding_sphere;
+        vec4 cone;
+        uint first_index;
+        uint index_count;
+        uint padding[2];
+    };
+    */
+    struct gpu_meshlet_t {
+        glm::vec4 bounding_sphere;
+        glm::vec4 cone;             // axis, cutoff
+        std::uint32_t first_index;
+        std::uint32_t index_count;
+        std::uint32_t padding[2];
+    };
+
+    struct render_data_t {
+        struct instance_buffer {
+            vk::UniqueBuffer buffer;
+            vk::UniqueDeviceMemory memory;
+            instance_t* mapped_instances = nullptr;
+            std::size_t capacity = 0;
+            // Instances written in the frame, each render_instanced() call after its own slice.
+            std::size_t used = 0;
+            std::uint64_t frame_serial = 0;
+            // Outgrown during the frame, and still read by the draws recorded before.
+            std::vector<std::tuple<vk::UniqueBuffer, vk::UniqueDeviceMemory>> retired;
+        };
+
+        struct object_buffers {
+            vk::UniqueBuffer objects_buffer;
+            vk::UniqueDeviceMemory objects_memory;
+            gpu_object_t* mapped_objects = nullptr;
+
+            vk::UniqueBuffer draw_commands_buffer;
+            vk::UniqueDeviceMemory draw_commands_memory;
+            vk::UniqueBuffer draw_count_buffer;
+            vk::UniqueDeviceMemory draw_count_memory;
+
+            std::size_t capacity = 0;
+            // One draw per object and cluster, and one count, per render_objects() call in the frame.
+            std::size_t draw_capacity = 0;
+            std::size_t count_capacity = 0;
+            // Written in the frame, each call after its own slice.
+            std::size_t draws_used = 0;
+            std::size_t counts_used = 0;
+            std::uint64_t frame_serial = 0;
+            // Outgrown during the frame, and still read by the passes recorded before.
+            std::vector<std::tuple<vk::UniqueBuffer, vk::UniqueDeviceMemory>> retired;
+
+            // Slots written since this frame's buffers were last uploaded.
+            std::vector<std::uint32_t> dirty_slots;
+            bool all_dirty = false;
+        };
+
+        // Objects are packed into slots so the cull pass only walks live objects;
+        // ids stay stable and map to whichever slot currently holds the object.
+        struct objects {
+            std::vector<gpu_object_t> slots;
+            std::vector<object_id> slot_ids;
+            std::vector<std::uint32_t> id_slots;
+            std::vector<object_id> free_ids;
+
+            std::array<object_buffers, render_manager::max_frames_in_flight> frame_buffers;
+
+            void mark_dirty(std::uint32_t slot);
+        };
+
         mesh_type mesh;
+
+        std::array<instance_buffer, render_manager::max_frames_in_flight> instance_buffers;
+
+        objects gpu_objects;
+
+        // GPU-driven mode: the mesh's clusters, or a single unused one for meshes without.
+        vk::UniqueBuffer meshlets_buffer;
+        vk::UniqueDeviceMemory meshlets_memory;
+        std::uint32_t meshlet_count = 0;
     };
 
 public:
     using render_data = std::shared_ptr<render_data_t>;
 
-    flat_shading(const vulkan_manager& vulkan_manager, const vk::RenderPass& render_pass);
+    // Pipelines are compiled by the render manager's pipeline_manager, so construction doesn't wait for the driver.
+    // Until the mode's variants are ready, draws use the descriptor set variant, instances drawn one by one, and until
+    // that one (and the depth prepass) is ready, draws are skipped. GPU-driven mode skips its draws until its own are.
+    flat_shading(const vulkan_manager& vulkan_manager, const render_manager& render_manager);
+    flat_shading(const vulkan_manager& vulkan_manager, const render_manager& render_manager, const options& options);
+
+    // Every pipeline of the mode has compiled, e.g. for a loading screen to wait for.
+    bool ready() const;
 
     render_data prepare_render_data(mesh_type&& mesh) const;
 
@@ -41,30 +202,209 @@ public:
                 const vk::Viewport& viewport, const camera& camera, const glm::mat4& model_matrix,
                 const glm::vec4& model_color, const glm::vec4& ambient_color) const;
 
+    // Push-constant mode only.
+    frame_constants prepare_frame_constants(std::uint32_t frame_index, const camera& camera) const;
+
+    void render(render_thread& render_thread,
+                gsl::not_null<render_data> render_data,
+                const vk::Viewport& viewport, const camera& camera, const frame_constants& frame_constants,
+                const glm::mat4& model_matrix, const glm::vec4& model_color, const glm::vec4& ambient_color) const;
+
+    // Draws the mesh once per model matrix / color pair with a single draw call per level of detail in use.
+    // A render_data should be drawn either per object or instanced within a frame, not both. It may be drawn
+    // instanced any number of times a frame, though not from several threads at once.
+    // Instances outside the camera frustum are dropped before they're written.
+    void render_instanced(render_thread& render_thread,
+                          gsl::not_null<render_data> render_data,
+                          const vk::Viewport& viewport, const camera& camera,
+                          gsl::span<const glm::mat4> model_matrices, gsl::span<const glm::vec4> model_colors,
+                          const glm::vec4& ambient_color) const;
+
+    // GPU-driven mode only. Objects persist across frames until removed; ids of removed objects are reused.
+    // Must not be called concurrently with rendering the same render_data.
+    object_id add_object(const render_data& render_data, const glm::mat4& model_matrix, const glm::vec4& model_color) const;
+    void update_object(const render_data& render_data, object_id id, const glm::mat4& model_matrix, const glm::vec4& model_color) const;
+    void remove_object(const render_data& render_data, object_id id) const;
+
+    // GPU-driven mode only. Culls every object of the render data against the camera frustum (and the depth pyramid,
+    // with occlusion culling) and draws the survivors. Objects drawn at full detail are culled again per cluster when
+    // the mesh has meshlets, which also drops clusters facing away from the camera. Can be called several times a
+    // frame, e.g. once per view; every call culls into draw buffers of its own.
+    void render_objects(render_thread& render_thread,
+                        gsl::not_null<render_data> render_data,
+                        const vk::Viewport& viewport, const camera& camera, const glm::vec4& ambient_color) const;
+
 private:
+    struct cull_descriptors_t {
+        std::array<vk::DescriptorBufferInfo, 3> buffers;  // objects, draw commands, draw count
+        vk::DescriptorImageInfo depth_pyramid;            // occlusion culling only
+        vk::DescriptorBufferInfo meshlets;
+    };
+
     struct persistent_data {
         vk::UniqueShaderModule vert_shader;
         vk::UniqueShaderModule frag_shader;
-        vk::UniqueDescriptorSetLayout descriptor_set_layout;
-        vk::UniqueDescriptorPool descriptor_pool;
+        vk::UniqueShaderModule instanced_vert_shader;
+        vk::UniqueShaderModule bindless_vert_shader;
         vk::UniquePipelineLayout pipeline_layout;
-        vk::UniquePipeline graphics_pipeline;
-
-        std::unique_ptr<std::mutex> descriptor_pool_mutex = std::make_unique<std::mutex>();
+        pipeline_handle graphics_pipeline;
+        pipeline_handle instanced_graphics_pipeline;
+        vk::UniquePipelineLayout bindless_pipeline_layout;
+        pipeline_handle bindless_graphics_pipeline;
+        vk::UniqueShaderModule push_constants_vert_shader;
+        vk::UniquePipelineLayout push_constants_pipeline_layout;
+        pipeline_handle push_constants_graphics_pipeline;
+        vk::UniqueShaderModule gpu_driven_vert_shader;
+        vk::UniqueShaderModule cull_comp_shader;
+        vk::UniqueDescriptorSetLayout objects_descriptor_set_layout;
+        vk::UniqueDescriptorSetLayout cull_descriptor_set_layout;
+        descriptor_update_template<vk::DescriptorBufferInfo> objects_update_template;
+        descriptor_update_template<cull_descriptors_t> cull_update_template;
+        vk::UniquePipelineLayout gpu_driven_pipeline_layout;
+        pipeline_handle gpu_driven_graphics_pipeline;
+        vk::UniquePipelineLayout cull_pipeline_layout;
+        pipeline_handle cull_pipeline;
     };
 
     persistent_render_data<persistent_data> m_persistent_render_data;
 
-    struct ubo_t {
-        glm::mat4 model_view;
+    /*
+    shaders/flat_bindless.vert:
+    layout(push_constant) uniform push_constants_t {
+        uint object_buffer_id;
+        uint object_offset;
+    } pc;
+    */
+    struct bindless_push_constants_t {
+        std::uint32_t object_buffer_id;
+        std::uint32_t object_offset;
+    };
+
+    /*
+    shaders/flat_push_constants.vert:
+    layout(binding = 0) uniform frame_ubo_t {
+        mat4 projection;
+    } frame_ubo;
+
+    layout(push_constant) uniform push_constants_t {
+        mat4 model_view;
+        vec4 model_color;
+        vec4 ambient_color;
+    } pc;
+    */
+    struct frame_ubo_t {
         glm::mat4 projection;
+    };
+
+    struct push_constants_t {
+        glm::mat4 model_view;
         glm::vec4 model_color;
         glm::vec4 ambient_color;
     };
 
-    static const std::uint32_t vertex_ubo_binding_idx = 0;
+    static_assert(sizeof(push_constants_t) <= draw_packet::max_push_constants_size);
+
+    /*
+    shaders/flat_gpu_driven.vert:
+    layout(set = 0, binding = 0) uniform frame_ubo_t {
+        mat4 view;
+        mat4 projection;
+        vec4 ambient_color;
+    } frame_ubo;
+
+    layout(set = 1, binding = 0) readonly buffer objects_t {
+        object_t objects[];
+    };
+    */
+    struct gpu_driven_frame_ubo_t {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 ambient_color;
+    };
+
+    /*
+    shaders/flat_cull.glsl:
+    layout(local_size_x = 64) in;
+
+    layout(set = 0, binding = 0) readonly buffer objects_t { object_t objects[]; };
+    layout(set = 0, binding = 1) writeonly buffer draw_commands_t { draw_command_t draw_commands[]; };
+    layout(set = 0, binding = 2) buffer draw_counts_t { uint draw_counts[]; };
+    layout(set = 0, binding = 3) readonly buffer meshlets_t { meshlet_t meshlets[]; };
+    layout(set = 0, binding = 4) uniform sampler2D depth_pyramid;  // flat_cull_occlusion.comp
+
+    struct lod_t {
+        uint first_index;
+        uint index_count;
+        float error;
+        uint padding;
+    };
+
+    layout(set = 1, binding = 0) uniform cull_ubo_t {
+        mat4 view_projection;
+        vec4 view_position;
+        vec4 frustum_planes[6];
+        lod_t lods[8];
+        vec2 depth_pyramid_size;
+        float lod_error_scale;
+        uint lod_count;
+        uint object_count;
+        uint compact;
+        uint meshlet_count;
+        uint draw_offset;
+        uint count_index;
+    } cull_ubo;
+    */
+    static const std::uint32_t max_cull_lods = 8;
+
+    struct cull_lod_t {
+        std::uint32_t first_index;
+        std::uint32_t index_count;
+        float error;
+        std::uint32_t padding;
+    };
+
+    struct cull_ubo_t {
+        glm::mat4 view_projection;
+        glm::vec4 view_position;
+        std::array<glm::vec4, 6> frustum_planes;
+        std::array<cull_lod_t, max_cull_lods> lods;
+        glm::vec2 depth_pyramid_size;
+        float lod_error_scale;       // pixels per unit of error at unit depth, over the allowed pixels
+        std::uint32_t lod_count;
+        std::uint32_t object_count;
+        std::uint32_t compact;
+        std::uint32_t meshlet_count;
+        std::uint32_t draw_offset;
+        std::uint32_t count_index;
+    };
+
+    static const std::uint32_t cull_workgroup_size = 64;
+
+    /*
+    shaders/flat_instanced.vert:
+    layout(location = 2) in mat4 in_model;
+    layout(location = 6) in vec4 in_color;
+    */
+    static const std::uint32_t instance_binding_idx = mesh_type::num_vertex_buffers;
+    static const std::uint32_t instance_model_matrix_location = 2;
+    static const std::uint32_t instance_color_location = 6;
+
+    static_assert(instance_binding_idx < draw_packet::max_vertex_buffers);
+
+    std::uint32_t select_lod(const mesh_type& mesh, const glm::mat4& model_view, const camera& camera, const vk::Viewport& viewport) const;
+
+    // One per pipeline, so the sort keeps each pipeline's draws together.
+    std::uint16_t m_pipeline_id = next_draw_pipeline_id();
+    std::uint16_t m_bindless_pipeline_id = next_draw_pipeline_id();
+    std::uint16_t m_push_constants_pipeline_id = next_draw_pipeline_id();
+    std::uint16_t m_instanced_pipeline_id = next_draw_pipeline_id();
+    std::uint16_t m_gpu_driven_pipeline_id = next_draw_pipeline_id();
 
     gsl::not_null<const vulkan_manager*> m_vulkan_manager;
+    gsl::not_null<const render_manager*> m_render_manager;
+    options m_options;
+
+    std::optional<render_techniques::depth_prepass> m_depth_prepass;
 };
 
 }
@@ -0,0 +1,241 @@
+#include "residency_manager.hpp"
+
+#include "cooked_mesh.hpp"
+#include "mesh_lod.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace squadbox::gfx {
+
+residency_manager_base::residency_manager_base(const render_manager& render_manager, const residency_options& options)
+    : m_render_manager(&render_manager), m_options(options) {
+}
+
+residency_manager_base::asset_id residency_manager_base::add(std::vector<std::string> level_paths, const bounding_sphere& bounds) {
+    if (level_paths.empty()) {
+        throw std::runtime_error("residency_manager: an asset needs at least one level.");
+    }
+
+    tracked_asset asset;
+    asset.bounds = bounds;
+
+    for (auto& path : level_paths) {
+        asset_level level;
+
+        const cooked_mesh_file file(path);
+        for (std::size_t mesh = 0; mesh < file.mesh_count(); ++mesh) {
+            level.size += file.desc(mesh).data_size;
+        }
+
+        level.path = std::move(path);
+        asset.levels.push_back(std::move(level));
+    }
+
+    m_assets.push_back(std::move(asset));
+    return static_cast<asset_id>(m_assets.size() - 1);
+}
+
+void residency_manager_base::update_residency(const camera& camera, const vk::Viewport& viewport) {
+    ++m_frame;
+
+    const auto retired = std::partition(m_retiring_levels.begin(), m_retiring_levels.end(), [this](const retiring_level& level) {
+        return !m_render_manager->is_frame_complete(level.frame_serial);
+    });
+
+    for (auto level = retired; level != m_retiring_levels.end(); ++level) {
+        m_used_bytes -= level->size;
+        m_retiring_bytes -= level->size;
+    }
+
+    m_retiring_levels.erase(retired, m_retiring_levels.end());
+
+    const auto error_to_pixels = lod_error_to_pixels(camera.projection_matrix(), std::abs(viewport.height));
+    const auto view_frustum = camera.view_frustum();
+    const auto camera_position = camera.position();
+
+    for (auto& asset : m_assets) {
+        asset.visible = view_frustum.intersects(asset.bounds);
+        if (asset.visible) asset.last_used = m_frame;
+
+        // From within the sphere, it's as big as it gets.
+        const auto distance = std::max(glm::length(asset.bounds.center - camera_position), asset.bounds.radius);
+        asset.pixel_radius = distance > 0.0f ? asset.bounds.radius * error_to_pixels / distance : 0.0f;
+
+        asset.wanted_levels = 0;
+        if (asset.last_used != 0 && m_frame - asset.last_used <= m_options.keep_frames) {
+            asset.wanted_levels = 1;
+
+            auto pixel_radius = m_options.detail_pixel_radius;
+            while (asset.wanted_levels < asset.levels.size() && asset.pixel_radius >= pixel_radius) {
+                ++asset.wanted_levels;
+                pixel_radius *= 2.0f;
+            }
+        }
+    }
+
+    // Whatever no longer fits, e.g. after the budget was lowered. Levels already evicted are freed soon regardless.
+    const auto budget = m_options.budget;
+    if (m_used_bytes - m_retiring_bytes > budget) {
+        auto excess = m_used_bytes - m_retiring_bytes - budget;
+
+        for (const auto& eviction : eviction_order([](const tracked_asset&, std::uint32_t) { return true; })) {
+            const auto size = m_assets[eviction.id].levels[eviction.level].size;
+            evict_level(eviction);
+
+            if (size >= excess) break;
+            excess -= size;
+        }
+    }
+
+    struct candidate {
+        asset_id id;
+        std::uint32_t level;
+    };
+
+    // Only the next level of each asset; the ones after it are candidates once it's resident.
+    std::vector<candidate> candidates;
+    for (asset_id id = 0; id < m_assets.size(); ++id) {
+        const auto& asset = m_assets[id];
+        if (!asset.visible || asset.loading || asset.resident_levels >= asset.wanted_levels) continue;
+
+        const auto& level = asset.levels[asset.resident_levels];
+        if (level.state == level_state::failed && m_frame < level.retry_frame) continue;
+
+        candidates.push_back({ id, asset.resident_levels });
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [this](const candidate& a, const candidate& b) {
+        if (a.level != b.level) return a.level < b.level;
+        return m_assets[a.id].pixel_radius > m_assets[b.id].pixel_radius;
+    });
+
+    for (const auto& candidate : candidates) {
+        if (m_loads_in_flight >= m_options.max_loads_in_flight) break;
+
+        auto& asset = m_assets[candidate.id];
+        // Making room for a candidate before this one may have evicted levels of this asset.
+        if (asset.resident_levels != candidate.level) continue;
+
+        auto& level = asset.levels[candidate.level];
+
+        const auto needed = m_used_bytes - m_retiring_bytes + level.size;
+        if (needed > budget) {
+            const auto lower_priority = [&candidate, &asset](const tracked_asset& other, std::uint32_t other_level) {
+                if (other_level >= other.wanted_levels) return true;
+                return other_level > candidate.level || (other_level == candidate.level && other.pixel_radius < asset.pixel_radius);
+            };
+
+            if (!make_room(needed - budget, lower_priority)) continue;
+        }
+
+        // Evicted levels count until the frames drawing them retire. Waiting for them rather than moving on keeps the
+        // room made from going to a candidate of lower priority.
+        if (m_used_bytes + level.size > budget) break;
+
+        asset.loading = true;
+        level.state = level_state::loading;
+        m_used_bytes += level.size;
+        ++m_loads_in_flight;
+
+        start_load(candidate.id, candidate.level, level.path);
+    }
+}
+
+void residency_manager_base::load_finished(asset_id id, std::uint32_t level, vk::DeviceSize size) {
+    auto& asset = m_assets[id];
+    auto& asset_level = asset.levels[level];
+    assert(asset.loading && asset.resident_levels == level);
+
+    m_used_bytes = m_used_bytes - asset_level.size + size;
+    asset_level.size = size;
+    asset_level.state = level_state::resident;
+    asset.resident_levels = level + 1;
+    asset.loading = false;
+    --m_loads_in_flight;
+}
+
+void residency_manager_base::load_failed(asset_id id, std::uint32_t level, const std::string& message) {
+    auto& asset = m_assets[id];
+    auto& asset_level = asset.levels[level];
+    assert(asset.loading && asset.resident_levels == level);
+
+    m_used_bytes -= asset_level.size;
+    asset_level.state = level_state::failed;
+    asset_level.retry_frame = m_frame + m_options.retry_frames;
+    asset.loading = false;
+    --m_loads_in_flight;
+    m_last_error = message;
+
+    // Most likely the memory pool ran out before the budget did, e.g. to fragmentation or other allocations, so
+    // levels nothing wants are evicted to make up for it.
+    for (const auto& eviction : eviction_order([](const tracked_asset& asset, std::uint32_t level) { return level >= asset.wanted_levels; })) {
+        evict_level(eviction);
+    }
+}
+
+std::vector<residency_manager_base::eviction> residency_manager_base::eviction_order(const eviction_filter& allowed) const {
+    std::vector<eviction> order;
+
+    for (asset_id id = 0; id < m_assets.size(); ++id) {
+        const auto& asset = m_assets[id];
+        if (asset.loading) continue;
+
+        for (auto level = asset.resident_levels; level-- > 0;) {
+            if (!allowed(asset, level)) break;
+            order.push_back({ id, level, level < asset.wanted_levels });
+        }
+    }
+
+    // Keeps the levels of an asset finest first, as either all of them are wanted, or the finer ones aren't, and the
+    // ones that aren't are ordered by when the asset was last used.
+    std::sort(order.begin(), order.end(), [this](const eviction& a, const eviction& b) {
+        if (a.wanted != b.wanted) return !a.wanted;
+
+        const auto& asset_a = m_assets[a.id];
+        const auto& asset_b = m_assets[b.id];
+
+        if (!a.wanted && asset_a.last_used != asset_b.last_used) return asset_a.last_used < asset_b.last_used;
+        if (a.level != b.level) return a.level > b.level;
+        if (a.wanted && asset_a.pixel_radius != asset_b.pixel_radius) return asset_a.pixel_radius < asset_b.pixel_radius;
+        return a.id < b.id;
+    });
+
+    return order;
+}
+
+bool residency_manager_base::make_room(vk::DeviceSize bytes, const eviction_filter& allowed) {
+    const auto order = eviction_order(allowed);
+
+    vk::DeviceSize freed = 0;
+    std::size_t count = 0;
+    while (count < order.size() && freed < bytes) {
+        freed += m_assets[order[count].id].levels[order[count].level].size;
+        ++count;
+    }
+
+    if (freed < bytes) return false;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        evict_level(order[i]);
+    }
+
+    return true;
+}
+
+void residency_manager_base::evict_level(const eviction& eviction) {
+    auto& asset = m_assets[eviction.id];
+    assert(!asset.loading && eviction.level + 1 == asset.resident_levels);
+
+    auto& level = asset.levels[eviction.level];
+    level.state = level_state::unloaded;
+    --asset.resident_levels;
+
+    // Draws this frame can't pick it up anymore, and earlier frames have lower serials.
+    m_retiring_levels.push_back({ m_render_manager->frame_serial(), level.size, evict(eviction.id, eviction.level) });
+    m_retiring_bytes += level.size;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+#ifndef SQUADBOX_GFX_RESIDENCY_MANAGER_HPP
+#define SQUADBOX_GFX_RESIDENCY_MANAGER_HPP
+
+#pragma once
+
+#include "asset_importer.hpp"
+#include "bounds.hpp"
+#include "camera.hpp"
+#include "render_manager.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/gsl>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace squadbox::gfx {
+
+struct residency_options {
+    // Device local memory the levels may take, counting the ones loading and the ones evicted but still in use by
+    // frames in flight.
+    vk::DeviceSize budget = 256 * 1024 * 1024;     // 256 MiB
+    std::uint32_t max_loads_in_flight = 4;
+    // Level 1 is wanted once an asset's bounding sphere is this big on screen, as a radius in pixels; every finer level
+    // needs twice the radius of the one before. Level 0 is wanted whenever the asset is in view.
+    float detail_pixel_radius = 32.0f;
+    // Assets that leave the view stay wanted for this many frames, so looking back doesn't reload them.
+    std::uint32_t keep_frames = 120;
+    // Frames to wait before loading a level that failed to load again.
+    std::uint32_t retry_frames = 60;
+};
+
+// What residency_manager decides, independent of the mesh type. Assets are streamed in level by level, coarsest
+// first, so a coarse level is drawn while the finer ones load. Their levels are always loaded in order, so the
+// resident ones are levels [0, resident_levels()).
+//
+// Every update(), levels are loaded in order of priority: any asset's level 0 before a finer level, and bigger on
+// screen first. Once the budget is full, levels nothing wants are evicted least recently used first, then wanted
+// levels of a lower priority than the one to load. Loads are started only if they can be made to fit.
+class residency_manager_base {
+public:
+    using asset_id = std::uint32_t;
+
+    residency_manager_base(const render_manager& render_manager, const residency_options& options);
+    residency_manager_base(const residency_manager_base&) = delete;
+    virtual ~residency_manager_base() = default;
+
+    // Cooked files of an asset's levels, coarsest first, and the world space bounds of its meshes. Reads the descs of
+    // every file to size its levels; throws if one isn't a cooked file. Nothing is loaded before the asset is in view.
+    asset_id add(std::vector<std::string> level_paths, const bounding_sphere& bounds);
+
+    std::size_t asset_count() const { return m_assets.size(); }
+    std::uint32_t level_count(asset_id id) const { return static_cast<std::uint32_t>(m_assets[id].levels.size()); }
+    std::uint32_t resident_levels(asset_id id) const { return m_assets[id].resident_levels; }
+    // Of the levels the asset's distance and screen size call for. Zero once it has been out of view for keep_frames.
+    std::uint32_t wanted_levels(asset_id id) const { return m_assets[id].wanted_levels; }
+
+    // Counted against the budget.
+    vk::DeviceSize used_bytes() const { return m_used_bytes; }
+    std::uint32_t loads_in_flight() const { return m_loads_in_flight; }
+    const residency_options& options() const { return m_options; }
+    // Takes effect on the next update(), evicting what no longer fits.
+    void set_budget(vk::DeviceSize budget) { m_options.budget = budget; }
+
+    // Of the last load that failed, empty if none did.
+    const std::string& last_error() const { return m_last_error; }
+
+protected:
+    // Frame thread only, once a frame, with the camera the frame is drawn with.
+    void update_residency(const camera& camera, const vk::Viewport& viewport);
+
+    // From the subclass as its loads finish, with the memory size of what was loaded.
+    void load_finished(asset_id id, std::uint32_t level, vk::DeviceSize size);
+    void load_failed(asset_id id, std::uint32_t level, const std::string& message);
+
+private:
+    enum class level_state {
+        unloaded,
+        loading,
+        resident,
+        failed
+    };
+
+    struct asset_level {
+        std::string path;
+        level_state state = level_state::unloaded;
+        // The buffers' sizes from the file until the level has been loaded, then the memory it took.
+        vk::DeviceSize size = 0;
+        std::uint64_t retry_frame = 0;
+    };
+
+    struct tracked_asset {
+        bounding_sphere bounds;
+        std::vector<asset_level> levels;
+        std::uint32_t resident_levels = 0;
+        std::uint32_t wanted_levels = 0;
+        float pixel_radius = 0.0f;
+        bool visible = false;
+        bool loading = false;
+        // Frame the asset was last in view, 0 if never.
+        std::uint64_t last_used = 0;
+    };
+
+    struct eviction {
+        asset_id id;
+        std::uint32_t level;
+        bool wanted;
+    };
+
+    struct retiring_level {
+        std::uint64_t frame_serial;
+        vk::DeviceSize size;
+        std::shared_ptr<void> resources;
+    };
+
+    // Starts loading a level; load_finished() or load_failed() has to follow.
+    virtual void start_load(asset_id id, std::uint32_t level, const std::string& path) = 0;
+    // Gives up a resident level's resources. They're held until the frames that might draw them have retired.
+    virtual std::shared_ptr<void> evict(asset_id id, std::uint32_t level) = 0;
+
+    using eviction_filter = std::function<bool(const tracked_asset& asset, std::uint32_t level)>;
+
+    // Resident levels the filter allows, in the order to evict them: levels nothing wants least recently used first,
+    // then wanted ones lowest priority first. Within an asset, finest first; a level is only allowed if every finer
+    // resident level of its asset is. Assets loading a level are left alone.
+    std::vector<eviction> eviction_order(const eviction_filter& allowed) const;
+    // Evicts the levels allowed, in order, until at least bytes are freed. Evicts nothing if that many can't be.
+    bool make_room(vk::DeviceSize bytes, const eviction_filter& allowed);
+    void evict_level(const eviction& eviction);
+
+    gsl::not_null<const render_manager*> m_render_manager;
+    residency_options m_options;
+    std::vector<tracked_asset> m_assets;
+    std::vector<retiring_level> m_retiring_levels;
+    vk::DeviceSize m_used_bytes = 0;
+    vk::DeviceSize m_retiring_bytes = 0;
+    std::uint32_t m_loads_in_flight = 0;
+    std::uint64_t m_frame = 0;
+    std::string m_last_error;
+};
+
+// Keeps the meshes of a large world within a fixed memory budget, loading the levels of every asset from cooked
+// files with an asset_importer as the camera gets close, and evicting them as it moves away. Loaded meshes are turned
+// into whatever the draws need by prepare, e.g. flat_shading::prepare_render_data() for each.
+//
+// update() has to be called once a frame on the thread submitting frames, after asset_importer::update(), and before
+// drawing. Evicted levels are released once the frames drawing them retire, so resident() is safe to draw from until
+// the next update().
+template<typename gpu_mesh_type, typename resource_type = std::vector<gpu_mesh_type>>
+class residency_manager : public residency_manager_base {
+public:
+    using prepare_function = std::function<resource_type(std::vector<gpu_mesh_type>&& meshes)>;
+
+    residency_manager(const render_manager& render_manager, asset_importer& asset_importer, const residency_options& options = {},
+                      prepare_function prepare = [](std::vector<gpu_mesh_type>&& meshes) { return resource_type(std::move(meshes)); })
+        : residency_manager_base(render_manager, options), m_asset_importer(&asset_importer), m_prepare(std::move(prepare)) {}
+
+    asset_id add(std::vector<std::string> level_paths, const bounding_sphere& bounds) {
+        const auto num_levels = level_paths.size();
+        const auto id = residency_manager_base::add(std::move(level_paths), bounds);
+        m_resources.emplace_back(num_levels);
+        return id;
+    }
+
+    void update(const camera& camera, const vk::Viewport& viewport) {
+        for (std::size_t i = 0; i < m_loads.size();) {
+            auto& load = m_loads[i];
+            if (load.meshes.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++i;
+                continue;
+            }
+
+            try {
+                auto meshes = load.meshes.get();
+
+                vk::DeviceSize size = 0;
+                for (const auto& mesh : meshes) {
+                    size += mesh.memory_size();
+                }
+
+                m_resources[load.id][load.level] = std::make_shared<resource_type>(m_prepare(std::move(meshes)));
+                load_finished(load.id, load.level, size);
+            }
+            catch (const std::exception& e) {
+                load_failed(load.id, load.level, e.what());
+            }
+
+            load = std::move(m_loads.back());
+            m_loads.pop_back();
+        }
+
+        update_residency(camera, viewport);
+    }
+
+    // The finest resident level, null while none is.
+    const resource_type* resident(asset_id id) const {
+        const auto levels = resident_levels(id);
+        return levels != 0 ? m_resources[id][levels - 1].get() : nullptr;
+    }
+
+private:
+    struct load {
+        asset_id id;
+        std::uint32_t level;
+        std::future<std::vector<gpu_mesh_type>> meshes;
+    };
+
+    void start_load(asset_id id, std::uint32_t level, const std::string& path) override {
+        m_loads.push_back({ id, level, m_asset_importer->import_cooked<gpu_mesh_type>(path) });
+    }
+
+    std::shared_ptr<void> evict(asset_id id, std::uint32_t level) override {
+        return std::move(m_resources[id][level]);
+    }
+
+    gsl::not_null<asset_importer*> m_asset_importer;
+    prepare_function m_prepare;
+    std::vector<std::vector<std::shared_ptr<resource_type>>> m_resources;
+    std::vector<load> m_loads;
+};
+
+}
+
+#endif
\ No newline at end of file
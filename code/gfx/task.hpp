@@ -0,0 +1,134 @@
+#ifndef SQUADBOX_GFX_TASK_HPP
+#define SQUADBOX_GFX_TASK_HPP
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace squadbox::gfx {
+
+template<typename T = void>
+class task;
+
+namespace internal_task {
+    // Resumes whoever awaited the task, if anyone did; a task nobody awaits stays suspended when done, for its owner
+    // to destroy.
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+
+        template<typename promise_type>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+            const auto continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    struct promise_base {
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        final_awaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+    };
+
+    template<typename T>
+    struct promise : promise_base {
+        task<T> get_return_object();
+
+        template<typename value_type>
+        void return_value(value_type&& value) { result.emplace(std::forward<value_type>(value)); }
+
+        T get() {
+            if (exception) std::rethrow_exception(exception);
+            return std::move(*result);
+        }
+
+        std::optional<T> result;
+    };
+
+    template<>
+    struct promise<void> : promise_base {
+        task<void> get_return_object();
+
+        void return_void() {}
+
+        void get() {
+            if (exception) std::rethrow_exception(exception);
+        }
+    };
+}
+
+// A coroutine that starts once awaited, and resumes its awaiter when done, with its result or its exception. Loading
+// code is written as a chain of tasks awaiting each other, with a frame_poller's awaitables at the bottom and
+// frame_poller::spawn() at the top. The task owns the coroutine; destroying it destroys the coroutine too, so it has
+// to outlive the coroutine's suspensions.
+template<typename T>
+class task {
+public:
+    using promise_type = internal_task::promise<T>;
+
+    task() = default;
+    explicit task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    task(const task&) = delete;
+    task(task&& rhs) noexcept : m_handle(std::exchange(rhs.m_handle, {})) {}
+
+    ~task() {
+        if (m_handle) m_handle.destroy();
+    }
+
+    task& operator=(task&& rhs) noexcept {
+        if (this != &rhs) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(rhs.m_handle, {});
+        }
+
+        return *this;
+    }
+
+    bool valid() const { return static_cast<bool>(m_handle); }
+    bool done() const { return m_handle && m_handle.done(); }
+
+    auto operator co_await() const noexcept {
+        struct awaiter {
+            bool await_ready() const noexcept { return handle.done(); }
+
+            // Straight into the task, without growing the stack.
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() const { return handle.promise().get(); }
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        return awaiter { m_handle };
+    }
+
+private:
+    friend class frame_poller;
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace internal_task {
+    template<typename T>
+    task<T> promise<T>::get_return_object() {
+        return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+    }
+
+    inline task<void> promise<void>::get_return_object() {
+        return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+    }
+}
+
+}
+
+#endif
\ No newline at end of file
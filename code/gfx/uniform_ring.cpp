@@ -0,0 +1,180 @@
+#include "uniform_ring.hpp"
+
+#include "vulkan_manager.hpp"
+#include "vulkan_utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <tuple>
+
+namespace squadbox::gfx {
+
+namespace {
+    constexpr std::uint32_t max_buffers = 256;
+}
+
+uniform_ring::uniform_ring(const vulkan_manager& vulkan_manager, std::uint32_t num_frames,
+                           bindless_heap* bindless_heap, vk::DeviceSize initial_frame_size)
+    : m_device(vulkan_manager.device()),
+      m_device_memory_props(vulkan_manager.physical_device().getMemoryProperties()),
+      m_bindless_heap(bindless_heap),
+      m_frames(num_frames) {
+    m_alignment = [](const vk::PhysicalDevice& physical_device) {
+        const auto limits = physical_device.getProperties().limits;
+
+        // vec4 granularity keeps bindless offsets exact.
+        return std::max<vk::DeviceSize>({ limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, 16 });
+    }(vulkan_manager.physical_device());
+
+    m_descriptor_set_layout = [](const vk::Device& device) {
+        vk::DescriptorSetLayoutBinding layout_binding;
+        layout_binding
+            .setBinding(binding)
+            .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+            .setStageFlags(vk::ShaderStageFlagBits::eAll)
+            .setDescriptorCount(1);
+
+        vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_ci;
+        descriptor_set_layout_ci
+            .setPBindings(&layout_binding)
+            .setBindingCount(1);
+
+        return device.createDescriptorSetLayoutUnique(descriptor_set_layout_ci);
+    }(m_device);
+
+    m_descriptor_pool = [](const vk::Device& device) {
+        vk::DescriptorPoolSize descriptor_pool_size;
+        descriptor_pool_size
+            .setType(vk::DescriptorType::eUniformBufferDynamic)
+            .setDescriptorCount(max_buffers);
+
+        vk::DescriptorPoolCreateInfo descriptor_pool_ci;
+        descriptor_pool_ci
+            .setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+            .setPPoolSizes(&descriptor_pool_size)
+            .setPoolSizeCount(1)
+            .setMaxSets(max_buffers);
+
+        return device.createDescriptorPoolUnique(descriptor_pool_ci);
+    }(m_device);
+
+    m_update_template = [](const vk::Device& device, const vk::DescriptorSetLayout& descriptor_set_layout) {
+        std::array<vk::DescriptorUpdateTemplateEntry, 1> entries;
+        entries[0]
+            .setDstBinding(binding)
+            .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+            .setDescriptorCount(1)
+            .setOffset(offsetof(descriptor_data_t, buffer))
+            .setStride(sizeof(vk::DescriptorBufferInfo));
+
+        return descriptor_update_template<descriptor_data_t> { device, descriptor_set_layout, entries };
+    }(m_device, m_descriptor_set_layout.get());
+
+    for (auto& frame : m_frames) {
+        frame.buffers.push_back(create_buffer(initial_frame_size));
+        frame.current_buffer = frame.buffers.back().get();
+    }
+}
+
+uniform_ring::allocation uniform_ring::allocate(std::uint32_t frame_index, std::uint32_t size) {
+    assert(size <= max_allocation_size);
+
+    const auto aligned_size = (size + m_alignment - 1) / m_alignment * m_alignment;
+    auto& frame = m_frames[frame_index];
+
+    while (true) {
+        auto buffer = frame.current_buffer.load(std::memory_order_acquire);
+        const auto offset = buffer->head.fetch_add(aligned_size, std::memory_order_relaxed);
+
+        if (offset + aligned_size <= buffer->capacity) {
+            allocation result;
+            result.descriptor_set = buffer->descriptor_set.get();
+            result.dynamic_offset = static_cast<std::uint32_t>(offset);
+            result.data = buffer->mapped_data + offset;
+            result.bindless_id = buffer->bindless_storage_handle.id();
+            result.bindless_offset = static_cast<std::uint32_t>(offset / 16);
+
+            return result;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Another thread may have chained a buffer in while we waited.
+        if (frame.current_buffer.load(std::memory_order_relaxed) == buffer) {
+            frame.buffers.push_back(create_buffer(buffer->capacity * 2));
+            frame.current_buffer.store(frame.buffers.back().get(), std::memory_order_release);
+        }
+    }
+}
+
+void uniform_ring::reset(std::uint32_t frame_index) {
+    auto& frame = m_frames[frame_index];
+
+    if (frame.buffers.size() > 1) {
+        vk::DeviceSize total_capacity = 0;
+        for (const auto& buffer : frame.buffers) {
+            total_capacity += buffer->capacity;
+        }
+
+        frame.buffers.clear();
+        frame.buffers.push_back(create_buffer(total_capacity));
+    }
+
+    frame.buffers.back()->head.store(0, std::memory_order_relaxed);
+    frame.current_buffer.store(frame.buffers.back().get(), std::memory_order_release);
+}
+
+std::unique_ptr<uniform_ring::buffer_data> uniform_ring::create_buffer(vk::DeviceSize capacity) {
+    auto buffer = std::make_unique<buffer_data>();
+
+    // Room past the last allocation for a full descriptor range.
+    const auto buffer_size = capacity + max_allocation_size;
+
+    std::tie(buffer->buffer, buffer->memory) = [](const vk::Device& device, const vk::PhysicalDeviceMemoryProperties& device_memory_props,
+                                                  const vk::DeviceSize buffer_size, bool storage) {
+        vk::BufferCreateInfo buffer_ci;
+        buffer_ci
+            .setSize(buffer_size)
+            .setUsage(storage ? vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer
+                              : vk::BufferUsageFlagBits::eUniformBuffer)
+            .setSharingMode(vk::SharingMode::eExclusive);
+
+        auto buffer = device.createBufferUnique(buffer_ci);
+        auto buffer_memory_reqs = device.getBufferMemoryRequirements(buffer.get());
+        auto buffer_memory = vk_utils::alloc_memory(device, device_memory_props, buffer_memory_reqs,
+                                                    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        device.bindBufferMemory(buffer.get(), buffer_memory.get(), 0);
+
+        return std::make_tuple(std::move(buffer), std::move(buffer_memory));
+    }(m_device, m_device_memory_props, buffer_size, m_bindless_heap != nullptr);
+
+    buffer->mapped_data = static_cast<std::byte*>(m_device.mapMemory(buffer->memory.get(), 0, VK_WHOLE_SIZE));
+    buffer->capacity = capacity;
+
+    buffer->descriptor_set = [](const vk::Device& device, const vk::DescriptorSetLayout& layout, const vk::DescriptorPool& pool) {
+        vk::DescriptorSetAllocateInfo descriptor_set_alloc_info;
+        descriptor_set_alloc_info
+            .setDescriptorPool(pool)
+            .setPSetLayouts(&layout)
+            .setDescriptorSetCount(1);
+
+        return std::move(device.allocateDescriptorSetsUnique(descriptor_set_alloc_info)[0]);
+    }(m_device, m_descriptor_set_layout.get(), m_descriptor_pool.get());
+
+    descriptor_data_t descriptor_data;
+    descriptor_data.buffer
+        .setBuffer(buffer->buffer.get())
+        .setOffset(0)
+        .setRange(max_allocation_size);
+
+    m_update_template.update(buffer->descriptor_set.get(), descriptor_data);
+
+    if (m_bindless_heap) {
+        buffer->bindless_storage_handle = m_bindless_heap->add_storage_buffer(buffer->buffer.get());
+    }
+
+    return buffer;
+}
+
+}
\ No newline at end of file
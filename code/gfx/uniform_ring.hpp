@@ -0,0 +1,111 @@
+#ifndef SQUADBOX_GFX_UNIFORM_RING_HPP
+#define SQUADBOX_GFX_UNIFORM_RING_HPP
+
+#pragma once
+
+#include "bindless_heap.hpp"
+#include "descriptor_allocator.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace squadbox::gfx {
+
+class vulkan_manager;
+
+// Per-frame linear allocator for short-lived shader constants.
+//
+// Each frame in flight has its own persistently mapped, host-coherent buffers, so data written
+// for one frame never races with frames the GPU is still reading. Allocations are a single
+// atomic add; a new, larger buffer is chained in when the current one is full, and the chain is
+// folded into one buffer once the frame retires.
+//
+// Data is bound as a UNIFORM_BUFFER_DYNAMIC descriptor (descriptor_set_layout(), binding 0) with
+// the allocation's dynamic offset. With a bindless heap the buffers are also registered as
+// storage buffers, readable as vec4[] at bindless_offset.
+class uniform_ring {
+public:
+    static constexpr std::uint32_t binding = 0;
+
+    // Largest single allocation, and the range of the dynamic uniform buffer descriptor.
+    static constexpr std::uint32_t max_allocation_size = 1024;
+
+    struct allocation {
+        vk::DescriptorSet descriptor_set;
+        std::uint32_t dynamic_offset = 0;
+        void* data = nullptr;
+
+        std::uint32_t bindless_id = bindless_handle::invalid_id;
+        std::uint32_t bindless_offset = 0;  // in vec4s
+    };
+
+    uniform_ring(const vulkan_manager& vulkan_manager, std::uint32_t num_frames,
+                 bindless_heap* bindless_heap = nullptr, vk::DeviceSize initial_frame_size = 256 * 1024);
+
+    uniform_ring(const uniform_ring&) = delete;
+    uniform_ring& operator=(const uniform_ring&) = delete;
+
+    const vk::DescriptorSetLayout& descriptor_set_layout() const { return m_descriptor_set_layout.get(); }
+
+    // Thread safe.
+    allocation allocate(std::uint32_t frame_index, std::uint32_t size);
+
+    template<typename data_type>
+    allocation push(std::uint32_t frame_index, const data_type& data) {
+        static_assert(std::is_trivially_copyable_v<data_type>);
+        static_assert(sizeof(data_type) <= max_allocation_size);
+
+        auto result = allocate(frame_index, sizeof(data_type));
+        std::memcpy(result.data, &data, sizeof(data_type));
+
+        return result;
+    }
+
+    // Call once the frame's previous submission has retired, before allocating for it again.
+    void reset(std::uint32_t frame_index);
+
+private:
+    struct buffer_data {
+        vk::UniqueBuffer buffer;
+        vk::UniqueDeviceMemory memory;
+        std::byte* mapped_data = nullptr;
+        vk::DeviceSize capacity = 0;
+        std::atomic<vk::DeviceSize> head { 0 };
+
+        vk::UniqueDescriptorSet descriptor_set;
+        bindless_handle bindless_storage_handle;
+    };
+
+    struct frame_data {
+        std::vector<std::unique_ptr<buffer_data>> buffers;
+        std::atomic<buffer_data*> current_buffer { nullptr };
+    };
+
+    struct descriptor_data_t {
+        vk::DescriptorBufferInfo buffer;
+    };
+
+    std::unique_ptr<buffer_data> create_buffer(vk::DeviceSize capacity);
+
+    vk::Device m_device;
+    vk::PhysicalDeviceMemoryProperties m_device_memory_props;
+    vk::DeviceSize m_alignment;
+    bindless_heap* m_bindless_heap;
+
+    vk::UniqueDescriptorSetLayout m_descriptor_set_layout;
+    vk::UniqueDescriptorPool m_descriptor_pool;
+    descriptor_update_template<descriptor_data_t> m_update_template;
+
+    std::mutex m_mutex;
+    std::vector<frame_data> m_frames;
+};
+
+}
+
+#endif
\ No newline at end of file
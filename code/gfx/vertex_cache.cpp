@@ -0,0 +1,169 @@
+#include "vertex_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <unordered_map>
+
+namespace squadbox::gfx {
+
+namespace {
+    constexpr auto no_vertex = std::numeric_limits<std::uint32_t>::max();
+
+    void tipsify(gsl::span<std::uint32_t> indices, std::uint32_t vertex_count, std::uint32_t cache_size) {
+        const auto num_triangles = static_cast<std::uint32_t>(indices.size() / 3);
+
+        // Triangles around every vertex, and how many of them are still to be emitted.
+        std::vector<std::uint32_t> triangle_offsets(vertex_count + 1, 0);
+        for (const auto index : indices) ++triangle_offsets[index + 1];
+        for (std::uint32_t v = 0; v < vertex_count; ++v) triangle_offsets[v + 1] += triangle_offsets[v];
+
+        std::vector<std::uint32_t> vertex_triangles(indices.size());
+        std::vector<std::uint32_t> live_triangles(vertex_count);
+        {
+            auto write_offsets = triangle_offsets;
+            for (std::ptrdiff_t i = 0; i < indices.size(); ++i) {
+                vertex_triangles[write_offsets[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+            }
+        }
+
+        for (std::uint32_t v = 0; v < vertex_count; ++v) {
+            live_triangles[v] = triangle_offsets[v + 1] - triangle_offsets[v];
+        }
+
+        std::vector<std::uint32_t> cache_timestamps(vertex_count, 0);
+        std::vector<bool> emitted(num_triangles, false);
+        std::vector<std::uint32_t> dead_end_stack;
+        std::vector<std::uint32_t> candidates;
+        std::vector<std::uint32_t> output;
+        output.reserve(indices.size());
+
+        std::uint32_t timestamp = cache_size + 1;
+        std::uint32_t cursor = 0;
+
+        // Recently used vertices with triangles left, then the input order.
+        const auto skip_dead_end = [&]() {
+            while (!dead_end_stack.empty()) {
+                const auto vertex = dead_end_stack.back();
+                dead_end_stack.pop_back();
+
+                if (live_triangles[vertex] > 0) return vertex;
+            }
+
+            for (; cursor < vertex_count; ++cursor) {
+                if (live_triangles[cursor] > 0) return cursor;
+            }
+
+            return no_vertex;
+        };
+
+        auto fanning_vertex = skip_dead_end();
+
+        while (fanning_vertex != no_vertex) {
+            candidates.clear();
+
+            for (auto t = triangle_offsets[fanning_vertex]; t < triangle_offsets[fanning_vertex + 1]; ++t) {
+                const auto triangle = vertex_triangles[t];
+                if (emitted[triangle]) continue;
+
+                emitted[triangle] = true;
+
+                for (std::uint32_t v = 0; v < 3; ++v) {
+                    const auto vertex = indices[triangle * 3 + v];
+
+                    output.push_back(vertex);
+                    dead_end_stack.push_back(vertex);
+                    candidates.push_back(vertex);
+                    --live_triangles[vertex];
+
+                    if (timestamp - cache_timestamps[vertex] > cache_size) {
+                        cache_timestamps[vertex] = timestamp++;
+                    }
+                }
+            }
+
+            // The candidate that will still be in the cache after its remaining triangles are emitted, and has
+            // been there the longest.
+            auto best_vertex = no_vertex;
+            std::int64_t best_priority = -1;
+
+            for (const auto vertex : candidates) {
+                if (live_triangles[vertex] == 0) continue;
+
+                std::int64_t priority = 0;
+                if (timestamp - cache_timestamps[vertex] + 2 * live_triangles[vertex] <= cache_size) {
+                    priority = timestamp - cache_timestamps[vertex];
+                }
+
+                if (priority > best_priority) {
+                    best_priority = priority;
+                    best_vertex = vertex;
+                }
+            }
+
+            fanning_vertex = best_vertex != no_vertex ? best_vertex : skip_dead_end();
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin());
+    }
+}
+
+float calculate_acmr(gsl::span<const std::uint32_t> triangle_list_indices, std::uint32_t cache_size) {
+    assert(triangle_list_indices.size() % 3 == 0);
+    if (triangle_list_indices.empty()) return 0.0f;
+
+    std::vector<std::uint32_t> fifo(cache_size, no_vertex);
+    std::uint32_t fifo_head = 0;
+    std::size_t misses = 0;
+
+    for (const auto index : triangle_list_indices) {
+        if (std::find(fifo.begin(), fifo.end(), index) != fifo.end()) continue;
+
+        fifo[fifo_head] = index;
+        fifo_head = (fifo_head + 1) % cache_size;
+        ++misses;
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(triangle_list_indices.size() / 3);
+}
+
+void optimize_vertex_cache(gsl::span<std::uint32_t> triangle_list_indices, std::uint32_t cache_size) {
+    assert(triangle_list_indices.size() % 3 == 0);
+    if (triangle_list_indices.empty()) return;
+
+    // Works on the vertices the span uses, numbered densely in order of first use, so small ranges of big meshes
+    // stay cheap. A hash table rather than a sort keeps it linear.
+    std::vector<std::uint32_t> vertices;
+    std::unordered_map<std::uint32_t, std::uint32_t> dense_indices;
+    dense_indices.reserve(triangle_list_indices.size());
+
+    for (auto& index : triangle_list_indices) {
+        const auto [it, inserted] = dense_indices.try_emplace(index, static_cast<std::uint32_t>(vertices.size()));
+        if (inserted) vertices.push_back(index);
+        index = it->second;
+    }
+
+    tipsify(triangle_list_indices, static_cast<std::uint32_t>(vertices.size()), cache_size);
+
+    for (auto& index : triangle_list_indices) {
+        index = vertices[index];
+    }
+}
+
+std::vector<std::uint32_t> optimize_vertex_fetch(gsl::span<std::uint32_t> triangle_list_indices, std::size_t vertex_count) {
+    std::vector<std::uint32_t> remap(vertex_count, no_vertex);
+    std::uint32_t next_vertex = 0;
+
+    for (auto& index : triangle_list_indices) {
+        if (remap[index] == no_vertex) remap[index] = next_vertex++;
+        index = remap[index];
+    }
+
+    for (auto& new_index : remap) {
+        if (new_index == no_vertex) new_index = next_vertex++;
+    }
+
+    return remap;
+}
+
+}
\ No newline at end of file
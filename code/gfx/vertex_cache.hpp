@@ -0,0 +1,37 @@
+#ifndef SQUADBOX_GFX_VERTEX_CACHE_HPP
+#define SQUADBOX_GFX_VERTEX_CACHE_HPP
+
+#pragma once
+
+#include <gsl/gsl>
+
+#include <cstdint>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// ACMR (see calculate_acmr()) before and after reordering.
+struct vertex_cache_stats {
+    float acmr_before = 0.0f;
+    float acmr_after = 0.0f;
+};
+
+// Most GPUs' post-transform caches behave like a FIFO of a few dozen vertices at best; 16 is a safe lower bound.
+constexpr std::uint32_t default_vertex_cache_size = 16;
+
+// Average cache miss ratio: post-transform cache misses per triangle, simulating a FIFO cache over the triangle
+// list. 3 is the worst possible, ~0.5-0.7 is typical of a well ordered regular mesh.
+float calculate_acmr(gsl::span<const std::uint32_t> triangle_list_indices, std::uint32_t cache_size = default_vertex_cache_size);
+
+// Reorders the triangles in place with Tipsify (Sander, Nehab, Barczak 2007), linear time in the triangle count
+// (expected, for the hashing of the vertices the span uses).
+// Only triangles within the span move, so it can be run on separate ranges of a larger list.
+void optimize_vertex_cache(gsl::span<std::uint32_t> triangle_list_indices, std::uint32_t cache_size = default_vertex_cache_size);
+
+// Renumbers vertices in order of first use so vertex fetches walk memory forwards. Vertices the indices don't
+// reference go last. Returns the new index of every old vertex, for reordering the vertex attributes to match.
+std::vector<std::uint32_t> optimize_vertex_fetch(gsl::span<std::uint32_t> triangle_list_indices, std::size_t vertex_count);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "vertex_welding.hpp"
+
+#if defined(__AVX__)
+#define SQUADBOX_GFX_WELD_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SQUADBOX_GFX_WELD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace squadbox::gfx {
+
+namespace {
+    constexpr auto no_vertex = std::numeric_limits<std::uint32_t>::max();
+
+    // From 2^23 up floats have no fraction left, so they're already on the grid. Keeping the rounded values as floats
+    // rather than converting to integers means far away values can't overflow into the same cell.
+    constexpr float exact_integer_limit = 8388608.0f;
+
+    // Rounds values / epsilon to the nearest integer, ties to even, and returns the bits. -0 becomes +0 so both sides of
+    // zero share a cell.
+    void quantize(const float* values, std::size_t count, float inv_epsilon, std::uint32_t* keys) {
+        std::size_t i = 0;
+
+#if defined(SQUADBOX_GFX_WELD_AVX)
+        const auto inv_epsilon_8 = _mm256_set1_ps(inv_epsilon);
+        const auto sign_mask_8 = _mm256_set1_ps(-0.0f);
+        const auto limit_8 = _mm256_set1_ps(exact_integer_limit);
+
+        for (; i + 8 <= count; i += 8) {
+            auto q = _mm256_mul_ps(_mm256_loadu_ps(values + i), inv_epsilon_8);
+
+            // Adding and subtracting 2^23 with q's sign leaves no bits for the fraction, rounding it off.
+            const auto magic = _mm256_or_ps(limit_8, _mm256_and_ps(q, sign_mask_8));
+            const auto rounded = _mm256_sub_ps(_mm256_add_ps(q, magic), magic);
+            const auto in_range = _mm256_cmp_ps(_mm256_andnot_ps(sign_mask_8, q), limit_8, _CMP_LT_OQ);
+
+            q = _mm256_blendv_ps(q, rounded, in_range);
+            q = _mm256_add_ps(q, _mm256_setzero_ps());
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(keys + i), _mm256_castps_si256(q));
+        }
+#elif defined(SQUADBOX_GFX_WELD_SSE2)
+        const auto inv_epsilon_4 = _mm_set1_ps(inv_epsilon);
+        const auto sign_mask_4 = _mm_set1_ps(-0.0f);
+        const auto limit_4 = _mm_set1_ps(exact_integer_limit);
+
+        for (; i + 4 <= count; i += 4) {
+            auto q = _mm_mul_ps(_mm_loadu_ps(values + i), inv_epsilon_4);
+
+            // Adding and subtracting 2^23 with q's sign leaves no bits for the fraction, rounding it off.
+            const auto magic = _mm_or_ps(limit_4, _mm_and_ps(q, sign_mask_4));
+            const auto rounded = _mm_sub_ps(_mm_add_ps(q, magic), magic);
+            const auto in_range = _mm_cmplt_ps(_mm_andnot_ps(sign_mask_4, q), limit_4);
+
+            q = _mm_or_ps(_mm_and_ps(in_range, rounded), _mm_andnot_ps(in_range, q));
+            q = _mm_add_ps(q, _mm_setzero_ps());
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(keys + i), _mm_castps_si128(q));
+        }
+#endif
+
+        for (; i < count; ++i) {
+            auto q = values[i] * inv_epsilon;
+            if (std::abs(q) < exact_integer_limit) q = std::nearbyint(q);
+            q += 0.0f;
+
+            std::memcpy(&keys[i], &q, sizeof(q));
+        }
+    }
+
+    std::uint64_t mix(std::uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    template<typename func_type>
+    void run_on_threads(unsigned int num_threads, const func_type& func) {
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+
+        for (unsigned int i = 1; i < num_threads; ++i) {
+            threads.emplace_back(func, i);
+        }
+
+        func(0);
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+vertex_weld_remap weld_vertices(gsl::span<const vertex_weld_stream> streams, std::size_t vertex_count, unsigned int max_threads) {
+    assert(vertex_count < no_vertex);
+
+    vertex_weld_remap result;
+    if (vertex_count == 0) return result;
+
+    if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    const auto num_threads = vertex_count < vertex_weld_parallel_threshold
+        ? 1u
+        : static_cast<unsigned int>(std::min<std::size_t>(max_threads, vertex_count / (vertex_weld_parallel_threshold / 2)));
+
+    std::vector<std::vector<std::uint32_t>> stream_keys(streams.size());
+    std::vector<float> inv_epsilons(streams.size());
+
+    for (std::ptrdiff_t stream = 0; stream < streams.size(); ++stream) {
+        assert(static_cast<std::size_t>(streams[stream].values.size()) == vertex_count * streams[stream].components);
+        assert(streams[stream].epsilon > 0.0f);
+
+        stream_keys[stream].resize(vertex_count * streams[stream].components);
+        inv_epsilons[stream] = 1.0f / streams[stream].epsilon;
+    }
+
+    std::vector<std::uint64_t> hashes(vertex_count);
+
+    // Vertices each thread's hash table owns, as found by each thread. Chunks are in vertex order, so walking
+    // them in thread order visits a table's vertices in ascending order.
+    std::vector<std::vector<std::vector<std::uint32_t>>> owned_vertices(num_threads, std::vector<std::vector<std::uint32_t>>(num_threads));
+
+    // Maps the hash's high bits to a thread evenly; the table within uses the low bits.
+    const auto owner = [num_threads](std::uint64_t hash) {
+        return static_cast<unsigned int>(((hash >> 32) * num_threads) >> 32);
+    };
+
+    run_on_threads(num_threads, [&](unsigned int thread_index) {
+        const auto begin = vertex_count * thread_index / num_threads;
+        const auto end = vertex_count * (thread_index + 1) / num_threads;
+
+        for (std::ptrdiff_t stream = 0; stream < streams.size(); ++stream) {
+            const auto components = streams[stream].components;
+            quantize(streams[stream].values.data() + begin * components, (end - begin) * components, inv_epsilons[stream],
+                     stream_keys[stream].data() + begin * components);
+        }
+
+        auto& found = owned_vertices[thread_index];
+        for (auto& vertices : found) {
+            vertices.reserve((end - begin) / num_threads + (end - begin) / (num_threads * 8) + 16);
+        }
+
+        for (auto vertex = begin; vertex < end; ++vertex) {
+            std::uint64_t hash = 0;
+
+            for (std::size_t stream = 0; stream < stream_keys.size(); ++stream) {
+                const auto components = streams[stream].components;
+                const auto keys = stream_keys[stream].data() + vertex * components;
+
+                for (std::uint32_t component = 0; component < components; ++component) {
+                    hash = (hash ^ keys[component]) * 0x9e3779b97f4a7c15ull;
+                }
+            }
+
+            hash = mix(hash);
+            hashes[vertex] = hash;
+            found[owner(hash)].push_back(static_cast<std::uint32_t>(vertex));
+        }
+    });
+
+    const auto same_cells = [&](std::uint32_t a, std::uint32_t b) {
+        for (std::size_t stream = 0; stream < stream_keys.size(); ++stream) {
+            const auto components = streams[stream].components;
+            const auto keys = stream_keys[stream].data();
+
+            if (std::memcmp(keys + a * components, keys + b * components, components * sizeof(std::uint32_t)) != 0) return false;
+        }
+
+        return true;
+    };
+
+    // First the vertex each one merges into, the lowest indexed of its kind.
+    result.remap.resize(vertex_count);
+
+    run_on_threads(num_threads, [&](unsigned int thread_index) {
+        std::size_t count = 0;
+        for (const auto& found : owned_vertices) {
+            count += found[thread_index].size();
+        }
+
+        std::size_t capacity = 16;
+        while (capacity < count * 2) capacity *= 2;
+
+        const auto mask = capacity - 1;
+        std::vector<std::uint32_t> table(capacity, no_vertex);
+
+        for (const auto& found : owned_vertices) {
+            for (const auto vertex : found[thread_index]) {
+                const auto hash = hashes[vertex];
+                auto slot = static_cast<std::size_t>(hash) & mask;
+
+                while (table[slot] != no_vertex) {
+                    const auto candidate = table[slot];
+                    if (hashes[candidate] == hash && same_cells(candidate, vertex)) break;
+
+                    slot = (slot + 1) & mask;
+                }
+
+                if (table[slot] == no_vertex) table[slot] = vertex;
+                result.remap[vertex] = table[slot];
+            }
+        }
+    });
+
+    // Vertices only ever merge into earlier ones, which are numbered by the time they're needed.
+    std::uint32_t next_index = 0;
+    for (std::uint32_t vertex = 0; vertex < vertex_count; ++vertex) {
+        const auto first = result.remap[vertex];
+        result.remap[vertex] = first == vertex ? next_index++ : result.remap[first];
+    }
+
+    result.unique_vertex_count = next_index;
+
+    return result;
+}
+
+}
\ No newline at end of file
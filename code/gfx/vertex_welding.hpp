@@ -0,0 +1,54 @@
+#ifndef SQUADBOX_GFX_VERTEX_WELDING_HPP
+#define SQUADBOX_GFX_VERTEX_WELDING_HPP
+
+#pragma once
+
+#include <gsl/gsl>
+
+#include <cstdint>
+#include <vector>
+
+namespace squadbox::gfx {
+
+// Attributes are snapped to a grid with this spacing per component. Vertices whose attributes all land in the same
+// cells are merged, so values closer than the spacing usually merge, and exactly equal ones always do.
+struct vertex_weld_options {
+    float position_epsilon = 1.0e-5f;
+    float normal_epsilon = 1.0e-3f;
+    float tex_2d_coord_epsilon = 1.0f / 65536.0f;
+    float color_epsilon = 1.0f / 1024.0f;
+    // 0 uses every hardware thread.
+    unsigned int max_threads = 0;
+};
+
+struct vertex_weld_stats {
+    std::size_t vertices_before = 0;
+    std::size_t vertices_after = 0;
+    // Triangles that collapsed onto an edge or a point once their vertices merged.
+    std::size_t triangles_removed = 0;
+};
+
+// One attribute of every vertex, components tightly packed.
+struct vertex_weld_stream {
+    gsl::span<const float> values;
+    std::uint32_t components;
+    float epsilon;
+};
+
+struct vertex_weld_remap {
+    // New index of every vertex. Merged vertices all get the index of the first of them, and new indices are
+    // handed out in order of first occurrence, so unique vertices keep their relative order.
+    std::vector<std::uint32_t> remap;
+    std::uint32_t unique_vertex_count = 0;
+};
+
+// Vertex counts below this are welded on the calling thread only.
+constexpr std::size_t vertex_weld_parallel_threshold = 64 * 1024;
+
+// Quantizes the streams with SIMD and hashes every vertex, then dedupes with one hash table per thread, each owning
+// a range of hash values. Linear time in the vertex count.
+vertex_weld_remap weld_vertices(gsl::span<const vertex_weld_stream> streams, std::size_t vertex_count, unsigned int max_threads = 0);
+
+}
+
+#endif
\ No newline at end of file
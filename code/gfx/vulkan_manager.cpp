@@ -2,7 +2,10 @@
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <vector>
 
 namespace squadbox::gfx {
 
@@ -15,8 +18,15 @@ vulkan_manager::vulkan_manager(gsl::not_null<GLFWwindow*> window)
     }();
 
     m_instance = [](gsl::span<const char*> required_glfw_extensions) {
+        // 1.1 for descriptor update templates.
+        vk::ApplicationInfo app_info;
+        app_info
+            .setPApplicationName("squadbox")
+            .setApiVersion(VK_API_VERSION_1_1);
+
         vk::InstanceCreateInfo instance_ci;
         instance_ci
+            .setPApplicationInfo(&app_info)
             .setPpEnabledExtensionNames(!required_glfw_extensions.empty() ? required_glfw_extensions.data() : nullptr)
             .setEnabledExtensionCount(required_glfw_extensions.size());
 
@@ -74,7 +84,35 @@ vulkan_manager::vulkan_manager(gsl::not_null<GLFWwindow*> window)
         }
     }
 
-    m_device = [](const vk::PhysicalDevice& physical_device, std::uint32_t graphics_queue_family_index) {
+    const auto device_extensions = m_physical_device.enumerateDeviceExtensionProperties();
+    const auto has_device_extension = [&device_extensions](const char* name) {
+        return std::any_of(device_extensions.begin(), device_extensions.end(), [name](const vk::ExtensionProperties& extension) {
+            return std::strcmp(extension.extensionName, name) == 0;
+        });
+    };
+
+    m_supports_draw_indirect_count = has_device_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    m_supports_multi_draw_indirect = m_physical_device.getFeatures().multiDrawIndirect == VK_TRUE;
+    m_supports_draw_indirect_first_instance = m_physical_device.getFeatures().drawIndirectFirstInstance == VK_TRUE;
+
+    m_supports_descriptor_indexing = [](const vk::PhysicalDevice& physical_device, bool has_extension) {
+        if (!has_extension) return false;
+
+        auto features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>()
+            .get<vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+
+        return features.runtimeDescriptorArray
+            && features.descriptorBindingPartiallyBound
+            && features.descriptorBindingUpdateUnusedWhilePending
+            && features.descriptorBindingStorageBufferUpdateAfterBind
+            && features.descriptorBindingSampledImageUpdateAfterBind
+            && features.shaderStorageBufferArrayNonUniformIndexing
+            && features.shaderSampledImageArrayNonUniformIndexing;
+    }(m_physical_device, has_device_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME));
+
+    m_device = [](const vk::PhysicalDevice& physical_device, std::uint32_t graphics_queue_family_index,
+                  bool enable_descriptor_indexing, bool enable_draw_indirect_count, bool enable_multi_draw_indirect,
+                  bool enable_draw_indirect_first_instance) {
         vk::DeviceQueueCreateInfo queue_ci;
         float queue_priorities[] = { 0.0f };
         queue_ci
@@ -82,17 +120,46 @@ vulkan_manager::vulkan_manager(gsl::not_null<GLFWwindow*> window)
             .setQueueCount(1)
             .setPQueuePriorities(queue_priorities);
 
-        std::array<const char*, 1> device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        std::vector<const char*> device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+
+        vk::PhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features;
+        descriptor_indexing_features
+            .setRuntimeDescriptorArray(true)
+            .setDescriptorBindingPartiallyBound(true)
+            .setDescriptorBindingUpdateUnusedWhilePending(true)
+            .setDescriptorBindingStorageBufferUpdateAfterBind(true)
+            .setDescriptorBindingSampledImageUpdateAfterBind(true)
+            .setShaderStorageBufferArrayNonUniformIndexing(true)
+            .setShaderSampledImageArrayNonUniformIndexing(true);
+
+        if (enable_descriptor_indexing) {
+            device_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+
+        if (enable_draw_indirect_count) {
+            device_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+
+        vk::PhysicalDeviceFeatures enabled_features;
+        enabled_features
+            .setMultiDrawIndirect(enable_multi_draw_indirect)
+            .setDrawIndirectFirstInstance(enable_draw_indirect_first_instance);
 
         vk::DeviceCreateInfo device_ci;
         device_ci
+            .setPNext(enable_descriptor_indexing ? &descriptor_indexing_features : nullptr)
+            .setPEnabledFeatures(&enabled_features)
             .setPQueueCreateInfos(&queue_ci)
             .setQueueCreateInfoCount(1)
             .setPpEnabledExtensionNames(!device_extensions.empty() ? device_extensions.data() : nullptr)
             .setEnabledExtensionCount(device_extensions.size());
 
         return physical_device.createDeviceUnique(device_ci);
-    }(m_physical_device, m_graphics_queue_family_index);
+    }(m_physical_device, m_graphics_queue_family_index,
+      m_supports_descriptor_indexing, m_supports_draw_indirect_count, m_supports_multi_draw_indirect,
+      m_supports_draw_indirect_first_instance);
+
+    m_dispatch_loader = vk::DispatchLoaderDynamic { m_instance.get(), m_device.get() };
 
     {
         auto surface_formats = m_physical_device.getSurfaceFormatsKHR(m_surface.get());
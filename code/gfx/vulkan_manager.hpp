@@ -28,6 +28,15 @@ public:
     std::uint32_t present_queue_family_index() const { return m_present_queue_family_index; }
     const vk::SurfaceFormatKHR& surface_format() const { return m_surface_format; }
 
+    // VK_EXT_descriptor_indexing with update-after-bind, partially bound descriptor arrays.
+    bool supports_descriptor_indexing() const { return m_supports_descriptor_indexing; }
+    bool supports_draw_indirect_count() const { return m_supports_draw_indirect_count; }
+    bool supports_multi_draw_indirect() const { return m_supports_multi_draw_indirect; }
+    bool supports_draw_indirect_first_instance() const { return m_supports_draw_indirect_first_instance; }
+
+    // For extension entry points, which the loader doesn't export.
+    const vk::DispatchLoaderDynamic& dispatch_loader() const { return m_dispatch_loader; }
+
 private:
     gsl::not_null<GLFWwindow*> m_window;
 
@@ -39,6 +48,12 @@ private:
     std::size_t m_graphics_queue_family_index;
     std::size_t m_present_queue_family_index;
     vk::SurfaceFormatKHR m_surface_format;
+    bool m_supports_descriptor_indexing = false;
+    bool m_supports_draw_indirect_count = false;
+    bool m_supports_multi_draw_indirect = false;
+    bool m_supports_draw_indirect_first_instance = false;
+
+    vk::DispatchLoaderDynamic m_dispatch_loader;
 };
 
 }
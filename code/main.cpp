@@ -1,11 +1,16 @@
 #include "console_ui.hpp"
+#include "gfx/asset_importer.hpp"
+#include "gfx/frame_poller.hpp"
 #include "gfx/imgui_glue.hpp"
+#include "gfx/mesh_uploader.hpp"
 #include "gfx/render_manager.hpp"
 #include "gfx/vulkan_manager.hpp"
 #include "gfx/vulkan_utils.hpp"
 #include "gfx/glfw_wrappers.hpp"
 
 #include <chrono>
+#include <exception>
+#include <iostream>
 
 
 int main() {
@@ -21,8 +26,11 @@ int main() {
     gfx::vulkan_manager vulkan_manager { window.get() };
     gfx::render_manager render_manager { vulkan_manager };
     gfx::imgui_glue imgui_glue { window.get(), vulkan_manager, render_manager };
+    gfx::mesh_uploader mesh_uploader { vulkan_manager, render_manager.get_gpu_memory_pool() };
+    gfx::asset_importer asset_importer { mesh_uploader };
+    gfx::frame_poller frame_poller { vulkan_manager };
 
-    console_ui console_ui;
+    console_ui console_ui { vulkan_manager, render_manager, asset_importer, frame_poller };
 #if _DEBUG
     console_ui.show();
 #endif
@@ -76,6 +84,17 @@ int main() {
         {
             glfwPollEvents();
 
+            asset_importer.update();
+            mesh_uploader.release_completed();
+
+            // A coroutine that let an exception escape is dropped; the rest carry on.
+            try {
+                frame_poller.poll();
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Loading failed: " << e.what() << '\n';
+            }
+
             imgui_glue.new_frame(delta_time);
             console_ui.update();
         }
@@ -84,6 +103,7 @@ int main() {
         {
             render_manager.begin_frame();
 
+            console_ui.render(render_manager);
             render_manager.add_render_job(imgui_glue.render(render_manager.command_buffer_inheritance_info()));
 
             render_manager.end_frame();
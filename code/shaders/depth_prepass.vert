@@ -0,0 +1,20 @@
+#version 450
+
+// Must compute gl_Position exactly as the shading pass does, or its equal depth test drops pixels.
+layout(push_constant) uniform push_constants_t {
+    mat4 model_view;
+    mat4 projection;
+} pc;
+
+layout(location = 0) in vec3 in_pos;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+invariant gl_Position;
+
+
+void main() {
+    gl_Position = pc.projection * pc.model_view * vec4(in_pos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 450
+
+layout(push_constant) uniform push_constants_t {
+    mat4 view;
+    mat4 projection;
+} pc;
+
+layout(location = 0) in vec3 in_pos;
+
+layout(location = 1) in mat4 in_model;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+invariant gl_Position;
+
+
+void main() {
+    mat4 model_view = pc.view * in_model;
+    gl_Position = pc.projection * model_view * vec4(in_pos, 1.0);
+}
\ No newline at end of file
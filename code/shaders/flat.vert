@@ -1,4 +1,7 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "octahedral.glsl"
 
 layout(binding = 0) uniform ubo_t {
     mat4 model_view;
@@ -8,19 +11,22 @@ layout(binding = 0) uniform ubo_t {
 } ubo;
 
 layout(location = 0) in vec3 in_pos;
-layout(location = 1) in vec3 in_normal;
+layout(location = 1) in vec2 in_normal_oct;
 
 out gl_PerVertex {
     vec4 gl_Position;
 };
 
+// Drawn with an equal depth test after the depth prepass, which has to land on the same depth bit for bit.
+invariant gl_Position;
+
 layout(location = 0) /*smooth*/ out vec4 out_color;
 
 
 void main() {
     gl_Position = ubo.projection * ubo.model_view * vec4(in_pos, 1.0);
 
-    vec3 normal_mv = normalize(vec3(ubo.model_view * vec4(in_normal, 0.0)));
+    vec3 normal_mv = normalize(vec3(ubo.model_view * vec4(octahedral_decode(in_normal_oct), 0.0)));
     float angle_of_incidence = clamp(dot(normal_mv, vec3(0, 0, 1)), 0, 1);
 
     out_color = (ubo.model_color * angle_of_incidence) + (ubo.model_color * ubo.ambient_color);
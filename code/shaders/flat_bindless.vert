@@ -0,0 +1,49 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "octahedral.glsl"
+
+// Uniform ring buffers; an object is laid out as ubo_t in flat.vert.
+layout(set = 0, binding = 0) readonly buffer object_buffer_t {
+    vec4 data[];
+} object_buffers[];
+
+layout(push_constant) uniform push_constants_t {
+    uint object_buffer_id;
+    uint object_offset;     // in vec4s
+} pc;
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_normal_oct;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+invariant gl_Position;
+
+layout(location = 0) /*smooth*/ out vec4 out_color;
+
+
+void main() {
+    uint offset = pc.object_offset;
+
+    mat4 model_view = mat4(object_buffers[pc.object_buffer_id].data[offset + 0],
+                           object_buffers[pc.object_buffer_id].data[offset + 1],
+                           object_buffers[pc.object_buffer_id].data[offset + 2],
+                           object_buffers[pc.object_buffer_id].data[offset + 3]);
+    mat4 projection = mat4(object_buffers[pc.object_buffer_id].data[offset + 4],
+                           object_buffers[pc.object_buffer_id].data[offset + 5],
+                           object_buffers[pc.object_buffer_id].data[offset + 6],
+                           object_buffers[pc.object_buffer_id].data[offset + 7]);
+    vec4 model_color = object_buffers[pc.object_buffer_id].data[offset + 8];
+    vec4 ambient_color = object_buffers[pc.object_buffer_id].data[offset + 9];
+
+    gl_Position = projection * model_view * vec4(in_pos, 1.0);
+
+    vec3 normal_mv = normalize(vec3(model_view * vec4(octahedral_decode(in_normal_oct), 0.0)));
+    float angle_of_incidence = clamp(dot(normal_mv, vec3(0, 0, 1)), 0, 1);
+
+    out_color = (model_color * angle_of_incidence) + (model_color * ambient_color);
+}
\ No newline at end of file
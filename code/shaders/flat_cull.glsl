@@ -0,0 +1,200 @@
+// Shared by flat_cull.comp and flat_cull_occlusion.comp, which define OCCLUSION_CULLING.
+
+layout(local_size_x = 64) in;
+
+struct object_t {
+    mat4 model_matrix;
+    vec4 color;
+    vec4 bounding_sphere;
+};
+
+// VkDrawIndexedIndirectCommand
+struct draw_command_t {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+layout(set = 0, binding = 0) readonly buffer objects_t {
+    object_t objects[];
+};
+
+layout(set = 0, binding = 1) writeonly buffer draw_commands_t {
+    draw_command_t draw_commands[];
+};
+
+// One count per render_objects() call in the frame.
+layout(set = 0, binding = 2) buffer draw_counts_t {
+    uint draw_counts[];
+};
+
+#ifdef OCCLUSION_CULLING
+layout(set = 0, binding = 4) uniform sampler2D depth_pyramid;
+#endif
+
+// Clusters of the full detail level, each a contiguous index range.
+struct meshlet_t {
+    vec4 bounding_sphere;
+    vec4 cone;              // axis, cutoff
+    uint first_index;
+    uint index_count;
+    uint padding[2];
+};
+
+layout(set = 0, binding = 3) readonly buffer meshlets_t {
+    meshlet_t meshlets[];
+};
+
+struct lod_t {
+    uint first_index;
+    uint index_count;
+    float error;
+    uint padding;
+};
+
+layout(set = 1, binding = 0) uniform cull_ubo_t {
+    mat4 view_projection;
+    vec4 view_position;
+    vec4 frustum_planes[6];
+    lod_t lods[8];
+    vec2 depth_pyramid_size;
+    float lod_error_scale;
+    uint lod_count;
+    uint object_count;
+    uint compact;
+    uint meshlet_count;
+    uint draw_offset;       // the call's slice of draw_commands
+    uint count_index;       // and of draw_counts
+} cull_ubo;
+
+
+bool frustum_visible(vec3 center, float radius) {
+    bool visible = true;
+    for (int i = 0; i < 6; ++i) {
+        visible = visible && dot(cull_ubo.frustum_planes[i].xyz, center) + cull_ubo.frustum_planes[i].w >= -radius;
+    }
+
+    return visible;
+}
+
+#ifdef OCCLUSION_CULLING
+bool occlusion_visible(vec3 center, float radius) {
+    // Screen rectangle and nearest depth of the sphere's bounding box.
+    vec2 uv_min = vec2(1.0);
+    vec2 uv_max = vec2(0.0);
+    float nearest_depth = 1.0;
+
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = cull_ubo.view_projection * vec4(corner, 1.0);
+
+        // Crosses the near plane; can't be hidden.
+        if (clip.w <= 0.0) return true;
+
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 uv = ndc.xy * 0.5 + 0.5;
+
+        uv_min = min(uv_min, uv);
+        uv_max = max(uv_max, uv);
+        nearest_depth = min(nearest_depth, ndc.z);
+    }
+
+    uv_min = clamp(uv_min, 0.0, 1.0);
+    uv_max = clamp(uv_max, 0.0, 1.0);
+
+    // The level where the rectangle spans at most two texels each way, so its four corners cover it.
+    vec2 size = (uv_max - uv_min) * cull_ubo.depth_pyramid_size;
+    float level = ceil(log2(max(max(size.x, size.y), 1.0)));
+
+    float farthest_depth = max(
+        max(textureLod(depth_pyramid, uv_min, level).r, textureLod(depth_pyramid, vec2(uv_max.x, uv_min.y), level).r),
+        max(textureLod(depth_pyramid, vec2(uv_min.x, uv_max.y), level).r, textureLod(depth_pyramid, uv_max, level).r));
+
+    return nearest_depth <= farthest_depth;
+}
+#endif
+
+
+// Coarsest level whose error stays within the allowed pixels, judged at the nearest point of the bounds.
+uint select_lod(vec3 center, float radius, float scale) {
+    float distance = (cull_ubo.view_projection * vec4(center, 1.0)).w - radius;
+    if (distance <= 0.0) return 0;
+
+    for (uint lod = cull_ubo.lod_count - 1; lod > 0; --lod) {
+        if (cull_ubo.lods[lod].error * scale * cull_ubo.lod_error_scale <= distance) return lod;
+    }
+
+    return 0;
+}
+
+
+bool sphere_visible(vec3 center, float radius) {
+#ifdef OCCLUSION_CULLING
+    return frustum_visible(center, radius) && occlusion_visible(center, radius);
+#else
+    return frustum_visible(center, radius);
+#endif
+}
+
+// The whole cluster faces away from the camera.
+bool cone_culled(vec3 center, float radius, vec3 cone_axis, float cone_cutoff) {
+    vec3 to_center = center - cull_ubo.view_position.xyz;
+    return dot(to_center, cone_axis) >= cone_cutoff * length(to_center) + radius;
+}
+
+
+// One invocation per object and cluster slot. Objects drawn at full detail emit a draw per surviving cluster;
+// coarser levels, and meshes without clusters, draw whole from the object's first slot.
+void main() {
+    uint cluster_slots = max(cull_ubo.meshlet_count, 1);
+    uint draw_slot = gl_GlobalInvocationID.x;
+    if (draw_slot >= cull_ubo.object_count * cluster_slots) return;
+
+    uint object_index = draw_slot / cluster_slots;
+    uint cluster_index = draw_slot % cluster_slots;
+
+    mat4 model_matrix = objects[object_index].model_matrix;
+    vec4 bounding_sphere = objects[object_index].bounding_sphere;
+
+    vec3 center = vec3(model_matrix * vec4(bounding_sphere.xyz, 1.0));
+    float scale = max(length(model_matrix[0].xyz), max(length(model_matrix[1].xyz), length(model_matrix[2].xyz)));
+    float radius = bounding_sphere.w * scale;
+
+    bool visible = sphere_visible(center, radius);
+
+    uint lod_index = select_lod(center, radius, scale);
+    uint first_index = cull_ubo.lods[lod_index].first_index;
+    uint index_count = cull_ubo.lods[lod_index].index_count;
+
+    if (lod_index == 0 && cull_ubo.meshlet_count != 0) {
+        meshlet_t meshlet = meshlets[cluster_index];
+
+        vec3 cluster_center = vec3(model_matrix * vec4(meshlet.bounding_sphere.xyz, 1.0));
+        float cluster_radius = meshlet.bounding_sphere.w * scale;
+        // Assumes uniform scale, as the bounding spheres already do.
+        vec3 cone_axis = normalize(mat3(model_matrix) * meshlet.cone.xyz);
+
+        visible = visible
+               && !cone_culled(cluster_center, cluster_radius, cone_axis, meshlet.cone.w)
+               && sphere_visible(cluster_center, cluster_radius);
+
+        first_index = meshlet.first_index;
+        index_count = meshlet.index_count;
+    }
+    else {
+        visible = visible && cluster_index == 0;
+    }
+
+    // The vertex shader finds the object through gl_InstanceIndex.
+    if (cull_ubo.compact != 0) {
+        if (!visible) return;
+
+        uint draw_index = atomicAdd(draw_counts[cull_ubo.count_index], 1);
+        draw_commands[cull_ubo.draw_offset + draw_index] = draw_command_t(index_count, 1, first_index, 0, object_index);
+    }
+    else {
+        draw_commands[cull_ubo.draw_offset + draw_slot] = draw_command_t(index_count, visible ? 1 : 0, first_index, 0, object_index);
+    }
+}
\ No newline at end of file
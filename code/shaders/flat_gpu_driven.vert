@@ -0,0 +1,43 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "octahedral.glsl"
+
+struct object_t {
+    mat4 model_matrix;
+    vec4 color;
+    vec4 bounding_sphere;
+};
+
+layout(set = 0, binding = 0) uniform frame_ubo_t {
+    mat4 view;
+    mat4 projection;
+    vec4 ambient_color;
+} frame_ubo;
+
+layout(set = 1, binding = 0) readonly buffer objects_t {
+    object_t objects[];
+};
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_normal_oct;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location = 0) /*smooth*/ out vec4 out_color;
+
+
+void main() {
+    // The cull pass writes the object index as the draw's first instance.
+    object_t object = objects[gl_InstanceIndex];
+    mat4 model_view = frame_ubo.view * object.model_matrix;
+
+    gl_Position = frame_ubo.projection * model_view * vec4(in_pos, 1.0);
+
+    vec3 normal_mv = normalize(vec3(model_view * vec4(octahedral_decode(in_normal_oct), 0.0)));
+    float angle_of_incidence = clamp(dot(normal_mv, vec3(0, 0, 1)), 0, 1);
+
+    out_color = (object.color * angle_of_incidence) + (object.color * frame_ubo.ambient_color);
+}
\ No newline at end of file
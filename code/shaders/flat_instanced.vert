@@ -0,0 +1,37 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "octahedral.glsl"
+
+layout(binding = 0) uniform ubo_t {
+    mat4 model_view;    // view matrix, the model matrix comes per instance
+    mat4 projection;
+    vec4 model_color;   // tint applied to every instance
+    vec4 ambient_color;
+} ubo;
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_normal_oct;
+
+layout(location = 2) in mat4 in_model;
+layout(location = 6) in vec4 in_color;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+invariant gl_Position;
+
+layout(location = 0) /*smooth*/ out vec4 out_color;
+
+
+void main() {
+    mat4 model_view = ubo.model_view * in_model;
+    gl_Position = ubo.projection * model_view * vec4(in_pos, 1.0);
+
+    vec3 normal_mv = normalize(vec3(model_view * vec4(octahedral_decode(in_normal_oct), 0.0)));
+    float angle_of_incidence = clamp(dot(normal_mv, vec3(0, 0, 1)), 0, 1);
+
+    vec4 color = in_color * ubo.model_color;
+    out_color = (color * angle_of_incidence) + (color * ubo.ambient_color);
+}
\ No newline at end of file
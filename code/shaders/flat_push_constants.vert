@@ -0,0 +1,36 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "octahedral.glsl"
+
+layout(binding = 0) uniform frame_ubo_t {
+    mat4 projection;
+} frame_ubo;
+
+// Fits in the 128 bytes every implementation guarantees.
+layout(push_constant) uniform push_constants_t {
+    mat4 model_view;
+    vec4 model_color;
+    vec4 ambient_color;
+} pc;
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_normal_oct;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+invariant gl_Position;
+
+layout(location = 0) /*smooth*/ out vec4 out_color;
+
+
+void main() {
+    gl_Position = frame_ubo.projection * pc.model_view * vec4(in_pos, 1.0);
+
+    vec3 normal_mv = normalize(vec3(pc.model_view * vec4(octahedral_decode(in_normal_oct), 0.0)));
+    float angle_of_incidence = clamp(dot(normal_mv, vec3(0, 0, 1)), 0, 1);
+
+    out_color = (pc.model_color * angle_of_incidence) + (pc.model_color * pc.ambient_color);
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+// Normals packed by gpu_mesh as octahedral snorm pairs, see internal_gpu_mesh::octahedral_encode().
+
+vec3 octahedral_decode(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+
+    // Unfold the lower hemisphere.
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+
+    return normalize(normal);
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "duck.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <filesystem>
+
+namespace squadbox::test_scenes {
+
+duck::duck(const gfx::vulkan_manager& vulkan_manager, const gfx::render_manager& render_manager, gfx::asset_importer& asset_importer,
+           gfx::frame_poller& frame_poller)
+    : m_flat_shading(vulkan_manager, render_manager) {
+    // Cooked with: asset_cooker assets/duck.dae assets/duck.cooked
+    if (std::filesystem::exists("assets/duck.cooked")) {
+        frame_poller.spawn(load(frame_poller, asset_importer.import_cooked<gfx::render_techniques::flat_shading::mesh_type>("assets/duck.cooked")));
+    }
+    else {
+        frame_poller.spawn(load(frame_poller, asset_importer.import<gfx::render_techniques::flat_shading::mesh_type>("assets/duck.dae")));
+    }
+}
+
+gfx::task<> duck::load(gfx::frame_poller& frame_poller, std::future<std::vector<gfx::render_techniques::flat_shading::mesh_type>> import) {
+    // Resumed by the poll after asset_importer::update() completes the import.
+    try {
+        auto meshes = co_await frame_poller.ready(std::move(import));
+        m_loading = false;
+        if (meshes.empty()) co_return;
+
+        // Centered on the first mesh, wide enough for the rest.
+        m_bounds = meshes.front().bounding_sphere();
+        for (const auto& mesh : meshes) {
+            const auto& bounds = mesh.bounding_sphere();
+            m_bounds.radius = std::max(m_bounds.radius, glm::distance(m_bounds.center, bounds.center) + bounds.radius);
+        }
+
+        for (auto& mesh : meshes) {
+            m_render_data.push_back(m_flat_shading.prepare_render_data(std::move(mesh)));
+        }
+    }
+    catch (const std::exception& e) {
+        m_loading = false;
+        m_error = e.what();
+    }
+}
+
+void duck::render(gfx::render_thread& render_thread, const vk::Viewport& viewport) const {
+    if (m_render_data.empty()) return;
+
+    // Scaled to a unit sphere at the origin, so it fits the camera's depth range whatever units it was modelled in.
+    const auto model_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / std::max(m_bounds.radius, 1e-6f)))
+                            * glm::translate(glm::mat4(1.0f), -m_bounds.center);
+
+    gfx::camera camera;
+    camera.orient({ 0.0f, 0.5f, 2.0f }, { 0.0f, 0.0f, 0.0f });
+    camera.set_perspective(60.0f, viewport.width / viewport.height);
+
+    for (const auto& render_data : m_render_data) {
+        m_flat_shading.render(render_thread, render_data, viewport, camera, model_matrix,
+                              glm::vec4 { 1.0f, 0.85f, 0.1f, 1.0f }, glm::vec4 { 0.2f, 0.2f, 0.2f, 1.0f });
+    }
+}
+
+}
\ No newline at end of file
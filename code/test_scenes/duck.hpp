@@ -0,0 +1,47 @@
+#ifndef SQUADBOX_TEST_SCENES_DUCK_HPP
+#define SQUADBOX_TEST_SCENES_DUCK_HPP
+
+#pragma once
+
+#include "../gfx/asset_importer.hpp"
+#include "../gfx/bounds.hpp"
+#include "../gfx/camera.hpp"
+#include "../gfx/frame_poller.hpp"
+#include "../gfx/render_techniques/flat_shading.hpp"
+#include "../gfx/render_manager.hpp"
+#include "../gfx/task.hpp"
+
+#include <future>
+#include <string>
+#include <vector>
+
+namespace squadbox::test_scenes {
+
+// assets/duck.dae, or assets/duck.cooked if it's been cooked, imported in the background when the scene is created.
+// A coroutine on the frame poller picks up the meshes once the import is done, so the scene has to outlive the poller's
+// polls until then.
+class duck {
+public:
+    duck(const gfx::vulkan_manager& vulkan_manager, const gfx::render_manager& render_manager, gfx::asset_importer& asset_importer,
+         gfx::frame_poller& frame_poller);
+
+    // Nothing until the meshes are picked up. The camera frames the whole model.
+    void render(gfx::render_thread& render_thread, const vk::Viewport& viewport) const;
+
+    bool loading() const { return m_loading; }
+    // Empty unless the import failed.
+    const std::string& error() const { return m_error; }
+
+private:
+    gfx::task<> load(gfx::frame_poller& frame_poller, std::future<std::vector<gfx::render_techniques::flat_shading::mesh_type>> import);
+
+    gfx::render_techniques::flat_shading m_flat_shading;
+    bool m_loading = true;
+    std::vector<gfx::render_techniques::flat_shading::render_data> m_render_data;
+    gfx::bounding_sphere m_bounds;
+    std::string m_error;
+};
+
+}
+
+#endif
\ No newline at end of file
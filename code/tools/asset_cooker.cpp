@@ -0,0 +1,100 @@
+// Cooks model files into the binary format gpu_mesh::load() reads (see gfx/cooked_mesh.hpp), in the vertex layout
+// flat_shading draws with. Every mesh of the model goes through the same processing as a runtime import.
+//
+//   asset_cooker [--no-lods] [--lod <level>] [--meshlets] [--strips] [--depth-positions] [--uncompressed] <model> <output>
+//
+// Meshes cooked with --strips or --depth-positions need the matching flat_shading options to be drawn. Buffers are
+// compressed (see gfx/mesh_codec.hpp) unless --uncompressed. --lod cooks a single generated level of detail on its
+// own (0 being full detail), e.g. as the coarse level a residency_manager streams in first.
+
+#include "../gfx/cooked_mesh.hpp"
+#include "../gfx/mesh_import.hpp"
+#include "../gfx/render_techniques/flat_shading.hpp"
+
+#include <assimp/Importer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    using namespace squadbox;
+    using mesh_type = gfx::render_techniques::flat_shading::mesh_type;
+
+    gfx::asset_import_options options;
+    auto topology = gfx::index_topology::triangle_list;
+    bool depth_positions = false;
+    bool compress = true;
+    int lod_level = -1;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--no-lods") == 0) options.generate_lods = false;
+        else if (std::strcmp(argv[i], "--lod") == 0 && i + 1 < argc) lod_level = std::max(std::atoi(argv[++i]), 0);
+        else if (std::strcmp(argv[i], "--meshlets") == 0) options.generate_meshlets = true;
+        else if (std::strcmp(argv[i], "--strips") == 0) topology = gfx::index_topology::triangle_strip;
+        else if (std::strcmp(argv[i], "--depth-positions") == 0) depth_positions = true;
+        else if (std::strcmp(argv[i], "--uncompressed") == 0) compress = false;
+        else paths.emplace_back(argv[i]);
+    }
+
+    if (paths.size() != 2) {
+        std::cerr << "Usage: asset_cooker [--no-lods] [--lod <level>] [--meshlets] [--strips] [--depth-positions] [--uncompressed] <model> <output>\n";
+        return 1;
+    }
+
+    // Meshlets are generated, and the vertex order optimized, for the level kept once it's full detail.
+    const bool generate_meshlets = options.generate_meshlets;
+    if (lod_level >= 0) {
+        options.generate_lods = true;
+        options.generate_meshlets = false;
+        options.optimize_vertex_order = false;
+    }
+
+    try {
+        const auto start_time = std::chrono::high_resolution_clock::now();
+
+        Assimp::Importer importer;
+        const auto ai_meshes = gfx::read_triangle_meshes(importer, paths[0]);
+
+        std::vector<gfx::cooked_mesh> cooked_meshes;
+        cooked_meshes.reserve(ai_meshes.size());
+
+        std::size_t total_bytes = 0;
+
+        for (const auto ai_mesh : ai_meshes) {
+            auto imported = gfx::process_imported_mesh(*ai_mesh, options);
+            if (lod_level >= 0) {
+                imported.mesh.keep_lod(static_cast<std::uint32_t>(lod_level));
+
+                if (generate_meshlets) imported.mesh.generate_meshlets();
+                imported.vertex_cache = imported.mesh.optimize_vertex_order();
+            }
+
+            cooked_meshes.push_back(mesh_type::cook(imported.mesh, topology, depth_positions));
+
+            total_bytes += cooked_meshes.back().data.size();
+            std::cout << imported.name << ": " << imported.mesh.positions().size() << " vertices, "
+                      << imported.mesh.triangle_list_indices().size() / 3 << " triangles, "
+                      << imported.mesh.lods().size() << " levels of detail, " << imported.mesh.meshlets().size() << " meshlets, ACMR "
+                      << imported.vertex_cache.acmr_before << " -> " << imported.vertex_cache.acmr_after << '\n';
+        }
+
+        gfx::write_cooked_meshes(paths[1], cooked_meshes, compress);
+
+        const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+        std::cout << "Cooked " << cooked_meshes.size() << " meshes (" << total_bytes / 1024 << " KiB of buffers) into " << paths[1]
+                  << " (" << std::filesystem::file_size(paths[1]) / 1024 << " KiB) in " << elapsed.count() << " s\n";
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file